@@ -8,6 +8,7 @@ set KEYFILE="..\Crypto\Keys\AES-256-Key.txt"
 %METACOMP% %INPATH%\Fonts.mta %OUTPATH%\Fonts.emta %KEYFILE% > nul
 %METACOMP% %INPATH%\Interface.mta %OUTPATH%\Interface.emta %KEYFILE% > nul
 %METACOMP% %INPATH%\Maps.mta %OUTPATH%\Maps.emta %KEYFILE% > nul
+%METACOMP% %INPATH%\Network.mta %OUTPATH%\Network.emta %KEYFILE% > nul
 %METACOMP% %INPATH%\Sounds.mta %OUTPATH%\Sounds.emta %KEYFILE% > nul
 %METACOMP% %INPATH%\Sprites.mta %OUTPATH%\Sprites.emta %KEYFILE% > nul
 %METACOMP% %INPATH%\Strings.mta %OUTPATH%\Strings.emta %KEYFILE% > nul
\ No newline at end of file
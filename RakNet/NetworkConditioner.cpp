@@ -0,0 +1,361 @@
+#include "NetworkConditioner.h"
+#include "GetTime.h"
+#include <string.h>
+
+// Defined in RakPeer.cpp
+extern void ProcessNetworkPacket( const unsigned int binaryAddress, const unsigned short port, const char *data, const int length, RakPeer *rakPeer, unsigned connectionSocketIndex );
+
+NetworkConditions::NetworkConditions()
+{
+	latency=0;
+	jitter=0;
+	lossChance=0.0f;
+	duplicateChance=0.0f;
+	reorderChance=0.0f;
+	reorderDelay=0;
+	bytesPerSecond=0;
+}
+
+bool NetworkConditions::IsActive( void ) const
+{
+	return latency > 0 || jitter > 0 || lossChance > 0.0f || duplicateChance > 0.0f || reorderChance > 0.0f || bytesPerSecond > 0;
+}
+
+NetworkConditioner::NetworkConditioner()
+{
+	active=false;
+	delivering=false;
+	randomState=1;
+	nextPruneTime=0;
+	memset( &statistics, 0, sizeof( statistics ) );
+}
+
+NetworkConditioner::~NetworkConditioner()
+{
+	Clear();
+
+	unsigned i;
+	for ( i = 0; i < links.Size(); i++ )
+		delete links[ i ];
+	links.Clear();
+}
+
+void NetworkConditioner::SetConditions( const NetworkConditions &conditions, const SystemAddress systemAddress )
+{
+	linksMutex.Lock();
+
+	if ( systemAddress == UNASSIGNED_SYSTEM_ADDRESS )
+		defaultConditions=conditions;
+	else
+	{
+		Link *link = GetLink( systemAddress );
+
+		if ( conditions.IsActive() )
+		{
+			if ( link == 0 )
+				link = AddLink( systemAddress );
+
+			link->conditions=conditions;
+			link->hasConditions=true;
+		}
+		// Pruned once its datagrams have been delivered
+		else if ( link )
+			link->hasConditions=false;
+	}
+
+	UpdateActive();
+
+	linksMutex.Unlock();
+}
+
+NetworkConditions NetworkConditioner::GetConditions( const SystemAddress systemAddress )
+{
+	NetworkConditions conditions;
+
+	linksMutex.Lock();
+
+	if ( systemAddress != UNASSIGNED_SYSTEM_ADDRESS && links.Has( systemAddress ) && links.Get( systemAddress )->hasConditions )
+		conditions=links.Get( systemAddress )->conditions;
+	else
+		conditions=defaultConditions;
+
+	linksMutex.Unlock();
+
+	return conditions;
+}
+
+void NetworkConditioner::SetSeed( unsigned int seed )
+{
+	linksMutex.Lock();
+	// The generator sticks at zero, so that seed is moved
+	randomState = seed ? seed : 0x9E3779B9;
+	linksMutex.Unlock();
+}
+
+NetworkConditionerStatistics NetworkConditioner::GetStatistics( void )
+{
+	linksMutex.Lock();
+	NetworkConditionerStatistics copy = statistics;
+	linksMutex.Unlock();
+
+	return copy;
+}
+
+bool NetworkConditioner::Send( SOCKET s, const char *data, int length, const SystemAddress systemAddress )
+{
+	return Condition( data, length, systemAddress, false, s, 0 );
+}
+
+bool NetworkConditioner::Receive( const char *data, int length, const SystemAddress systemAddress, unsigned connectionSocketIndex )
+{
+	// Datagrams being delivered have already been conditioned
+	if ( delivering )
+		return false;
+
+	return Condition( data, length, systemAddress, true, (SOCKET) -1, connectionSocketIndex );
+}
+
+void NetworkConditioner::Update( RakPeer *rakPeer )
+{
+	if ( datagrams.Size() == 0 && links.Size() == 0 )
+		return;
+
+	RakNetTimeNS time = RakNet::GetTimeNS();
+
+	if ( time >= nextPruneTime )
+	{
+		PruneLinks( time );
+		nextPruneTime = time + (RakNetTimeNS) NETWORK_CONDITIONER_PRUNE_INTERVAL * 1000;
+	}
+
+	delivering=true;
+
+	while ( datagrams.Size() > 0 && datagrams.PeekWeight() <= time )
+	{
+		Datagram *datagram = datagrams.Pop( 0 );
+
+		if ( datagram->incoming )
+			ProcessNetworkPacket( datagram->systemAddress.binaryAddress, datagram->systemAddress.port, datagram->data, datagram->length, rakPeer, datagram->connectionSocketIndex );
+		else
+			SocketLayer::Instance()->SendTo( datagram->s, datagram->data, datagram->length, datagram->systemAddress.binaryAddress, datagram->systemAddress.port );
+
+		freeDatagrams.Insert( datagram );
+	}
+
+	delivering=false;
+}
+
+RakNetTimeNS NetworkConditioner::GetNextDeliveryTime( RakNetTimeNS maxTime )
+{
+	if ( datagrams.Size() > 0 && datagrams.PeekWeight() < maxTime )
+		return datagrams.PeekWeight();
+
+	return maxTime;
+}
+
+void NetworkConditioner::Clear( void )
+{
+	while ( datagrams.Size() > 0 )
+		delete datagrams.Pop( 0 );
+
+	unsigned i;
+	for ( i = 0; i < freeDatagrams.Size(); i++ )
+		delete freeDatagrams[ i ];
+	freeDatagrams.Clear();
+
+	// The held datagrams are gone, so the links start out empty again and only those with their own conditions are kept
+	linksMutex.Lock();
+	i = links.Size();
+	while ( i-- > 0 )
+	{
+		if ( links[ i ]->hasConditions )
+		{
+			links[ i ]->lastDeliveryTime[ 0 ] = links[ i ]->lastDeliveryTime[ 1 ] = 0;
+			links[ i ]->nextFreeTime[ 0 ] = links[ i ]->nextFreeTime[ 1 ] = 0;
+		}
+		else
+		{
+			delete links[ i ];
+			links.RemoveAtIndex( i );
+		}
+	}
+	linksMutex.Unlock();
+}
+
+bool NetworkConditioner::Condition( const char *data, int length, const SystemAddress systemAddress, bool incoming, SOCKET s, unsigned connectionSocketIndex )
+{
+	if ( active == false || length <= 0 || length > MAXIMUM_MTU_SIZE )
+		return false;
+
+	linksMutex.Lock();
+
+	Link *link = GetLink( systemAddress );
+	NetworkConditions conditions = ( link && link->hasConditions ) ? link->conditions : defaultConditions;
+
+	if ( conditions.IsActive() == false )
+	{
+		linksMutex.Unlock();
+		return false;
+	}
+
+	statistics.datagramsConditioned++;
+
+	if ( RandomChance( conditions.lossChance ) )
+	{
+		statistics.datagramsLost++;
+		linksMutex.Unlock();
+		return true;
+	}
+
+	// A system under the default conditions only gets a link while it has datagrams in flight
+	if ( link == 0 )
+		link = AddLink( systemAddress );
+
+	RakNetTimeNS time = RakNet::GetTimeNS();
+	int direction = incoming ? 1 : 0;
+
+	// Under a bandwidth limit the datagram starts once the link has finished with the ones ahead of it, and arrives once it has all gone
+	if ( conditions.bytesPerSecond > 0 )
+	{
+		if ( link->nextFreeTime[ direction ] > time + (RakNetTimeNS) NETWORK_CONDITIONER_MAX_QUEUE_TIME * 1000 )
+		{
+			statistics.datagramsOverflowed++;
+			linksMutex.Unlock();
+			return true;
+		}
+
+		if ( link->nextFreeTime[ direction ] > time )
+			time = link->nextFreeTime[ direction ];
+
+		time += (RakNetTimeNS) length * 1000000 / conditions.bytesPerSecond;
+		link->nextFreeTime[ direction ] = time;
+	}
+
+	RakNetTimeNS deliveryTime = time + (RakNetTimeNS) conditions.latency * 1000;
+
+	if ( conditions.jitter > 0 )
+		deliveryTime += RandomInt( (unsigned int) conditions.jitter * 1000 + 1 );
+
+	if ( RandomChance( conditions.reorderChance ) )
+	{
+		// Held back without moving the link on, so the datagrams behind it arrive first
+		deliveryTime += 1 + RandomInt( (unsigned int) conditions.reorderDelay * 1000 + 1 );
+		statistics.datagramsReordered++;
+	}
+	else
+	{
+		if ( deliveryTime <= link->lastDeliveryTime[ direction ] )
+			deliveryTime = link->lastDeliveryTime[ direction ] + 1;
+
+		link->lastDeliveryTime[ direction ] = deliveryTime;
+	}
+
+	Hold( data, length, systemAddress, incoming, s, connectionSocketIndex, deliveryTime );
+
+	if ( RandomChance( conditions.duplicateChance ) )
+	{
+		Hold( data, length, systemAddress, incoming, s, connectionSocketIndex, deliveryTime + 1 + RandomInt( (unsigned int) conditions.jitter * 1000 + 1 ) );
+		statistics.datagramsDuplicated++;
+	}
+
+	linksMutex.Unlock();
+
+	return true;
+}
+
+void NetworkConditioner::Hold( const char *data, int length, const SystemAddress systemAddress, bool incoming, SOCKET s, unsigned connectionSocketIndex, RakNetTimeNS deliveryTime )
+{
+	Datagram *datagram;
+
+	if ( freeDatagrams.Size() > 0 )
+	{
+		datagram = freeDatagrams[ freeDatagrams.Size() - 1 ];
+		freeDatagrams.RemoveFromEnd();
+	}
+	else
+		datagram = new Datagram;
+
+	datagram->systemAddress=systemAddress;
+	datagram->s=s;
+	datagram->connectionSocketIndex=connectionSocketIndex;
+	datagram->incoming=incoming;
+	datagram->length=length;
+	memcpy( datagram->data, data, length );
+
+	datagrams.Push( deliveryTime, datagram );
+}
+
+NetworkConditioner::Link* NetworkConditioner::GetLink( const SystemAddress systemAddress )
+{
+	if ( links.Has( systemAddress ) )
+		return links.Get( systemAddress );
+
+	return 0;
+}
+
+NetworkConditioner::Link* NetworkConditioner::AddLink( const SystemAddress systemAddress )
+{
+	Link *link = new Link;
+	link->hasConditions=false;
+	link->lastDeliveryTime[ 0 ] = link->lastDeliveryTime[ 1 ] = 0;
+	link->nextFreeTime[ 0 ] = link->nextFreeTime[ 1 ] = 0;
+
+	links.Set( systemAddress, link );
+
+	return link;
+}
+
+void NetworkConditioner::PruneLinks( RakNetTimeNS time )
+{
+	linksMutex.Lock();
+
+	unsigned i = links.Size();
+	while ( i-- > 0 )
+	{
+		Link *link = links[ i ];
+
+		if ( link->hasConditions == false &&
+			link->lastDeliveryTime[ 0 ] < time && link->lastDeliveryTime[ 1 ] < time &&
+			link->nextFreeTime[ 0 ] < time && link->nextFreeTime[ 1 ] < time )
+		{
+			delete link;
+			links.RemoveAtIndex( i );
+		}
+	}
+
+	linksMutex.Unlock();
+}
+
+void NetworkConditioner::UpdateActive( void )
+{
+	bool anyActive = defaultConditions.IsActive();
+
+	unsigned i;
+	for ( i = 0; i < links.Size() && anyActive == false; i++ )
+		anyActive = links[ i ]->hasConditions;
+
+	active=anyActive;
+}
+
+unsigned int NetworkConditioner::RandomInt( void )
+{
+	// Xorshift, which is cheap and gives the same sequence for the same seed on every platform
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+
+	return randomState;
+}
+
+unsigned int NetworkConditioner::RandomInt( unsigned int limit )
+{
+	return RandomInt() % limit;
+}
+
+bool NetworkConditioner::RandomChance( float chance )
+{
+	if ( chance <= 0.0f )
+		return false;
+
+	return (float) ( RandomInt() >> 8 ) * ( 1.0f / 16777216.0f ) < chance;
+}
@@ -0,0 +1,153 @@
+/// \file
+/// \brief Simulates a bad link by conditioning the datagrams passed between RakPeer and SocketLayer, so that games can be tested under latency, jitter, loss, duplication, reordering and bandwidth limits without external tools.
+
+#ifndef __NETWORK_CONDITIONER_H
+#define __NETWORK_CONDITIONER_H
+
+#include "RakMemoryOverride.h"
+#include "RakNetTypes.h"
+#include "SocketLayer.h"
+#include "MTUSize.h"
+#include "DS_Heap.h"
+#include "DS_List.h"
+#include "DS_Map.h"
+#include "SimpleMutex.h"
+#include "Export.h"
+
+class RakPeer;
+
+/// The most time in ms that datagrams can queue behind a bandwidth limit before more are dropped, as a router's queue would
+#define NETWORK_CONDITIONER_MAX_QUEUE_TIME 1000
+
+/// How often in ms the links to systems without their own conditions are pruned once their datagrams have all been delivered
+#define NETWORK_CONDITIONER_PRUNE_INTERVAL 1000
+
+/// The conditions on the link to a system. Each direction is conditioned separately, so the latency is added twice to the round trip.
+struct RAK_DLL_EXPORT NetworkConditions
+{
+	NetworkConditions();
+
+	/// \return If any of the conditions would change the datagrams
+	bool IsActive( void ) const;
+
+	/// The time in ms added to every datagram
+	unsigned short latency;
+	/// The most time in ms randomly added on top of the latency. Jitter alone doesn't reorder datagrams.
+	unsigned short jitter;
+	/// The chance, from 0 to 1, of dropping a datagram
+	float lossChance;
+	/// The chance, from 0 to 1, of delivering a datagram twice
+	float duplicateChance;
+	/// The chance, from 0 to 1, of holding a datagram back so that the datagrams behind it overtake it
+	float reorderChance;
+	/// The most time in ms a reordered datagram is held back
+	unsigned short reorderDelay;
+	/// The bytes per second each direction can carry, or 0 for no limit
+	unsigned int bytesPerSecond;
+};
+
+/// What the conditioner has done to the datagrams since it was created
+struct RAK_DLL_EXPORT NetworkConditionerStatistics
+{
+	unsigned int datagramsConditioned;
+	unsigned int datagramsLost;
+	unsigned int datagramsOverflowed;
+	unsigned int datagramsDuplicated;
+	unsigned int datagramsReordered;
+};
+
+/// Holds back, drops, duplicates and reorders the datagrams to and from each system according to its conditions.
+/// Conditions can be set from any thread. Everything else is called by RakPeer from its update thread.
+class RAK_DLL_EXPORT NetworkConditioner : public RakNet::RakMemoryOverride
+{
+public:
+	NetworkConditioner();
+	~NetworkConditioner();
+
+	/// Set the conditions on the link to a system
+	/// \param[in] conditions The conditions to apply. Inactive conditions return the system to the default conditions.
+	/// \param[in] systemAddress The system to apply them to, or UNASSIGNED_SYSTEM_ADDRESS to set the default conditions for every system without its own
+	void SetConditions( const NetworkConditions &conditions, const SystemAddress systemAddress );
+
+	/// \param[in] systemAddress The system to get the conditions for, or UNASSIGNED_SYSTEM_ADDRESS for the default conditions
+	/// \return The conditions that apply to the link to a system
+	NetworkConditions GetConditions( const SystemAddress systemAddress );
+
+	/// Seed the random numbers, so that the same datagrams get the same treatment on every run
+	/// \param[in] seed The seed value
+	void SetSeed( unsigned int seed );
+
+	/// \return What has been done to the datagrams since the conditioner was created
+	NetworkConditionerStatistics GetStatistics( void );
+
+	/// \internal Hold on to an outgoing datagram if there are conditions on the link to the system
+	/// \return True if the conditioner has taken the datagram, false if it should be sent as normal
+	bool Send( SOCKET s, const char *data, int length, const SystemAddress systemAddress );
+
+	/// \internal Hold on to an incoming datagram if there are conditions on the link to the system
+	/// \return True if the conditioner has taken the datagram, false if it should be processed as normal
+	bool Receive( const char *data, int length, const SystemAddress systemAddress, unsigned connectionSocketIndex );
+
+	/// \internal Send and process the datagrams that are due
+	void Update( RakPeer *rakPeer );
+
+	/// \internal
+	/// \return The time the next datagram is due, or maxTime if that is sooner
+	RakNetTimeNS GetNextDeliveryTime( RakNetTimeNS maxTime );
+
+	/// \internal Free every datagram still held, once the sockets are closed
+	void Clear( void );
+
+protected:
+	struct Datagram
+	{
+		SystemAddress systemAddress;
+		SOCKET s;
+		unsigned connectionSocketIndex;
+		bool incoming;
+		int length;
+		char data[ MAXIMUM_MTU_SIZE ];
+	};
+
+	struct Link
+	{
+		NetworkConditions conditions;
+		bool hasConditions;
+		/// The time the last datagram in order is due, for each direction
+		RakNetTimeNS lastDeliveryTime[ 2 ];
+		/// The time the bandwidth limit lets the next datagram start, for each direction
+		RakNetTimeNS nextFreeTime[ 2 ];
+	};
+
+	bool Condition( const char *data, int length, const SystemAddress systemAddress, bool incoming, SOCKET s, unsigned connectionSocketIndex );
+	void Hold( const char *data, int length, const SystemAddress systemAddress, bool incoming, SOCKET s, unsigned connectionSocketIndex, RakNetTimeNS deliveryTime );
+	/// \return The link to a system, or 0 if there isn't one
+	Link* GetLink( const SystemAddress systemAddress );
+	Link* AddLink( const SystemAddress systemAddress );
+	/// Remove the links without their own conditions that no longer have datagrams in flight, as they are the same as a new link
+	void PruneLinks( RakNetTimeNS time );
+	void UpdateActive( void );
+	unsigned int RandomInt( void );
+	unsigned int RandomInt( unsigned int limit );
+	bool RandomChance( float chance );
+
+	NetworkConditions defaultConditions;
+	/// The links to systems with their own conditions, and to systems under the default conditions while their datagrams are in flight
+	DataStructures::Map<SystemAddress, Link*> links;
+	SimpleMutex linksMutex;
+	RakNetTimeNS nextPruneTime;
+
+	/// Checked without the mutex, so that nothing is locked while there are no conditions
+	volatile bool active;
+
+	/// Set while due incoming datagrams are processed, so that they aren't held again
+	bool delivering;
+
+	DataStructures::Heap<RakNetTimeNS, Datagram*, false> datagrams;
+	DataStructures::List<Datagram*> freeDatagrams;
+
+	unsigned int randomState;
+	NetworkConditionerStatistics statistics;
+};
+
+#endif
@@ -26,6 +26,11 @@
 #include <unistd.h>
 #endif
 
+#if defined(__linux__) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #include <ctype.h> // toupper
 #include <string.h>
 #include "GetTime.h"
@@ -193,6 +198,10 @@ RakPeer::RakPeer()
 	occasionalPing = false;
 	connectionSockets = 0;
 	connectionSocketsLength=0;
+#ifdef SOCKET_LAYER_BATCHED_IO
+	receiveBatch = 0;
+	sendBatch = 0;
+#endif
 	mySystemAddress = UNASSIGNED_SYSTEM_ADDRESS;
 	allowConnectionResponseIPMigration = false;
 	blockOnRPCReply=false;
@@ -215,6 +224,9 @@ RakPeer::RakPeer()
 
 #if defined (_WIN32) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
 	recvEvent = INVALID_HANDLE_VALUE;
+#elif defined(__linux__) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
+	recvEpoll = -1;
+	wakeEvent = -1;
 #endif
 
 #ifndef _RELEASE
@@ -240,6 +252,10 @@ RakPeer::~RakPeer()
 
 	Shutdown( 0, 0);
 
+#ifdef SOCKET_LAYER_BATCHED_IO
+	delete receiveBatch;
+	delete sendBatch;
+#endif
 
 	StringCompressor::RemoveReference();
 	RakNet::StringTable::RemoveReference();
@@ -284,6 +300,21 @@ bool RakPeer::Startup( unsigned short maxConnections, int _threadSleepTimer, Soc
 	connectionSocketsLength=0;
 
 	connectionSockets=new SOCKET[socketDescriptorCount];
+#ifdef SOCKET_LAYER_BATCHED_IO
+	if (SocketLayer::Instance()->IsBatchedIO())
+	{
+		if (receiveBatch==0)
+			receiveBatch=new SocketLayerBatch;
+		if (sendBatch==0)
+			sendBatch=new SocketLayerBatch;
+	}
+	else
+	{
+		delete receiveBatch;
+		delete sendBatch;
+		receiveBatch=sendBatch=0;
+	}
+#endif
 	for (i=0; i<socketDescriptorCount; i++)
 	{
 		connectionSockets[i] = SocketLayer::Instance()->CreateBoundSocket( socketDescriptors[i].port, true, socketDescriptors[i].hostAddress );
@@ -309,6 +340,34 @@ bool RakPeer::Startup( unsigned short maxConnections, int _threadSleepTimer, Soc
 		for (i=0; i<socketDescriptorCount; i++)
 			WSAEventSelect(connectionSockets[i],recvEvent,FD_READ);
 	}
+#elif defined(__linux__) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
+	if (_threadSleepTimer>0)
+	{
+		recvEpoll=epoll_create(1);
+		wakeEvent=eventfd(0,EFD_NONBLOCK);
+		if (recvEpoll!=-1 && wakeEvent!=-1)
+		{
+			epoll_event readEvent;
+			memset(&readEvent,0,sizeof(readEvent));
+			readEvent.events=EPOLLIN;
+			for (i=0; i<socketDescriptorCount; i++)
+			{
+				readEvent.data.fd=connectionSockets[i];
+				epoll_ctl(recvEpoll,EPOLL_CTL_ADD,connectionSockets[i],&readEvent);
+			}
+			readEvent.data.fd=wakeEvent;
+			epoll_ctl(recvEpoll,EPOLL_CTL_ADD,wakeEvent,&readEvent);
+		}
+		else
+		{
+			// Without both the update thread falls back to polling
+			if (recvEpoll!=-1)
+				close(recvEpoll);
+			if (wakeEvent!=-1)
+				close(wakeEvent);
+			recvEpoll=wakeEvent=-1;
+		}
+	}
 #endif
 
 	if ( maximumNumberOfPeers == 0 )
@@ -339,6 +398,7 @@ bool RakPeer::Startup( unsigned short maxConnections, int _threadSleepTimer, Soc
 			#ifndef _RELEASE
 			remoteSystemList[ i ].reliabilityLayer.ApplyNetworkSimulator(_maxSendBPS, _minExtraPing, _extraPingVariance);
 			#endif
+			remoteSystemList[ i ].reliabilityLayer.SetNetworkConditioner(&networkConditioner);
 		}
 
 		// Clear the lookup table.  Safe to call from the user thread since the network thread is now stopped
@@ -813,12 +873,18 @@ void RakPeer::Shutdown( unsigned int blockDuration, unsigned char orderingChanne
 	}
 
 
+	endThreads = true;
+	SignalUpdateThread();
+
 	while ( isMainLoopThreadActive )
 	{
 		endThreads = true;
 		RakSleep(15);
 	}
 
+	// Anything the conditioner still holds was meant for sockets that are about to close
+	networkConditioner.Clear();
+
 	// remoteSystemList in Single thread
 	for ( i = 0; i < systemListSize; i++ )
 	{
@@ -884,6 +950,13 @@ void RakPeer::Shutdown( unsigned int blockDuration, unsigned char orderingChanne
 		CloseHandle( recvEvent );
 		recvEvent = INVALID_HANDLE_VALUE;
 	}
+#elif defined(__linux__) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
+	if (recvEpoll!=-1)
+	{
+		close( recvEpoll );
+		close( wakeEvent );
+		recvEpoll = wakeEvent = -1;
+	}
 #endif
 
 	// Clear out the reliability layer list in case we want to reallocate it in a successive call to Init.
@@ -2654,6 +2727,14 @@ bool RakPeer::IsNetworkSimulatorActive( void )
 #endif
 }
 
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Returns the conditioner that simulates a bad link to each system
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+NetworkConditioner* RakPeer::GetNetworkConditioner( void )
+{
+	return &networkConditioner;
+}
+
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // For internal use
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -2882,6 +2963,8 @@ bool RakPeer::SendConnectionRequest( const char* host, unsigned short remotePort
 	requestedConnectionQueue.Push(rcs);
 	requestedConnectionQueueMutex.Unlock();
 
+	SignalUpdateThread();
+
 	return true;
 }
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -3729,6 +3812,7 @@ void RakPeer::CloseConnectionInternal( const SystemAddress target, bool sendDisc
 #ifdef _RAKNET_THREADSAFE
 			rakPeerMutexes[bufferedCommands_Mutex].Unlock();
 #endif
+			SignalUpdateThread();
 		}
 	}
 }
@@ -3781,6 +3865,8 @@ void RakPeer::SendBuffered( const char *data, BitSize_t numberOfBitsToSend, Pack
 #ifdef _RAKNET_THREADSAFE
 	rakPeerMutexes[bufferedCommands_Mutex].Unlock();
 #endif
+
+	SignalUpdateThread();
 }
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void RakPeer::SendBufferedList( char **data, const int *lengths, const int numParameters, PacketPriority priority, PacketReliability reliability, char orderingChannel, SystemAddress systemAddress, bool broadcast, RemoteSystemStruct::ConnectMode connectionMode )
@@ -3829,6 +3915,60 @@ void RakPeer::SendBufferedList( char **data, const int *lengths, const int numPa
 #ifdef _RAKNET_THREADSAFE
 	rakPeerMutexes[bufferedCommands_Mutex].Unlock();
 #endif
+
+	SignalUpdateThread();
+}
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RakPeer::SignalUpdateThread(void)
+{
+#if defined (_WIN32) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
+	if (recvEvent!=INVALID_HANDLE_VALUE)
+		SetEvent(recvEvent);
+#elif defined(__linux__) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
+	if (wakeEvent!=-1)
+	{
+		eventfd_t signal=1;
+		if (write(wakeEvent,&signal,sizeof(signal))<0)
+		{
+			// The counter is already set, so the update thread will wake anyway
+		}
+	}
+#endif
+}
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+RakNetTime RakPeer::GetUpdateWaitTime(void)
+{
+	// Anything queued since the update cycle read the buffered commands is handled straight away
+	if (bufferedCommands.Size() > 0)
+		return 0;
+
+	RakNetTimeNS timeNS = RakNet::GetTimeNS();
+	RakNetTimeNS nextUpdateTime = timeNS + (RakNetTimeNS) threadSleepTimer * (RakNetTimeNS) 1000;
+	unsigned i;
+
+	// remoteSystemList in network thread
+	for ( i = 0; i < maximumNumberOfPeers; i++ )
+	{
+		if ( remoteSystemList[ i ].isActive )
+			nextUpdateTime = remoteSystemList[ i ].reliabilityLayer.GetNextUpdateTime( timeNS, nextUpdateTime );
+	}
+
+	requestedConnectionQueueMutex.Lock();
+	for ( i = 0; i < requestedConnectionQueue.Size(); i++ )
+	{
+		RakNetTimeNS requestTime = (RakNetTimeNS) requestedConnectionQueue[ i ]->nextRequestTime * (RakNetTimeNS) 1000;
+		if ( requestTime < nextUpdateTime )
+			nextUpdateTime = requestTime;
+	}
+	requestedConnectionQueueMutex.Unlock();
+
+	nextUpdateTime = networkConditioner.GetNextDeliveryTime( nextUpdateTime );
+
+	if ( nextUpdateTime <= timeNS )
+		return 0;
+
+	// Round up so that the thread doesn't wake just short of the deadline and have to wait again
+	return (RakNetTime) ( ( nextUpdateTime - timeNS + 999 ) / 1000 );
 }
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool RakPeer::SendImmediate( char *data, BitSize_t numberOfBitsToSend, PacketPriority priority, PacketReliability reliability, char orderingChannel, SystemAddress systemAddress, bool broadcast, bool useCallerDataAllocation, RakNetTimeNS currentTime )
@@ -4002,6 +4142,10 @@ void ProcessNetworkPacket( const unsigned int binaryAddress, const unsigned shor
 	systemAddress.binaryAddress = binaryAddress;
  	systemAddress.port = port;
 
+	// The conditioner processes the datagram itself once it is due
+	if ( rakPeer->networkConditioner.Receive( data, length, systemAddress, connectionSocketIndex ) )
+		return;
+
 #if !defined(_XBOX360)
 	if (rakPeer->IsBanned( systemAddress.ToString(false) ))
 	{
@@ -4481,8 +4625,16 @@ bool RakPeer::RunUpdateCycle( void )
 	{
 		do
 		{
+#ifdef SOCKET_LAYER_BATCHED_IO
+			// Read a batch of packets
+			if (receiveBatch)
+				gotData = SocketLayer::Instance()->RecvFromBatch( connectionSockets[connectionSocketIndex], this, &errorCode, connectionSocketIndex, receiveBatch );
+			else
+				gotData = SocketLayer::Instance()->RecvFrom( connectionSockets[connectionSocketIndex], this, &errorCode, connectionSocketIndex );
+#else
 			// Read a packet
 			gotData = SocketLayer::Instance()->RecvFrom( connectionSockets[connectionSocketIndex], this, &errorCode, connectionSocketIndex );
+#endif
 
 			if ( gotData == -1 )
 			{
@@ -4523,9 +4675,16 @@ bool RakPeer::RunUpdateCycle( void )
 			if ( endThreads )
 				return false;
 		}
+#ifdef SOCKET_LAYER_BATCHED_IO
+		while ( receiveBatch ? gotData==SOCKET_LAYER_BATCH_SIZE : gotData>0 ); // Read until a batch comes back short, or there is nothing left
+#else
 		while ( gotData>0 ); // Read until there is nothing left
+#endif
 	}
 
+	// Send and process the datagrams the conditioner has held until now
+	networkConditioner.Update( this );
+
 	timeNS=0;
 	timeMS=0;
 
@@ -5316,15 +5475,53 @@ RAK_THREAD_DECLARATION(UpdateNetworkLoop)
 
 	while ( rakPeer->endThreads == false )
 	{
+#ifdef SOCKET_LAYER_BATCHED_IO
+		// Everything the update cycle sends goes out in as few sendmmsg calls as possible at the end of the cycle
+		if (rakPeer->sendBatch)
+		{
+			SocketLayer::Instance()->BeginSendBatch( rakPeer->sendBatch );
+			rakPeer->RunUpdateCycle();
+			SocketLayer::Instance()->FlushSendBatch();
+		}
+		else
+			rakPeer->RunUpdateCycle();
+#else
 		rakPeer->RunUpdateCycle();
+#endif
 
 // #if ((_WIN32_WINNT >= 0x0400) || (_WIN32_WINDOWS > 0x0400)) &&
 #if defined(USE_WAIT_FOR_MULTIPLE_EVENTS) && defined(_WIN32)
 		#pragma message("-- RakNet: Using WaitForSingleObject. Comment out USE_WAIT_FOR_MULTIPLE_EVENTS in RakNetDefines.h if you want to use Sleep instead. --")
 
-		if (rakPeer->threadSleepTimer>0)
+		// Wait for a datagram or a user thread signal, but no longer than until the next resend, ack or connection request is due
+		if (rakPeer->recvEvent!=INVALID_HANDLE_VALUE)
 		{
-			WSAWaitForMultipleEvents(1,&rakPeer->recvEvent,FALSE,rakPeer->threadSleepTimer,FALSE);
+			RakNetTime waitTime = rakPeer->GetUpdateWaitTime();
+			if (waitTime>0)
+				WSAWaitForMultipleEvents(1,&rakPeer->recvEvent,FALSE,waitTime,FALSE);
+		}
+		else
+			RakSleep(0);
+
+#elif defined(USE_WAIT_FOR_MULTIPLE_EVENTS) && defined(__linux__)
+		#pragma message("-- RakNet: Using epoll_wait. Comment out USE_WAIT_FOR_MULTIPLE_EVENTS in RakNetDefines.h if you want to use Sleep instead. --")
+
+		// Wait for a datagram or a user thread signal, but no longer than until the next resend, ack or connection request is due
+		if (rakPeer->recvEpoll!=-1)
+		{
+			RakNetTime waitTime = rakPeer->GetUpdateWaitTime();
+			if (waitTime>0)
+			{
+				epoll_event readyEvents[8];
+				epoll_wait(rakPeer->recvEpoll,readyEvents,8,(int) waitTime);
+			}
+
+			// Reset the signal so the next wait blocks, as the auto reset event does on Windows
+			eventfd_t signal;
+			if (read(rakPeer->wakeEvent,&signal,sizeof(signal))<0)
+			{
+				// Nothing was signalled
+			}
 		}
 		else
 			RakSleep(0);
@@ -30,6 +30,7 @@
 #include "Export.h"
 #include "RakString.h"
 #include "RakThread.h"
+#include "NetworkConditioner.h"
 
 class HuffmanEncodingTree;
 class PluginInterface;
@@ -541,6 +542,11 @@ public:
 	/// \return If you previously called ApplyNetworkSimulator
 	bool IsNetworkSimulatorActive( void );
 
+	/// Returns the conditioner that simulates latency, jitter, loss, duplication, reordering and bandwidth limits on the link to each system.
+	/// Unlike ApplyNetworkSimulator this conditions both directions and is available in release builds.
+	/// \return The network conditioner, which stays valid for the lifetime of this instance
+	NetworkConditioner* GetNetworkConditioner( void );
+
 	// --------------------------------------------------------------------------------------------Statistical Functions - Functions dealing with API performance--------------------------------------------------------------------------------------------
 
 	/// Returns a structure containing a large set of network statistics for the specified system.
@@ -803,6 +809,10 @@ protected:
 	void CloseConnectionInternal( const SystemAddress target, bool sendDisconnectionNotification, bool performImmediate, unsigned char orderingChannel );
 	void SendBuffered( const char *data, BitSize_t numberOfBitsToSend, PacketPriority priority, PacketReliability reliability, char orderingChannel, SystemAddress systemAddress, bool broadcast, RemoteSystemStruct::ConnectMode connectionMode );
 	void SendBufferedList( char **data, const int *lengths, const int numParameters, PacketPriority priority, PacketReliability reliability, char orderingChannel, SystemAddress systemAddress, bool broadcast, RemoteSystemStruct::ConnectMode connectionMode );
+	// Wake the update thread if it is waiting, so that work queued by the user thread is handled straight away
+	void SignalUpdateThread(void);
+	// How long in ms the update thread can wait for a datagram or a signal before it has work of its own to do, up to threadSleepTimer
+	RakNetTime GetUpdateWaitTime(void);
 	bool SendImmediate( char *data, BitSize_t numberOfBitsToSend, PacketPriority priority, PacketReliability reliability, char orderingChannel, SystemAddress systemAddress, bool broadcast, bool useCallerDataAllocation, RakNetTimeNS currentTime );
 	//bool HandleBufferedRPC(BufferedCommandStruct *bcs, RakNetTime time);
 	void ClearBufferedCommands(void);
@@ -821,8 +831,19 @@ protected:
 
 #if defined (_WIN32) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
 	WSAEVENT recvEvent;
+#elif defined(__linux__) && defined(USE_WAIT_FOR_MULTIPLE_EVENTS)
+	// The epoll instance watching the connection sockets and wakeEvent, and the eventfd the user thread writes to wake the update thread
+	int recvEpoll, wakeEvent;
+#endif
+
+#ifdef SOCKET_LAYER_BATCHED_IO
+	// The buffers the update thread reads and writes datagrams through, kept for the life of the instance
+	SocketLayerBatch *receiveBatch, *sendBatch;
 #endif
 
+	// Conditions the datagrams passed between the reliability layers and the sockets
+	NetworkConditioner networkConditioner;
+
 	// Used for RPC replies
 	RakNet::BitStream *replyFromTargetBS;
 	SystemAddress replyFromTargetPlayer;
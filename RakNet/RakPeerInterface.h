@@ -33,6 +33,7 @@ struct RPCMap;
 struct RakNetStatistics;
 class RouterInterface;
 class NetworkIDManager;
+class NetworkConditioner;
 
 /// The primary interface for RakNet, RakPeer contains all major functions for the library.
 /// See the individual functions for what the class can do.
@@ -529,6 +530,11 @@ public:
 	/// \return If you previously called ApplyNetworkSimulator
 	virtual bool IsNetworkSimulatorActive( void )=0;
 
+	/// Returns the conditioner that simulates latency, jitter, loss, duplication, reordering and bandwidth limits on the link to each system.
+	/// Unlike ApplyNetworkSimulator this conditions both directions and is available in release builds.
+	/// \return The network conditioner, which stays valid for the lifetime of this instance
+	virtual NetworkConditioner* GetNetworkConditioner( void )=0;
+
 	// --------------------------------------------------------------------------------------------Statistical Functions - Functions dealing with API performance--------------------------------------------------------------------------------------------
 
 	/// Returns a structure containing a large set of network statistics for the specified system.
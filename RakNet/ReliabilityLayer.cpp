@@ -15,6 +15,7 @@
 /// option) any later version.
 
 #include "ReliabilityLayer.h"
+#include "NetworkConditioner.h"
 #include "GetTime.h"
 #include "SocketLayer.h"
 #include "PluginInterface.h"
@@ -86,6 +87,8 @@ ReliabilityLayer::ReliabilityLayer() : updateBitStream( DEFAULT_MTU_SIZE + 21 )
 	maxSendBPS=minExtraPing=extraPingVariance=0;
 #endif
 
+	networkConditioner=0;
+
 	InitializeVariables();
 }
 
@@ -118,6 +121,14 @@ void ReliabilityLayer::SetEncryptionKey( const unsigned char* key )
 		encryptor.UnsetKey();
 }
 
+//-------------------------------------------------------------------------------------------------------
+// Pass outgoing datagrams through a conditioner
+//-------------------------------------------------------------------------------------------------------
+void ReliabilityLayer::SetNetworkConditioner( NetworkConditioner *conditioner )
+{
+	networkConditioner=conditioner;
+}
+
 //-------------------------------------------------------------------------------------------------------
 // Set the time, in MS, to use before considering ourselves disconnected after not being able to deliver a reliable packet
 //-------------------------------------------------------------------------------------------------------
@@ -1381,6 +1392,10 @@ void ReliabilityLayer::SendBitStream( SOCKET s, SystemAddress systemAddress, Rak
 	histogramBitsSent += length * 8;
 	//printf("total bits=%i length=%i\n", BITS_TO_BYTES(statistics.totalBitsSent), length);
 
+	// The conditioner sends the datagram itself once it is due
+	if ( networkConditioner && networkConditioner->Send( s, ( char* ) bitStream->GetData(), length, systemAddress ) )
+		return;
+
 	SocketLayer::Instance()->SendTo( s, ( char* ) bitStream->GetData(), length, systemAddress.binaryAddress, systemAddress.port );
 
 	// lastPacketSendTime=time;
@@ -1705,6 +1720,58 @@ bool ReliabilityLayer::AreAcksWaiting(void)
 	return acknowlegements.Size() > 0;
 }
 
+//-------------------------------------------------------------------------------------------------------
+RakNetTimeNS ReliabilityLayer::GetNextUpdateTime(RakNetTimeNS time, RakNetTimeNS maxTime)
+{
+	// Acks go out on the next update regardless of flow control
+	if ( acknowlegements.Size() > 0 )
+		return time;
+
+	RakNetTimeNS nextUpdateTime = maxTime;
+	unsigned i;
+
+	for ( i = 0; i < NUMBER_OF_PRIORITIES; i++ )
+	{
+		if ( sendPacketSet[ i ].Size() > 0 )
+		{
+			nextUpdateTime = time;
+			break;
+		}
+	}
+
+	// Holes at the front of the resend queue have a time of 0, so they are due now and get cleared out by the update
+	if ( resendQueue.Size() > 0 && resendQueue.Peek()->nextActionTime < nextUpdateTime )
+		nextUpdateTime = resendQueue.Peek()->nextActionTime;
+
+#ifdef _ENABLE_FLOW_CONTROL
+	// Data waiting on flow control can't go out before the next send time anyway
+	if ( nextUpdateTime < maxTime )
+	{
+		if ( nextUpdateTime < nextSendTime )
+			nextUpdateTime = nextSendTime;
+
+		if ( throughputCapCountdown > 0 && nextUpdateTime < time + (RakNetTimeNS) throughputCapCountdown )
+			nextUpdateTime = time + (RakNetTimeNS) throughputCapCountdown;
+
+		if ( nextUpdateTime > maxTime )
+			nextUpdateTime = maxTime;
+	}
+#endif
+
+#ifndef _RELEASE
+	for ( i = 0; i < delayList.Size(); i++ )
+	{
+		if ( delayList[ i ]->sendTime < nextUpdateTime )
+			nextUpdateTime = delayList[ i ]->sendTime;
+	}
+#endif
+
+	if ( nextUpdateTime < time )
+		nextUpdateTime = time;
+
+	return nextUpdateTime;
+}
+
 //-------------------------------------------------------------------------------------------------------
 void ReliabilityLayer::ApplyNetworkSimulator( double _maxSendBPS, RakNetTime _minExtraPing, RakNetTime _extraPingVariance )
 {
@@ -36,6 +36,7 @@
 #include "DS_MemoryPool.h"
 
 class PluginInterface;
+class NetworkConditioner;
 
 /// Sizeof an UDP header in byte
 #define UDP_HEADER_SIZE 28
@@ -139,9 +140,19 @@ public:
 	bool IsReliableOutgoingDataWaiting(void);
 	bool AreAcksWaiting(void);
 
+	/// When Update next has something to send, so the update thread can wait until then
+	/// \param[in] time The current time
+	/// \param[in] maxTime The latest time to return
+	/// \return A time no later than maxTime, and no earlier than time
+	RakNetTimeNS GetNextUpdateTime(RakNetTimeNS time, RakNetTimeNS maxTime);
+
 	// Set outgoing lag and packet loss properties
 	void ApplyNetworkSimulator( double _maxSendBPS, RakNetTime _minExtraPing, RakNetTime _extraPingVariance );
 
+	/// Pass outgoing datagrams through a conditioner, which holds on to them if there are conditions on the link
+	/// \param[in] conditioner The conditioner to use, or 0 to send straight to the socket
+	void SetNetworkConditioner( NetworkConditioner *conditioner );
+
 	/// Returns if you previously called ApplyNetworkSimulator
 	/// \return If you previously called ApplyNetworkSimulator
 	bool IsNetworkSimulatorActive( void );
@@ -369,6 +380,9 @@ private:
 	RakNetTime minExtraPing, extraPingVariance;
 #endif
 
+	// Conditions outgoing datagrams before they reach the socket, or 0 to send straight to it
+	NetworkConditioner *networkConditioner;
+
 	// This has to be a member because it's not threadsafe when I removed the mutexes
 	DataStructures::MemoryPool<InternalPacket> internalPacketPool;
 };
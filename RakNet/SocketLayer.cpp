@@ -57,7 +57,35 @@ static unsigned short HACK_APP_PORT;
 #pragma warning( push )
 #endif
 
+#ifdef SOCKET_LAYER_BATCHED_IO
+// The batch this thread is queueing sends in, if any
+static __thread SocketLayerBatch *sendBatch = 0;
+
+// Send every datagram queued in a batch, skipping any the socket refuses just as a failed sendto would drop them
+static void SendBatch( SocketLayerBatch *batch )
+{
+	int sent = 0;
+
+	while ( sent < batch->count )
+	{
+		int result = sendmmsg( batch->s, batch->headers + sent, batch->count - sent, 0 );
+
+		if ( result > 0 )
+			sent += result;
+		else if ( result < 0 && errno == EINTR )
+			continue;
+		else
+			sent++;
+	}
+
+	batch->count = 0;
+}
+#endif
+
 bool SocketLayer::socketLayerStarted = false;
+#ifdef SOCKET_LAYER_BATCHED_IO
+bool SocketLayer::batchedIO = true;
+#endif
 #ifdef _WIN32
 WSADATA SocketLayer::winsockInfo;
 #endif
@@ -485,6 +513,81 @@ int SocketLayer::RecvFrom( const SOCKET s, RakPeer *rakPeer, int *errorCode, uns
 	return 0; // no data
 }
 
+#ifdef SOCKET_LAYER_BATCHED_IO
+int SocketLayer::RecvFromBatch( const SOCKET s, RakPeer *rakPeer, int *errorCode, unsigned connectionSocketIndex, SocketLayerBatch *batch )
+{
+	if ( s == (SOCKET) -1 )
+	{
+		*errorCode = -1;
+		return -1;
+	}
+
+	int i;
+
+	for ( i = 0; i < SOCKET_LAYER_BATCH_SIZE; i++ )
+	{
+		batch->vectors[ i ].iov_base = batch->data[ i ];
+		batch->vectors[ i ].iov_len = MAXIMUM_MTU_SIZE;
+
+		memset( &batch->headers[ i ], 0, sizeof( mmsghdr ) );
+		batch->headers[ i ].msg_hdr.msg_name = &batch->addresses[ i ];
+		batch->headers[ i ].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+		batch->headers[ i ].msg_hdr.msg_iov = &batch->vectors[ i ];
+		batch->headers[ i ].msg_hdr.msg_iovlen = 1;
+	}
+
+	int count;
+
+	do
+	{
+		count = recvmmsg( s, batch->headers, SOCKET_LAYER_BATCH_SIZE, MSG_DONTWAIT, 0 );
+	}
+	while ( count < 0 && errno == EINTR );
+
+	if ( count <= 0 )
+	{
+		*errorCode = 0;
+		return 0; // no data
+	}
+
+	for ( i = 0; i < count; i++ )
+	{
+		// Empty datagrams carry nothing for RakNet, so they are skipped rather than treated as an error
+		if ( batch->headers[ i ].msg_len > 0 )
+			ProcessNetworkPacket( batch->addresses[ i ].sin_addr.s_addr, ntohs( batch->addresses[ i ].sin_port ), batch->data[ i ], (int) batch->headers[ i ].msg_len, rakPeer, connectionSocketIndex );
+	}
+
+	return count;
+}
+
+void SocketLayer::BeginSendBatch( SocketLayerBatch *batch )
+{
+	batch->count = 0;
+	sendBatch = batch;
+}
+
+void SocketLayer::FlushSendBatch( void )
+{
+	if ( sendBatch )
+	{
+		if ( sendBatch->count > 0 )
+			SendBatch( sendBatch );
+
+		sendBatch = 0;
+	}
+}
+
+void SocketLayer::SetBatchedIO( bool enabled )
+{
+	batchedIO = enabled;
+}
+
+bool SocketLayer::IsBatchedIO( void ) const
+{
+	return batchedIO;
+}
+#endif
+
 #ifdef _MSC_VER
 #pragma warning( disable : 4702 ) // warning C4702: unreachable code
 #endif
@@ -497,6 +600,35 @@ int SocketLayer::SendTo( SOCKET s, const char *data, int length, unsigned int bi
 
 	int len;
 
+#ifdef SOCKET_LAYER_BATCHED_IO
+	// Queue the datagram in the batch, sending the batch first if it is full or for another socket
+	if ( sendBatch && length > 0 && length <= MAXIMUM_MTU_SIZE )
+	{
+		if ( sendBatch->count > 0 && ( sendBatch->count == SOCKET_LAYER_BATCH_SIZE || sendBatch->s != s ) )
+			SendBatch( sendBatch );
+
+		int i = sendBatch->count++;
+
+		sendBatch->s = s;
+		memcpy( sendBatch->data[ i ], data, length );
+
+		sendBatch->addresses[ i ].sin_family = AF_INET;
+		sendBatch->addresses[ i ].sin_port = htons( port );
+		sendBatch->addresses[ i ].sin_addr.s_addr = binaryAddress;
+
+		sendBatch->vectors[ i ].iov_base = sendBatch->data[ i ];
+		sendBatch->vectors[ i ].iov_len = length;
+
+		memset( &sendBatch->headers[ i ], 0, sizeof( mmsghdr ) );
+		sendBatch->headers[ i ].msg_hdr.msg_name = &sendBatch->addresses[ i ];
+		sendBatch->headers[ i ].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+		sendBatch->headers[ i ].msg_hdr.msg_iov = &sendBatch->vectors[ i ];
+		sendBatch->headers[ i ].msg_hdr.msg_iovlen = 1;
+
+		return 0;
+	}
+#endif
+
 #if defined(_PS3) && defined (_PS3_LOBBY)
 	sockaddr_in_p2p sa;
 	memset(&sa, 0, sizeof(sa));
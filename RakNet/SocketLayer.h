@@ -44,6 +44,30 @@ typedef int SOCKET;
 #endif
 //#include "ClientContextStruct.h"
 
+/// Read and write datagrams in batches with recvmmsg and sendmmsg where the platform has them, saving a system call per datagram
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define SOCKET_LAYER_BATCHED_IO
+#include "MTUSize.h"
+#endif
+
+/// The most datagrams read or written by each recvmmsg or sendmmsg call
+#define SOCKET_LAYER_BATCH_SIZE 32
+
+#ifdef SOCKET_LAYER_BATCHED_IO
+/// The buffers for a batch of datagrams, allocated once and reused for every call
+struct SocketLayerBatch
+{
+	char data[ SOCKET_LAYER_BATCH_SIZE ][ MAXIMUM_MTU_SIZE ];
+	sockaddr_in addresses[ SOCKET_LAYER_BATCH_SIZE ];
+	iovec vectors[ SOCKET_LAYER_BATCH_SIZE ];
+	mmsghdr headers[ SOCKET_LAYER_BATCH_SIZE ];
+	/// The socket the queued datagrams are sent on
+	SOCKET s;
+	/// The number of datagrams queued
+	int count;
+};
+#endif
+
 class RakPeer;
 
 // A platform independent implementation of Berkeley sockets, with settings used by RakNet
@@ -105,6 +129,31 @@ public:
 	/// \param[in] connectionSocketIndex Which of the sockets in RakPeer we are using
 	/// \return Returns true if you successfully read data, false on error.
 	int RecvFrom( const SOCKET s, RakPeer *rakPeer, int *errorCode, unsigned connectionSocketIndex );
+
+#ifdef SOCKET_LAYER_BATCHED_IO
+	/// Read the datagrams waiting on a socket with a single recvmmsg call
+	/// \param[in] s the socket
+	/// \param[in] rakPeer The instance of rakPeer containing the recvFrom C callback
+	/// \param[in] errorCode An error code if an error occured .
+	/// \param[in] connectionSocketIndex Which of the sockets in RakPeer we are using
+	/// \param[in] batch The buffers to read into
+	/// \return The number of datagrams read, up to SOCKET_LAYER_BATCH_SIZE, 0 if there were none, or -1 on error.
+	int RecvFromBatch( const SOCKET s, RakPeer *rakPeer, int *errorCode, unsigned connectionSocketIndex, SocketLayerBatch *batch );
+
+	/// Queue the datagrams this thread passes to SendTo in a batch rather than sending each one straight away, until FlushSendBatch
+	/// \param[in] batch The buffers to queue the datagrams in
+	void BeginSendBatch( SocketLayerBatch *batch );
+
+	/// Send the datagrams this thread has queued since BeginSendBatch, and go back to sending each one straight away
+	void FlushSendBatch( void );
+
+	/// Turn batched reads and writes on or off for every RakPeer started afterwards, so the two paths can be compared
+	/// \param[in] enabled True to use recvmmsg and sendmmsg, false for a recvfrom or sendto per datagram. On by default.
+	void SetBatchedIO( bool enabled );
+
+	/// \return If RakPeer reads and writes datagrams in batches
+	bool IsBatchedIO( void ) const;
+#endif
 	
 #if !defined(_XBOX360)
 	/// Retrieve all local IP address in a string format.
@@ -152,6 +201,10 @@ private:
 
 	static bool socketLayerStarted;
 
+#ifdef SOCKET_LAYER_BATCHED_IO
+	static bool batchedIO;
+#endif
+
 #ifdef _WIN32
 	static WSADATA winsockInfo;
 #endif
@@ -116,7 +116,10 @@ struct RAK_DLL_EXPORT ThreadPool : public RakNet::RakMemoryOverride
 protected:
 	// It is valid to cancel input before it is processed.  To do so, lock the inputQueue with inputQueueMutex,
 	// Scan the list, and remove the item you don't want.
-	SimpleMutex inputQueueMutex, outputQueueMutex, workingThreadCountMutex, runThreadsMutex;
+	SimpleMutex inputQueueMutex, outputQueueMutex, workingThreadCountMutex;
+
+	// Mutable so that WasStopped can lock it from a const method.
+	mutable SimpleMutex runThreadsMutex;
 
 	void* (*perThreadDataFactory)();
 	void (*perThreadDataDestructor)(void*);
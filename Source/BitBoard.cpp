@@ -0,0 +1,386 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <BitBoard.h>
+
+// System.
+#if BITBOARD_SSE2
+	#include <emmintrin.h>
+#endif
+
+//##############################################################################
+
+// =============================================================================
+CBitBoard::CBitBoard() :
+	m_iWidth(0),
+	m_iBlockCount(0),
+	m_iWordCount(0)
+{
+}
+
+// =============================================================================
+void CBitBoard::Build(CMap* pMap)
+{
+	Reset(pMap->GetWidth(), pMap->GetBlockCount());
+
+	for (xint iA = 0; iA < m_iBlockCount; ++iA)
+	{
+		CMapBlock* pBlock = pMap->GetBlock(iA);
+
+		if (pBlock->IsWall())
+			continue;
+
+		Set(m_liOpen[PlayerType_Ghost], iA);
+
+		if (!pBlock->IsGhostWall())
+			Set(m_liOpen[PlayerType_Pacman], iA);
+
+		if (pBlock->m_iBlockType == BlockType_Pellet)
+			Set(m_liPelletBlocks, iA);
+	}
+
+	BuildMoves();
+	Refresh(pMap);
+}
+
+// =============================================================================
+void CBitBoard::Refresh(CMap* pMap)
+{
+	const t_BlockBitmap& lpEaten = pMap->GetEatenBitmap();
+	xint iEatenWords = (xint)lpEaten.size();
+
+	// The eaten bitmap has two words for every plane word.
+	for (xint iA = 0; iA < m_iWordCount; ++iA)
+	{
+		xuint64 iEaten = 0;
+
+		if (iA * 2 < iEatenWords)
+			iEaten |= lpEaten[iA * 2];
+
+		if (iA * 2 + 1 < iEatenWords)
+			iEaten |= (xuint64)lpEaten[iA * 2 + 1] << 32;
+
+		m_liPellets[iA] = m_liPelletBlocks[iA] & ~iEaten;
+	}
+
+	for (xint iA = 0; iA < PlayerType_Max; ++iA)
+		m_liPlayers[iA].assign(m_iWordCount, 0);
+}
+
+// =============================================================================
+void CBitBoard::Reset(xint iWidth, xint iBlockCount)
+{
+	// The column planes only change with the board's size so they are only rebuilt when that does.
+	xbool bResized = (m_iWidth != iWidth || m_iBlockCount != iBlockCount);
+
+	m_iWidth = iWidth;
+	m_iBlockCount = iBlockCount;
+	m_iWordCount = (m_iBlockCount + BITBOARD_WORD_BITS - 1) / BITBOARD_WORD_BITS;
+
+	for (xint iA = 0; iA < PlayerType_Max; ++iA)
+	{
+		m_liOpen[iA].assign(m_iWordCount, 0);
+		m_liPlayers[iA].assign(m_iWordCount, 0);
+	}
+
+	m_liPellets.assign(m_iWordCount, 0);
+	m_liPelletBlocks.assign(m_iWordCount, 0);
+
+	if (bResized)
+	{
+		m_liFirstColumn.assign(m_iWordCount, 0);
+		m_liLastColumn.assign(m_iWordCount, 0);
+
+		for (xint iA = 0; iA < m_iBlockCount; iA += m_iWidth)
+		{
+			Set(m_liFirstColumn, iA);
+			Set(m_liLastColumn, iA + m_iWidth - 1);
+		}
+	}
+}
+
+// =============================================================================
+void CBitBoard::BuildMoves()
+{
+	// A block can be left in a direction when the block that way is open, which is the open plane moved back the other way.
+	for (xint iA = 0; iA < PlayerType_Max; ++iA)
+	{
+		for (xint iB = 0; iB < AdjacentDirection_Max; ++iB)
+		{
+			Shift(m_liOpen[iA], (iB + 2) % AdjacentDirection_Max, m_liMoves[iA][iB]);
+			And(m_liMoves[iA][iB], m_liOpen[iA], m_liMoves[iA][iB]);
+		}
+	}
+}
+
+// =============================================================================
+void CBitBoard::Offset(const t_BitPlane& liSource, xint iOffset, t_BitPlane& liTarget)
+{
+	// Split the offset into whole words and remaining bits, rounding down so that the bits are never negative.
+	xint iWords = (iOffset >= 0) ? iOffset / BITBOARD_WORD_BITS : -((-iOffset + BITBOARD_WORD_BITS - 1) / BITBOARD_WORD_BITS);
+	xint iBits = iOffset - iWords * BITBOARD_WORD_BITS;
+
+	for (xint iA = 0; iA < m_iWordCount; ++iA)
+	{
+		xuint64 iValue = liSource[iA];
+
+		if (!iValue)
+			continue;
+
+		xint iTarget = iA + iWords;
+
+		if (iTarget >= 0 && iTarget < m_iWordCount)
+			liTarget[iTarget] |= iValue << iBits;
+
+		if (iBits && iTarget + 1 >= 0 && iTarget + 1 < m_iWordCount)
+			liTarget[iTarget + 1] |= iValue >> (BITBOARD_WORD_BITS - iBits);
+	}
+
+	// Drop anything moved past the last block.
+	if (m_iBlockCount % BITBOARD_WORD_BITS)
+		liTarget[m_iWordCount - 1] &= ((xuint64)1 << (m_iBlockCount % BITBOARD_WORD_BITS)) - 1;
+}
+
+// =============================================================================
+void CBitBoard::Shift(const t_BitPlane& liSource, xint iDirection, t_BitPlane& liTarget)
+{
+	liTarget.assign(m_iWordCount, 0);
+	m_liScratch.resize(m_iWordCount);
+
+	switch (iDirection)
+	{
+	case AdjacentDirection_Left:
+		{
+			// The first column wraps round to the last column of the same row.
+			AndNot(liSource, m_liFirstColumn, m_liScratch);
+			Offset(m_liScratch, -1, liTarget);
+
+			And(liSource, m_liFirstColumn, m_liScratch);
+			Offset(m_liScratch, m_iWidth - 1, liTarget);
+		}
+		break;
+
+	case AdjacentDirection_Right:
+		{
+			AndNot(liSource, m_liLastColumn, m_liScratch);
+			Offset(m_liScratch, 1, liTarget);
+
+			And(liSource, m_liLastColumn, m_liScratch);
+			Offset(m_liScratch, 1 - m_iWidth, liTarget);
+		}
+		break;
+
+	// Rows wrap from top to bottom, so the part moved off one end comes back on at the other.
+	case AdjacentDirection_Up:
+		{
+			Offset(liSource, -m_iWidth, liTarget);
+			Offset(liSource, m_iBlockCount - m_iWidth, liTarget);
+		}
+		break;
+
+	case AdjacentDirection_Down:
+		{
+			Offset(liSource, m_iWidth, liTarget);
+			Offset(liSource, m_iWidth - m_iBlockCount, liTarget);
+		}
+		break;
+	}
+}
+
+// =============================================================================
+void CBitBoard::Grow()
+{
+	// These are the same moves as a shift in each direction, wrapping included, in the same order as the parts of each word below.
+	xint iOffsets[BITBOARD_GROW_PARTS] =
+	{
+		-1, m_iWidth - 1,
+		1, 1 - m_iWidth,
+		-m_iWidth, m_iBlockCount - m_iWidth,
+		m_iWidth, m_iWidth - m_iBlockCount,
+	};
+
+	xint iWords[BITBOARD_GROW_PARTS];
+	xint iBits[BITBOARD_GROW_PARTS];
+
+	for (xint iA = 0; iA < BITBOARD_GROW_PARTS; ++iA)
+	{
+		iWords[iA] = (iOffsets[iA] >= 0) ? iOffsets[iA] / BITBOARD_WORD_BITS : -((-iOffsets[iA] + BITBOARD_WORD_BITS - 1) / BITBOARD_WORD_BITS);
+		iBits[iA] = iOffsets[iA] - iWords[iA] * BITBOARD_WORD_BITS;
+	}
+
+	// The frontier is usually a thin ring so only the words it's in are visited, and each is moved every way at once while it's at hand.
+	XEN_LIST_FOREACH(t_BitWordList, piWord, m_liActive)
+	{
+		xint iA = *piWord;
+		xuint64 iWord = m_liFrontier[iA];
+
+		xuint64 iParts[BITBOARD_GROW_PARTS] =
+		{
+			iWord & ~m_liFirstColumn[iA], iWord & m_liFirstColumn[iA],
+			iWord & ~m_liLastColumn[iA], iWord & m_liLastColumn[iA],
+			iWord, iWord,
+			iWord, iWord,
+		};
+
+		for (xint iB = 0; iB < BITBOARD_GROW_PARTS; ++iB)
+		{
+			if (!iParts[iB])
+				continue;
+
+			xint iTarget = iA + iWords[iB];
+
+			if (iTarget >= 0 && iTarget < m_iWordCount)
+				AddGrowth(iTarget, iParts[iB] << iBits[iB]);
+
+			if (iBits[iB] && iTarget + 1 >= 0 && iTarget + 1 < m_iWordCount)
+				AddGrowth(iTarget + 1, iParts[iB] >> (BITBOARD_WORD_BITS - iBits[iB]));
+		}
+	}
+
+	// Bits moved past the last block are left for Advance to drop as they're never open.
+}
+
+// =============================================================================
+void CBitBoard::And(const t_BitPlane& liSource, const t_BitPlane& liMask, t_BitPlane& liTarget)
+{
+	xint iA = 0;
+
+#if BITBOARD_SSE2
+	for (; iA + 2 <= m_iWordCount; iA += 2)
+	{
+		__m128i xSource = _mm_loadu_si128((const __m128i*)&liSource[iA]);
+		__m128i xMask = _mm_loadu_si128((const __m128i*)&liMask[iA]);
+
+		_mm_storeu_si128((__m128i*)&liTarget[iA], _mm_and_si128(xSource, xMask));
+	}
+#endif
+
+	for (; iA < m_iWordCount; ++iA)
+		liTarget[iA] = liSource[iA] & liMask[iA];
+}
+
+// =============================================================================
+void CBitBoard::AndNot(const t_BitPlane& liSource, const t_BitPlane& liMask, t_BitPlane& liTarget)
+{
+	xint iA = 0;
+
+#if BITBOARD_SSE2
+	for (; iA + 2 <= m_iWordCount; iA += 2)
+	{
+		__m128i xSource = _mm_loadu_si128((const __m128i*)&liSource[iA]);
+		__m128i xMask = _mm_loadu_si128((const __m128i*)&liMask[iA]);
+
+		_mm_storeu_si128((__m128i*)&liTarget[iA], _mm_andnot_si128(xMask, xSource));
+	}
+#endif
+
+	for (; iA < m_iWordCount; ++iA)
+		liTarget[iA] = liSource[iA] & ~liMask[iA];
+}
+
+// =============================================================================
+xbool CBitBoard::Advance(const t_BitPlane& liOpen)
+{
+	// Once a good part of the board has grown it's quicker to sweep the whole of it than to visit each word.
+	if ((xint)m_liTouched.size() * BITBOARD_DENSE_FRACTION >= m_iWordCount)
+	{
+		m_liActive.clear();
+
+		xint iA = 0;
+
+#if BITBOARD_SSE2
+		__m128i xZero = _mm_setzero_si128();
+
+		for (; iA + 2 <= m_iWordCount; iA += 2)
+		{
+			__m128i xGrowth = _mm_loadu_si128((const __m128i*)&m_liGrowth[iA]);
+			__m128i xOpen = _mm_loadu_si128((const __m128i*)&liOpen[iA]);
+			__m128i xReached = _mm_loadu_si128((const __m128i*)&m_liReached[iA]);
+			__m128i xFrontier = _mm_andnot_si128(xReached, _mm_and_si128(xGrowth, xOpen));
+
+			_mm_storeu_si128((__m128i*)&m_liFrontier[iA], xFrontier);
+			_mm_storeu_si128((__m128i*)&m_liReached[iA], _mm_or_si128(xReached, xFrontier));
+			_mm_storeu_si128((__m128i*)&m_liGrowth[iA], xZero);
+
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(xFrontier, xZero)) != 0xFFFF)
+			{
+				if (m_liFrontier[iA])
+					m_liActive.push_back(iA);
+
+				if (m_liFrontier[iA + 1])
+					m_liActive.push_back(iA + 1);
+			}
+		}
+#endif
+
+		for (; iA < m_iWordCount; ++iA)
+		{
+			m_liFrontier[iA] = m_liGrowth[iA] & liOpen[iA] & ~m_liReached[iA];
+			m_liReached[iA] |= m_liFrontier[iA];
+			m_liGrowth[iA] = 0;
+
+			if (m_liFrontier[iA])
+				m_liActive.push_back(iA);
+		}
+	}
+	else
+	{
+		XEN_LIST_FOREACH(t_BitWordList, piWord, m_liActive)
+			m_liFrontier[*piWord] = 0;
+
+		m_liActive.clear();
+
+		XEN_LIST_FOREACH(t_BitWordList, piWord, m_liTouched)
+		{
+			xint iA = *piWord;
+
+			m_liFrontier[iA] = m_liGrowth[iA] & liOpen[iA] & ~m_liReached[iA];
+			m_liReached[iA] |= m_liFrontier[iA];
+			m_liGrowth[iA] = 0;
+
+			if (m_liFrontier[iA])
+				m_liActive.push_back(iA);
+		}
+	}
+
+	m_liTouched.clear();
+
+	return !m_liActive.empty();
+}
+
+// =============================================================================
+void CBitBoard::GetDistances(const t_BitPlane& liSources, t_PlayerType iType, t_BlockDistanceList& liDistances)
+{
+	liDistances.assign(m_iBlockCount, -1);
+
+	// Grow outwards from every source at once, a whole ring of blocks per step.
+	m_liReached = liSources;
+	m_liFrontier = liSources;
+	m_liGrowth.assign(m_iWordCount, 0);
+
+	m_liActive.clear();
+	m_liTouched.clear();
+
+	for (xint iA = 0; iA < m_iWordCount; ++iA)
+	{
+		if (m_liFrontier[iA])
+			m_liActive.push_back(iA);
+	}
+
+	for (xint iDistance = 0; !m_liActive.empty(); ++iDistance)
+	{
+		XEN_LIST_FOREACH(t_BitWordList, piWord, m_liActive)
+		{
+			for (xuint64 iWord = m_liFrontier[*piWord]; iWord; iWord &= iWord - 1)
+				liDistances[*piWord * BITBOARD_WORD_BITS + GetLowestBit(iWord)] = iDistance;
+		}
+
+		Grow();
+		Advance(m_liOpen[iType]);
+	}
+}
+
+//##############################################################################
@@ -0,0 +1,252 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Other.
+#include <Map.h>
+
+//##############################################################################
+
+// The number of bits held in each word of a bit plane.
+#define BITBOARD_WORD_BITS 64
+
+// The number of parts each word is split into when growing, one for each direction and another for each wrap.
+#define BITBOARD_GROW_PARTS 8
+
+// Growth is swept across the whole board at once when at least one word in this many has grown, and otherwise visited a word at a time.
+#define BITBOARD_DENSE_FRACTION 8
+
+// Use SSE2 for the bulk plane operations where the target supports it, falling back to a word at a time.
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define BITBOARD_SSE2 1
+#else
+	#define BITBOARD_SSE2 0
+#endif
+
+//##############################################################################
+
+// A plane holding a bit for each block of a map, laid out row by row.
+typedef xarray<xuint64> t_BitPlane;
+
+// Lists.
+typedef xarray<xint> t_BlockDistanceList;
+typedef xarray<xint> t_BitWordList;
+
+//##############################################################################
+
+// A compact model of a map with a bit plane for each property of interest. Moving a whole plane by a block is a handful of word shifts, which is what makes bulk queries such as distance fields cheap.
+class CBitBoard
+{
+public:
+	// Constructor.
+	CBitBoard();
+
+	// Build the planes from the current state of a map. Pellets are taken as they stand and the player planes are cleared.
+	void Build(CMap* pMap);
+
+	// Take the pellets from a map the board was built from and clear the player planes, leaving the walls as they were built.
+	void Refresh(CMap* pMap);
+
+	// Size the board and clear every plane.
+	void Reset(xint iWidth, xint iBlockCount);
+
+	// Open a block to a player type. The move planes must be rebuilt once all blocks are open.
+	inline void SetOpen(t_PlayerType iType, xint iBlock)
+	{
+		Set(m_liOpen[iType], iBlock);
+	}
+
+	// Build the move planes from the open planes.
+	void BuildMoves();
+
+	// Get the width of the board in blocks.
+	inline xint GetWidth()
+	{
+		return m_iWidth;
+	}
+
+	// Get the number of blocks on the board.
+	inline xint GetBlockCount()
+	{
+		return m_iBlockCount;
+	}
+
+	// Get the number of words in each plane.
+	inline xint GetWordCount()
+	{
+		return m_iWordCount;
+	}
+
+	// Get the index of the block adjacent to another in a direction, wrapping at the edges as the map does.
+	inline xint GetAdjacent(xint iBlock, xint iDirection)
+	{
+		switch (iDirection)
+		{
+		case AdjacentDirection_Left:	return (iBlock % m_iWidth) ? iBlock - 1 : iBlock + m_iWidth - 1;
+		case AdjacentDirection_Up:		return (iBlock >= m_iWidth) ? iBlock - m_iWidth : iBlock + m_iBlockCount - m_iWidth;
+		case AdjacentDirection_Right:	return (iBlock % m_iWidth < m_iWidth - 1) ? iBlock + 1 : iBlock - m_iWidth + 1;
+		case AdjacentDirection_Down:	return (iBlock < m_iBlockCount - m_iWidth) ? iBlock + m_iWidth : iBlock - m_iBlockCount + m_iWidth;
+		}
+
+		return iBlock;
+	}
+
+	// Check if a player type can move from a block in a direction.
+	inline xbool CanMove(t_PlayerType iType, xint iBlock, xint iDirection)
+	{
+		return Test(m_liMoves[iType][iDirection], iBlock);
+	}
+
+	// Check if a block is open to a player type.
+	inline xbool IsOpen(t_PlayerType iType, xint iBlock)
+	{
+		return Test(m_liOpen[iType], iBlock);
+	}
+
+	// Check if a block has an uneaten pellet.
+	inline xbool IsPellet(xint iBlock)
+	{
+		return Test(m_liPellets, iBlock);
+	}
+
+	// Check if a block has a player of a type on it.
+	inline xbool IsPlayer(t_PlayerType iType, xint iBlock)
+	{
+		return Test(m_liPlayers[iType], iBlock);
+	}
+
+	// Get the plane of blocks with a player of a type on them.
+	inline const t_BitPlane& GetPlayers(t_PlayerType iType)
+	{
+		return m_liPlayers[iType];
+	}
+
+	// Add a player to the plane for its type.
+	inline void AddPlayer(t_PlayerType iType, xint iBlock)
+	{
+		Set(m_liPlayers[iType], iBlock);
+	}
+
+	// Get the distance in moves for a player type from each block to the nearest source block, or -1 where no source can be reached.
+	void GetDistances(const t_BitPlane& liSources, t_PlayerType iType, t_BlockDistanceList& liDistances);
+
+	// Get the distance in moves for a player type from each block to the nearest pellet, or -1 where no pellet can be reached.
+	inline void GetPelletDistances(t_PlayerType iType, t_BlockDistanceList& liDistances)
+	{
+		GetDistances(m_liPellets, iType, liDistances);
+	}
+
+	// Get the distance in moves for a player type from each block to the nearest player of that type, or -1 where none can be reached.
+	inline void GetPlayerDistances(t_PlayerType iType, t_BlockDistanceList& liDistances)
+	{
+		GetDistances(m_liPlayers[iType], iType, liDistances);
+	}
+
+	// Move every bit of a plane one block in a direction, wrapping at the edges as the map does.
+	void Shift(const t_BitPlane& liSource, xint iDirection, t_BitPlane& liTarget);
+
+	// Check a bit in a plane.
+	static inline xbool Test(const t_BitPlane& liPlane, xint iBlock)
+	{
+		return ((liPlane[iBlock / BITBOARD_WORD_BITS] >> (iBlock % BITBOARD_WORD_BITS)) & 1) != 0;
+	}
+
+	// Set a bit in a plane.
+	static inline void Set(t_BitPlane& liPlane, xint iBlock)
+	{
+		liPlane[iBlock / BITBOARD_WORD_BITS] |= (xuint64)1 << (iBlock % BITBOARD_WORD_BITS);
+	}
+
+	// Clear a bit in a plane.
+	static inline void Clear(t_BitPlane& liPlane, xint iBlock)
+	{
+		liPlane[iBlock / BITBOARD_WORD_BITS] &= ~((xuint64)1 << (iBlock % BITBOARD_WORD_BITS));
+	}
+
+protected:
+	// Combine a plane moved along the board by a number of bits into a target. Bits moved off either end are dropped.
+	void Offset(const t_BitPlane& liSource, xint iOffset, t_BitPlane& liTarget);
+
+	// Keep the bits of a plane that are also in a mask.
+	void And(const t_BitPlane& liSource, const t_BitPlane& liMask, t_BitPlane& liTarget);
+
+	// Keep the bits of a plane that are not in a mask.
+	void AndNot(const t_BitPlane& liSource, const t_BitPlane& liMask, t_BitPlane& liTarget);
+
+	// Add the blocks next to the frontier in every direction to the growth.
+	void Grow();
+
+	// Take the grown blocks that are open and not yet reached as the next frontier, mark them reached and clear the growth. Returns false once nothing new was reached.
+	xbool Advance(const t_BitPlane& liOpen);
+
+	// Add bits to a word of the growth, noting the word the first time it grows.
+	inline void AddGrowth(xint iWord, xuint64 iBits)
+	{
+		if (!iBits)
+			return;
+
+		if (!m_liGrowth[iWord])
+			m_liTouched.push_back(iWord);
+
+		m_liGrowth[iWord] |= iBits;
+	}
+
+	// Get the index of the lowest set bit in a word, which must not be zero.
+	static inline xint GetLowestBit(xuint64 iWord)
+	{
+		static const xint s_iIndices[BITBOARD_WORD_BITS] =
+		{
+			 0, 47,  1, 56, 48, 27,  2, 60, 57, 49, 41, 37, 28, 16,  3, 61,
+			54, 58, 35, 52, 50, 42, 21, 44, 38, 32, 29, 23, 17, 11,  4, 62,
+			46, 55, 26, 59, 40, 36, 15, 53, 34, 51, 20, 43, 31, 22, 10, 45,
+			25, 39, 14, 33, 19, 30,  9, 24, 13, 18,  8, 12,  7,  6,  5, 63,
+		};
+
+		return s_iIndices[((iWord ^ (iWord - 1)) * 0x03F79D71B4CB0A89ULL) >> 58];
+	}
+
+	// The width of the board in blocks.
+	xint m_iWidth;
+
+	// The number of blocks on the board.
+	xint m_iBlockCount;
+
+	// The number of words in each plane.
+	xint m_iWordCount;
+
+	// The blocks each player type may stand on.
+	t_BitPlane m_liOpen[PlayerType_Max];
+
+	// The blocks each player type may leave in each direction.
+	t_BitPlane m_liMoves[PlayerType_Max][AdjacentDirection_Max];
+
+	// The blocks with an uneaten pellet.
+	t_BitPlane m_liPellets;
+
+	// The blocks that started with a pellet.
+	t_BitPlane m_liPelletBlocks;
+
+	// The blocks with a player of each type on them.
+	t_BitPlane m_liPlayers[PlayerType_Max];
+
+	// The blocks in the first column.
+	t_BitPlane m_liFirstColumn;
+
+	// The blocks in the last column.
+	t_BitPlane m_liLastColumn;
+
+	// The planes used while shifting and growing, kept to avoid allocating each time.
+	t_BitPlane m_liScratch;
+	t_BitPlane m_liFrontier;
+	t_BitPlane m_liReached;
+	t_BitPlane m_liGrowth;
+
+	// The words with any frontier in them and the words that have grown since the last advance.
+	t_BitWordList m_liActive;
+	t_BitWordList m_liTouched;
+};
+
+//##############################################################################
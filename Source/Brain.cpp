@@ -18,17 +18,64 @@
 // Other.
 #include <Player.h>
 #include <Map.h>
+#include <Profile.h>
+#include <Replay.h>
+
+// System.
+#include <algorithm>
 
 //##############################################################################
 
 // =============================================================================
 CBrain::CBrain(CPlayer* pPlayer) :
-	m_pPlayer(pPlayer)
+	m_pPlayer(pPlayer),
+	m_bPending(false),
+	m_iPriority(0),
+	m_iLastThinkTime(0),
+	m_iThinkCount(0),
+	m_iThinkCost(0),
+	m_iMaxThinkCost(0)
+{
+}
+
+// =============================================================================
+CBrain::~CBrain()
 {
+	BrainScheduler.Cancel(this);
+}
+
+// =============================================================================
+xdouble CBrain::GetAverageThinkTime()
+{
+	return m_iThinkCount ? CProfileManager::GetMilliseconds(m_iThinkCost) / (xdouble)m_iThinkCount : 0.0;
+}
+
+// =============================================================================
+xdouble CBrain::GetMaxThinkTime()
+{
+	return CProfileManager::GetMilliseconds(m_iMaxThinkCost);
+}
+
+// =============================================================================
+void CBrain::Apply(CBrainDecision& xDecision)
+{
+	if (xDecision.m_pPath)
+		m_pPlayer->SetNavPath(xDecision.m_pPath);
+
+	if (xDecision.m_iMove != PlayerDirection_None)
+		m_pPlayer->Move(xDecision.m_iMove);
+
+	xDecision.m_pPath = NULL;
 }
 
 // =============================================================================
-void CBrain::Wander()
+xint CBrain::Random(xint iLimit)
+{
+	return m_xRandom.GetInt(iLimit);
+}
+
+// =============================================================================
+void CBrain::Wander(CBrainDecision& xDecision)
 {
 	CMapBlock* pMoveDirection[PlayerDirection_Max];
 	t_PlayerDirection iRealDirection[PlayerDirection_Max];
@@ -36,8 +83,8 @@ void CBrain::Wander()
 
 	for (xint iA = 0; iA < PlayerDirection_Max; ++iA)
 	{
-		iRealDirection[iA] = (t_PlayerDirection)((m_pPlayer->m_iMoveDir + iA + 3) % PlayerDirection_Max);
-		pMoveDirection[iA] = MapManager.GetCurrentMap()->GetAdjacentBlock((t_AdjacentDirection)iRealDirection[iA], m_pPlayer->m_pCurrentBlock);
+		iRealDirection[iA] = (t_PlayerDirection)((m_pPlayer->GetMovement().m_iMoveDir + iA + 3) % PlayerDirection_Max);
+		pMoveDirection[iA] = MapManager.GetCurrentMap()->GetAdjacentBlock((t_AdjacentDirection)iRealDirection[iA], m_pPlayer->GetCurrentBlock());
 
 		if (m_pPlayer->IsPassable(pMoveDirection[iA]))
 			iDirectionCount++;
@@ -52,7 +99,7 @@ void CBrain::Wander()
 		{
 			if (pMoveDirection[iA])
 			{
-				m_pPlayer->Move(iRealDirection[iA]);
+				xDecision.m_iMove = iRealDirection[iA];
 				break;
 			}
 		}
@@ -60,7 +107,7 @@ void CBrain::Wander()
 	// Otherwise pick a random path to move down.
 	else
 	{
-		xint iRandomDir = rand() % (iDirectionCount - 1);
+		xint iRandomDir = Random(iDirectionCount - 1);
 
 		for (xint iA = 0; iA < PlayerDirection_Max; ++iA)
 		{
@@ -69,7 +116,7 @@ void CBrain::Wander()
 
 			if (iRandomDir == -1)
 			{
-				m_pPlayer->Move(iRealDirection[iA]);
+				xDecision.m_iMove = iRealDirection[iA];
 				break;
 			}
 		}
@@ -77,68 +124,646 @@ void CBrain::Wander()
 }
 
 // =============================================================================
-t_PlayerList CBrain::ScanCorridor(t_PlayerDirection iDirection)
+void CBrain::ScanCorridor(t_PlayerDirection iDirection)
 {
-	t_PlayerList xPlayerList;
-	CMapBlock* pCurrentBlock = m_pPlayer->m_pCurrentBlock->m_pAdjacents[iDirection];
+	CMap* pMap = MapManager.GetCurrentMap();
+	CMapBlock* pCurrentBlock = m_pPlayer->GetCurrentBlock()->m_pAdjacents[iDirection];
 
-	static xint s_iMaxBlocks = 10;
 	xint iSearchedBlocks = 0;
 
-	while (pCurrentBlock && !pCurrentBlock->IsWall() && !pCurrentBlock->IsGhostWall() && iSearchedBlocks++ < s_iMaxBlocks)
+	m_lpVisiblePlayers.clear();
+
+	while (pCurrentBlock && !pCurrentBlock->IsWall() && !pCurrentBlock->IsGhostWall() && iSearchedBlocks++ < BRAIN_SCAN_RANGE)
 	{
-		XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
-		{
-			if ((*ppPlayer)->m_pCurrentBlock == pCurrentBlock)
-				xPlayerList.push_back(*ppPlayer);
-		}
+		for (CPlayer* pPlayer = pMap->GetFirstOccupant(pCurrentBlock); pPlayer; pPlayer = pMap->GetNextOccupant(pPlayer))
+			m_lpVisiblePlayers.push_back(pPlayer);
 
 		pCurrentBlock = pCurrentBlock->m_pAdjacents[iDirection];
 	}
-
-	return xPlayerList;
 }
 
 //##############################################################################
 
 // =============================================================================
-CGhostBrain::CGhostBrain(CPlayer* pPlayer) : CBrain(pPlayer)
+CGhostBrain::CGhostBrain(CPlayer* pPlayer) : CBrain(pPlayer),
+	m_pLastSeen(NULL)
 {
 }
 
 // =============================================================================
-void CGhostBrain::Think()
+void CGhostBrain::Decide(CBrainDecision& xDecision)
 {
 	xbool bFoundPacman = false;
 
 	// Search for Pacman and if he's found, navigate to him.
 	for (xuint iA = 0; iA < PlayerDirection_Max; ++iA)
 	{
-		t_PlayerList lxVisiblePlayers = ScanCorridor((t_PlayerDirection)iA);
+		ScanCorridor((t_PlayerDirection)iA);
 
-		XEN_LIST_FOREACH(t_PlayerList, ppPlayer, lxVisiblePlayers)
+		XEN_LIST_FOREACH(t_PlayerList, ppPlayer, m_lpVisiblePlayers)
 		{
 			if ((*ppPlayer)->GetType() == PlayerType_Pacman)
 			{
 				bFoundPacman = true;
 
-				CMapBlock* pBlock = (*ppPlayer)->m_pCurrentBlock;
+				CMapBlock* pBlock = (*ppPlayer)->GetCurrentBlock();
 
 				// 50% of the time, the Ghost will follow accurately round corners.
-				if ((*ppPlayer)->m_pTargetBlock)
+				if ((*ppPlayer)->GetMovement().m_pTargetBlock)
+				{
+					if (Random(10) > 4)
+						pBlock = (*ppPlayer)->GetMovement().m_pTargetBlock;
+				}
+
+				m_pLastSeen = pBlock; // AI can be dumbed down by always using current block.
+			}
+		}
+	}
+
+	// Only the last Pacman seen is chased so only one path is needed.
+	if (bFoundPacman)
+		xDecision.m_pPath = m_pPlayer->FindPath(m_pLastSeen);
+
+	// If we're not heading anywhere specific, follow the pressure towards a nearby Pacman or just wander around.
+	if (!bFoundPacman && !m_pPlayer->GetNavPath())
+	{
+		xint iBlock = m_pPlayer->GetCurrentBlock()->m_iIndex;
+		xint iPressure = InfluenceMap.GetPressure(iBlock);
+
+		if (iPressure > 0 && iPressure <= BRAIN_PRESSURE_RANGE)
+			xDecision.m_iMove = (t_PlayerDirection)InfluenceMap.GetChaseDirection(iBlock);
+
+		if (xDecision.m_iMove == PlayerDirection_None)
+			Wander(xDecision);
+	}
+}
+
+// =============================================================================
+xint CGhostBrain::GetTargetDistance()
+{
+	return m_pPlayer->GetCurrentBlock() ? InfluenceMap.GetPressure(m_pPlayer->GetCurrentBlock()->m_iIndex) : -1;
+}
+
+//##############################################################################
+
+// =============================================================================
+xdouble CPacmanBrain::s_fThinkTime = PACMAN_BRAIN_THINK_TIME;
+
+// =============================================================================
+CPacmanBrain::CPacmanBrain(CPlayer* pPlayer) : CBrain(pPlayer),
+	m_pBoard(NULL),
+	m_iRootBlock(0),
+	m_iRootDirection(-1),
+	m_iRolloutCount(0),
+	m_iSearchCost(0)
+{
+}
+
+// =============================================================================
+void CPacmanBrain::Decide(CBrainDecision& xDecision)
+{
+	if (!m_pPlayer->GetCurrentBlock())
+		return;
+
+	BuildModel();
+
+	// A time limit would let recorded games play out differently so a fixed amount of searching is done instead.
+	xint iMove = -1;
+
+	if (ReplayManager.IsRecording() || ReplayManager.IsReplaying())
+		iMove = Search(PACMAN_BRAIN_FIXED_ITERATIONS, 0.0);
+	else
+		iMove = Search(PACMAN_BRAIN_MAX_ITERATIONS, s_fThinkTime);
+
+	if (iMove != -1)
+		xDecision.m_iMove = (t_PlayerDirection)iMove;
+}
+
+// =============================================================================
+xint CPacmanBrain::GetTargetDistance()
+{
+	return m_pPlayer->GetCurrentBlock() ? InfluenceMap.GetDanger(m_pPlayer->GetCurrentBlock()->m_iIndex) : -1;
+}
+
+// =============================================================================
+void CPacmanBrain::LogStats()
+{
+	xdouble fSearchTime = CProfileManager::GetMilliseconds(m_iSearchCost);
+
+	XLOG("[BrainScheduler] Player %d: %d rollouts, %.0f rollouts/sec with a %.2fms think time.",
+		m_pPlayer->GetIndex(),
+		m_iRolloutCount,
+		fSearchTime > 0.0 ? (xdouble)m_iRolloutCount * 1000.0 / fSearchTime : 0.0,
+		s_fThinkTime);
+}
+
+// =============================================================================
+void CPacmanBrain::Benchmark(xint iIterations)
+{
+	if (!m_pPlayer->GetCurrentBlock())
+		return;
+
+	InfluenceMap.Update();
+	BuildModel();
+
+	xint64 iStart = CProfileManager::GetCounter();
+
+	Search(iIterations, 0.0);
+
+	xdouble fTime = CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - iStart);
+
+	XLOG("[PacmanBrain] %d rollouts of %d moves in %.2fms, %.0f rollouts/sec and %d tree nodes.",
+		iIterations,
+		PACMAN_BRAIN_HORIZON,
+		fTime,
+		fTime > 0.0 ? (xdouble)iIterations * 1000.0 / fTime : 0.0,
+		(xint)m_lxNodes.size());
+}
+
+// =============================================================================
+void CPacmanBrain::BuildModel()
+{
+	m_pBoard = &InfluenceMap.GetBoard();
+
+	m_iRootBlock = m_pPlayer->GetCurrentBlock()->m_iIndex;
+	m_iRootDirection = m_pPlayer->GetMovement().m_iMoveDir;
+
+	m_liGhostBlocks.clear();
+	m_liGhostDirections.clear();
+
+	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+	{
+		CPlayer* pPlayer = *ppPlayer;
+
+		if (pPlayer->GetType() != PlayerType_Ghost || !pPlayer->GetCurrentBlock())
+			continue;
+
+		// A ghost part way between blocks is treated as having arrived.
+		CPlayerMovement& xMovement = pPlayer->GetMovement();
+		CMapBlock* pBlock = xMovement.m_pTargetBlock ? xMovement.m_pTargetBlock : xMovement.m_pCurrentBlock;
+
+		m_liGhostBlocks.push_back(pBlock->m_iIndex);
+		m_liGhostDirections.push_back(xMovement.m_iMoveDir);
+	}
+}
+
+// =============================================================================
+xint CPacmanBrain::Search(xint iMaxIterations, xdouble fTimeLimit)
+{
+	xint64 iStart = CProfileManager::GetCounter();
+
+	m_lxNodes.clear();
+	m_lxNodes.reserve(iMaxIterations + 1);
+	m_lxNodes.push_back(CPacmanSearchNode());
+
+	for (xint iA = 0; iA < iMaxIterations; ++iA)
+	{
+		// Reading the counter costs about as much as a short rollout so only check the time every few iterations.
+		if (fTimeLimit > 0.0 && (iA & 15) == 0 && CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - iStart) >= fTimeLimit)
+			break;
+
+		Iterate();
+	}
+
+	m_iSearchCost += CProfileManager::GetCounter() - iStart;
+
+	// The most visited move is the one the search trusts the most.
+	CPacmanSearchNode& xRoot = m_lxNodes[0];
+	xint iBestMove = -1;
+	xint iBestVisits = 0;
+
+	for (xint iA = 0; iA < PlayerDirection_Max; ++iA)
+	{
+		xint iChild = xRoot.m_iChildren[iA];
+
+		if (iChild != -1 && m_lxNodes[iChild].m_iVisits > iBestVisits)
+		{
+			iBestMove = iA;
+			iBestVisits = m_lxNodes[iChild].m_iVisits;
+		}
+	}
+
+	return iBestMove;
+}
+
+// =============================================================================
+void CPacmanBrain::Iterate()
+{
+	m_liSimulatedBlocks = m_liGhostBlocks;
+	m_liSimulatedDirections = m_liGhostDirections;
+	m_liEaten.assign(m_pBoard->GetWordCount(), 0);
+
+	m_liPath.clear();
+	m_liPath.push_back(0);
+
+	xint iNode = 0;
+	xint iBlock = m_iRootBlock;
+	xint iDirection = m_iRootDirection;
+	xint iEaten = 0;
+	xint iStep = 0;
+	xbool bInTree = true;
+	xbool bCaught = false;
+
+	for (; iStep < PACMAN_BRAIN_HORIZON && !bCaught; ++iStep)
+	{
+		xint iMove = -1;
+
+		// Follow the tree until a move that hasn't been tried is found, then add it and play out the rest at random.
+		if (bInTree)
+		{
+			iMove = SelectMove(iNode, iBlock);
+
+			if (iMove != -1)
+			{
+				if (m_lxNodes[iNode].m_iChildren[iMove] == -1)
 				{
-					if (rand() % 10 > 4)
-						pBlock = (*ppPlayer)->m_pTargetBlock;
+					m_lxNodes[iNode].m_iChildren[iMove] = (xint)m_lxNodes.size();
+					m_lxNodes.push_back(CPacmanSearchNode());
+
+					bInTree = false;
 				}
 
-				m_pLastSeen = pBlock; 
+				iNode = m_lxNodes[iNode].m_iChildren[iMove];
+				m_liPath.push_back(iNode);
+			}
+		}
+		else
+			iMove = RandomMove(PlayerType_Pacman, iBlock, iDirection);
+
+		if (iMove == -1)
+			break;
+
+		xint iFromBlock = iBlock;
+
+		iBlock = m_pBoard->GetAdjacent(iBlock, iMove);
+		iDirection = iMove;
+
+		bCaught = StepGhosts(iFromBlock, iBlock);
+
+		if (!bCaught && m_pBoard->IsPellet(iBlock) && !CBitBoard::Test(m_liEaten, iBlock))
+		{
+			CBitBoard::Set(m_liEaten, iBlock);
+			iEaten++;
+		}
+	}
+
+	// Being caught is always worse than surviving, but lasting longer still counts. Survivors score for pellets eaten and for ending up near more.
+	xdouble fReward = 0.0;
+
+	if (bCaught)
+		fReward = 0.25 * (xdouble)iStep / (xdouble)PACMAN_BRAIN_HORIZON;
+	else
+	{
+		xint iDistance = InfluenceMap.GetPelletDistance(iBlock);
+		xdouble fScore = (xdouble)iEaten + ((iDistance != -1) ? 1.0 / (xdouble)(iDistance + 1) : 0.0);
+
+		fReward = 0.5 + 0.5 * fScore / (xdouble)(PACMAN_BRAIN_HORIZON + 1);
+	}
+
+	XEN_LIST_FOREACH(xarray<xint>, piNode, m_liPath)
+	{
+		m_lxNodes[*piNode].m_iVisits++;
+		m_lxNodes[*piNode].m_fReward += fReward;
+	}
+
+	m_iRolloutCount++;
+}
+
+// =============================================================================
+xint CPacmanBrain::SelectMove(xint iNode, xint iBlock)
+{
+	CPacmanSearchNode& xNode = m_lxNodes[iNode];
+
+	xint iUntried[PlayerDirection_Max];
+	xint iUntriedCount = 0;
+	xint iBestMove = -1;
+	xdouble fBestScore = 0.0;
+	xdouble fLogVisits = log((xdouble)Math::Max(xNode.m_iVisits, 1));
 
-				m_pPlayer->NavigateTo(m_pLastSeen); // AI can be dumbed down by always using current block.
+	for (xint iA = 0; iA < PlayerDirection_Max; ++iA)
+	{
+		if (!m_pBoard->CanMove(PlayerType_Pacman, iBlock, iA))
+			continue;
+
+		xint iChild = xNode.m_iChildren[iA];
+
+		if (iChild == -1)
+		{
+			iUntried[iUntriedCount++] = iA;
+			continue;
+		}
+
+		CPacmanSearchNode& xChild = m_lxNodes[iChild];
+		xdouble fScore = xChild.m_fReward / (xdouble)xChild.m_iVisits + PACMAN_BRAIN_EXPLORATION * sqrt(fLogVisits / (xdouble)xChild.m_iVisits);
+
+		if (iBestMove == -1 || fScore > fBestScore)
+		{
+			iBestMove = iA;
+			fBestScore = fScore;
+		}
+	}
+
+	if (iUntriedCount)
+		return iUntried[Random(iUntriedCount)];
+
+	return iBestMove;
+}
+
+// =============================================================================
+xint CPacmanBrain::RandomMove(t_PlayerType iType, xint iBlock, xint iLastDirection)
+{
+	xint iMoves[PlayerDirection_Max];
+	xint iMoveCount = 0;
+	xint iReverse = (iLastDirection != -1) ? (iLastDirection + 2) % PlayerDirection_Max : -1;
+
+	for (xint iA = 0; iA < PlayerDirection_Max; ++iA)
+	{
+		if (iA != iReverse && m_pBoard->CanMove(iType, iBlock, iA))
+			iMoves[iMoveCount++] = iA;
+	}
+
+	if (!iMoveCount)
+		return (iReverse != -1 && m_pBoard->CanMove(iType, iBlock, iReverse)) ? iReverse : -1;
+
+	return iMoves[Random(iMoveCount)];
+}
+
+// =============================================================================
+xbool CPacmanBrain::StepGhosts(xint iFromBlock, xint iToBlock)
+{
+	xbool bCaught = false;
+
+	m_liGhostPlane.assign(m_pBoard->GetWordCount(), 0);
+
+	for (xint iA = 0; iA < (xint)m_liSimulatedBlocks.size(); ++iA)
+	{
+		xint iGhostBlock = m_liSimulatedBlocks[iA];
+		xint iMove = -1;
+
+		// Chasing ghosts take whichever way forward brings them closest.
+		if (Random(100) < PACMAN_BRAIN_CHASE_CHANCE)
+		{
+			xint iReverse = (m_liSimulatedDirections[iA] != -1) ? (m_liSimulatedDirections[iA] + 2) % PlayerDirection_Max : -1;
+			xint iBestDistance = 0;
+
+			for (xint iB = 0; iB < PlayerDirection_Max; ++iB)
+			{
+				if (iB == iReverse || !m_pBoard->CanMove(PlayerType_Ghost, iGhostBlock, iB))
+					continue;
+
+				xint iDistance = GetDistance(m_pBoard->GetAdjacent(iGhostBlock, iB), iToBlock);
+
+				if (iMove == -1 || iDistance < iBestDistance)
+				{
+					iMove = iB;
+					iBestDistance = iDistance;
+				}
 			}
 		}
+
+		if (iMove == -1)
+			iMove = RandomMove(PlayerType_Ghost, iGhostBlock, m_liSimulatedDirections[iA]);
+
+		if (iMove != -1)
+		{
+			m_liSimulatedBlocks[iA] = m_pBoard->GetAdjacent(iGhostBlock, iMove);
+			m_liSimulatedDirections[iA] = iMove;
+		}
+
+		// Pacman and a ghost passing each other between blocks also counts as a catch.
+		if (iGhostBlock == iToBlock && m_liSimulatedBlocks[iA] == iFromBlock)
+			bCaught = true;
+
+		CBitBoard::Set(m_liGhostPlane, m_liSimulatedBlocks[iA]);
+	}
+
+	return bCaught || CBitBoard::Test(m_liGhostPlane, iToBlock);
+}
+
+// =============================================================================
+xint CPacmanBrain::GetDistance(xint iBlockA, xint iBlockB)
+{
+	xint iWidth = m_pBoard->GetWidth();
+	xint iHeight = m_pBoard->GetBlockCount() / iWidth;
+
+	xint iX = abs(iBlockA % iWidth - iBlockB % iWidth);
+	xint iY = abs(iBlockA / iWidth - iBlockB / iWidth);
+
+	return Math::Min(iX, iWidth - iX) + Math::Min(iY, iHeight - iY);
+}
+
+//##############################################################################
+
+// =============================================================================
+CBrainScheduler::CBrainScheduler() :
+	m_bSeeded(false),
+	m_fBudget(BRAIN_TICK_BUDGET)
+{
+	Reset();
+}
+
+// =============================================================================
+void CBrainScheduler::Reset()
+{
+	XEN_LIST_FOREACH(t_BrainList, ppBrain, m_lpPending)
+		(*ppBrain)->m_bPending = false;
+
+	m_lpPending.clear();
+
+	m_bSeeded = false;
+	m_iClock = 0;
+	m_iTickCount = 0;
+	m_iThinkCount = 0;
+	m_iDeferredCount = 0;
+	m_fTotalTime = 0.0;
+	m_fMaxTickTime = 0.0;
+}
+
+// =============================================================================
+void CBrainScheduler::Request(CBrain* pBrain)
+{
+	if (!pBrain->m_bPending)
+	{
+		pBrain->m_bPending = true;
+		m_lpPending.push_back(pBrain);
+	}
+}
+
+// =============================================================================
+void CBrainScheduler::Cancel(CBrain* pBrain)
+{
+	if (pBrain->m_bPending)
+	{
+		pBrain->m_bPending = false;
+		m_lpPending.erase(std::remove(m_lpPending.begin(), m_lpPending.end(), pBrain), m_lpPending.end());
+	}
+}
+
+// =============================================================================
+void CBrainScheduler::Update()
+{
+	m_iClock += _TIMEDELTA;
+
+	if (m_lpPending.empty())
+		return;
+
+	// The shared fields are brought up to date before anything looks at them, including the priorities.
+	InfluenceMap.Update();
+
+	// Seeding on the first think keeps the brains in step with the seed a recording sets after the players are created.
+	if (!m_bSeeded)
+		SeedBrains();
+
+	// Run the most urgent brains first.
+	XEN_LIST_FOREACH(t_BrainList, ppBrain, m_lpPending)
+		(*ppBrain)->m_iPriority = GetPriority(*ppBrain);
+
+	std::stable_sort(m_lpPending.begin(), m_lpPending.end(), &CBrainScheduler::ComparePriority);
+
+	// The time budget and thread count would make recorded games play out differently so only the fixed limit applies while recording or replaying.
+	xbool bTimed = !ReplayManager.IsRecording() && !ReplayManager.IsReplaying();
+
+	// Each thread taking part in the decide phase can spend the budget. A hosted match decides on its own thread alone.
+	xint iLanes = (bTimed && !CMatchContext::GetCurrent()) ? WorkerPool.GetThreadCount() + 1 : 1;
+	xint iLimit = BRAIN_TICK_LIMIT * iLanes;
+	xdouble fBudget = m_fBudget * iLanes;
+	xdouble fEstimate = 0.0;
+	xint iProcessed = 0;
+
+	m_lxDecisions.clear();
+
+	for (; iProcessed < (xint)m_lpPending.size() && (xint)m_lxDecisions.size() < iLimit; ++iProcessed)
+	{
+		CBrain* pBrain = m_lpPending[iProcessed];
+		xdouble fCost = pBrain->GetAverageThinkTime();
+
+		// Always allow one brain to think so that no request waits forever.
+		if (bTimed && m_lxDecisions.size() && fEstimate + fCost > fBudget)
+			break;
+
+		pBrain->m_bPending = false;
+
+		// The brain may only decide while its player is waiting for a decision.
+		if (pBrain->m_pPlayer->GetState() != PlayerState_Idle || !pBrain->m_pPlayer->IsThinking())
+			continue;
+
+		CBrainDecision xDecision;
+		xDecision.m_pBrain = pBrain;
+
+		m_lxDecisions.push_back(xDecision);
+
+		fEstimate += fCost;
+	}
+
+	m_lpPending.erase(m_lpPending.begin(), m_lpPending.begin() + iProcessed);
+
+	xint64 iTickStart = CProfileManager::GetCounter();
+
+	{
+		PROFILE_SECTION(ProfileSection_Brain);
+
+		// Nothing changes the world while the brains decide so they can all look at it at once.
+		WorkerPool.Execute(this, (xint)m_lxDecisions.size());
+
+		// Apply in priority order so that the outcome doesn't depend on which thread finished first.
+		XEN_LIST_FOREACH(t_BrainDecisionList, pxDecision, m_lxDecisions)
+		{
+			CBrain* pBrain = pxDecision->m_pBrain;
+
+			pBrain->Apply(*pxDecision);
+
+			pBrain->m_iLastThinkTime = m_iClock;
+			pBrain->m_iThinkCount++;
+			pBrain->m_iThinkCost += pxDecision->m_iCost;
+			pBrain->m_iMaxThinkCost = Math::Max(pBrain->m_iMaxThinkCost, pxDecision->m_iCost);
+		}
+	}
+
+	// Carry the remaining requests forward with their waiting time intact.
+	xdouble fTickTime = CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - iTickStart);
+
+	m_iTickCount++;
+	m_iThinkCount += (xint)m_lxDecisions.size();
+	m_iDeferredCount += (xint)m_lpPending.size();
+	m_fTotalTime += fTickTime;
+	m_fMaxTickTime = Math::Max(m_fMaxTickTime, fTickTime);
+
+	m_lxDecisions.clear();
+}
+
+// =============================================================================
+void CBrainScheduler::Execute(xint iIndex)
+{
+	CBrainDecision& xDecision = m_lxDecisions[iIndex];
+
+	xint64 iStart = CProfileManager::GetCounter();
+
+	xDecision.m_pBrain->Decide(xDecision);
+	xDecision.m_iCost = CProfileManager::GetCounter() - iStart;
+}
+
+// =============================================================================
+void CBrainScheduler::SeedBrains()
+{
+	xuint64 iSeed = _RANDOM(RandomStream_Brain).Next();
+
+	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+	{
+		CBrain* pBrain = (*ppPlayer)->GetControl().m_pBrain;
+
+		if (pBrain)
+			pBrain->SetSeed(iSeed, (*ppPlayer)->GetIndex());
 	}
 
-	// If we're not heading anywhere specific, just wander around.
-	if (!bFoundPacman && !m_pPlayer->GetNavPath())	
-		Wander();
+	m_bSeeded = true;
+}
+
+// =============================================================================
+xint CBrainScheduler::GetPriority(CBrain* pBrain)
+{
+	xint iPriority = m_iClock - pBrain->m_iLastThinkTime;
+	xint iDistance = pBrain->GetTargetDistance();
+
+	if (iDistance >= 0 && iDistance < BRAIN_PROXIMITY_RANGE)
+		iPriority += (BRAIN_PROXIMITY_RANGE - iDistance) * BRAIN_PROXIMITY_WEIGHT;
+
+	return iPriority;
 }
+
+// =============================================================================
+xbool CBrainScheduler::ComparePriority(CBrain* pA, CBrain* pB)
+{
+	return pA->m_iPriority > pB->m_iPriority;
+}
+
+// =============================================================================
+void CBrainScheduler::LogStats()
+{
+	XLOG("[BrainScheduler] %d thinks over %d ticks, %d deferrals, %.3fms average and %.3fms longest per tick with a %.2fms budget.",
+		m_iThinkCount,
+		m_iTickCount,
+		m_iDeferredCount,
+		m_iTickCount ? m_fTotalTime / (xdouble)m_iTickCount : 0.0,
+		m_fMaxTickTime,
+		m_fBudget);
+
+	InfluenceMap.LogStats();
+
+	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+	{
+		CBrain* pBrain = (*ppPlayer)->GetControl().m_pBrain;
+
+		if (pBrain && pBrain->GetThinkCount())
+		{
+			XLOG("[BrainScheduler] Player %d: %d thinks, %.3fms average, %.3fms longest.",
+				(*ppPlayer)->GetIndex(),
+				pBrain->GetThinkCount(),
+				pBrain->GetAverageThinkTime(),
+				pBrain->GetMaxThinkTime());
+
+			pBrain->LogStats();
+		}
+	}
+}
+
+//##############################################################################
@@ -16,33 +16,303 @@
 
 // Other.
 #include <Player.h>
+#include <Worker.h>
+#include <Influence.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define BrainScheduler CBrainScheduler::Get()
+
+// The time in milliseconds the brains may spend thinking each tick.
+#define BRAIN_TICK_BUDGET 2.0
+
+// The maximum number of brains that may think each tick.
+#define BRAIN_TICK_LIMIT 8
+
+// The distance in blocks within which a brain's target raises its priority.
+#define BRAIN_PROXIMITY_RANGE 16
+
+// The priority in milliseconds of waiting time given for each block closer than the proximity range.
+#define BRAIN_PROXIMITY_WEIGHT 20
+
+// The number of blocks a brain can see down a corridor.
+#define BRAIN_SCAN_RANGE 10
+
+// The number of moves within which a ghost that can't see a Pacman will still follow the pressure towards one.
+#define BRAIN_PRESSURE_RANGE 16
+
+// The default time in milliseconds a Pacman brain searches for on each decision.
+#define PACMAN_BRAIN_THINK_TIME 1.0
+
+// The command line option that sets the time in milliseconds a Pacman brain searches for on each decision.
+#define PACMAN_BRAIN_THINK_OPTION "-pacmanthink "
+
+// The number of search iterations a Pacman brain runs on each decision while recording or replaying, where a time limit would play out differently.
+#define PACMAN_BRAIN_FIXED_ITERATIONS 256
+
+// The most search iterations a Pacman brain runs on a single decision, which also bounds the size of the tree.
+#define PACMAN_BRAIN_MAX_ITERATIONS 4096
+
+// The number of moves each search iteration looks ahead.
+#define PACMAN_BRAIN_HORIZON 24
+
+// The weight given to exploring less visited moves when descending the search tree.
+#define PACMAN_BRAIN_EXPLORATION 1.4
+
+// The chance in percent that a simulated ghost closes in on Pacman rather than wandering.
+#define PACMAN_BRAIN_CHASE_CHANCE 60
+
+// The number of search iterations run by the benchmark.
+#define PACMAN_BRAIN_BENCHMARK_ITERATIONS 100000
+
+//##############################################################################
+
+// Predeclare.
+class CBrain;
+
+// Lists.
+typedef xarray<CBrain*> t_BrainList;
+
+//##############################################################################
+
+// The outcome of a brain thinking, applied to its player once every brain for the tick has decided.
+class CBrainDecision
+{
+public:
+	// Constructor.
+	CBrainDecision() :
+		m_pBrain(NULL),
+		m_iMove(PlayerDirection_None),
+		m_pPath(NULL),
+		m_iCost(0)
+	{
+	}
+
+	// The brain that decided.
+	CBrain* m_pBrain;
+
+	// The direction to move in or none to stay put.
+	t_PlayerDirection m_iMove;
+
+	// A new navigation path to follow or NULL to keep the current one.
+	CNavigationPath* m_pPath;
+
+	// The counter interval spent deciding.
+	xint64 m_iCost;
+};
+
+// Lists.
+typedef xarray<CBrainDecision> t_BrainDecisionList;
 
 //##############################################################################
 class CBrain
 {
 public:
+	// Friends.
+	friend class CBrainScheduler;
+
 	// Constructor.
 	CBrain(CPlayer* pPlayer);
 
-	// Execute the behavioural logic.
-	virtual void Think() = 0;
+	// Destructor.
+	virtual ~CBrain();
+
+	// Decide what the player should do next. This may run on a worker thread alongside other brains so it must only write to the brain and the decision. Players and the map's occupancy index are only changed outside of the decide phase so they can be read freely.
+	virtual void Decide(CBrainDecision& xDecision) = 0;
+
+	// Apply a decision to the player.
+	void Apply(CBrainDecision& xDecision);
+
+	// Seed the brain's random number generator, giving each brain its own stream of the seed.
+	inline void SetSeed(xuint64 iSeed, xuint64 iStream)
+	{
+		m_xRandom.Seed(iSeed, iStream);
+	}
+
+	// Get the distance in blocks to the brain's current target or -1 if it has none.
+	virtual xint GetTargetDistance()
+	{
+		return -1;
+	}
+
+	// Get the player object associated with this brain.
+	inline CPlayer* GetPlayer()
+	{
+		return m_pPlayer;
+	}
+
+	// Get the number of times the brain has thought.
+	inline xint GetThinkCount()
+	{
+		return m_iThinkCount;
+	}
+
+	// Get the average time in milliseconds spent on each think.
+	xdouble GetAverageThinkTime();
+
+	// Get the longest time in milliseconds spent on a single think.
+	xdouble GetMaxThinkTime();
+
+	// Write any statistics particular to the type of brain to the log.
+	virtual void LogStats()
+	{
+	}
 
 protected:
-	// Execute a basic wander logic.
-	void Wander();
+	// Decide on a basic wander logic.
+	void Wander(CBrainDecision& xDecision);
 
-	// Approach a specific target
+	// Scan a corridor for other players using the map's occupancy index. The players found replace the visible player list.
+	void ScanCorridor(t_PlayerDirection iDirection);
 
-	// Scan a corridor for other players.
-	t_PlayerList ScanCorridor(t_PlayerDirection iDirection);
+	// Get a random number from zero up to but excluding a limit. The brain keeps its own sequence so that decisions don't depend on which thread runs them.
+	xint Random(xint iLimit);
 
 	// The player object associated with this brain.
 	CPlayer* m_pPlayer;
+
+	// Determines if the brain is waiting to think.
+	xbool m_bPending;
+
+	// The scheduler priority calculated for the current tick.
+	xint m_iPriority;
+
+	// The scheduler time of the last think.
+	xint m_iLastThinkTime;
+
+	// The number of times the brain has thought.
+	xint m_iThinkCount;
+
+	// The total counter interval spent thinking.
+	xint64 m_iThinkCost;
+
+	// The longest counter interval spent on a single think.
+	xint64 m_iMaxThinkCost;
+
+	// The random number generator.
+	CRandom m_xRandom;
+
+	// The players found by the last corridor scan, kept to avoid allocating on each scan.
+	t_PlayerList m_lpVisiblePlayers;
+};
+
+//##############################################################################
+
+// A node in a Pacman brain's search tree, standing for the sequence of moves that leads to it from the root.
+class CPacmanSearchNode
+{
+public:
+	// Constructor.
+	CPacmanSearchNode() :
+		m_iVisits(0),
+		m_fReward(0.0)
+	{
+		for (xint iA = 0; iA < PlayerDirection_Max; ++iA)
+			m_iChildren[iA] = -1;
+	}
+
+	// The number of iterations that have passed through the node.
+	xint m_iVisits;
+
+	// The total reward of those iterations.
+	xdouble m_fReward;
+
+	// The index of the node reached by each move or -1 if it hasn't been expanded.
+	xint m_iChildren[PlayerDirection_Max];
 };
 
+// Lists.
+typedef xarray<CPacmanSearchNode> t_PacmanSearchNodeList;
+
 //##############################################################################
 class CPacmanBrain : public CBrain
 {
+public:
+	// Constructor.
+	CPacmanBrain(CPlayer* pPlayer);
+
+	// Decide what the player should do next by searching the moves ahead with a Monte Carlo tree search.
+	virtual void Decide(CBrainDecision& xDecision);
+
+	// Get the number of moves the nearest ghost needs to reach the player.
+	virtual xint GetTargetDistance();
+
+	// Write the search statistics to the log.
+	virtual void LogStats();
+
+	// Time a number of search iterations from the current position and log the rollout rate.
+	void Benchmark(xint iIterations);
+
+	// Set the time in milliseconds every Pacman brain searches for on each decision.
+	static inline void SetThinkTime(xdouble fThinkTime)
+	{
+		s_fThinkTime = fThinkTime;
+	}
+
+	// Get the time in milliseconds every Pacman brain searches for on each decision.
+	static inline xdouble GetThinkTime()
+	{
+		return s_fThinkTime;
+	}
+
+protected:
+	// Capture the ghosts from the world and take the maze from the influence map.
+	void BuildModel();
+
+	// Search from the current position for a number of iterations or until a time limit in milliseconds passes and return the best move, or -1 if there is none.
+	xint Search(xint iMaxIterations, xdouble fTimeLimit);
+
+	// Descend the tree, expand a node, play out the rest of the horizon and back up the reward along the way taken.
+	void Iterate();
+
+	// Choose the move to descend at a node, trying each move once before weighing them up.
+	xint SelectMove(xint iNode, xint iBlock);
+
+	// Pick a random move for a simulated player, only turning back at a dead end.
+	xint RandomMove(t_PlayerType iType, xint iBlock, xint iLastDirection);
+
+	// Move each simulated ghost a block and check if Pacman was caught moving from one block to another.
+	xbool StepGhosts(xint iFromBlock, xint iToBlock);
+
+	// Get the distance in blocks between two blocks, allowing for the wrap at the edges.
+	xint GetDistance(xint iBlockA, xint iBlockB);
+
+	// The time in milliseconds every Pacman brain searches for on each decision.
+	static xdouble s_fThinkTime;
+
+	// The model of the maze searched over, shared with every other brain so only read from.
+	CBitBoard* m_pBoard;
+
+	// The blocks with a simulated ghost on them.
+	t_BitPlane m_liGhostPlane;
+
+	// The search tree, with the root first.
+	t_PacmanSearchNodeList m_lxNodes;
+
+	// The nodes visited by the current iteration.
+	xarray<xint> m_liPath;
+
+	// The block and direction Pacman starts each iteration from.
+	xint m_iRootBlock;
+	xint m_iRootDirection;
+
+	// The block and direction of each ghost at the start of each iteration.
+	xarray<xint> m_liGhostBlocks;
+	xarray<xint> m_liGhostDirections;
+
+	// The block and direction of each ghost during the current iteration.
+	xarray<xint> m_liSimulatedBlocks;
+	xarray<xint> m_liSimulatedDirections;
+
+	// The pellets eaten during the current iteration.
+	t_BitPlane m_liEaten;
+
+	// The number of rollouts run.
+	xint m_iRolloutCount;
+
+	// The total counter interval spent searching.
+	xint64 m_iSearchCost;
 };
 
 //##############################################################################
@@ -52,11 +322,97 @@ public:
 	// Constructor.
 	CGhostBrain(CPlayer* pPlayer);
 
-	// Execute the behavioural logic.
-	virtual void Think();
+	// Decide what the player should do next.
+	virtual void Decide(CBrainDecision& xDecision);
+
+	// Get the number of moves the player needs to reach the nearest Pacman.
+	virtual xint GetTargetDistance();
 
 	// The last point Pacman was seen.
 	CMapBlock* m_pLastSeen;
 };
 
+//##############################################################################
+class CBrainScheduler : public CWorkerJob
+{
+public:
+	// Singleton instance, or the instance belonging to the match bound to the calling thread.
+	static inline CBrainScheduler& Get()
+	{
+		if (CMatchContext* pContext = CMatchContext::GetCurrent())
+			return *pContext->m_pBrainScheduler;
+
+		static CBrainScheduler s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CBrainScheduler();
+
+	// Discard all pending requests and clear the statistics.
+	void Reset();
+
+	// Request that a brain thinks as soon as the budget allows. Requests are kept until the brain thinks.
+	void Request(CBrain* pBrain);
+
+	// Remove any pending request for a brain.
+	void Cancel(CBrain* pBrain);
+
+	// Run the pending brains in priority order until the tick budget is spent, deferring the rest to the next tick. The selected brains decide in parallel and their decisions are then applied in priority order.
+	void Update();
+
+
+	// Set the time in milliseconds the brains may spend thinking each tick.
+	inline void SetBudget(xdouble fBudget)
+	{
+		m_fBudget = fBudget;
+	}
+
+	// Write the scheduler and per-brain statistics to the log.
+	void LogStats();
+
+	// Let a selected brain decide. This is run by the worker pool.
+	virtual void Execute(xint iIndex);
+
+protected:
+	// Calculate the priority of a pending brain.
+	xint GetPriority(CBrain* pBrain);
+
+	// Sort brains so that the highest priority comes first.
+	static xbool ComparePriority(CBrain* pA, CBrain* pB);
+
+	// Seed each active brain from the global random sequence.
+	void SeedBrains();
+
+	// The brains waiting to think.
+	t_BrainList m_lpPending;
+
+	// The decisions for the brains selected this tick.
+	t_BrainDecisionList m_lxDecisions;
+
+	// Determines if the brains have been seeded since the last reset.
+	xbool m_bSeeded;
+
+	// The simulation time used to measure how long brains have waited.
+	xint m_iClock;
+
+	// The time in milliseconds the brains may spend thinking each tick.
+	xdouble m_fBudget;
+
+	// The number of ticks that have had brains to run.
+	xint m_iTickCount;
+
+	// The number of thinks run.
+	xint m_iThinkCount;
+
+	// The number of requests deferred to a later tick.
+	xint m_iDeferredCount;
+
+	// The total time in milliseconds spent thinking.
+	xdouble m_fTotalTime;
+
+	// The longest time in milliseconds spent thinking in a single tick.
+	xdouble m_fMaxTickTime;
+};
+
 //##############################################################################
\ No newline at end of file
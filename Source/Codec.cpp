@@ -0,0 +1,162 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Codec.h>
+
+//##############################################################################
+
+// =============================================================================
+template <typename t_Type>
+inline void SetField(t_Type& tField, xuint32 iValue)
+{
+	tField = (t_Type)iValue;
+}
+
+// =============================================================================
+template <>
+inline void SetField<xbool>(xbool& bField, xuint32 iValue)
+{
+	bField = (iValue != 0);
+}
+
+//##############################################################################
+
+// =============================================================================
+void CPlayerSnapshotCodec::Write(const CPlayerSnapshot& xSnapshot, const CPlayerSnapshot* pBaseline, BitStream* pStream)
+{
+	if (pBaseline)
+	{
+		// Only write the fields that have changed, with a single bit for the rest.
+		#define PLAYER_SNAPSHOT_WRITE_DELTA(TYPE, NAME, BITS, QUANTISE) \
+			if ((xSnapshot.NAME >> QUANTISE) != (pBaseline->NAME >> QUANTISE)) \
+			{ \
+				pStream->Write1(); \
+				WriteValue(pStream, (xuint32)xSnapshot.NAME >> QUANTISE, BITS); \
+			} \
+			else \
+				pStream->Write0();
+
+		PLAYER_SNAPSHOT_SCHEMA(PLAYER_SNAPSHOT_WRITE_DELTA)
+		#undef PLAYER_SNAPSHOT_WRITE_DELTA
+	}
+	else
+	{
+		#define PLAYER_SNAPSHOT_WRITE(TYPE, NAME, BITS, QUANTISE) \
+			WriteValue(pStream, (xuint32)xSnapshot.NAME >> QUANTISE, BITS);
+
+		PLAYER_SNAPSHOT_SCHEMA(PLAYER_SNAPSHOT_WRITE)
+		#undef PLAYER_SNAPSHOT_WRITE
+	}
+}
+
+// =============================================================================
+void CPlayerSnapshotCodec::Read(CPlayerSnapshot& xSnapshot, const CPlayerSnapshot* pBaseline, BitStream* pStream)
+{
+	if (pBaseline)
+	{
+		xSnapshot = *pBaseline;
+
+		#define PLAYER_SNAPSHOT_READ_DELTA(TYPE, NAME, BITS, QUANTISE) \
+			if (pStream->ReadBit()) \
+				SetField(xSnapshot.NAME, ReadValue(pStream, BITS) << QUANTISE);
+
+		PLAYER_SNAPSHOT_SCHEMA(PLAYER_SNAPSHOT_READ_DELTA)
+		#undef PLAYER_SNAPSHOT_READ_DELTA
+	}
+	else
+	{
+		#define PLAYER_SNAPSHOT_READ(TYPE, NAME, BITS, QUANTISE) \
+			SetField(xSnapshot.NAME, ReadValue(pStream, BITS) << QUANTISE);
+
+		PLAYER_SNAPSHOT_SCHEMA(PLAYER_SNAPSHOT_READ)
+		#undef PLAYER_SNAPSHOT_READ
+	}
+}
+
+// =============================================================================
+xint CPlayerSnapshotCodec::GetBitCount(xuint32 iCount)
+{
+	xint iBits = 1;
+
+	while (iBits < 32 && ((xuint32)1 << iBits) < iCount)
+		iBits++;
+
+	return iBits;
+}
+
+// =============================================================================
+void CPlayerSnapshotCodec::Benchmark(const t_PlayerSnapshotList& lxPlayers, xint iIterations)
+{
+	if (lxPlayers.empty())
+		return;
+
+	// Build a baseline where roughly half the players have moved on since, as they would between two snapshots.
+	t_PlayerSnapshotList lxBaseline = lxPlayers;
+
+	for (xint iA = 0; iA < (xint)lxBaseline.size(); iA += 2)
+	{
+		lxBaseline[iA].m_iTransition += 64;
+		lxBaseline[iA].m_iInputSequence--;
+	}
+
+	BitStream xStream;
+	CPlayerSnapshot xDecoded;
+
+	xint iFullBits = 0;
+	xint iDeltaBits = 0;
+
+	// Encode.
+	xuint iEncodeStart = _TIMEMS;
+
+	for (xint iA = 0; iA < iIterations; ++iA)
+	{
+		xStream.Reset();
+
+		for (xint iB = 0; iB < (xint)lxPlayers.size(); ++iB)
+			Write(lxPlayers[iB], &lxBaseline[iB], &xStream);
+	}
+
+	xuint iEncodeTime = _TIMEMS - iEncodeStart;
+	iDeltaBits = xStream.GetNumberOfBitsUsed();
+
+	// Decode.
+	xuint iDecodeStart = _TIMEMS;
+
+	for (xint iA = 0; iA < iIterations; ++iA)
+	{
+		xStream.ResetReadPointer();
+
+		for (xint iB = 0; iB < (xint)lxPlayers.size(); ++iB)
+			Read(xDecoded, &lxBaseline[iB], &xStream);
+	}
+
+	xuint iDecodeTime = _TIMEMS - iDecodeStart;
+
+	// Measure the full encoding for comparison.
+	xStream.Reset();
+
+	for (xint iB = 0; iB < (xint)lxPlayers.size(); ++iB)
+		Write(lxPlayers[iB], NULL, &xStream);
+
+	iFullBits = xStream.GetNumberOfBitsUsed();
+
+	xint iPlayers = iIterations * (xint)lxPlayers.size();
+
+	XLOG("[PlayerSnapshotCodec] Encoded %d players in %dms (%.0f players/sec), decoded in %dms (%.0f players/sec).",
+		iPlayers,
+		iEncodeTime,
+		iEncodeTime ? (xfloat)iPlayers * 1000.f / (xfloat)iEncodeTime : 0.f,
+		iDecodeTime,
+		iDecodeTime ? (xfloat)iPlayers * 1000.f / (xfloat)iDecodeTime : 0.f);
+
+	XLOG("[PlayerSnapshotCodec] Average size per player: %.1f bits delta, %.1f bits full, %d bits per block index, %d bytes unpacked.",
+		(xfloat)iDeltaBits / (xfloat)lxPlayers.size(),
+		(xfloat)iFullBits / (xfloat)lxPlayers.size(),
+		m_iBlockBits,
+		sizeof(CPlayerSnapshot));
+}
+
+//##############################################################################
\ No newline at end of file
@@ -0,0 +1,143 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Other.
+#include <Network.h>
+
+//##############################################################################
+
+// The replicated state of a single player. Each field lists its type, name, packed bit width and the number of low bits dropped by quantisation.
+// The bit width may use the codec's m_iBlockBits which is derived from the size of the current map.
+#define PLAYER_SNAPSHOT_SCHEMA(FIELD) \
+	FIELD(xuint32,	m_iBlock,			m_iBlockBits,	0) /* The index of the block the player is on. */ \
+	FIELD(xuint8,	m_iState,			3,				0) /* The player state. */ \
+	FIELD(xuint8,	m_iDirection,		2,				0) /* The direction the player is moving in. */ \
+	FIELD(xuint8,	m_iTransition,		5,				3) /* The transition between blocks scaled to the range 0 to 255. */ \
+	FIELD(xbool,	m_bLeaving,			1,				0) /* Determines if the player is leaving the map when warping. */ \
+	FIELD(xuint16,	m_iInputSequence,	16,				0) /* The sequence number of the last input from the owning client that the host has applied. */
+
+//##############################################################################
+class CPlayerSnapshot
+{
+public:
+	// Check if the replicated state differs from another once quantised.
+	inline xbool operator!=(const CPlayerSnapshot& xOther) const
+	{
+		#define PLAYER_SNAPSHOT_COMPARE(TYPE, NAME, BITS, QUANTISE) || ((NAME >> QUANTISE) != (xOther.NAME >> QUANTISE))
+		return false PLAYER_SNAPSHOT_SCHEMA(PLAYER_SNAPSHOT_COMPARE);
+		#undef PLAYER_SNAPSHOT_COMPARE
+	}
+
+	// The replicated fields.
+	#define PLAYER_SNAPSHOT_DECLARE(TYPE, NAME, BITS, QUANTISE) TYPE NAME;
+	PLAYER_SNAPSHOT_SCHEMA(PLAYER_SNAPSHOT_DECLARE)
+	#undef PLAYER_SNAPSHOT_DECLARE
+};
+
+// Lists.
+typedef xarray<CPlayerSnapshot> t_PlayerSnapshotList;
+
+//##############################################################################
+class CPlayerSnapshotCodec
+{
+public:
+	// Constructor.
+	CPlayerSnapshotCodec() : m_iBlockBits(1) {}
+
+	// Set the number of blocks on the current map which determines the width of block indices.
+	void SetBlockCount(xint iBlockCount)
+	{
+		m_iBlockBits = GetBitCount(iBlockCount);
+	}
+
+	// Get the number of bits used to write a block index.
+	inline xint GetBlockBits()
+	{
+		return m_iBlockBits;
+	}
+
+	// Write a player snapshot as a delta against a baseline. A NULL baseline will write every field.
+	void Write(const CPlayerSnapshot& xSnapshot, const CPlayerSnapshot* pBaseline, BitStream* pStream);
+
+	// Read a player snapshot as a delta against a baseline. A NULL baseline will read every field.
+	void Read(CPlayerSnapshot& xSnapshot, const CPlayerSnapshot* pBaseline, BitStream* pStream);
+
+	// Write the lowest bits of a value.
+	static inline void WriteValue(BitStream* pStream, xuint32 iValue, xint iBits)
+	{
+		pStream->WriteBits((const xuint8*)&iValue, iBits, true);
+	}
+
+	// Read a value from the specified number of bits.
+	static inline xuint32 ReadValue(BitStream* pStream, xint iBits)
+	{
+		xuint32 iValue = 0;
+		pStream->ReadBits((xuint8*)&iValue, iBits, true);
+
+		return iValue;
+	}
+
+	// Get the number of bits below the highest set bit of a value, which must not be zero.
+	static inline xint GetGammaOrder(xuint32 iValue)
+	{
+		xint iOrder = 0;
+
+		while (iValue >>= 1)
+			iOrder++;
+
+		return iOrder;
+	}
+
+	// Get the number of bits taken to write a value as a gamma code.
+	static inline xint GetGammaBits(xuint32 iValue)
+	{
+		return GetGammaOrder(iValue) * 2 + 1;
+	}
+
+	// Write a value of one or more as an Elias gamma code, which is shorter the smaller the value.
+	static inline void WriteGamma(BitStream* pStream, xuint32 iValue)
+	{
+		xint iOrder = GetGammaOrder(iValue);
+
+		for (xint iA = 0; iA < iOrder; ++iA)
+			pStream->Write0();
+
+		pStream->Write1();
+
+		if (iOrder)
+			WriteValue(pStream, iValue, iOrder);
+	}
+
+	// Read a value written as a gamma code, or zero if the stream doesn't hold a whole code.
+	static inline xuint32 ReadGamma(BitStream* pStream)
+	{
+		for (xint iOrder = 0; iOrder < 32 && pStream->GetNumberOfUnreadBits(); ++iOrder)
+		{
+			if (pStream->ReadBit())
+			{
+				if (pStream->GetNumberOfUnreadBits() < (BitSize_t)iOrder)
+					return 0;
+
+				return ((xuint32)1 << iOrder) | (iOrder ? ReadValue(pStream, iOrder) : 0);
+			}
+		}
+
+		return 0;
+	}
+
+	// Get the number of bits required to store any value below the specified count.
+	static xint GetBitCount(xuint32 iCount);
+
+	// Measure the encode and decode throughput and the average size of each player using the current game state.
+	void Benchmark(const t_PlayerSnapshotList& lxPlayers, xint iIterations);
+
+protected:
+	// The number of bits used to write a block index.
+	xint m_iBlockBits;
+};
+
+//##############################################################################
\ No newline at end of file
@@ -6,6 +6,9 @@
 // Local.
 #include <Collision.h>
 
+// Other.
+#include <Profile.h>
+
 //##############################################################################
 
 // =============================================================================
@@ -32,6 +35,8 @@ void CCollisionManager::Reset()
 // =============================================================================
 void CCollisionManager::OnUpdate()
 {
+	PROFILE_SECTION(ProfileSection_Collision);
+
 	for (xint iA = 0; iA < CollisionLayer_Max; ++iA)
 	{
 		XEN_LIST_FOREACH(t_CollidableList, ppCollidable, m_lpCollidables[iA])
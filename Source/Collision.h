@@ -103,9 +103,12 @@ private:
 class CCollisionManager : public CModule
 {
 public:
-	// Singleton instance.
+	// Singleton instance, or the instance belonging to the match bound to the calling thread.
 	static inline CCollisionManager& Get() 
 	{
+		if (CMatchContext* pContext = CMatchContext::GetCurrent())
+			return *pContext->m_pCollisionManager;
+
 		static CCollisionManager s_Instance;
 		return s_Instance;
 	}
@@ -16,18 +16,29 @@
 #include <Game.h>
 
 // Other.
+#include <Brain.h>
+#include <Influence.h>
 #include <Minimap.h>
 #include <Network.h>
+#include <Replay.h>
+#include <Snapshot.h>
+#include <Trace.h>
 #include <Sound.h>
+#include <Trigger.h>
 
 //##############################################################################
 
 // =============================================================================
 void CGameScreen::OnActivate()
 {
-	// Initialise the players.
-	PlayerManager.InitialisePlayers(PlayerLogicType_None);
-	PlayerManager.SetLocalPlayer(0);
+	// Initialise the players. Network games have already assigned players to each peer in the lobby.
+	if (!NetworkManager.IsRunning())
+	{
+		PlayerManager.InitialisePlayers(PlayerLogicType_None);
+		PlayerManager.SetLocalPlayer(0);
+	}
+
+	SnapshotManager.Reset();
 
 	// Initialise the render manager for the game.
 	m_xRenderView = new CRenderView(GameLayerIndex_Max);
@@ -75,6 +86,8 @@ void CGameScreen::OnActivate()
 // =============================================================================
 void CGameScreen::OnDeactivate()
 {
+	ReplayManager.StopRecording();
+
 	CollisionManager.Reset();
 
 	delete m_pCountdownFont;
@@ -132,7 +145,7 @@ xbool CGameScreen::OnEvent(xint iEventType, void* pEventInfo)
 			case HGEK_ENTER:
 				{
 					if (m_iState == GameState_Finished)
-						SetState(GameState_Intro);
+						Restart();
 				}
 				break;
 			}
@@ -184,8 +197,11 @@ void CGameScreen::OnUpdate()
 	CalculateColourisation();
 
 	// Update the other components.
+	ReplayManager.BeginTick();
+
 	MapManager.Update();
 	PlayerManager.Update();
+	SnapshotManager.Update();
 
 	// Generate the minimap.
 	GenerateMinimap();
@@ -258,7 +274,7 @@ void CGameScreen::ResetGame()
 	m_pChannel = NULL;
 
 	t_FileScanResult lsMusicFiles = FileManager.Scan("Sound\\Level\\*.mp3");
-	xint iMusicIndex = rand() % lsMusicFiles.size();
+	xint iMusicIndex = _RANDOM(RandomStream_Presentation).GetInt((xint)lsMusicFiles.size());
 
 	if (lsMusicFiles.size())
 		_FMOD->createStream(XFORMAT("Sound\\Level\\%s", lsMusicFiles[iMusicIndex].c_str()), FMOD_SOFTWARE, 0, &m_pMusic);
@@ -267,7 +283,7 @@ void CGameScreen::ResetGame()
 	for (xint iA = 0; iA < 3; ++iA)
 	{
 		Global.m_fColourChannels[iA] = .5f;
-		m_bColouriseDir[iA] = (rand() % 2 == 0);
+		m_bColouriseDir[iA] = _RANDOM(RandomStream_Presentation).GetBool();
 	}
 
 	// Disable the players.
@@ -281,6 +297,12 @@ void CGameScreen::ResetGame()
 // =============================================================================
 void CGameScreen::StartGame()
 {
+	// Each match plays out from its own seed. Recording a match replaces it with one that's saved along with the match.
+	Global.SeedMatch((xuint32)_RANDOM(RandomStream_Session).Next());
+
+	// Timed effects from a previous match or the intro don't carry over.
+	TriggerManager.Restart();
+
 	//m_pMusic->Play();
 	if (m_pMusic)
 		_FMOD->playSound(FMOD_CHANNEL_FREE, m_pMusic, false, &m_pChannel);
@@ -289,6 +311,9 @@ void CGameScreen::StartGame()
 	{
 		(*ppPlayer)->Revive();
 
+		if (NetworkManager.IsRunning())
+			continue;
+
 		if ((*ppPlayer)->GetType() == PlayerType_Pacman)
 			(*ppPlayer)->SetLogicType(PlayerLogicType_Local);
 		else if ((*ppPlayer)->GetType() == PlayerType_Ghost)
@@ -296,11 +321,16 @@ void CGameScreen::StartGame()
 	}
 
 	PlayerManager.SetPlayersEnabled(true);
+
+	if (m_bRecordGames)
+		ReplayManager.StartRecording(REPLAY_DEFAULT_FILE);
 }
 
 // =============================================================================
 void CGameScreen::EndGame()
 {
+	ReplayManager.StopRecording();
+
 	Global.m_fMapAlpha = 1.f;
 
 	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
@@ -505,7 +535,7 @@ void CGameScreen::DebugControls()
 	// Test path-finding on the local player.
 	if (_HGE->Input_KeyDown(HGEK_CTRL))
 	{
-		PlayerManager.GetLocalPlayer()->NavigateTo(MapManager.GetCurrentMap()->GetBlock(rand() % MapManager.GetCurrentMap()->GetBlockCount()));
+		PlayerManager.GetLocalPlayer()->NavigateTo(MapManager.GetCurrentMap()->GetBlock(_RANDOM(RandomStream_Gameplay).GetInt(MapManager.GetCurrentMap()->GetBlockCount())));
 	}
 
 	if (_HGE->Input_KeyDown(HGEK_F1))
@@ -518,4 +548,44 @@ void CGameScreen::DebugControls()
 		RenderLayer(GameLayerIndex_EdgeOverlay)->SetEnabled(!RenderLayer(GameLayerIndex_EdgeOverlay)->IsEnabled());
 	if (_HGE->Input_KeyDown(HGEK_F4))
 		RenderLayer(GameLayerIndex_GhostOverlay)->SetEnabled(!RenderLayer(GameLayerIndex_GhostOverlay)->IsEnabled());
+
+	// Benchmark the snapshot codec.
+	if (_HGE->Input_KeyDown(HGEK_F5))
+		SnapshotManager.Benchmark();
+
+	// Toggle recording from the next game.
+	if (_HGE->Input_KeyDown(HGEK_F6))
+	{
+		m_bRecordGames = !m_bRecordGames;
+
+		if (!m_bRecordGames)
+			ReplayManager.StopRecording();
+
+		XLOG("[GameScreen] Game recording %s.", m_bRecordGames ? "enabled" : "disabled");
+	}
+
+	// Log the brain scheduler statistics.
+	if (_HGE->Input_KeyDown(HGEK_F7))
+		BrainScheduler.LogStats();
+
+	// Benchmark the Pacman search.
+	if (_HGE->Input_KeyDown(HGEK_F8))
+	{
+		XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+		{
+			if ((*ppPlayer)->GetType() == PlayerType_Pacman)
+			{
+				((CPacmanBrain*)(*ppPlayer)->GetControl().m_pBrain)->Benchmark(PACMAN_BRAIN_BENCHMARK_ITERATIONS);
+				break;
+			}
+		}
+	}
+
+	// Benchmark the influence map's distance fields.
+	if (_HGE->Input_KeyDown(HGEK_F9))
+		InfluenceMap.Benchmark();
+
+	// Dump the packet trace.
+	if (_HGE->Input_KeyDown(HGEK_F11))
+		PacketTrace.Dump("requested");
 }
@@ -59,11 +59,23 @@ class CGameScreen : public CScreen
 {
 public:
 	// Constructor.
-	CGameScreen() : CScreen(ScreenIndex_GameScreen) {}
+	CGameScreen() : CScreen(ScreenIndex_GameScreen), m_bRecordGames(false) {}
 
 	// Callback for when Pacman is captured by a ghost.
 	void OnPacmanDie(CGhost* pGhost);
 
+	// Get the current game state.
+	inline t_GameState GetState()
+	{
+		return m_iState;
+	}
+
+	// Restart the round from the countdown.
+	inline void Restart()
+	{
+		SetState(GameState_Intro);
+	}
+
 protected:
 	// Called to load the screen resources.
 	virtual void OnLoad() {}
@@ -177,6 +189,9 @@ protected:
 
 	// The countdown sound.
 	CSound* m_pCountdownSound;
+
+	// Determines if each game should be recorded for replay.
+	xbool m_bRecordGames;
 };
 
 //##############################################################################
\ No newline at end of file
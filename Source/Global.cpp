@@ -4,8 +4,19 @@
 #include <Global.h>
 
 // Other.
+#include <Brain.h>
+#include <Collision.h>
+#include <Influence.h>
+#include <Network.h>
 #include <Player.h>
 #include <Map.h>
+#include <Snapshot.h>
+#include <Trigger.h>
+
+//##############################################################################
+
+// Match Context.
+__declspec(thread) CMatchContext* CMatchContext::s_pCurrent = NULL;
 
 //##############################################################################
 
@@ -38,4 +49,86 @@ const xchar* CGlobal::GetLocaleFromVar(const xchar* pInput)
 	return pInput;
 }
 
+// =============================================================================
+void CGlobal::SeedRandom(xuint32 iSeed)
+{
+	for (xint iA = 0; iA < RandomStream_Max; ++iA)
+		m_xRandom[iA].Seed(iSeed, iA);
+}
+
+// =============================================================================
+void CGlobal::SeedMatch(xuint32 iSeed)
+{
+	CMatchContext* pContext = CMatchContext::GetCurrent();
+	CRandom* pRandom = pContext ? pContext->m_xRandom : m_xRandom;
+
+	for (xint iA = 0; iA < RandomStream_MatchMax; ++iA)
+		pRandom[iA].Seed(iSeed, iA);
+}
+
+//##############################################################################
+
+// =============================================================================
+CMatchContext::CMatchContext(xint iID, xuint32 iSeed) :
+	m_iID(iID)
+{
+	for (xint iA = 0; iA < RandomStream_Max; ++iA)
+		m_xRandom[iA].Seed(iSeed, iA);
+
+	// Players register with the match modules as they are created, so the context must be bound first.
+	CMatchScope xScope(this);
+
+	m_pNetworkManager = new CNetworkManager();
+	m_pMapManager = new CMapManager();
+	m_pPlayerManager = new CPlayerManager();
+	m_pCollisionManager = new CCollisionManager();
+	m_pSnapshotManager = new CSnapshotManager();
+	m_pTriggerManager = new CTriggerManager();
+	m_pBrainScheduler = new CBrainScheduler();
+	m_pInfluenceMap = new CInfluenceMap();
+
+	m_xModules.Add(m_pNetworkManager);
+	m_xModules.Add(m_pPlayerManager);
+	m_xModules.Add(m_pMapManager);
+	m_xModules.Add(m_pCollisionManager);
+	m_xModules.Add(m_pSnapshotManager);
+
+	m_xModules.Initialise();
+
+	m_pPlayerManager->Initialise();
+}
+
+// =============================================================================
+CMatchContext::~CMatchContext()
+{
+	CMatchScope xScope(this);
+
+	// Players leave the other modules as they are freed, so those are deleted last.
+	m_xModules.Deinitialise();
+
+	delete m_pNetworkManager;
+	delete m_pPlayerManager;
+	delete m_pMapManager;
+	delete m_pCollisionManager;
+	delete m_pSnapshotManager;
+	delete m_pTriggerManager;
+	delete m_pBrainScheduler;
+	delete m_pInfluenceMap;
+}
+
+// =============================================================================
+CMatchContext* CMatchContext::Bind(CMatchContext* pContext)
+{
+	CMatchContext* pPrevious = s_pCurrent;
+	s_pCurrent = pContext;
+
+	return pPrevious;
+}
+
+// =============================================================================
+void CMatchContext::Update()
+{
+	m_xModules.Update();
+}
+
 //##############################################################################
\ No newline at end of file
@@ -66,7 +66,7 @@
 // Game options.
 #define _GID					"PikPik-1"
 #define _HOSTPORT				20557
-#define _MAXPLAYERS				5
+#define _MAXPLAYERS				64
 #define _MAXNAMELEN				15
 #define _MAXNAMECHARS			16
 
@@ -78,6 +78,7 @@
 #define _TIMEDELTA				Application::GetTimeDelta()
 #define _TIMEDELTAF				_HGE->Timer_GetDelta()
 #define _LOCALE(NAME)			Global.GetLocale(NAME)
+#define _RANDOM(STREAM)			Global.GetRandom(STREAM)
 
 // Colour manipulations.
 #define _ARGB(A, R, G, B)		ARGB(A, R, G, B)
@@ -103,6 +104,14 @@ class CSprite;
 class CPlayer;
 class CMap;
 class CFont;
+class CNetworkManager;
+class CMapManager;
+class CPlayerManager;
+class CCollisionManager;
+class CSnapshotManager;
+class CTriggerManager;
+class CBrainScheduler;
+class CInfluenceMap;
 
 // The game playing mode.
 enum t_PlayMode
@@ -199,6 +208,10 @@ enum t_NetworkStreamType
 	NetworkStreamType_PlayerInfo,
 	NetworkStreamType_StartGame,
 	NetworkStreamType_PlayerUpdate,
+	NetworkStreamType_Snapshot,
+	NetworkStreamType_SnapshotAck,
+	NetworkStreamType_LoadTest,
+	NetworkStreamType_WorldState,
 };
 
 // The lobby start mode.
@@ -220,6 +233,23 @@ enum t_CollisionGroup
 	CollisionGroup_Max,
 };
 
+// The random number streams, one for each part of the game so that drawing in one never changes what another gets.
+enum t_RandomStream
+{
+	// Match streams, reseeded for each match and by recordings.
+	RandomStream_Spawn,
+	RandomStream_Brain,
+	RandomStream_Gameplay,
+
+	// Other streams, only seeded on start up.
+	RandomStream_Presentation,
+	RandomStream_Session,
+	RandomStream_LoadTest,
+
+	RandomStream_Max,
+	RandomStream_MatchMax = RandomStream_Presentation,
+};
+
 // Common list types.
 typedef xlist<CMetadata*> t_MetadataList;
 typedef xlist<CSprite*> t_SpriteList;
@@ -228,6 +258,83 @@ typedef xlist<CSprite*> t_SpriteList;
 using namespace Xen;
 using namespace fastdelegate;
 
+//##############################################################################
+
+// The state of a single match, so that one process can run many matches side by side. The match modules return the instance from the context bound to the calling thread, or their own instance when there isn't one.
+class CMatchContext
+{
+public:
+	// Constructor. The match modules are created and initialised with the context bound to the calling thread.
+	CMatchContext(xint iID, xuint32 iSeed);
+
+	// Destructor.
+	~CMatchContext();
+
+	// Get the context bound to the calling thread or NULL if the thread uses the application's modules.
+	static inline CMatchContext* GetCurrent()
+	{
+		return s_pCurrent;
+	}
+
+	// Bind a context to the calling thread and return the one it replaces.
+	static CMatchContext* Bind(CMatchContext* pContext);
+
+	// Update the match modules that the module system would update each frame.
+	void Update();
+
+	// Get the match ID.
+	inline xint GetID()
+	{
+		return m_iID;
+	}
+
+	// The match modules.
+	CNetworkManager* m_pNetworkManager;
+	CMapManager* m_pMapManager;
+	CPlayerManager* m_pPlayerManager;
+	CCollisionManager* m_pCollisionManager;
+	CSnapshotManager* m_pSnapshotManager;
+	CTriggerManager* m_pTriggerManager;
+	CBrainScheduler* m_pBrainScheduler;
+	CInfluenceMap* m_pInfluenceMap;
+
+	// The random number streams.
+	CRandom m_xRandom[RandomStream_Max];
+
+protected:
+	// The match ID.
+	xint m_iID;
+
+	// The modules updated each frame, in the same order as the application's.
+	CModuleManager m_xModules;
+
+	// The context bound to each thread.
+	static __declspec(thread) CMatchContext* s_pCurrent;
+};
+
+//##############################################################################
+
+// Binds a match context to the calling thread for the life of the scope.
+class CMatchScope
+{
+public:
+	// Constructor.
+	CMatchScope(CMatchContext* pContext) :
+		m_pPrevious(CMatchContext::Bind(pContext))
+	{
+	}
+
+	// Destructor.
+	~CMatchScope()
+	{
+		CMatchContext::Bind(m_pPrevious);
+	}
+
+protected:
+	// The context bound before the scope.
+	CMatchContext* m_pPrevious;
+};
+
 //##############################################################################
 class CGlobal
 {
@@ -246,9 +353,31 @@ public:
 	// Process and substitute a string if it is a locale variable.
 	const xchar* GetLocaleFromVar(const xchar* pInput);
 
+	// Seed every random number stream.
+	void SeedRandom(xuint32 iSeed);
+
+	// Seed the random number streams that decide how a match plays out.
+	void SeedMatch(xuint32 iSeed);
+
+	// Get a random number stream, from the match bound to the calling thread if there is one.
+	inline CRandom& GetRandom(t_RandomStream iStream)
+	{
+		CMatchContext* pContext = CMatchContext::GetCurrent();
+		return pContext ? pContext->m_xRandom[iStream] : m_xRandom[iStream];
+	}
+
 	// The current focus status of the game window.
 	xbool m_bWindowFocused;
 
+	// Determines if the local player is steered by its brain rather than the keys, whether or not the window has focus.
+	xbool m_bBotControlled;
+
+	// The port used to host and join matches.
+	xint m_iHostPort;
+
+	// The random number streams.
+	CRandom m_xRandom[RandomStream_Max];
+
 	// The overall screen alpha.
 	xfloat m_fMapAlpha;
 
@@ -0,0 +1,586 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Host.h>
+
+// Other.
+#include <Map.h>
+#include <Player.h>
+#include <Snapshot.h>
+#include <Trigger.h>
+#include <RakNet/RakNetStatistics.h>
+
+// System.
+#include <Windows.h>
+#include <process.h>
+
+//##############################################################################
+
+// =============================================================================
+CHostedMatch::CHostedMatch(xint iID, xint iClientCount, const xchar* pMap, RakPeerInterface* pInterface, CRITICAL_SECTION* pLock) :
+	m_iState(HostedMatchState_Waiting),
+	m_iClientCount(iClientCount),
+	m_sMap(pMap),
+	m_iRoundCount(0),
+	m_iMeasureEpoch(-1),
+	m_iBusyCounter(0)
+{
+	// Every match plays with the application's settings and from its own seed.
+	xint iSendBudget = NetworkManager.GetSendBudget();
+	xbool bCoalescing = NetworkManager.IsCoalescing();
+	xuint32 iSeed = (xuint32)_RANDOM(RandomStream_Session).Next();
+
+	m_pContext = new CMatchContext(iID, iSeed);
+
+	CMatchScope xScope(m_pContext);
+
+	MapManager.SetCurrentMap(m_sMap.c_str());
+	PlayerManager.InitialisePlayers(PlayerLogicType_AI);
+
+	strcpy_s(m_xGamerCard.m_cNickname, _MAXNAMELEN, XFORMAT("Match%d", iID));
+	m_xGamerCard.m_iSeed = _RANDOM(RandomStream_Session).GetInt(4096);
+
+	NetworkManager.SetMatchID(iID);
+	NetworkManager.SetSendBudget(iSendBudget);
+	NetworkManager.SetCoalescing(bCoalescing);
+
+	NetworkManager.SetGamerCard(&m_xGamerCard, sizeof(CNetworkGamerCard));
+	NetworkManager.SetVerificationInfo(_GID, String::Length(_GID) + 1);
+
+	// Bind the stream type callbacks.
+	NetworkManager.BindReceiveCallback(NetworkStreamType_PlayerUpdate, &CPlayer::OnReceivePlayerUpdate);
+	NetworkManager.BindReceiveCallback(NetworkStreamType_Snapshot, xbind(&SnapshotManager, &CSnapshotManager::OnReceiveSnapshot));
+	NetworkManager.BindReceiveCallback(NetworkStreamType_SnapshotAck, xbind(&SnapshotManager, &CSnapshotManager::OnReceiveSnapshotAck));
+	NetworkManager.BindReceiveCallback(NetworkStreamType_WorldState, xbind(&SnapshotManager, &CSnapshotManager::OnReceiveWorldState));
+
+	// Bind all event callbacks.
+	NetworkManager.m_xCallbacks.m_fpVerifyPeer = xbind(this, &CHostedMatch::OnVerifyPeer);
+	NetworkManager.m_xCallbacks.m_fpPeerJoined = xbind(this, &CHostedMatch::OnPeerJoined);
+	NetworkManager.m_xCallbacks.m_fpPeerLeaving = xbind(this, &CHostedMatch::OnPeerLeaving);
+
+	NetworkManager.StartSharedHost(pInterface, pLock);
+}
+
+// =============================================================================
+CHostedMatch::~CHostedMatch()
+{
+	{
+		CMatchScope xScope(m_pContext);
+
+		XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, NetworkManager.GetVerifiedPeers())
+		{
+			delete (CNetworkPeerInfo*)(*ppPeer)->m_pData;
+			(*ppPeer)->m_pData = NULL;
+		}
+
+		if (NetworkManager.IsRunning())
+			NetworkManager.Stop();
+
+		CollisionManager.Reset();
+		MapManager.ClearCurrentMap();
+	}
+
+	delete m_pContext;
+}
+
+// =============================================================================
+void CHostedMatch::Update()
+{
+	CMatchScope xScope(m_pContext);
+
+	xint64 iStart = CProfileManager::GetCounter();
+
+	// A new measuring period starts from the next tick.
+	if (m_iMeasureEpoch != MatchHost.GetMeasureEpoch())
+	{
+		m_iMeasureEpoch = MatchHost.GetMeasureEpoch();
+
+		m_lfTickTimes.clear();
+		m_lfRoundTrips.clear();
+		m_iBusyCounter = 0;
+
+		m_xSampleTimer.ExpireAfter(0);
+	}
+
+	m_pContext->Update();
+
+	if (!NetworkManager.IsRunning())
+		return;
+
+	UpdateState();
+
+	if (m_iState != HostedMatchState_Waiting)
+	{
+		MapManager.Update();
+		PlayerManager.Update();
+		SnapshotManager.Update();
+
+		if (m_xSampleTimer.IsExpired())
+		{
+			SampleRoundTrips();
+			m_xSampleTimer.ExpireAfter(MATCH_HOST_SAMPLE_INTERVAL);
+		}
+	}
+
+	// Send everything queued during the tick together.
+	NetworkManager.Flush();
+
+	xint64 iTicks = CProfileManager::GetCounter() - iStart;
+
+	m_lfTickTimes.push_back(CProfileManager::GetMilliseconds(iTicks));
+	m_iBusyCounter += iTicks;
+}
+
+// =============================================================================
+void CHostedMatch::UpdateState()
+{
+	switch (m_iState)
+	{
+	case HostedMatchState_Waiting:
+		{
+			if ((xint)NetworkManager.GetVerifiedPeers().size() == m_iClientCount + 1 && NetworkManager.IsEveryoneVerified())
+				StartMatch();
+		}
+		break;
+
+	case HostedMatchState_Intro:
+		{
+			if (m_xStateTimer.IsExpired())
+				StartRound();
+		}
+		break;
+
+	case HostedMatchState_Playing:
+		{
+			// There is no game screen to end the round, so a new one is started as soon as Pacman is caught.
+			XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+			{
+				if ((*ppPlayer)->GetType() == PlayerType_Pacman && (*ppPlayer)->GetState() == PlayerState_Die)
+				{
+					StartIntro();
+					break;
+				}
+			}
+		}
+		break;
+	}
+}
+
+// =============================================================================
+void CHostedMatch::StartMatch()
+{
+	XLOG("[MatchHost] Starting match %d with %d clients.", GetID(), m_iClientCount);
+
+	// The clients are told which map to load.
+	CNetworkStream* pStream = NetworkManager.BeginBroadcast(NULL, NetworkStreamType_StartGame, NETWORK_PRIORITY_LOBBY, RELIABLE_ORDERED);
+
+	pStream->Write((xuint8)m_sMap.length());
+	pStream->Write(m_sMap.c_str(), (xint)m_sMap.length());
+
+	NetworkManager.SendStream(pStream);
+
+	// Players are given out in peer order just as the clients do. The host's own player is played by the AI.
+	xint iPlayerIndex = 0;
+
+	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, NetworkManager.GetVerifiedPeers())
+	{
+		CNetworkPeer* pPeer = *ppPeer;
+		CNetworkPeerInfo* pInfo = (CNetworkPeerInfo*)pPeer->m_pData;
+
+		pInfo->m_pPlayer = PlayerManager.GetActivePlayer(iPlayerIndex++);
+
+		if (pPeer->m_bLocal)
+		{
+			PlayerManager.SetLocalPlayer(pInfo->m_pPlayer);
+			pInfo->m_pPlayer->SetLogicType(PlayerLogicType_AI);
+		}
+		else
+			pInfo->m_pPlayer->SetLogicType(PlayerLogicType_Remote);
+	}
+
+	SnapshotManager.Reset();
+
+	StartIntro();
+}
+
+// =============================================================================
+void CHostedMatch::StartIntro()
+{
+	PlayerManager.SetPlayersEnabled(false);
+
+	m_iState = HostedMatchState_Intro;
+	m_xStateTimer.ExpireAfter(MATCH_HOST_INTRO_TIME);
+}
+
+// =============================================================================
+void CHostedMatch::StartRound()
+{
+	// Each round plays out from its own seed.
+	Global.SeedMatch((xuint32)_RANDOM(RandomStream_Session).Next());
+
+	// Timed effects from a previous round or the intro don't carry over.
+	TriggerManager.Restart();
+
+	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+		(*ppPlayer)->Revive();
+
+	PlayerManager.SetPlayersEnabled(true);
+
+	m_iRoundCount++;
+	m_iState = HostedMatchState_Playing;
+}
+
+// =============================================================================
+void CHostedMatch::SampleRoundTrips()
+{
+	// RakNet only measures the time from a ping to its reply, so this is twice the one way latency on a symmetric link.
+	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, NetworkManager.GetVerifiedPeers())
+	{
+		xint iPing = NetworkManager.GetLastPing(*ppPeer);
+
+		if (iPing >= 0)
+			m_lfRoundTrips.push_back((xdouble)iPing);
+	}
+}
+
+// =============================================================================
+xbool CHostedMatch::OnVerifyPeer(CNetworkPeer* pPeer, void* pData, xint iDataLength)
+{
+	return iDataLength && pData && String::IsMatch(_GID, (const xchar*)pData) && m_iState == HostedMatchState_Waiting && (xint)NetworkManager.GetVerifiedPeers().size() <= m_iClientCount;
+}
+
+// =============================================================================
+void CHostedMatch::OnPeerJoined(CNetworkPeer* pPeer)
+{
+	CNetworkPeerInfo* pInfo = new CNetworkPeerInfo();
+	pInfo->m_pPlayer = NULL;
+
+	pPeer->m_pData = pInfo;
+
+	NetworkManager.SortPeers();
+}
+
+// =============================================================================
+void CHostedMatch::OnPeerLeaving(CNetworkPeer* pPeer)
+{
+	CNetworkPeerInfo* pInfo = pPeer ? (CNetworkPeerInfo*)pPeer->m_pData : NULL;
+
+	if (pInfo)
+	{
+		XLOG("[MatchHost] Peer %d is leaving match %d.", pPeer->m_iID, GetID());
+
+		// The AI takes over the player so the match can carry on.
+		if (pInfo->m_pPlayer)
+			pInfo->m_pPlayer->SetLogicType(PlayerLogicType_AI);
+
+		delete pInfo;
+		pPeer->m_pData = NULL;
+	}
+}
+
+//##############################################################################
+
+// =============================================================================
+CMatchHost::CMatchHost() :
+	m_pInterface(NULL),
+	m_iMeasureEpoch(0),
+	m_bStopping(false)
+{
+}
+
+// =============================================================================
+void CMatchHost::OnDeinitialise()
+{
+	Close();
+}
+
+// =============================================================================
+xbool CMatchHost::Start(xint iMatchCount, xint iClientCount, const xchar* pMap, xint iPort)
+{
+	XASSERT(!m_pInterface);
+
+	if (m_pInterface)
+		return false;
+
+	// Every match takes its clients from the one interface.
+	xint iMaxConnections = iMatchCount * iClientCount;
+
+	m_pInterface = RakNetworkFactory::GetRakPeerInterface();
+
+	m_xSocket.hostAddress[0] = NULL;
+	m_xSocket.port = iPort;
+
+	if (!m_pInterface->Startup(iMaxConnections, NETWORK_THREAD_WAIT_TIME, &m_xSocket, 1))
+	{
+		XLOG("[MatchHost] Failed to listen on port %d.", iPort);
+
+		RakNetworkFactory::DestroyRakPeerInterface(m_pInterface);
+		m_pInterface = NULL;
+
+		return false;
+	}
+
+	// The conditions are simulated on every connection as they would be for a single match.
+	m_pInterface->GetNetworkConditioner()->SetConditions(NetworkManager.GetConditions(), UNASSIGNED_SYSTEM_ADDRESS);
+	m_pInterface->SetMaximumIncomingConnections(iMaxConnections);
+	m_pInterface->SetTimeoutTime(NETWORK_PEER_TIMEOUT, UNASSIGNED_SYSTEM_ADDRESS);
+	m_pInterface->SetOccasionalPing(true);
+
+	InitializeCriticalSection(&m_xLock);
+
+	for (xint iA = 0; iA < iMatchCount; ++iA)
+		m_lpMatches.push_back(new CHostedMatch(iA, iClientCount, pMap, m_pInterface, &m_xLock));
+
+	// A thread for each processor, with the matches dealt out between them.
+	SYSTEM_INFO xInfo;
+	GetSystemInfo(&xInfo);
+
+	xint iThreadCount = Math::Clamp<xint>(Math::Min<xint>((xint)xInfo.dwNumberOfProcessors, iMatchCount), 1, MATCH_HOST_THREAD_LIMIT);
+
+	for (xint iA = 0; iA < iThreadCount; ++iA)
+		m_lpThreads.push_back(new CMatchThread());
+
+	for (xint iA = 0; iA < iMatchCount; ++iA)
+		m_lpThreads[iA % iThreadCount]->m_lpMatches.push_back(m_lpMatches[iA]);
+
+	m_bStopping = false;
+
+	XEN_LIST_FOREACH(t_MatchThreadList, ppThread, m_lpThreads)
+		(*ppThread)->m_hThread = (HANDLE)_beginthreadex(NULL, 0, &CMatchHost::ThreadMain, *ppThread, 0, NULL);
+
+	XLOG("[MatchHost] Hosting %d matches of %d clients on port %d across %d threads.", iMatchCount, iClientCount, iPort, iThreadCount);
+
+	return true;
+}
+
+// =============================================================================
+void CMatchHost::Stop()
+{
+	m_bStopping = true;
+
+	XEN_LIST_FOREACH(t_MatchThreadList, ppThread, m_lpThreads)
+	{
+		if ((*ppThread)->m_hThread)
+		{
+			WaitForSingleObject((*ppThread)->m_hThread, INFINITE);
+			CloseHandle((*ppThread)->m_hThread);
+		}
+
+		delete *ppThread;
+	}
+
+	m_lpThreads.clear();
+}
+
+// =============================================================================
+void CMatchHost::Close()
+{
+	if (!m_pInterface)
+		return;
+
+	Stop();
+
+	XLOG("[MatchHost] Closing %d matches.", GetMatchCount());
+
+	XEN_LIST_FOREACH(t_HostedMatchList, ppMatch, m_lpMatches)
+		delete *ppMatch;
+
+	m_lpMatches.clear();
+	m_xRoutes.clear();
+
+	for (t_PendingConnectionTable::iterator xIt = m_xPendingConnections.begin(); xIt != m_xPendingConnections.end(); ++xIt)
+		m_pInterface->DeallocatePacket(xIt->second);
+
+	m_xPendingConnections.clear();
+
+	m_pInterface->Shutdown(500);
+
+	RakNetworkFactory::DestroyRakPeerInterface(m_pInterface);
+	m_pInterface = NULL;
+
+	DeleteCriticalSection(&m_xLock);
+}
+
+// =============================================================================
+xbool CMatchHost::IsEveryMatchStarted()
+{
+	XEN_LIST_FOREACH(t_HostedMatchList, ppMatch, m_lpMatches)
+	{
+		if (!(*ppMatch)->IsStarted())
+			return false;
+	}
+
+	return m_lpMatches.size() > 0;
+}
+
+// =============================================================================
+void CMatchHost::StartMeasuring()
+{
+	InterlockedIncrement((volatile LONG*)&m_iMeasureEpoch);
+}
+
+// =============================================================================
+void CMatchHost::GetTraffic(xuint64& iBitsSent, xuint64& iBitsReceived, xuint64& iPacketsSent, xuint64& iPacketsReceived)
+{
+	iBitsSent = 0;
+	iBitsReceived = 0;
+	iPacketsSent = 0;
+	iPacketsReceived = 0;
+
+	if (!m_pInterface)
+		return;
+
+	CNetworkLock xLock(&m_xLock);
+
+	// The matches together can hold more connections than a single match has peer IDs.
+	xuint16 iCount = m_pInterface->GetMaximumNumberOfPeers();
+	xarray<SystemAddress> lxAddresses(Math::Max<xint>(iCount, 1));
+
+	m_pInterface->GetConnectionList(&lxAddresses[0], &iCount);
+
+	for (xint iA = 0; iA < (xint)iCount; ++iA)
+	{
+		RakNetStatistics* pStatistics = m_pInterface->GetStatistics(lxAddresses[iA]);
+
+		if (pStatistics)
+		{
+			iBitsSent += pStatistics->totalBitsSent;
+			iBitsReceived += pStatistics->bitsReceived;
+			iPacketsSent += pStatistics->packetsSent;
+			iPacketsReceived += pStatistics->packetsReceived;
+		}
+	}
+}
+
+// =============================================================================
+xuint __stdcall CMatchHost::ThreadMain(void* pParam)
+{
+	CMatchThread* pThread = (CMatchThread*)pParam;
+
+	xuint32 iLastTime = _TIMEMS;
+
+	while (!MatchHost.m_bStopping)
+	{
+		xuint32 iTime = _TIMEMS;
+
+		// Each match thread keeps its own clock.
+		Application::SetTimeDelta(iTime - iLastTime);
+		iLastTime = iTime;
+
+		MatchHost.Route();
+
+		XEN_LIST_FOREACH(t_HostedMatchList, ppMatch, pThread->m_lpMatches)
+			(*ppMatch)->Update();
+
+		xint iElapsed = (xint)(_TIMEMS - iTime);
+
+		Sleep(Math::Max<xint>(MATCH_HOST_TICK_TIME - iElapsed, 0));
+	}
+
+	return 0;
+}
+
+// =============================================================================
+void CMatchHost::Route()
+{
+	CNetworkLock xLock(&m_xLock);
+
+	while (Packet* pPacket = m_pInterface->Receive())
+	{
+		xuint8 cIdentifier = pPacket->data[0];
+
+		switch (cIdentifier)
+		{
+		// The match isn't known until the client asks to be verified, so the connection waits until then.
+		case ID_NEW_INCOMING_CONNECTION:
+			{
+				t_PendingConnectionTable::iterator xIt = m_xPendingConnections.find(pPacket->systemAddress);
+
+				if (xIt != m_xPendingConnections.end())
+					m_pInterface->DeallocatePacket(xIt->second);
+
+				// A route left by an earlier connection from the same address no longer applies.
+				m_xRoutes.erase(pPacket->systemAddress);
+				m_xPendingConnections[pPacket->systemAddress] = pPacket;
+			}
+			continue;
+
+		// The client names the match it is joining ahead of its verification info.
+		case ID_VERIFICATION_REQUEST:
+			{
+				t_PendingConnectionTable::iterator xIt = m_xPendingConnections.find(pPacket->systemAddress);
+
+				if (xIt == m_xPendingConnections.end())
+					break;
+
+				Packet* pConnection = xIt->second;
+				m_xPendingConnections.erase(xIt);
+
+				BitStream xStream(&pPacket->data[1], pPacket->length - 1, false);
+				xuint16 iMatchID = 0;
+
+				CHostedMatch* pMatch = xStream.Read(iMatchID) ? FindMatch(iMatchID) : NULL;
+
+				if (pMatch)
+				{
+					m_xRoutes[pPacket->systemAddress] = pMatch;
+
+					pMatch->GetNetworkManager().QueuePacket(pConnection);
+					pMatch->GetNetworkManager().QueuePacket(pPacket);
+				}
+				else
+				{
+					XLOG("[MatchHost] A client asked to join match %d which isn't hosted here.", iMatchID);
+
+					m_pInterface->CloseConnection(pPacket->systemAddress, true);
+					m_pInterface->DeallocatePacket(pConnection);
+					m_pInterface->DeallocatePacket(pPacket);
+				}
+			}
+			continue;
+
+		// A connection that never picked a match is forgotten.
+		case ID_DISCONNECTION_NOTIFICATION:
+		case ID_CONNECTION_LOST:
+			{
+				t_PendingConnectionTable::iterator xIt = m_xPendingConnections.find(pPacket->systemAddress);
+
+				if (xIt != m_xPendingConnections.end())
+				{
+					m_pInterface->DeallocatePacket(xIt->second);
+					m_xPendingConnections.erase(xIt);
+				}
+			}
+			break;
+		}
+
+		t_MatchRouteTable::iterator xRoute = m_xRoutes.find(pPacket->systemAddress);
+
+		if (xRoute != m_xRoutes.end())
+		{
+			xRoute->second->GetNetworkManager().QueuePacket(pPacket);
+
+			if (cIdentifier == ID_DISCONNECTION_NOTIFICATION || cIdentifier == ID_CONNECTION_LOST)
+				m_xRoutes.erase(xRoute);
+		}
+		else
+			m_pInterface->DeallocatePacket(pPacket);
+	}
+}
+
+// =============================================================================
+CHostedMatch* CMatchHost::FindMatch(xint iID)
+{
+	XEN_LIST_FOREACH(t_HostedMatchList, ppMatch, m_lpMatches)
+	{
+		if ((*ppMatch)->GetID() == iID)
+			return *ppMatch;
+	}
+
+	return NULL;
+}
+
+//##############################################################################
@@ -0,0 +1,288 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Other.
+#include <Lobby.h>
+#include <Network.h>
+#include <Profile.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define MatchHost CMatchHost::Get()
+
+// The time in milliseconds each match thread aims to spend on a tick, sleeping for whatever is left.
+#define MATCH_HOST_TICK_TIME 16
+
+// The most match threads the host will start.
+#define MATCH_HOST_THREAD_LIMIT 32
+
+// The time in milliseconds counted down before each round, matching the game screen.
+#define MATCH_HOST_INTRO_TIME 3000
+
+// The interval in milliseconds between round trip time samples.
+#define MATCH_HOST_SAMPLE_INTERVAL 100
+
+//##############################################################################
+
+// The hosted match states.
+enum t_HostedMatchState
+{
+	HostedMatchState_Waiting,			// Waiting for every client to join.
+	HostedMatchState_Intro,				// Counting down to the round.
+	HostedMatchState_Playing,			// Playing a round until Pacman is caught.
+};
+
+// Predeclare.
+class CHostedMatch;
+class CMatchThread;
+
+// Lists.
+typedef xarray<xdouble> t_MatchSampleList;
+typedef xarray<CHostedMatch*> t_HostedMatchList;
+typedef xarray<CMatchThread*> t_MatchThreadList;
+typedef xhash<SystemAddress, CHostedMatch*> t_MatchRouteTable;
+typedef xhash<SystemAddress, Packet*> t_PendingConnectionTable;
+
+//##############################################################################
+
+// A match run by the match host on its own context, updated by whichever match thread it was given to.
+class CHostedMatch
+{
+public:
+	// Constructor. Must be called on the main thread as the settings are taken from the application's network manager.
+	CHostedMatch(xint iID, xint iClientCount, const xchar* pMap, RakPeerInterface* pInterface, CRITICAL_SECTION* pLock);
+
+	// Destructor.
+	~CHostedMatch();
+
+	// Run a tick of the match on the calling thread.
+	void Update();
+
+	// Get the match ID.
+	inline xint GetID()
+	{
+		return m_pContext->GetID();
+	}
+
+	// Get the network manager for the match, which the host passes the match's packets to.
+	inline CNetworkManager& GetNetworkManager()
+	{
+		return *m_pContext->m_pNetworkManager;
+	}
+
+	// Check if every client has joined and the match has started.
+	inline xbool IsStarted()
+	{
+		return m_iState != HostedMatchState_Waiting;
+	}
+
+	// Get the number of rounds started.
+	inline xint GetRoundCount()
+	{
+		return m_iRoundCount;
+	}
+
+	// Get the tick times in milliseconds recorded while measuring.
+	inline t_MatchSampleList& GetTickTimes()
+	{
+		return m_lfTickTimes;
+	}
+
+	// Get the round trip times in milliseconds to each client recorded while measuring.
+	inline t_MatchSampleList& GetRoundTrips()
+	{
+		return m_lfRoundTrips;
+	}
+
+	// Get the time in milliseconds spent running ticks while measuring.
+	inline xdouble GetBusyTime()
+	{
+		return CProfileManager::GetMilliseconds(m_iBusyCounter);
+	}
+
+protected:
+	// Run the match states.
+	void UpdateState();
+
+	// Tell the clients to start the game and give each one a player.
+	void StartMatch();
+
+	// Start counting down to a round.
+	void StartIntro();
+
+	// Start a round.
+	void StartRound();
+
+	// Sample the round trip time to each client.
+	void SampleRoundTrips();
+
+	// Callback to verify a client wanting to join the match.
+	xbool OnVerifyPeer(CNetworkPeer* pPeer, void* pData, xint iDataLength);
+
+	// Callback for when a peer joins the match.
+	void OnPeerJoined(CNetworkPeer* pPeer);
+
+	// Callback for when a peer is about to leave the match.
+	void OnPeerLeaving(CNetworkPeer* pPeer);
+
+	// The match state.
+	CMatchContext* m_pContext;
+
+	// The current state.
+	t_HostedMatchState m_iState;
+
+	// The timer for the current state.
+	CTimer m_xStateTimer;
+
+	// The timer for the next round trip time sample.
+	CTimer m_xSampleTimer;
+
+	// The number of clients the match starts with.
+	xint m_iClientCount;
+
+	// The map the match is played on.
+	xstring m_sMap;
+
+	// The host's gamer card.
+	CNetworkGamerCard m_xGamerCard;
+
+	// The number of rounds started.
+	xint m_iRoundCount;
+
+	// The measuring period the samples belong to.
+	xint m_iMeasureEpoch;
+
+	// The tick times recorded while measuring.
+	t_MatchSampleList m_lfTickTimes;
+
+	// The round trip times recorded while measuring.
+	t_MatchSampleList m_lfRoundTrips;
+
+	// The counter ticks spent running ticks while measuring.
+	xint64 m_iBusyCounter;
+};
+
+//##############################################################################
+
+// A thread running its share of the hosted matches.
+class CMatchThread
+{
+public:
+	// The thread handle.
+	HANDLE m_hThread;
+
+	// The matches updated on the thread.
+	t_HostedMatchList m_lpMatches;
+};
+
+//##############################################################################
+
+// Hosts many matches in one process. The matches are shared across a thread for each processor and share one interface, with each connection routed to the match it asked to join.
+class CMatchHost : public CModule
+{
+public:
+	// Singleton instance.
+	static inline CMatchHost& Get()
+	{
+		static CMatchHost s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CMatchHost();
+
+	// Close any matches still hosted.
+	virtual void OnDeinitialise();
+
+	// Host a number of matches on a port, each waiting for a number of clients before starting.
+	xbool Start(xint iMatchCount, xint iClientCount, const xchar* pMap, xint iPort);
+
+	// Stop the match threads, leaving the matches and their statistics in place.
+	void Stop();
+
+	// Stop and free the matches and close the interface.
+	void Close();
+
+	// Check if matches are being hosted.
+	inline xbool IsRunning()
+	{
+		return m_pInterface != NULL;
+	}
+
+	// Check if every client of every match has joined.
+	xbool IsEveryMatchStarted();
+
+	// Start a new measuring period on every match. The matches reset their samples on their next tick.
+	void StartMeasuring();
+
+	// Get the current measuring period.
+	inline xint GetMeasureEpoch()
+	{
+		return m_iMeasureEpoch;
+	}
+
+	// Get the total bits and packets sent and received on every connection.
+	void GetTraffic(xuint64& iBitsSent, xuint64& iBitsReceived, xuint64& iPacketsSent, xuint64& iPacketsReceived);
+
+	// Get the number of hosted matches.
+	inline xint GetMatchCount()
+	{
+		return (xint)m_lpMatches.size();
+	}
+
+	// Get a hosted match by index.
+	inline CHostedMatch* GetMatch(xint iIndex)
+	{
+		return m_lpMatches[iIndex];
+	}
+
+	// Get the number of match threads.
+	inline xint GetThreadCount()
+	{
+		return (xint)m_lpThreads.size();
+	}
+
+protected:
+	// The match thread entry point.
+	static xuint __stdcall ThreadMain(void* pParam);
+
+	// Pass each received packet to the match its connection belongs to.
+	void Route();
+
+	// Find a hosted match by ID.
+	CHostedMatch* FindMatch(xint iID);
+
+	// The interface shared by every match.
+	RakPeerInterface* m_pInterface;
+
+	// The socket the interface listens on.
+	SocketDescriptor m_xSocket;
+
+	// The lock held for every call on the interface.
+	CRITICAL_SECTION m_xLock;
+
+	// The hosted matches.
+	t_HostedMatchList m_lpMatches;
+
+	// The match threads.
+	t_MatchThreadList m_lpThreads;
+
+	// The match each connection was routed to.
+	t_MatchRouteTable m_xRoutes;
+
+	// The new connections waiting to say which match they are joining.
+	t_PendingConnectionTable m_xPendingConnections;
+
+	// The current measuring period.
+	volatile xint m_iMeasureEpoch;
+
+	// Determines if the match threads should exit.
+	volatile xbool m_bStopping;
+};
+
+//##############################################################################
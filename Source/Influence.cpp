@@ -0,0 +1,168 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Influence.h>
+
+// Other.
+#include <Map.h>
+#include <Player.h>
+#include <Profile.h>
+
+//##############################################################################
+
+// =============================================================================
+CInfluenceMap::CInfluenceMap() :
+	m_pBoardMap(NULL),
+	m_iUpdateCount(0),
+	m_iUpdateCost(0)
+{
+}
+
+// =============================================================================
+void CInfluenceMap::Update()
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+
+	if (!pMap)
+		return;
+
+	xint64 iStart = CProfileManager::GetCounter();
+
+	// Walls never change during a match so the whole board is only built when the map does.
+	if (pMap != m_pBoardMap)
+	{
+		m_xBoard.Build(pMap);
+		m_pBoardMap = pMap;
+	}
+	else
+		m_xBoard.Refresh(pMap);
+
+	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+	{
+		CPlayer* pPlayer = *ppPlayer;
+
+		if (pPlayer->GetCurrentBlock())
+			m_xBoard.AddPlayer(pPlayer->GetType(), pPlayer->GetCurrentBlock()->m_iIndex);
+	}
+
+	// Both player fields are measured in ghost moves since that's how far apart a ghost and Pacman really are.
+	m_xBoard.GetPlayerDistances(PlayerType_Ghost, m_liDanger);
+	m_xBoard.GetDistances(m_xBoard.GetPlayers(PlayerType_Pacman), PlayerType_Ghost, m_liPressure);
+	m_xBoard.GetPelletDistances(PlayerType_Pacman, m_liPellets);
+
+	m_iUpdateCount++;
+	m_iUpdateCost += CProfileManager::GetCounter() - iStart;
+}
+
+// =============================================================================
+xint CInfluenceMap::GetEscapeDirection(t_PlayerType iType, xint iBlock)
+{
+	xint iBestMove = -1;
+	xint iBestDanger = 0;
+
+	for (xint iA = 0; iA < AdjacentDirection_Max; ++iA)
+	{
+		if (!m_xBoard.CanMove(iType, iBlock, iA))
+			continue;
+
+		// A block no ghost can reach is as safe as it gets.
+		xint iDanger = GetDanger(m_xBoard.GetAdjacent(iBlock, iA));
+
+		if (iDanger == -1)
+			return iA;
+
+		if (iBestMove == -1 || iDanger > iBestDanger)
+		{
+			iBestMove = iA;
+			iBestDanger = iDanger;
+		}
+	}
+
+	return iBestMove;
+}
+
+// =============================================================================
+xint CInfluenceMap::GetChaseDirection(xint iBlock)
+{
+	xint iBestMove = -1;
+	xint iBestPressure = 0;
+
+	for (xint iA = 0; iA < AdjacentDirection_Max; ++iA)
+	{
+		if (!m_xBoard.CanMove(PlayerType_Ghost, iBlock, iA))
+			continue;
+
+		xint iPressure = GetPressure(m_xBoard.GetAdjacent(iBlock, iA));
+
+		if (iPressure != -1 && (iBestMove == -1 || iPressure < iBestPressure))
+		{
+			iBestMove = iA;
+			iBestPressure = iPressure;
+		}
+	}
+
+	return iBestMove;
+}
+
+// =============================================================================
+void CInfluenceMap::LogStats()
+{
+	XLOG("[InfluenceMap] %d updates, %.3fms average.",
+		m_iUpdateCount,
+		m_iUpdateCount ? CProfileManager::GetMilliseconds(m_iUpdateCost) / (xdouble)m_iUpdateCount : 0.0);
+}
+
+// =============================================================================
+void CInfluenceMap::Benchmark()
+{
+	XLOG("[InfluenceMap] Benchmarking with %s plane operations.", BITBOARD_SSE2 ? "SSE2" : "scalar");
+
+	Benchmark(INFLUENCE_BENCHMARK_SMALL_SIZE, INFLUENCE_BENCHMARK_SMALL_FIELDS);
+	Benchmark(INFLUENCE_BENCHMARK_LARGE_SIZE, INFLUENCE_BENCHMARK_LARGE_FIELDS);
+}
+
+// =============================================================================
+void CInfluenceMap::Benchmark(xint iSize, xint iFields)
+{
+	CBitBoard xBoard;
+	t_BlockDistanceList liField;
+
+	xBoard.Reset(iSize, iSize * iSize);
+
+	// A scattering of walls leaves most of the board connected, which is the costly case.
+	for (xint iA = 0; iA < iSize * iSize; ++iA)
+	{
+		if (_RANDOM(RandomStream_LoadTest).GetInt(100) >= INFLUENCE_BENCHMARK_WALL_CHANCE)
+		{
+			xBoard.SetOpen(PlayerType_Ghost, iA);
+			xBoard.SetOpen(PlayerType_Pacman, iA);
+		}
+	}
+
+	xBoard.BuildMoves();
+
+	for (xint iA = 0; iA < INFLUENCE_BENCHMARK_GHOSTS; ++iA)
+		xBoard.AddPlayer(PlayerType_Ghost, _RANDOM(RandomStream_LoadTest).GetInt(iSize * iSize));
+
+	for (xint iA = 0; iA < INFLUENCE_BENCHMARK_PACMEN; ++iA)
+		xBoard.AddPlayer(PlayerType_Pacman, _RANDOM(RandomStream_LoadTest).GetInt(iSize * iSize));
+
+	xint64 iStart = CProfileManager::GetCounter();
+
+	for (xint iA = 0; iA < iFields; ++iA)
+		xBoard.GetPlayerDistances((t_PlayerType)(iA % PlayerType_Max), liField);
+
+	xdouble fTime = CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - iStart);
+
+	XLOG("[InfluenceMap] %d fields on a %dx%d board in %.2fms, %.0f fields/sec.",
+		iFields,
+		iSize,
+		iSize,
+		fTime,
+		fTime > 0.0 ? (xdouble)iFields * 1000.0 / fTime : 0.0);
+}
+
+//##############################################################################
@@ -0,0 +1,121 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Other.
+#include <BitBoard.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define InfluenceMap CInfluenceMap::Get()
+
+// The number of fields computed for each board size when benchmarking.
+#define INFLUENCE_BENCHMARK_SMALL_FIELDS 10000
+#define INFLUENCE_BENCHMARK_LARGE_FIELDS 50
+
+// The sizes of the square benchmark boards in blocks.
+#define INFLUENCE_BENCHMARK_SMALL_SIZE 31
+#define INFLUENCE_BENCHMARK_LARGE_SIZE 512
+
+// The chance out of 100 of a benchmark block being a wall.
+#define INFLUENCE_BENCHMARK_WALL_CHANCE 30
+
+// The number of each player type placed on a benchmark board.
+#define INFLUENCE_BENCHMARK_GHOSTS 5
+#define INFLUENCE_BENCHMARK_PACMEN 2
+
+//##############################################################################
+
+// The distance fields shared by every brain, computed once a tick from all the ghosts and Pacmen at once. Brains only read from it while they decide so any number can look at it together.
+class CInfluenceMap
+{
+public:
+	// Singleton instance, or the instance belonging to the match bound to the calling thread.
+	static inline CInfluenceMap& Get()
+	{
+		if (CMatchContext* pContext = CMatchContext::GetCurrent())
+			return *pContext->m_pInfluenceMap;
+
+		static CInfluenceMap s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CInfluenceMap();
+
+	// Refresh the board and rebuild every field from the current map and players. This must not run while brains decide.
+	void Update();
+
+	// Get the board the fields were computed over.
+	inline CBitBoard& GetBoard()
+	{
+		return m_xBoard;
+	}
+
+	// Get the number of moves a ghost needs to reach a block or -1 if none can.
+	inline xint GetDanger(xint iBlock)
+	{
+		return GetField(m_liDanger, iBlock);
+	}
+
+	// Get the number of moves a ghost needs from a block to reach the nearest Pacman or -1 if none can be reached.
+	inline xint GetPressure(xint iBlock)
+	{
+		return GetField(m_liPressure, iBlock);
+	}
+
+	// Get the number of moves Pacman needs from a block to reach the nearest pellet or -1 if none can be reached.
+	inline xint GetPelletDistance(xint iBlock)
+	{
+		return GetField(m_liPellets, iBlock);
+	}
+
+	// Get the direction a player type should move from a block to get furthest from the ghosts or -1 if it can't move.
+	xint GetEscapeDirection(t_PlayerType iType, xint iBlock);
+
+	// Get the direction a ghost should move from a block to get closest to a Pacman or -1 if none can be reached.
+	xint GetChaseDirection(xint iBlock);
+
+	// Write the update statistics to the log.
+	void LogStats();
+
+	// Time the distance fields on generated boards of a small and a large size and log the rate.
+	void Benchmark();
+
+protected:
+	// Get a value from a field, allowing for a block outside of it.
+	static inline xint GetField(t_BlockDistanceList& liField, xint iBlock)
+	{
+		return (iBlock >= 0 && iBlock < (xint)liField.size()) ? liField[iBlock] : -1;
+	}
+
+	// Time a number of fields on a generated square board and log the rate.
+	void Benchmark(xint iSize, xint iFields);
+
+	// The model of the current map with the players on it.
+	CBitBoard m_xBoard;
+
+	// The map the board's walls were built from.
+	CMap* m_pBoardMap;
+
+	// The distance from each block to the nearest ghost.
+	t_BlockDistanceList m_liDanger;
+
+	// The distance from each block to the nearest Pacman.
+	t_BlockDistanceList m_liPressure;
+
+	// The distance from each block to the nearest pellet.
+	t_BlockDistanceList m_liPellets;
+
+	// The number of updates run.
+	xint m_iUpdateCount;
+
+	// The total counter interval spent updating.
+	xint64 m_iUpdateCost;
+};
+
+//##############################################################################
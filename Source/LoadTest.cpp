@@ -0,0 +1,690 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <LoadTest.h>
+
+// Other.
+#include <Game.h>
+#include <Host.h>
+#include <Lobby.h>
+#include <Map.h>
+#include <Network.h>
+#include <Player.h>
+#include <Profile.h>
+#include <Snapshot.h>
+#include <RakNet/RakNetStatistics.h>
+
+// System.
+#include <Windows.h>
+#include <algorithm>
+
+//##############################################################################
+
+// =============================================================================
+CLoadTestManager::CLoadTestManager() :
+	m_iMode(LoadTestMode_None),
+	m_iState(LoadTestState_Idle),
+	m_iMaxClients(0),
+	m_iStepTime(LOADTEST_DEFAULT_STEP_TIME),
+	m_iClientCount(0),
+	m_iMatchCount(1),
+	m_iRelayRate(0),
+	m_bCoalescing(true),
+	m_iSendBudget(0),
+	m_sMap(LOBBY_MAP),
+	m_iStartCounter(0),
+	m_fStartProcessTime(0.0),
+	m_iStartBitsSent(0),
+	m_iStartBitsReceived(0),
+	m_iStartPacketsSent(0),
+	m_iStartPacketsReceived(0),
+	m_iStartRelayedMessages(0),
+	m_iStartRelayedSends(0),
+	m_fStartRelayTime(0.0),
+	m_iStartScheduledMessages(0),
+	m_iStartSupersededMessages(0),
+	m_iStartScheduleDelay(0)
+{
+}
+
+// =============================================================================
+void CLoadTestManager::OnDeinitialise()
+{
+	CloseBots();
+}
+
+// =============================================================================
+void CLoadTestManager::OnUpdate()
+{
+	switch (m_iMode)
+	{
+	case LoadTestMode_Host:
+		UpdateHost();
+		break;
+
+	case LoadTestMode_Bot:
+		UpdateBot();
+		break;
+	}
+}
+
+// =============================================================================
+void CLoadTestManager::StartHost(xint iMaxClients, xint iStepTime)
+{
+	CMap* pMap = MapManager.GetMap(m_sMap.c_str());
+
+	if (!pMap)
+	{
+		XLOG("[LoadTest] There is no map '%s' so the test will use '%s'.", m_sMap.c_str(), LOBBY_MAP);
+
+		m_sMap = LOBBY_MAP;
+		pMap = MapManager.GetMap(LOBBY_MAP);
+	}
+
+	// Every bot needs a player of its own alongside the host.
+	xint iPlayerLimit = pMap->GetPacmanCount() + pMap->GetGhostCount() - 1;
+
+	if (iMaxClients > iPlayerLimit)
+		XLOG("[LoadTest] The map only has players for %d clients so the test will stop there.", iPlayerLimit);
+
+	m_iMode = LoadTestMode_Host;
+	Global.m_bBotControlled = true;
+	m_iState = LoadTestState_Idle;
+	m_iMaxClients = Math::Clamp<xint>(iMaxClients, 1, iPlayerLimit);
+	m_iStepTime = Math::Max<xint>(iStepTime, 1);
+	m_iClientCount = 0;
+
+	m_lsReports.clear();
+
+	m_iMatchCount = Math::Max<xint>(m_iMatchCount, 1);
+
+	XLOG("[LoadTest] Testing up to %d clients in each of %d matches for %d seconds each on '%s' (%dx%d).", m_iMaxClients, m_iMatchCount, m_iStepTime, m_sMap.c_str(), pMap->GetWidth(), pMap->GetHeight());
+}
+
+// =============================================================================
+void CLoadTestManager::StartBot(const xchar* pHostAddress)
+{
+	m_iMode = LoadTestMode_Bot;
+	Global.m_bBotControlled = true;
+	m_iState = LoadTestState_Joining;
+	m_sHostAddress = pHostAddress;
+
+	// Only the address is wanted from the rest of the command line.
+	m_sHostAddress = m_sHostAddress.substr(0, m_sHostAddress.find(' '));
+
+	ScreenManager.Set(ScreenIndex_LobbyScreen, true);
+
+	CLobbyScreen* pLobby = (CLobbyScreen*)ScreenManager.FindScreen(ScreenIndex_LobbyScreen);
+	pLobby->Start(LobbyStartMode_JoinPrivate);
+	pLobby->JoinLobby(m_sHostAddress.c_str());
+
+	m_xStateTimer.ExpireAfter(LOADTEST_JOIN_TIMEOUT);
+}
+
+// =============================================================================
+void CLoadTestManager::RecordTick(xdouble fTime)
+{
+	if (m_iState == LoadTestState_Measuring)
+		m_lfTickTimes.push_back(fTime);
+}
+
+// =============================================================================
+void CLoadTestManager::UpdateHost()
+{
+	CLobbyScreen* pLobby = (CLobbyScreen*)ScreenManager.FindScreen(ScreenIndex_LobbyScreen);
+
+	switch (m_iState)
+	{
+	case LoadTestState_Idle:
+		{
+			if (m_iClientCount == m_iMaxClients)
+			{
+				XLOG("[LoadTest] Finished.");
+
+				XEN_LIST_FOREACH(t_LoadTestReportList, psReport, m_lsReports)
+					XLOG("[LoadTest] %s", psReport->c_str());
+
+				m_iMode = LoadTestMode_None;
+				Global.m_bBotControlled = false;
+				_TERMINATE;
+			}
+			else
+			{
+				m_iClientCount++;
+				StartStep();
+			}
+		}
+		break;
+
+	case LoadTestState_Joining:
+		{
+			if (MatchHost.IsRunning())
+			{
+				// The hosted matches start themselves once their clients have joined.
+				if (MatchHost.IsEveryMatchStarted())
+				{
+					m_iState = LoadTestState_WarmingUp;
+					m_xStateTimer.ExpireAfter(LOADTEST_WARMUP_TIME);
+				}
+				else if (m_xStateTimer.IsExpired())
+				{
+					XLOG("[LoadTest] Not every match filled in time, skipping the step.");
+					EndStep();
+				}
+			}
+			else if (pLobby->IsInLobby() && (xint)NetworkManager.GetVerifiedPeers().size() == m_iClientCount + 1 && NetworkManager.IsEveryoneVerified())
+			{
+				pLobby->StartMatch();
+
+				m_iState = LoadTestState_WarmingUp;
+				m_xStateTimer.ExpireAfter(LOADTEST_WARMUP_TIME);
+			}
+			else if (m_xStateTimer.IsExpired())
+			{
+				XLOG("[LoadTest] Only %d of %d clients joined in time, skipping the step.", (xint)NetworkManager.GetVerifiedPeers().size() - 1, m_iClientCount);
+				EndStep();
+			}
+		}
+		break;
+
+	case LoadTestState_WarmingUp:
+		{
+			RestartFinishedGame();
+
+			if (m_xStateTimer.IsExpired())
+				StartMeasuring();
+		}
+		break;
+
+	case LoadTestState_Measuring:
+		{
+			RestartFinishedGame();
+
+			if (m_xSampleTimer.IsExpired() && !MatchHost.IsRunning())
+			{
+				SampleRoundTrips();
+				m_xSampleTimer.ExpireAfter(LOADTEST_SAMPLE_INTERVAL);
+			}
+
+			if (m_xStateTimer.IsExpired())
+			{
+				if (MatchHost.IsRunning())
+					ReportMatches();
+				else
+					ReportStep();
+
+				EndStep();
+			}
+		}
+		break;
+
+	case LoadTestState_Leaving:
+		{
+			// The lobby closes itself once the network has stopped.
+			if (!pLobby->IsActive() && !NetworkManager.IsRunning())
+			{
+				CloseBots();
+				m_iState = LoadTestState_Idle;
+			}
+		}
+		break;
+	}
+}
+
+// =============================================================================
+void CLoadTestManager::UpdateBot()
+{
+	CLobbyScreen* pLobby = (CLobbyScreen*)ScreenManager.FindScreen(ScreenIndex_LobbyScreen);
+
+	// The host ends every step by closing the connection.
+	xbool bClosed = !pLobby->IsActive() || (m_iState == LoadTestState_Measuring && !NetworkManager.IsRunning());
+
+	if (bClosed || (m_iState == LoadTestState_Joining && m_xStateTimer.IsExpired()))
+	{
+		m_iMode = LoadTestMode_None;
+		Global.m_bBotControlled = false;
+		_TERMINATE;
+
+		return;
+	}
+
+	CGameScreen* pGame = (CGameScreen*)ScreenManager.FindScreen(ScreenIndex_GameScreen);
+
+	if (pGame->IsActive())
+		m_iState = LoadTestState_Measuring;
+
+	if (m_iState == LoadTestState_Measuring && m_iRelayRate && NetworkManager.IsVerified())
+		SendRelayTraffic();
+
+	RestartFinishedGame();
+}
+
+// =============================================================================
+void CLoadTestManager::RestartFinishedGame()
+{
+	CGameScreen* pGame = (CGameScreen*)ScreenManager.FindScreen(ScreenIndex_GameScreen);
+
+	if (pGame->IsAwake() && pGame->GetState() == GameState_Finished)
+		pGame->Restart();
+}
+
+// =============================================================================
+void CLoadTestManager::StartStep()
+{
+	m_iState = LoadTestState_Joining;
+	m_xStateTimer.ExpireAfter(LOADTEST_JOIN_TIMEOUT);
+
+	// Several matches are hosted by the match host rather than the lobby, with each bot told which match to join.
+	if (m_iMatchCount > 1)
+	{
+		XLOG("[LoadTest] Starting %d matches with %d clients each.", m_iMatchCount, m_iClientCount);
+
+		if (!MatchHost.Start(m_iMatchCount, m_iClientCount, m_sMap.c_str(), Global.m_iHostPort))
+		{
+			EndStep();
+			return;
+		}
+
+		for (xint iA = 0; iA < m_iMatchCount; ++iA)
+		{
+			for (xint iB = 0; iB < m_iClientCount; ++iB)
+			{
+				if (!SpawnBot(iA))
+					XLOG("[LoadTest] Failed to launch a bot client.");
+			}
+		}
+
+		return;
+	}
+
+	XLOG("[LoadTest] Starting a match with %d clients.", m_iClientCount);
+
+	ScreenManager.Set(ScreenIndex_LobbyScreen, true);
+
+	CLobbyScreen* pLobby = (CLobbyScreen*)ScreenManager.FindScreen(ScreenIndex_LobbyScreen);
+	pLobby->SetMap(m_sMap.c_str());
+	pLobby->Start(LobbyStartMode_CreatePrivate, m_iClientCount + 1);
+
+	for (xint iA = 0; iA < m_iClientCount; ++iA)
+	{
+		if (!SpawnBot(0))
+			XLOG("[LoadTest] Failed to launch a bot client.");
+	}
+}
+
+// =============================================================================
+void CLoadTestManager::EndStep()
+{
+	CGameScreen* pGame = (CGameScreen*)ScreenManager.FindScreen(ScreenIndex_GameScreen);
+	CLobbyScreen* pLobby = (CLobbyScreen*)ScreenManager.FindScreen(ScreenIndex_LobbyScreen);
+
+	// Leaving the game returns to the lobby which then stops the network.
+	if (MatchHost.IsRunning())
+		MatchHost.Close();
+	else if (pGame->IsActive())
+		ScreenManager.Pop();
+	else if (pLobby->IsActive())
+		pLobby->Stop();
+
+	m_iState = LoadTestState_Leaving;
+}
+
+// =============================================================================
+void CLoadTestManager::StartMeasuring()
+{
+	m_lfTickTimes.clear();
+	m_lfRoundTrips.clear();
+
+	m_iStartCounter = CProfileManager::GetCounter();
+	m_fStartProcessTime = GetProcessTime(GetCurrentProcess());
+
+	GetTraffic(m_iStartBitsSent, m_iStartBitsReceived, m_iStartPacketsSent, m_iStartPacketsReceived);
+
+	m_iStartRelayedMessages = NetworkManager.GetRelayedMessages();
+	m_iStartRelayedSends = NetworkManager.GetRelayedSends();
+	m_fStartRelayTime = NetworkManager.GetRelayTime();
+
+	m_iStartScheduledMessages = NetworkManager.GetScheduledMessages();
+	m_iStartSupersededMessages = NetworkManager.GetSupersededMessages();
+	m_iStartScheduleDelay = NetworkManager.GetScheduleDelay();
+
+	if (MatchHost.IsRunning())
+		MatchHost.StartMeasuring();
+
+	m_iState = LoadTestState_Measuring;
+	m_xStateTimer.ExpireAfter(m_iStepTime * 1000);
+	m_xSampleTimer.ExpireAfter(0);
+}
+
+// =============================================================================
+void CLoadTestManager::SampleRoundTrips()
+{
+	// RakNet only measures the time from a ping to its reply, so this is twice the one way latency on a symmetric link.
+	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, NetworkManager.GetVerifiedPeers())
+	{
+		if (!(*ppPeer)->m_bLocal)
+			m_lfRoundTrips.push_back((xdouble)NetworkManager.GetInterface()->GetLastPing((*ppPeer)->m_xAddress));
+	}
+}
+
+// =============================================================================
+void CLoadTestManager::ReportStep()
+{
+	xdouble fTime = CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - m_iStartCounter);
+	xdouble fCpu = (GetProcessTime(GetCurrentProcess()) - m_fStartProcessTime) * 100.0 / fTime;
+
+	xuint64 iBitsSent = 0;
+	xuint64 iBitsReceived = 0;
+	xuint64 iPacketsSent = 0;
+	xuint64 iPacketsReceived = 0;
+
+	GetTraffic(iBitsSent, iBitsReceived, iPacketsSent, iPacketsReceived);
+
+	// Kilobits per second per client, so dividing bits by milliseconds already gives kilobits per second.
+	xdouble fClientSent = (xdouble)(iBitsSent - m_iStartBitsSent) / fTime / (xdouble)m_iClientCount;
+	xdouble fClientReceived = (xdouble)(iBitsReceived - m_iStartBitsReceived) / fTime / (xdouble)m_iClientCount;
+
+	xdouble fClientPacketsSent = (xdouble)(iPacketsSent - m_iStartPacketsSent) * 1000.0 / fTime / (xdouble)m_iClientCount;
+	xdouble fClientPacketsReceived = (xdouble)(iPacketsReceived - m_iStartPacketsReceived) * 1000.0 / fTime / (xdouble)m_iClientCount;
+
+	xint iRelayedMessages = NetworkManager.GetRelayedMessages() - m_iStartRelayedMessages;
+	xint iRelayedSends = NetworkManager.GetRelayedSends() - m_iStartRelayedSends;
+	xdouble fRelayTime = NetworkManager.GetRelayTime() - m_fStartRelayTime;
+
+	xstring sReport = XFORMAT("Port %d, '%s', %d clients: %.1f%% host CPU, %d ticks at %.3f/%.3f/%.3f/%.3fms (p50/p95/p99/max), %.2fkbps (%.1f packets/sec) sent and %.2fkbps (%.1f packets/sec) received per client%s, %.0f/%.0f/%.0f/%.0fms round trip (p50/p95/p99/max), %.0f relayed messages/sec to %.1f peers each at %.2fus per message.",
+		Global.m_iHostPort,
+		m_sMap.c_str(),
+		m_iClientCount,
+		fCpu,
+		(xint)m_lfTickTimes.size(),
+		GetPercentile(m_lfTickTimes, 50.0),
+		GetPercentile(m_lfTickTimes, 95.0),
+		GetPercentile(m_lfTickTimes, 99.0),
+		GetPercentile(m_lfTickTimes, 100.0),
+		fClientSent,
+		fClientPacketsSent,
+		fClientReceived,
+		fClientPacketsReceived,
+		m_bCoalescing ? "" : " without coalescing",
+		GetPercentile(m_lfRoundTrips, 50.0),
+		GetPercentile(m_lfRoundTrips, 95.0),
+		GetPercentile(m_lfRoundTrips, 99.0),
+		GetPercentile(m_lfRoundTrips, 100.0),
+		(xdouble)iRelayedMessages * 1000.0 / fTime,
+		iRelayedMessages ? (xdouble)iRelayedSends / (xdouble)iRelayedMessages : 0.0,
+		iRelayedMessages ? fRelayTime * 1000.0 / (xdouble)iRelayedMessages : 0.0);
+
+	if (!m_sConditions.empty())
+		sReport += XFORMAT(" Simulating '%s' network conditions.", m_sConditions.c_str());
+
+	// With a send budget, report how long messages waited for it and how many were dropped for newer ones.
+	if (m_iSendBudget > 0)
+	{
+		xint iScheduledMessages = NetworkManager.GetScheduledMessages() - m_iStartScheduledMessages;
+		xint iSupersededMessages = NetworkManager.GetSupersededMessages() - m_iStartSupersededMessages;
+		xint64 iScheduleDelay = NetworkManager.GetScheduleDelay() - m_iStartScheduleDelay;
+		xint iSentMessages = iScheduledMessages - iSupersededMessages;
+
+		sReport += XFORMAT(" Budget of %d bytes/sec per peer: %.0f scheduled messages/sec, %.1f%% superseded, %.1fms average wait and %dms longest since starting.",
+			m_iSendBudget,
+			(xdouble)iScheduledMessages * 1000.0 / fTime,
+			iScheduledMessages ? (xdouble)iSupersededMessages * 100.0 / (xdouble)iScheduledMessages : 0.0,
+			iSentMessages > 0 ? (xdouble)iScheduleDelay / (xdouble)iSentMessages : 0.0,
+			NetworkManager.GetScheduleDelayMax());
+	}
+
+	// Report how much the bots were sent to catch up with the world when they joined and how long they took from connecting to applying their first snapshot.
+	if (SnapshotManager.GetWorldStatesSent())
+	{
+		xint iJoinCount = SnapshotManager.GetJoinCount();
+
+		sReport += XFORMAT(" %d world states sent at %.0f bytes each, playable %.0fms after connecting on average and %dms at most since starting.",
+			SnapshotManager.GetWorldStatesSent(),
+			(xdouble)SnapshotManager.GetWorldStateBytes() / (xdouble)SnapshotManager.GetWorldStatesSent(),
+			iJoinCount ? (xdouble)SnapshotManager.GetJoinTime() / (xdouble)iJoinCount : 0.0,
+			SnapshotManager.GetJoinTimeMax());
+	}
+
+	XLOG("[LoadTest] %s", sReport.c_str());
+
+	m_lsReports.push_back(sReport);
+}
+
+// =============================================================================
+void CLoadTestManager::ReportMatches()
+{
+	// The match threads are stopped so that their samples can be read.
+	MatchHost.Stop();
+
+	xdouble fTime = CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - m_iStartCounter);
+	xdouble fCpu = (GetProcessTime(GetCurrentProcess()) - m_fStartProcessTime) * 100.0 / fTime;
+
+	xuint64 iBitsSent = 0;
+	xuint64 iBitsReceived = 0;
+	xuint64 iPacketsSent = 0;
+	xuint64 iPacketsReceived = 0;
+
+	GetTraffic(iBitsSent, iBitsReceived, iPacketsSent, iPacketsReceived);
+
+	xint iTotalClients = m_iClientCount * MatchHost.GetMatchCount();
+
+	// Kilobits per second per client, so dividing bits by milliseconds already gives kilobits per second.
+	xdouble fClientSent = (xdouble)(iBitsSent - m_iStartBitsSent) / fTime / (xdouble)iTotalClients;
+	xdouble fClientReceived = (xdouble)(iBitsReceived - m_iStartBitsReceived) / fTime / (xdouble)iTotalClients;
+
+	// Each match reports the share of a core its ticks used along with its own tick and round trip times. The totals are taken over every match rather than this thread's ticks.
+	m_lfTickTimes.clear();
+	m_lfRoundTrips.clear();
+
+	for (xint iA = 0; iA < MatchHost.GetMatchCount(); ++iA)
+	{
+		CHostedMatch* pMatch = MatchHost.GetMatch(iA);
+
+		t_LoadTestSampleList& lfTickTimes = pMatch->GetTickTimes();
+		t_LoadTestSampleList& lfRoundTrips = pMatch->GetRoundTrips();
+
+		m_lfTickTimes.insert(m_lfTickTimes.end(), lfTickTimes.begin(), lfTickTimes.end());
+		m_lfRoundTrips.insert(m_lfRoundTrips.end(), lfRoundTrips.begin(), lfRoundTrips.end());
+
+		xstring sReport = XFORMAT("Match %d: %.1f%% of a core, %d rounds, %d ticks at %.3f/%.3f/%.3f/%.3fms (p50/p95/p99/max), %.0f/%.0f/%.0f/%.0fms round trip (p50/p95/p99/max).",
+			pMatch->GetID(),
+			pMatch->GetBusyTime() * 100.0 / fTime,
+			pMatch->GetRoundCount(),
+			(xint)lfTickTimes.size(),
+			GetPercentile(lfTickTimes, 50.0),
+			GetPercentile(lfTickTimes, 95.0),
+			GetPercentile(lfTickTimes, 99.0),
+			GetPercentile(lfTickTimes, 100.0),
+			GetPercentile(lfRoundTrips, 50.0),
+			GetPercentile(lfRoundTrips, 95.0),
+			GetPercentile(lfRoundTrips, 99.0),
+			GetPercentile(lfRoundTrips, 100.0));
+
+		XLOG("[LoadTest] %s", sReport.c_str());
+
+		m_lsReports.push_back(sReport);
+	}
+
+	xstring sReport = XFORMAT("Port %d, '%s', %d matches of %d clients on %d threads: %.1f%% host CPU, %d ticks at %.3f/%.3f/%.3f/%.3fms (p50/p95/p99/max), %.2fkbps sent and %.2fkbps received per client%s, %.0f/%.0f/%.0f/%.0fms round trip (p50/p95/p99/max).",
+		Global.m_iHostPort,
+		m_sMap.c_str(),
+		MatchHost.GetMatchCount(),
+		m_iClientCount,
+		MatchHost.GetThreadCount(),
+		fCpu,
+		(xint)m_lfTickTimes.size(),
+		GetPercentile(m_lfTickTimes, 50.0),
+		GetPercentile(m_lfTickTimes, 95.0),
+		GetPercentile(m_lfTickTimes, 99.0),
+		GetPercentile(m_lfTickTimes, 100.0),
+		fClientSent,
+		fClientReceived,
+		m_bCoalescing ? "" : " without coalescing",
+		GetPercentile(m_lfRoundTrips, 50.0),
+		GetPercentile(m_lfRoundTrips, 95.0),
+		GetPercentile(m_lfRoundTrips, 99.0),
+		GetPercentile(m_lfRoundTrips, 100.0));
+
+	if (!m_sConditions.empty())
+		sReport += XFORMAT(" Simulating '%s' network conditions.", m_sConditions.c_str());
+
+	XLOG("[LoadTest] %s", sReport.c_str());
+
+	m_lsReports.push_back(sReport);
+}
+
+// =============================================================================
+HANDLE CLoadTestManager::SpawnProcess(const xchar* pOptions)
+{
+	xchar cPath[MAX_PATH];
+	GetModuleFileName(NULL, cPath, MAX_PATH);
+
+	xstring sCommandLine = XFORMAT("\"%s\" %s", cPath, pOptions);
+
+	STARTUPINFO xStartup;
+	PROCESS_INFORMATION xProcess;
+
+	memset(&xStartup, 0, sizeof(xStartup));
+	xStartup.cb = sizeof(xStartup);
+
+	// The command line buffer must be writable.
+	xarray<xchar> lcCommandLine(sCommandLine.begin(), sCommandLine.end());
+	lcCommandLine.push_back(0);
+
+	if (!CreateProcess(NULL, &lcCommandLine[0], NULL, NULL, FALSE, 0, NULL, NULL, &xStartup, &xProcess))
+		return NULL;
+
+	CloseHandle(xProcess.hThread);
+
+	return xProcess.hProcess;
+}
+
+// =============================================================================
+xbool CLoadTestManager::SpawnBot(xint iMatchID)
+{
+	xstring sOptions = XFORMAT("%s127.0.0.1 %s%d %s", LOADTEST_BOT_OPTION, LOADTEST_PORT_OPTION, Global.m_iHostPort, GetSharedOptions().c_str());
+
+	if (m_iMatchCount > 1)
+		sOptions += XFORMAT(" %s%d", LOADTEST_MATCH_OPTION, iMatchID);
+
+	HANDLE hBot = SpawnProcess(sOptions.c_str());
+
+	if (!hBot)
+		return false;
+
+	m_lhBots.push_back(hBot);
+
+	return true;
+}
+
+// =============================================================================
+void CLoadTestManager::SendRelayTraffic()
+{
+	for (xint iA = 0; iA < m_iRelayRate; ++iA)
+	{
+		CNetworkStream* pStream = NetworkManager.BeginBroadcast(NULL, NetworkStreamType_LoadTest, LOW_PRIORITY, UNRELIABLE);
+
+		for (xint iB = 0; iB < LOADTEST_RELAY_BYTES; ++iB)
+			pStream->Write((xuint8)iB);
+
+		NetworkManager.SendStream(pStream);
+	}
+}
+
+// =============================================================================
+void CLoadTestManager::CloseBots()
+{
+	if (m_lhBots.empty())
+		return;
+
+	if (WaitForMultipleObjects((DWORD)m_lhBots.size(), &m_lhBots[0], TRUE, LOADTEST_EXIT_TIMEOUT) == WAIT_TIMEOUT)
+		XLOG("[LoadTest] Bots failed to exit in time and are being closed.");
+
+	XEN_LIST_FOREACH(t_ProcessHandleList, phBot, m_lhBots)
+	{
+		TerminateProcess(*phBot, 0);
+		CloseHandle(*phBot);
+	}
+
+	m_lhBots.clear();
+}
+
+// =============================================================================
+void CLoadTestManager::GetTraffic(xuint64& iBitsSent, xuint64& iBitsReceived, xuint64& iPacketsSent, xuint64& iPacketsReceived)
+{
+	iBitsSent = 0;
+	iBitsReceived = 0;
+	iPacketsSent = 0;
+	iPacketsReceived = 0;
+
+	if (MatchHost.IsRunning())
+	{
+		MatchHost.GetTraffic(iBitsSent, iBitsReceived, iPacketsSent, iPacketsReceived);
+		return;
+	}
+
+	if (!NetworkManager.GetInterface())
+		return;
+
+	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, NetworkManager.GetVerifiedPeers())
+	{
+		if ((*ppPeer)->m_bLocal)
+			continue;
+
+		RakNetStatistics* pStatistics = NetworkManager.GetInterface()->GetStatistics((*ppPeer)->m_xAddress);
+
+		if (pStatistics)
+		{
+			iBitsSent += pStatistics->totalBitsSent;
+			iBitsReceived += pStatistics->bitsReceived;
+			iPacketsSent += pStatistics->packetsSent;
+			iPacketsReceived += pStatistics->packetsReceived;
+		}
+	}
+}
+
+// =============================================================================
+xstring CLoadTestManager::GetSharedOptions()
+{
+	xstring sOptions = XFORMAT("%s%d%s", LOADTEST_RELAY_OPTION, m_iRelayRate, m_bCoalescing ? "" : " " LOADTEST_NO_COALESCE_OPTION);
+
+	if (m_iSendBudget > 0)
+		sOptions += XFORMAT(" %s%d", LOADTEST_BUDGET_OPTION, m_iSendBudget);
+
+	return sOptions;
+}
+
+// =============================================================================
+xdouble CLoadTestManager::GetProcessTime(HANDLE hProcess)
+{
+	FILETIME xCreation, xExit, xKernel, xUser;
+	GetProcessTimes(hProcess, &xCreation, &xExit, &xKernel, &xUser);
+
+	ULARGE_INTEGER xKernelTime, xUserTime;
+
+	xKernelTime.LowPart = xKernel.dwLowDateTime;
+	xKernelTime.HighPart = xKernel.dwHighDateTime;
+	xUserTime.LowPart = xUser.dwLowDateTime;
+	xUserTime.HighPart = xUser.dwHighDateTime;
+
+	// The times are in 100 nanosecond units.
+	return (xdouble)(xKernelTime.QuadPart + xUserTime.QuadPart) / 10000.0;
+}
+
+// =============================================================================
+xdouble CLoadTestManager::GetPercentile(t_LoadTestSampleList& lfSamples, xdouble fPercentile)
+{
+	if (lfSamples.empty())
+		return 0.0;
+
+	std::sort(lfSamples.begin(), lfSamples.end());
+
+	xint iIndex = (xint)((fPercentile / 100.0) * (xdouble)(lfSamples.size() - 1) + 0.5);
+
+	return lfSamples[Math::Clamp<xint>(iIndex, 0, (xint)lfSamples.size() - 1)];
+}
+
+//##############################################################################
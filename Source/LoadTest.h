@@ -0,0 +1,283 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define LoadTest CLoadTestManager::Get()
+
+// The command line option that runs a load test host.
+#define LOADTEST_HOST_OPTION "-loadtest "
+
+// The command line option that runs a bot client.
+#define LOADTEST_BOT_OPTION "-bot "
+
+// The command line option that sets the port to host or join on.
+#define LOADTEST_PORT_OPTION "-port "
+
+// The command line option that has each bot broadcast a number of filler messages every frame through the host.
+#define LOADTEST_RELAY_OPTION "-relay "
+
+// The command line option that turns off coalescing the messages sent each tick, passed on to every process in the test.
+#define LOADTEST_NO_COALESCE_OPTION "-nocoalesce"
+
+// The command line option that sets the map the load test host plays on.
+#define LOADTEST_MAP_OPTION "-map "
+
+// The command line option that limits the bytes per second each process sends to each peer, passed on to every process in the test.
+#define LOADTEST_BUDGET_OPTION "-budget "
+
+// The command line option that has each step host a number of matches side by side in one process.
+#define LOADTEST_MATCHES_OPTION "-matches "
+
+// The command line option that picks the match a bot joins on a host running several matches.
+#define LOADTEST_MATCH_OPTION "-match "
+
+// The size, in bytes, of each filler message a bot broadcasts.
+#define LOADTEST_RELAY_BYTES 32
+
+// The default time in seconds each step of a load test is measured for.
+#define LOADTEST_DEFAULT_STEP_TIME 30
+
+// The time in milliseconds to wait for every bot to join before abandoning a step.
+#define LOADTEST_JOIN_TIMEOUT 30000
+
+// The time in milliseconds to let a match settle before measuring, covering the countdown.
+#define LOADTEST_WARMUP_TIME 6000
+
+// The time in milliseconds to wait for bot processes to exit once a step ends.
+#define LOADTEST_EXIT_TIMEOUT 5000
+
+// The interval in milliseconds between round trip time samples.
+#define LOADTEST_SAMPLE_INTERVAL 100
+
+//##############################################################################
+
+// The load test modes.
+enum t_LoadTestMode
+{
+	LoadTestMode_None,
+	LoadTestMode_Host,			// Host matches and spawn bot clients at increasing counts.
+	LoadTestMode_Bot,			// Join a host and play until the connection closes.
+};
+
+// The load test states.
+enum t_LoadTestState
+{
+	LoadTestState_Idle,
+	LoadTestState_Joining,
+	LoadTestState_WarmingUp,
+	LoadTestState_Measuring,
+	LoadTestState_Leaving,
+};
+
+// Lists.
+typedef xarray<xdouble> t_LoadTestSampleList;
+typedef xarray<HANDLE> t_ProcessHandleList;
+typedef xarray<xstring> t_LoadTestReportList;
+
+//##############################################################################
+class CLoadTestManager : public CModule
+{
+public:
+	// Singleton instance.
+	static inline CLoadTestManager& Get()
+	{
+		static CLoadTestManager s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CLoadTestManager();
+
+	// Stop any bots still running.
+	virtual void OnDeinitialise();
+
+	// Advance the load test.
+	virtual void OnUpdate();
+
+	// Host a match for each client count from one up to the limit, measuring each for a number of seconds.
+	void StartHost(xint iMaxClients, xint iStepTime);
+
+	// Join a host as a bot and play until the host ends the match.
+	void StartBot(const xchar* pHostAddress);
+
+	// Check if a load test is running in this process.
+	inline xbool IsRunning()
+	{
+		return m_iMode != LoadTestMode_None;
+	}
+
+	// Record the time in milliseconds taken by a tick.
+	void RecordTick(xdouble fTime);
+
+	// Set the number of filler messages each bot broadcasts through the host every frame.
+	inline void SetRelayRate(xint iRelayRate)
+	{
+		m_iRelayRate = iRelayRate;
+	}
+
+	// Set whether the processes launched by the test coalesce their messages.
+	inline void SetCoalescing(xbool bCoalescing)
+	{
+		m_bCoalescing = bCoalescing;
+	}
+
+	// Set the bytes per second the processes launched by the test send to each peer, or zero for no limit.
+	inline void SetSendBudget(xint iSendBudget)
+	{
+		m_iSendBudget = iSendBudget;
+	}
+
+	// Set the map the matches are played on.
+	inline void SetMap(const xchar* pMap)
+	{
+		m_sMap = pMap;
+	}
+
+	// Set the number of matches each step hosts side by side in this process.
+	inline void SetMatchCount(xint iMatchCount)
+	{
+		m_iMatchCount = iMatchCount;
+	}
+
+	// Set the name of the network conditions the match hosts simulate.
+	inline void SetConditions(const xchar* pName)
+	{
+		m_sConditions = pName;
+	}
+
+protected:
+	// Update the host side of the load test.
+	void UpdateHost();
+
+	// Update a bot client.
+	void UpdateBot();
+
+	// Keep matches running by restarting them whenever they finish.
+	void RestartFinishedGame();
+
+	// Host a match and launch the bots for the current step.
+	void StartStep();
+
+	// Leave the current match and wait for the bots to exit.
+	void EndStep();
+
+	// Reset the statistics at the start of the measured period.
+	void StartMeasuring();
+
+	// Sample the round trip time to each bot.
+	void SampleRoundTrips();
+
+	// Write the statistics for the current step to the log.
+	void ReportStep();
+
+	// Write the statistics for each match of a step hosting several matches to the log.
+	void ReportMatches();
+
+	// Launch a copy of this executable with the given options.
+	static HANDLE SpawnProcess(const xchar* pOptions);
+
+	// Launch a bot client process to join a match.
+	xbool SpawnBot(xint iMatchID);
+
+	// Broadcast the filler messages for a frame as a bot.
+	void SendRelayTraffic();
+
+	// Wait for the bot processes to exit, closing any that don't.
+	void CloseBots();
+
+	// Get the total bits and packets sent and received to all remote peers.
+	static void GetTraffic(xuint64& iBitsSent, xuint64& iBitsReceived, xuint64& iPacketsSent, xuint64& iPacketsReceived);
+
+	// Get the options passed on to the processes launched by the test.
+	xstring GetSharedOptions();
+
+	// Get the processor time used by a process in milliseconds.
+	static xdouble GetProcessTime(HANDLE hProcess);
+
+	// Get a percentile from a list of samples. The list is sorted in place.
+	static xdouble GetPercentile(t_LoadTestSampleList& lfSamples, xdouble fPercentile);
+
+	// The load test mode.
+	t_LoadTestMode m_iMode;
+
+	// The current state.
+	t_LoadTestState m_iState;
+
+	// The address of the host to join as a bot.
+	xstring m_sHostAddress;
+
+	// The largest number of bots to test with.
+	xint m_iMaxClients;
+
+	// The time in seconds each step is measured for.
+	xint m_iStepTime;
+
+	// The number of bots in the current step.
+	xint m_iClientCount;
+
+	// The number of matches hosted side by side in each step.
+	xint m_iMatchCount;
+
+	// The timer for the current state.
+	CTimer m_xStateTimer;
+
+	// The timer for the next round trip time sample.
+	CTimer m_xSampleTimer;
+
+	// The number of filler messages each bot broadcasts every frame.
+	xint m_iRelayRate;
+
+	// Determines if the processes launched by the test coalesce their messages.
+	xbool m_bCoalescing;
+
+	// The bytes per second the processes launched by the test send to each peer, or zero for no limit.
+	xint m_iSendBudget;
+
+	// The name of the network conditions the match hosts simulate, or empty for none.
+	xstring m_sConditions;
+
+	// The map the matches are played on.
+	xstring m_sMap;
+
+	// The tick times recorded while measuring.
+	t_LoadTestSampleList m_lfTickTimes;
+
+	// The round trip times recorded while measuring.
+	t_LoadTestSampleList m_lfRoundTrips;
+
+	// The counter value when measuring started.
+	xint64 m_iStartCounter;
+
+	// The processor time when measuring started.
+	xdouble m_fStartProcessTime;
+
+	// The traffic to the bots when measuring started.
+	xuint64 m_iStartBitsSent;
+	xuint64 m_iStartBitsReceived;
+	xuint64 m_iStartPacketsSent;
+	xuint64 m_iStartPacketsReceived;
+
+	// The relay statistics when measuring started.
+	xint m_iStartRelayedMessages;
+	xint m_iStartRelayedSends;
+	xdouble m_fStartRelayTime;
+
+	// The scheduling statistics when measuring started.
+	xint m_iStartScheduledMessages;
+	xint m_iStartSupersededMessages;
+	xint64 m_iStartScheduleDelay;
+
+	// The bot process handles for the current step.
+	t_ProcessHandleList m_lhBots;
+
+	// The report for each completed step, logged again once the test finishes.
+	t_LoadTestReportList m_lsReports;
+};
+
+//##############################################################################
@@ -19,6 +19,8 @@
 
 // =============================================================================
 CLobbyScreen::CLobbyScreen() : CScreen(ScreenIndex_LobbyScreen),
+	m_iMaxPeers(LOBBY_MAX_PEERS),
+	m_sMap(LOBBY_MAP),
 	m_iState(LobbyState_None),
 	m_bPublic(true),
 	m_pSession(NULL)
@@ -161,10 +163,7 @@ void CLobbyScreen::UpdateLobby()
 
 		// Start the game when ENTER is pressed (debug).
 		if (_HGE->Input_KeyUp(HGEK_ENTER) && NetworkManager.IsEveryoneVerified())
-		{
-			NetworkManager.Broadcast(NULL, NetworkStreamType_StartGame, NULL, HIGH_PRIORITY, RELIABLE_ORDERED);
-			StartGame();
-		}
+			StartMatch();
 	}
 }
 
@@ -188,9 +187,11 @@ void CLobbyScreen::RenderLobby(CRenderLayer* pLayer)
 }
 
 // =============================================================================
-void CLobbyScreen::Start(t_LobbyStartMode iStartMode)
+void CLobbyScreen::Start(t_LobbyStartMode iStartMode, xint iMaxPeers)
 {
 	m_xPingTimer.Reset();
+
+	m_iMaxPeers = Math::Min<xint>(iMaxPeers, _MAXPLAYERS);
 	
 	m_bPublic = (iStartMode == LobbyStartMode_JoinPublic || iStartMode == LobbyStartMode_CreatePublic);
 	m_pSession = NULL;
@@ -213,7 +214,7 @@ void CLobbyScreen::Start(t_LobbyStartMode iStartMode)
 	case LobbyStartMode_CreatePublic:
 		{
 			SetState(LobbyState_Creating);
-			m_pSession = MatchManager.CreateSession(4, "PikPik Beta Server", xbind(this, &CLobbyScreen::OnCreateSessionCompleted));
+			m_pSession = MatchManager.CreateSession(m_iMaxPeers, "PikPik Beta Server", xbind(this, &CLobbyScreen::OnCreateSessionCompleted));
 		}
 		break;
 
@@ -341,8 +342,8 @@ void CLobbyScreen::InitialiseNetwork()
 		"bkt"
 	};
 
-	strcpy_s(m_xGamerCard.m_cNickname, _MAXNAMELEN, s_pNames[rand() % 20]);
-	m_xGamerCard.m_iSeed = rand() % 4096;
+	strcpy_s(m_xGamerCard.m_cNickname, _MAXNAMELEN, s_pNames[_RANDOM(RandomStream_Session).GetInt(20)]);
+	m_xGamerCard.m_iSeed = _RANDOM(RandomStream_Session).GetInt(4096);
 
 	NetworkManager.SetGamerCard(&m_xGamerCard, sizeof(CNetworkGamerCard));
 
@@ -352,6 +353,9 @@ void CLobbyScreen::InitialiseNetwork()
 	// Bind the stream type callbacks.
 	NetworkManager.BindReceiveCallback(NetworkStreamType_StartGame, xbind(this, &CLobbyScreen::OnReceiveStartGame));
 	NetworkManager.BindReceiveCallback(NetworkStreamType_PlayerUpdate, &CPlayer::OnReceivePlayerUpdate);
+	NetworkManager.BindReceiveCallback(NetworkStreamType_Snapshot, xbind(&SnapshotManager, &CSnapshotManager::OnReceiveSnapshot));
+	NetworkManager.BindReceiveCallback(NetworkStreamType_SnapshotAck, xbind(&SnapshotManager, &CSnapshotManager::OnReceiveSnapshotAck));
+	NetworkManager.BindReceiveCallback(NetworkStreamType_WorldState, xbind(&SnapshotManager, &CSnapshotManager::OnReceiveWorldState));
 
 	// Bind all event callbacks.
 	NetworkManager.m_xCallbacks.m_fpNetworkStarted = xbind(this, &CLobbyScreen::OnNetworkStart);
@@ -371,7 +375,7 @@ void CLobbyScreen::CreateLobby()
 
 	InitialiseNetwork();
 
-	NetworkManager.StartHost(4, _HOSTPORT);
+	NetworkManager.StartHost(m_iMaxPeers, Global.m_iHostPort);
 
 	SetState(LobbyState_Lobby);
 }
@@ -383,18 +387,31 @@ void CLobbyScreen::JoinLobby(const xchar* pHostAddress)
 
 	InitialiseNetwork();
 
-	NetworkManager.StartClient(pHostAddress, _HOSTPORT);
+	NetworkManager.StartClient(pHostAddress, Global.m_iHostPort);
 
 	SetState(LobbyState_Connecting);
 }
 
+// =============================================================================
+void CLobbyScreen::StartMatch()
+{
+	// The clients are told which map to load.
+	CNetworkStream* pStream = NetworkManager.BeginBroadcast(NULL, NetworkStreamType_StartGame, NETWORK_PRIORITY_LOBBY, RELIABLE_ORDERED);
+
+	pStream->Write((xuint8)m_sMap.length());
+	pStream->Write(m_sMap.c_str(), (xint)m_sMap.length());
+
+	NetworkManager.SendStream(pStream);
+	StartGame();
+}
+
 // =============================================================================
 void CLobbyScreen::StartGame()
 {
 	//SetState(LobbyState_Starting);
 
 	// Load the map.
-	MapManager.SetCurrentMap("M009");
+	MapManager.SetCurrentMap(m_sMap.c_str());
 
 	// Initialise the players.
 	if (NetworkManager.IsHosting())
@@ -413,7 +430,7 @@ void CLobbyScreen::StartGame()
 		pInfo->m_pPlayer->SetLogicType(pPeer->m_bLocal ? PlayerLogicType_Local : PlayerLogicType_Remote);
 
 		if (pPeer->m_bLocal)
-			PlayerManager.SetLocalPlayer(iPlayerIndex);
+			PlayerManager.SetLocalPlayer(pInfo->m_pPlayer);
 	}
 
 	// Start the game.
@@ -558,7 +575,18 @@ void CLobbyScreen::OnPeerLeaving(CNetworkPeer* pPeer)
 // =============================================================================
 void CLobbyScreen::OnReceiveStartGame(CNetworkPeer* pFrom, BitStream* pStream)
 {
-	XLOG("[LobbyScreen] Received notification to start the game.");
+	xuint8 iLength = 0;
+	xchar cMap[256];
+
+	if (pStream->Read(iLength) && pStream->Read(cMap, iLength))
+	{
+		cMap[iLength] = 0;
+
+		if (MapManager.GetMap(cMap))
+			m_sMap = cMap;
+	}
+
+	XLOG("[LobbyScreen] Received notification to start the game on '%s'.", m_sMap.c_str());
 
 	StartGame();
 }
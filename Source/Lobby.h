@@ -23,6 +23,12 @@
 
 //##############################################################################
 
+// The map played in network games unless the host picks another.
+#define LOBBY_MAP "M009"
+
+// The default number of peers a lobby can hold.
+#define LOBBY_MAX_PEERS 4
+
 // Predeclare.
 class CStatusBox;
 class CJoinInterface;
@@ -98,11 +104,35 @@ public:
 	virtual ~CLobbyScreen();
 
 	// Start and initialise the lobby using the specified mode.
-	void Start(t_LobbyStartMode iStartMode);
+	void Start(t_LobbyStartMode iStartMode, xint iMaxPeers = LOBBY_MAX_PEERS);
 
 	// Stop and close the lobby.
 	void Stop();
 
+	// Join an existing lobby and act as a client.
+	void JoinLobby(const xchar* pHostAddress);
+
+	// Tell every peer to start the game and start it locally. Only the host may start the game.
+	void StartMatch();
+
+	// Set the map the host starts the game on.
+	inline void SetMap(const xchar* pMap)
+	{
+		m_sMap = pMap;
+	}
+
+	// Get the map the game is started on.
+	inline const xchar* GetMap()
+	{
+		return m_sMap.c_str();
+	}
+
+	// Check if the lobby is open and waiting for the game to start.
+	inline xbool IsInLobby()
+	{
+		return m_iState == LobbyState_Lobby;
+	}
+
 	// Get the gamer card from a peer structure.
 	inline CNetworkGamerCard* GetGamerCard(CNetworkPeer* pPeer)
 	{
@@ -158,9 +188,6 @@ protected:
 	// Create a new lobby and act as the host.
 	void CreateLobby();
 
-	// Join an existing lobby and act as a client.
-	void JoinLobby(const xchar* pHostAddress);
-
 	// Start the game from the lobby.
 	void StartGame();
 
@@ -215,6 +242,12 @@ protected:
 	// The lobby startup mode.
 	t_LobbyStartMode m_iStartMode;
 
+	// The maximum number of peers the lobby can hold.
+	xint m_iMaxPeers;
+
+	// The map the game is started on.
+	xstring m_sMap;
+
 	// The current lobby state.
 	t_LobbyState m_iState;
 
@@ -16,11 +16,19 @@
 #include <Sound.h>
 #include <Splash.h>
 #include <Menu.h>
+#include <Brain.h>
 #include <Game.h>
+#include <Host.h>
 #include <Map.h>
 #include <Lobby.h>
+#include <LoadTest.h>
 #include <Navigation.h>
 #include <Player.h>
+#include <Profile.h>
+#include <Replay.h>
+#include <Snapshot.h>
+#include <Trace.h>
+#include <Worker.h>
 
 // Crypto.
 #include <Crypto/cryptlib.h>
@@ -38,8 +46,8 @@ static HGE* s_pInterface = NULL;
 // Flow Control.
 static xbool s_bTerminate = false;
 
-// Timer.
-static xuint s_iTimeDelta = 0;
+// Timer. Each match thread keeps its own.
+static __declspec(thread) xuint s_iTimeDelta = 0;
 
 // Screen List.
 ::t_ScreenList s_lpScreens;
@@ -47,7 +55,7 @@ static xuint s_iTimeDelta = 0;
 //##############################################################################
 
 // =============================================================================
-int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
+int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR lpCmdLine, int)
 {
 	s_pInterface = hgeCreate(HGE_VERSION);
 
@@ -73,7 +81,119 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 		{
 			Application::Initialise();
 
-			s_pInterface->System_Start();
+			// Replay a recorded game headlessly when requested, otherwise run normally.
+			const xchar* pReplay = strstr(lpCmdLine, "-replay ");
+			const xchar* pDecodeTrace = strstr(lpCmdLine, PACKET_TRACE_DECODE_OPTION);
+			const xchar* pLoadTest = strstr(lpCmdLine, LOADTEST_HOST_OPTION);
+			const xchar* pBot = strstr(lpCmdLine, LOADTEST_BOT_OPTION);
+			const xchar* pPort = strstr(lpCmdLine, LOADTEST_PORT_OPTION);
+			const xchar* pRelay = strstr(lpCmdLine, LOADTEST_RELAY_OPTION);
+			const xchar* pNoCoalesce = strstr(lpCmdLine, LOADTEST_NO_COALESCE_OPTION);
+			const xchar* pBudget = strstr(lpCmdLine, LOADTEST_BUDGET_OPTION);
+			const xchar* pThinkTime = strstr(lpCmdLine, PACMAN_BRAIN_THINK_OPTION);
+			const xchar* pConditions = strstr(lpCmdLine, NETWORK_CONDITIONS_OPTION);
+			const xchar* pMap = strstr(lpCmdLine, LOADTEST_MAP_OPTION);
+			const xchar* pMatches = strstr(lpCmdLine, LOADTEST_MATCHES_OPTION);
+			const xchar* pMatch = strstr(lpCmdLine, LOADTEST_MATCH_OPTION);
+
+			if (pPort)
+				sscanf_s(pPort + strlen(LOADTEST_PORT_OPTION), "%d", &Global.m_iHostPort);
+
+			// Load tests can measure the host relay by having the bots broadcast through it.
+			if (pRelay)
+			{
+				xint iRelayRate = 0;
+
+				sscanf_s(pRelay + strlen(LOADTEST_RELAY_OPTION), "%d", &iRelayRate);
+				LoadTest.SetRelayRate(Math::Max<xint>(iRelayRate, 0));
+			}
+
+			// Coalescing can be turned off to compare the traffic with and without it.
+			if (pNoCoalesce)
+			{
+				LoadTest.SetCoalescing(false);
+				NetworkManager.SetCoalescing(false);
+			}
+
+			// A send budget paces what goes to each peer, keeping the most important and most recent messages when it runs short.
+			if (pBudget)
+			{
+				xint iSendBudget = 0;
+
+				sscanf_s(pBudget + strlen(LOADTEST_BUDGET_OPTION), "%d", &iSendBudget);
+				iSendBudget = Math::Max<xint>(iSendBudget, 0);
+
+				LoadTest.SetSendBudget(iSendBudget);
+				NetworkManager.SetSendBudget(iSendBudget);
+			}
+
+			// Bad network links can be simulated to see how the game holds up over them.
+			if (pConditions)
+			{
+				xchar cConditions[64] = "";
+
+				sscanf_s(pConditions + strlen(NETWORK_CONDITIONS_OPTION), "%63s", cConditions, (unsigned)_countof(cConditions));
+
+				if (NetworkManager.LoadConditions(cConditions))
+					LoadTest.SetConditions(cConditions);
+			}
+
+			// Load tests can be played on a larger map to see how it scales.
+			if (pMap)
+			{
+				xchar cMap[64] = "";
+
+				sscanf_s(pMap + strlen(LOADTEST_MAP_OPTION), "%63s", cMap, (unsigned)_countof(cMap));
+				LoadTest.SetMap(cMap);
+			}
+
+			// Load tests can host several matches side by side in one process.
+			if (pMatches)
+			{
+				xint iMatchCount = 1;
+
+				sscanf_s(pMatches + strlen(LOADTEST_MATCHES_OPTION), "%d", &iMatchCount);
+				LoadTest.SetMatchCount(Math::Max<xint>(iMatchCount, 1));
+			}
+
+			// Bots joining a host with several matches say which one they are joining.
+			if (pMatch)
+			{
+				xint iMatchID = 0;
+
+				sscanf_s(pMatch + strlen(LOADTEST_MATCH_OPTION), "%d", &iMatchID);
+				NetworkManager.SetMatchID(Math::Max<xint>(iMatchID, 0));
+			}
+
+			// Servers can trade the Pacman bots' play for time.
+			if (pThinkTime)
+			{
+				xdouble fThinkTime = PACMAN_BRAIN_THINK_TIME;
+
+				sscanf_s(pThinkTime + strlen(PACMAN_BRAIN_THINK_OPTION), "%lf", &fThinkTime);
+				CPacmanBrain::SetThinkTime(fThinkTime);
+			}
+
+			if (pReplay)
+				ReplayManager.Run(pReplay + strlen("-replay "));
+			else if (pDecodeTrace)
+				CPacketTrace::Decode(pDecodeTrace + strlen(PACKET_TRACE_DECODE_OPTION));
+			else
+			{
+				// Load tests run the normal game loop with bots in control of the players.
+				if (pLoadTest)
+				{
+					xint iMaxClients = 1;
+					xint iStepTime = LOADTEST_DEFAULT_STEP_TIME;
+
+					sscanf_s(pLoadTest + strlen(LOADTEST_HOST_OPTION), "%d %d", &iMaxClients, &iStepTime);
+					LoadTest.StartHost(iMaxClients, iStepTime);
+				}
+				else if (pBot)
+					LoadTest.StartBot(pBot + strlen(LOADTEST_BOT_OPTION));
+
+				s_pInterface->System_Start();
+			}
 		}
 		catch (Xen::CException xException)
 		{
@@ -107,11 +227,13 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 // =============================================================================
 void Application::Initialise()
 {
-	// Seed the random number generator.
-	srand(_TIMEMS);
+	// Seed the random number streams.
+	Global.SeedRandom(_TIMEMS);
 
 	// Initialise global vars.
 	Global.m_bWindowFocused = true;
+	Global.m_bBotControlled = false;
+	Global.m_iHostPort = _HOSTPORT;
 
 	// Add all required modules to the game.
 	XMODULE(&NetworkManager);
@@ -125,6 +247,11 @@ void Application::Initialise()
 	XMODULE(&CollisionManager);
 	XMODULE(&MatchManager);
 	XMODULE(&NavigationManager);
+	XMODULE(&SnapshotManager);
+	XMODULE(&ReplayManager);
+	XMODULE(&WorkerPool);
+	XMODULE(&MatchHost); // The hosted matches use the resources and worker pool so are closed before them.
+	XMODULE(&LoadTest);
 
 	// Initialise all modules.
 	ModuleManager.Initialise();
@@ -196,7 +323,15 @@ xbool Application::OnUpdate()
 		while (s_pInterface->Input_GetEvent(&hgEvent))
 			ModuleManager.Event(hgEvent.type, &hgEvent);
 
+		xint64 iStart = CProfileManager::GetCounter();
+
 		ModuleManager.Update();
+
+		// Send everything queued during the tick together.
+		if (NetworkManager.IsRunning())
+			NetworkManager.Flush();
+
+		LoadTest.RecordTick(CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - iStart));
 	}
 
 	return s_bTerminate;
@@ -260,4 +395,10 @@ xuint Application::GetTimeDelta()
 	return s_iTimeDelta;
 }
 
+// =============================================================================
+void Application::SetTimeDelta(xuint iTimeDelta)
+{
+	s_iTimeDelta = iTimeDelta;
+}
+
 //##############################################################################
\ No newline at end of file
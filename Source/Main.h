@@ -54,6 +54,9 @@ namespace Application
 
 	// Get the current time delta in milliseconds.
 	xuint GetTimeDelta();
+
+	// Override the time delta for the current update. This is used to play back recorded games.
+	void SetTimeDelta(xuint iTimeDelta);
 }
 
 //##############################################################################
\ No newline at end of file
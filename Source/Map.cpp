@@ -11,6 +11,8 @@
 #include <Resource.h>
 #include <Player.h>
 #include <Crypt.h>
+#include <Profile.h>
+#include <Trigger.h>
 
 //##############################################################################
 
@@ -112,6 +114,7 @@ void CMapBlock::Eat()
 		//xTimer.ExpireAfter(60000);
 
 		MapManager.GetCurrentMap()->m_iPelletsEaten++;
+		MapManager.GetCurrentMap()->m_lpEatenBitmap[m_iIndex >> 5] |= (1u << (m_iIndex & 31));
 	}
 }
 
@@ -167,6 +170,9 @@ void CMap::Load()
 		// Allocate the map block memory.
 		m_xBlocks = new CMapBlock[m_iBlockCount];
 
+		// Start afresh with a trigger slot for each block.
+		TriggerManager.Reset(m_iBlockCount);
+
 		// Process the map blocks.
 		CProperty* pProperty = m_pDataset->GetProperty("Data");
 
@@ -205,7 +211,16 @@ void CMap::Load()
 			{
 			// Special.
 			case '*': pBlock->m_iTileType = TileType_Pellet;	break;
-			case '@': pBlock->m_iTileType = TileType_Power;		break;
+			case '@': 
+				pBlock->m_iTileType = TileType_Power;
+				new CPower(pBlock);
+				break;
+
+			case '^':
+				pBlock->m_iTileType = TileType_Blank;
+				new CTrap(pBlock);
+				break;
+
 			case '=': pBlock->m_iTileType = TileType_Entrance;	break;
 
 			// Wall.
@@ -267,6 +282,34 @@ void CMap::Load()
 
 		// Initialise the map properties.
 		m_iPelletsEaten = 0;
+		m_lpEatenBitmap.assign((m_iBlockCount + 31) / 32, 0);
+
+		// Players are added to the occupancy index as they are placed.
+		m_liFirstOccupant.assign(m_iBlockCount, -1);
+		m_liNextOccupant.clear();
+		m_liPrevOccupant.clear();
+		m_liOccupiedBlock.clear();
+
+		// Every spawn starts out free and is taken out of its lists while occupied.
+		m_liSpawnLists.assign(m_iBlockCount, 0);
+
+		for (xint iA = 0; iA < MAP_SPAWN_LISTS; ++iA)
+		{
+			m_lpFreeSpawns[iA].clear();
+			m_liFreeSpawnIndex[iA].assign(m_iBlockCount, -1);
+		}
+
+		for (xint iA = 0; iA < PlayerType_Max; ++iA)
+		{
+			XEN_LIST_FOREACH(t_MapBlockList, ppBlock, m_lpSpawnPoints[iA])
+				AddSpawn(iA, *ppBlock);
+		}
+
+		for (xint iA = 0; iA < m_iBlockCount; ++iA)
+		{
+			if (!m_xBlocks[iA].IsWall())
+				AddSpawn(MAP_OPEN_SPAWNS, &m_xBlocks[iA]);
+		}
 	}
 
 	m_bLoaded = true;
@@ -280,6 +323,14 @@ void CMap::Unload()
 		for (xint iA = 0; iA < TileType_Max; ++iA)
 			delete m_pTiles[iA];
 
+		for (xint iA = 0; iA < m_iBlockCount; ++iA)
+		{
+			delete m_xBlocks[iA].m_pPower;
+			delete m_xBlocks[iA].m_pTrap;
+		}
+
+		TriggerManager.Reset(0);
+
 		delete[] m_xBlocks;
 		m_xBlocks = NULL;
 
@@ -287,6 +338,21 @@ void CMap::Unload()
 			m_lpSpawnPoints[iA].clear();
 
 		delete m_pNavMesh;
+
+		m_lpEatenBitmap.clear();
+
+		m_liFirstOccupant.clear();
+		m_liNextOccupant.clear();
+		m_liPrevOccupant.clear();
+		m_liOccupiedBlock.clear();
+
+		for (xint iA = 0; iA < MAP_SPAWN_LISTS; ++iA)
+		{
+			m_lpFreeSpawns[iA].clear();
+			m_liFreeSpawnIndex[iA].clear();
+		}
+
+		m_liSpawnLists.clear();
 	}
 
 	m_bLoaded = false;
@@ -300,13 +366,15 @@ void CMap::Update()
 		m_pTiles[iA]->Update();
 
 	// Calculate the block visibility.
-	if (PlayerManager.GetLocalPlayer()->m_iType == PlayerType_Ghost)
+	if (PlayerManager.GetLocalPlayer()->GetType() == PlayerType_Ghost)
 	{
 		for (xint iA = 0; iA < m_iBlockCount; ++iA)
 			m_xBlocks[iA].m_fVisibility = 0.f;
 
-		AddVisiblePaths(PlayerManager.GetLocalPlayer()->m_pCurrentBlock, 1.0f - PlayerManager.GetLocalPlayer()->m_fTransition);
-		AddVisiblePaths(PlayerManager.GetLocalPlayer()->m_pTargetBlock, PlayerManager.GetLocalPlayer()->m_fTransition);
+		CPlayerMovement& xMovement = PlayerManager.GetLocalPlayer()->GetMovement();
+
+		AddVisiblePaths(xMovement.m_pCurrentBlock, 1.0f - xMovement.m_fTransition);
+		AddVisiblePaths(xMovement.m_pTargetBlock, xMovement.m_fTransition);
 
 		for (xint iA = 0; iA < m_iBlockCount; ++iA)
 		{
@@ -393,24 +461,168 @@ CMapBlock* CMap::GetAdjacentBlock(t_AdjacentDirection iAdjacentDir, CMapBlock* p
 	}
 }
 
+// =============================================================================
+xint CMap::GetDistance(CMapBlock* pBlockA, CMapBlock* pBlockB)
+{
+	xint iX = abs(pBlockA->m_xPosition.m_tX - pBlockB->m_xPosition.m_tX);
+	xint iY = abs(pBlockA->m_xPosition.m_tY - pBlockB->m_xPosition.m_tY);
+
+	return Math::Min(iX, m_iWidth - iX) + Math::Min(iY, m_iHeight - iY);
+}
+
 // =============================================================================
 CMapBlock* CMap::GetSpawnBlock(t_PlayerType iPlayerType)
 {
-	CMapBlock* pBlock = NULL;
+	// Large matches can have more players than spawn points so fall back to any free open block.
+	t_MapBlockList& lpFreeBlocks = m_lpFreeSpawns[iPlayerType].empty() ? m_lpFreeSpawns[MAP_OPEN_SPAWNS] : m_lpFreeSpawns[iPlayerType];
+
+	XMASSERT(!lpFreeBlocks.empty(), "There are no free blocks left to spawn a player on.");
+
+	return lpFreeBlocks[_RANDOM(RandomStream_Spawn).GetInt((xint)lpFreeBlocks.size())];
+}
+
+// =============================================================================
+void CMap::AddSpawn(xint iList, CMapBlock* pBlock)
+{
+	if (m_liSpawnLists[pBlock->m_iIndex] & XBIT(iList))
+		return;
 
-	do
+	m_liSpawnLists[pBlock->m_iIndex] |= XBIT(iList);
+
+	if (!IsOccupied(pBlock))
+	{
+		m_liFreeSpawnIndex[iList][pBlock->m_iIndex] = (xint)m_lpFreeSpawns[iList].size();
+		m_lpFreeSpawns[iList].push_back(pBlock);
+	}
+}
+
+// =============================================================================
+void CMap::SetSpawnFree(CMapBlock* pBlock, xbool bFree)
+{
+	xint iBlock = pBlock->m_iIndex;
+
+	for (xint iA = 0; iA < MAP_SPAWN_LISTS; ++iA)
 	{
-		pBlock = m_lpSpawnPoints[iPlayerType][rand() % m_lpSpawnPoints[iPlayerType].size()];
+		if (!(m_liSpawnLists[iBlock] & XBIT(iA)))
+			continue;
+
+		t_MapBlockList& lpFree = m_lpFreeSpawns[iA];
+		t_OccupancyList& liIndex = m_liFreeSpawnIndex[iA];
 
-		XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+		if (bFree && liIndex[iBlock] == -1)
 		{
-			if ((*ppPlayer)->GetCurrentBlock() == pBlock)
-				pBlock = NULL;
+			liIndex[iBlock] = (xint)lpFree.size();
+			lpFree.push_back(pBlock);
 		}
+		else if (!bFree && liIndex[iBlock] != -1)
+		{
+			// Fill the gap with the last free block so that the list stays packed.
+			CMapBlock* pLast = lpFree.back();
+
+			lpFree[liIndex[iBlock]] = pLast;
+			liIndex[pLast->m_iIndex] = liIndex[iBlock];
+
+			lpFree.pop_back();
+			liIndex[iBlock] = -1;
+		}
+	}
+}
+
+// =============================================================================
+void CMap::SetOccupiedBlock(CPlayer* pPlayer, CMapBlock* pBlock)
+{
+	xint iPlayer = pPlayer->GetIndex();
+
+	if (iPlayer >= (xint)m_liOccupiedBlock.size())
+	{
+		m_liNextOccupant.resize(iPlayer + 1, -1);
+		m_liPrevOccupant.resize(iPlayer + 1, -1);
+		m_liOccupiedBlock.resize(iPlayer + 1, -1);
+	}
+
+	xint iBlock = pBlock ? (xint)pBlock->m_iIndex : -1;
+
+	if (m_liOccupiedBlock[iPlayer] == iBlock)
+		return;
+
+	// Unlink the player from the block they were on.
+	if (m_liOccupiedBlock[iPlayer] != -1)
+	{
+		xint iNext = m_liNextOccupant[iPlayer];
+		xint iPrev = m_liPrevOccupant[iPlayer];
+
+		if (iPrev != -1)
+			m_liNextOccupant[iPrev] = iNext;
+		else
+			m_liFirstOccupant[m_liOccupiedBlock[iPlayer]] = iNext;
+
+		if (iNext != -1)
+			m_liPrevOccupant[iNext] = iPrev;
+
+		if (m_liFirstOccupant[m_liOccupiedBlock[iPlayer]] == -1)
+			SetSpawnFree(&m_xBlocks[m_liOccupiedBlock[iPlayer]], true);
+	}
+
+	// Link the player to the front of the new block.
+	xint iLastBlock = m_liOccupiedBlock[iPlayer];
+	m_liOccupiedBlock[iPlayer] = iBlock;
+	m_liPrevOccupant[iPlayer] = -1;
+	m_liNextOccupant[iPlayer] = -1;
+
+	if (iBlock != -1)
+	{
+		xint iFirst = m_liFirstOccupant[iBlock];
+
+		if (iFirst != -1)
+			m_liPrevOccupant[iFirst] = iPlayer;
+		else
+			SetSpawnFree(pBlock, false);
+
+		m_liNextOccupant[iPlayer] = iFirst;
+		m_liFirstOccupant[iBlock] = iPlayer;
 	}
-	while (!pBlock);
 
-	return pBlock;
+	// Fire the triggers on either block now the player is linked in place.
+	TriggerManager.OnLeave(pPlayer, iLastBlock);
+	TriggerManager.OnEnter(pPlayer, iBlock);
+}
+
+// =============================================================================
+CPlayer* CMap::GetFirstOccupant(CMapBlock* pBlock)
+{
+	xint iPlayer = m_liFirstOccupant[pBlock->m_iIndex];
+
+	return (iPlayer != -1) ? PlayerManager.GetPlayer(iPlayer) : NULL;
+}
+
+// =============================================================================
+CPlayer* CMap::GetNextOccupant(CPlayer* pPlayer)
+{
+	xint iPlayer = m_liNextOccupant[pPlayer->GetIndex()];
+
+	return (iPlayer != -1) ? PlayerManager.GetPlayer(iPlayer) : NULL;
+}
+
+// =============================================================================
+void CMap::SetEaten(xint iBlockIndex, xbool bEaten)
+{
+	CMapBlock* pBlock = GetBlock(iBlockIndex);
+
+	if (pBlock->m_bEaten != bEaten)
+	{
+		pBlock->m_bEaten = bEaten;
+
+		if (bEaten)
+		{
+			m_iPelletsEaten++;
+			m_lpEatenBitmap[iBlockIndex >> 5] |= (1u << (iBlockIndex & 31));
+		}
+		else
+		{
+			m_iPelletsEaten--;
+			m_lpEatenBitmap[iBlockIndex >> 5] &= ~(1u << (iBlockIndex & 31));
+		}
+	}
 }
 
 //##############################################################################
@@ -434,17 +646,25 @@ xfloat CMapEvaluator::GetCost(CNavigationRequest* pRequest, CNavigationNode* pPa
 
 	xfloat fCost = (pCurrentBlock->IsGhostWall()) ? 3.0f : 1.0f;
 
-	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+	// Try not to go down the same route as other ghosts.
+	fCost += 10.0f * (xfloat)(CountGhosts(pParentBlock) + CountGhosts(pCurrentBlock));
+
+	return fCost;
+}
+
+// =============================================================================
+xint CMapEvaluator::CountGhosts(CMapBlock* pBlock)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+	xint iCount = 0;
+
+	for (CPlayer* pPlayer = pMap->GetFirstOccupant(pBlock); pPlayer; pPlayer = pMap->GetNextOccupant(pPlayer))
 	{
-		// Try not to go down the same route as other ghosts.
-		if ((*ppPlayer)->GetCurrentBlock() == pParentBlock || (*ppPlayer)->GetCurrentBlock() == pCurrentBlock)
-		{
-			if (*ppPlayer != m_pPlayer && (*ppPlayer)->GetType() == PlayerType_Ghost)
-				fCost += 10.0f;
-		}
+		if (pPlayer != m_pPlayer && pPlayer->GetType() == PlayerType_Ghost)
+			iCount++;
 	}
 
-	return fCost;
+	return iCount;
 }
 
 // =============================================================================
@@ -485,6 +705,8 @@ void CMapManager::OnDeinitialise()
 // =============================================================================
 void CMapManager::Update()
 {
+	PROFILE_SECTION(ProfileSection_Map);
+
 	if (m_pCurrentMap)
 		m_pCurrentMap->Update();
 }
@@ -68,6 +68,18 @@ enum t_AdjacentDirection
 typedef xarray<CMapBlock*> t_MapBlockList;
 typedef xarray<CMap*> t_MapList;
 
+// A packed bitmap with one bit per map block.
+typedef xarray<xuint32> t_BlockBitmap;
+
+// A list of block or player indices used to link players to the blocks they occupy.
+typedef xarray<xint> t_OccupancyList;
+
+// The spawn list of open blocks used once a player type's own spawn points are taken, kept after the spawn list of each player type.
+#define MAP_OPEN_SPAWNS PlayerType_Max
+
+// The number of spawn lists.
+#define MAP_SPAWN_LISTS (PlayerType_Max + 1)
+
 //##############################################################################
 class CMapBlock
 {
@@ -263,12 +275,39 @@ public:
 		return m_pNavMesh; 
 	}
 
-	// Get a random player spawn block.
+	// Get a random free spawn block for a player type, or any free open block if its spawn points are all taken.
 	CMapBlock* GetSpawnBlock(t_PlayerType iPlayerType);
 
 	// Get a block in the adjacent direction to the specified block. This will wrap around the map if on the edge.
 	CMapBlock* GetAdjacentBlock(t_AdjacentDirection iAdjacentDir, CMapBlock* pBlock);
 
+	// Get the distance in blocks between two blocks, allowing for the wrap at the edges.
+	xint GetDistance(CMapBlock* pBlockA, CMapBlock* pBlockB);
+
+	// Set the eaten status of a block directly, such as when applying state from the network.
+	void SetEaten(xint iBlockIndex, xbool bEaten);
+
+	// Get the packed bitmap of all eaten blocks.
+	inline const t_BlockBitmap& GetEatenBitmap()
+	{
+		return m_lpEatenBitmap;
+	}
+
+	// Record that a player has moved onto a block or off the map if the block is NULL.
+	void SetOccupiedBlock(CPlayer* pPlayer, CMapBlock* pBlock);
+
+	// Get the first player on a block or NULL if the block is empty.
+	CPlayer* GetFirstOccupant(CMapBlock* pBlock);
+
+	// Get the next player on the same block as the specified player or NULL if there are no more.
+	CPlayer* GetNextOccupant(CPlayer* pPlayer);
+
+	// Check if any player is on a block.
+	inline xbool IsOccupied(CMapBlock* pBlock)
+	{
+		return m_liFirstOccupant[pBlock->m_iIndex] != -1;
+	}
+
 protected:
 	// Load the map into memory so that it's playable.
 	void Load();
@@ -282,6 +321,12 @@ protected:
 	// Add the specified visibility to all valid paths from the specified block.
 	void AddVisiblePaths(CMapBlock* pStartingBlock, xfloat fVisibility);
 
+	// Add a block to a spawn list.
+	void AddSpawn(xint iList, CMapBlock* pBlock);
+
+	// Take a block out of the free part of its spawn lists when it becomes occupied or put it back when it empties.
+	void SetSpawnFree(CMapBlock* pBlock, xbool bFree);
+
 	// The map dataset.
 	CDataset* m_pDataset;
 
@@ -312,6 +357,21 @@ protected:
 	// The total number of pellets eaten.
 	xint m_iPelletsEaten;
 
+	// The eaten status of every block, kept in step with each block's eaten flag.
+	t_BlockBitmap m_lpEatenBitmap;
+
+	// The index of the first player on each block or -1 if the block is empty.
+	t_OccupancyList m_liFirstOccupant;
+
+	// The index of the next player on the same block as each player or -1 at the end of the list.
+	t_OccupancyList m_liNextOccupant;
+
+	// The index of the previous player on the same block as each player or -1 at the start of the list.
+	t_OccupancyList m_liPrevOccupant;
+
+	// The index of the block each player is on or -1 if they are off the map.
+	t_OccupancyList m_liOccupiedBlock;
+
 	// The tiles used for rendering the map.
 	CAnimatedSprite* m_pTiles[TileType_Max];
 
@@ -324,6 +384,15 @@ protected:
 	// The list of player spawn positions.
 	t_MapBlockList m_lpSpawnPoints[PlayerType_Max];	
 
+	// The free blocks in each spawn list, in no particular order.
+	t_MapBlockList m_lpFreeSpawns[MAP_SPAWN_LISTS];
+
+	// The position of each block in each free spawn list or -1 if it isn't there.
+	t_OccupancyList m_liFreeSpawnIndex[MAP_SPAWN_LISTS];
+
+	// The spawn lists each block belongs to as a bit per list.
+	xarray<xuint8> m_liSpawnLists;
+
 	// The current map offset in pixels.
 	xpoint m_xOffset;
 
@@ -351,6 +420,9 @@ protected:
 	// Get the heuristic between the current and goal node.
 	virtual xfloat GetHeuristic(CNavigationRequest* pRequest, CNavigationNode* pCurrentNode, CNavigationNode* pGoalNode);
 
+	// Count the ghosts other than the evaluated player on a block.
+	xint CountGhosts(CMapBlock* pBlock);
+
 	// The player for which the path is being generated.
 	CPlayer* m_pPlayer;
 };
@@ -362,9 +434,12 @@ public:
 	// Friends.
 	friend class CMap;
 
-	// Singleton instance.
+	// Singleton instance, or the instance belonging to the match bound to the calling thread.
 	static inline CMapManager& Get() 
 	{
+		if (CMatchContext* pContext = CMatchContext::GetCurrent())
+			return *pContext->m_pMapManager;
+
 		static CMapManager s_Instance;
 		return s_Instance;
 	}
@@ -400,6 +475,12 @@ public:
 		return m_pCurrentMap;
 	}
 
+	// Check if there is a current map.
+	inline xbool HasCurrentMap()
+	{
+		return m_pCurrentMap != NULL;
+	}
+
 	// Get the number of known maps.
 	inline xint GetMapCount()
 	{
@@ -524,7 +524,7 @@ xstring CMatchManager::GenerateSessionID()
 	for (xint iA = 0; iA < 4; ++iA)
 	{
 		for (xint iB = 0; iB < 8; ++iB)
-			sSessionID += s_pChars[rand() % s_iNumChars];
+			sSessionID += s_pChars[_RANDOM(RandomStream_Session).GetInt(s_iNumChars)];
 
 		if (iA != 3)
 			sSessionID += '-';
@@ -6,6 +6,9 @@
 // Local.
 #include <Navigation.h>
 
+// Other.
+#include <Profile.h>
+
 //##############################################################################
 
 // =============================================================================
@@ -77,6 +80,8 @@ void CNavigationOpenList::Remove(CNavigationSearchNode* pNode)
 // =============================================================================
 t_NavigationError CNavigationManager::FindPath(CNavigationRequest* pRequest, XOUT CNavigationPath& xPath)
 {
+	PROFILE_SECTION(ProfileSection_Navigation);
+
 	// Check the info is valid.
 	if (!pRequest)
 		return NavigationError_InvalidParam;
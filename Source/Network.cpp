@@ -6,12 +6,25 @@
 // Local.
 #include <Network.h>
 
+// Other.
+#include <Profile.h>
+#include <Trace.h>
+
+// System.
+#include <intrin.h>
+
 //##############################################################################
 
 // =============================================================================
 CNetworkManager::CNetworkManager()
 {
 	m_pInterface = NULL;
+	m_pSharedLock = NULL;
+	m_fpStreamMonitor = NULL;
+	m_bCoalescing = true;
+	m_iSendBudget = 0;
+	m_iConditionsSeed = 1;
+	m_iMatchID = 0;
 
 	Reset();
 }
@@ -30,7 +43,10 @@ void CNetworkManager::Reset()
 		m_bConnected = false;
 		m_bVerified = false;
 
-		m_iLastPeerID = 0;
+		memset(m_pPeersByID, 0, sizeof(m_pPeersByID));
+		memset(m_pPeersByAddress, 0, sizeof(m_pPeersByAddress));
+
+		m_liFreePeerIDs.clear();
 
 		m_pLocalPeer = NULL;
 		m_pHostPeer = NULL;
@@ -54,6 +70,22 @@ void CNetworkManager::Reset()
 
 		m_pVerificationInfo = NULL;
 		m_iVerificationInfoSize = 0;
+
+		m_iCoalescedMessages = 0;
+		m_iCoalescedPackets = 0;
+
+		m_iScheduleTime = 0;
+		m_iScheduleCount = 0;
+		m_iScheduledMessages = 0;
+		m_iSupersededMessages = 0;
+		m_iScheduleDelay = 0;
+		m_iScheduleDelayMax = 0;
+
+		m_iRelayedMessages = 0;
+		m_iRelayedSends = 0;
+		m_iRelayCounter = 0;
+
+		m_iConnectTime = 0;
 	}
 }
 
@@ -63,122 +95,56 @@ void CNetworkManager::OnInitialise()
 	Reset();
 }
 
+// =============================================================================
+void CNetworkManager::OnDeinitialise()
+{
+	for (xint iA = 0; iA < (xint)m_lpFreeStreams.size(); ++iA)
+		delete m_lpFreeStreams[iA];
+
+	m_lpFreeStreams.clear();
+}
+
 // =============================================================================
 void CNetworkManager::OnUpdate()
 {
 	if (m_bStopPending)
 		Stop();
 
-	if (m_pInterface)
+	if (m_pSharedLock)
 	{
-		while (Packet* pPacket = m_pInterface->Receive())
+		// Take the packets routed to this match in one go so the lock isn't held while they are processed.
+		t_NetworkPacketList lpPackets;
+
 		{
-			xchar cIdentifier = pPacket->data[0];
+			CNetworkLock xLock(m_pSharedLock);
+			lpPackets.swap(m_lpRoutedPackets);
+		}
 
-			xuchar* pData = &pPacket->data[1];
-			xint iDataSize = pPacket->length - 1;
+		while (lpPackets.size())
+		{
+			Packet* pPacket = lpPackets.front();
+			lpPackets.pop_front();
 
-			static const char* s_pNetworkID[] =
-			{
-				"ID_INTERNAL_PING",  
-				"ID_PING",
-				"ID_PING_OPEN_CONNECTIONS",
-				"ID_CONNECTED_PONG",
-				"ID_CONNECTION_REQUEST",
-				"ID_SECURED_CONNECTION_RESPONSE",
-				"ID_SECURED_CONNECTION_CONFIRMATION",
-				"ID_RPC_MAPPING",
-				"ID_DETECT_LOST_CONNECTIONS",
-				"ID_OPEN_CONNECTION_REQUEST",
-				"ID_OPEN_CONNECTION_REPLY",
-				"ID_RPC",
-				"ID_RPC_REPLY",
-				"ID_OUT_OF_BAND_INTERNAL",
-				"ID_CONNECTION_REQUEST_ACCEPTED",
-				"ID_CONNECTION_ATTEMPT_FAILED",
-				"ID_ALREADY_CONNECTED",
-				"ID_NEW_INCOMING_CONNECTION",
-				"ID_NO_FREE_INCOMING_CONNECTIONS",
-				"ID_DISCONNECTION_NOTIFICATION",
-				"ID_CONNECTION_LOST",
-				"ID_RSA_PUBLIC_KEY_MISMATCH",
-				"ID_CONNECTION_BANNED",
-				"ID_INVALID_PASSWORD",
-				"ID_MODIFIED_PACKET",
-				"ID_TIMESTAMP",
-				"ID_PONG",
-				"ID_ADVERTISE_SYSTEM",
-				"ID_REMOTE_DISCONNECTION_NOTIFICATION",
-				"ID_REMOTE_CONNECTION_LOST",
-				"ID_REMOTE_NEW_INCOMING_CONNECTION",
-				"ID_DOWNLOAD_PROGRESS",
-				"ID_FILE_LIST_TRANSFER_HEADER",
-				"ID_FILE_LIST_TRANSFER_FILE",
-				"ID_DDT_DOWNLOAD_REQUEST",
-				"ID_TRANSPORT_STRING",
-				"ID_REPLICA_MANAGER_CONSTRUCTION",
-				"ID_REPLICA_MANAGER_DESTRUCTION",
-				"ID_REPLICA_MANAGER_SCOPE_CHANGE",
-				"ID_REPLICA_MANAGER_SERIALIZE",
-				"ID_REPLICA_MANAGER_DOWNLOAD_STARTED",
-				"ID_REPLICA_MANAGER_DOWNLOAD_COMPLETE",
-				"ID_CONNECTION_GRAPH_REQUEST",
-				"ID_CONNECTION_GRAPH_REPLY",
-				"ID_CONNECTION_GRAPH_UPDATE",
-				"ID_CONNECTION_GRAPH_NEW_CONNECTION",
-				"ID_CONNECTION_GRAPH_CONNECTION_LOST",
-				"ID_CONNECTION_GRAPH_DISCONNECTION_NOTIFICATION",
-				"ID_ROUTE_AND_MULTICAST",
-				"ID_RAKVOICE_OPEN_CHANNEL_REQUEST",
-				"ID_RAKVOICE_OPEN_CHANNEL_REPLY",
-				"ID_RAKVOICE_CLOSE_CHANNEL",
-				"ID_RAKVOICE_DATA",
-				"ID_AUTOPATCHER_GET_CHANGELIST_SINCE_DATE",
-				"ID_AUTOPATCHER_CREATION_LIST",
-				"ID_AUTOPATCHER_DELETION_LIST",
-				"ID_AUTOPATCHER_GET_PATCH",
-				"ID_AUTOPATCHER_PATCH_LIST",
-				"ID_AUTOPATCHER_REPOSITORY_FATAL_ERROR",
-				"ID_AUTOPATCHER_FINISHED_INTERNAL",
-				"ID_AUTOPATCHER_FINISHED",
-				"ID_AUTOPATCHER_RESTART_APPLICATION",
-				"ID_NAT_PUNCHTHROUGH_REQUEST",
-				"ID_NAT_TARGET_NOT_CONNECTED",
-				"ID_NAT_TARGET_CONNECTION_LOST",
-				"ID_NAT_CONNECT_AT_TIME",
-				"ID_NAT_SEND_OFFLINE_MESSAGE_AT_TIME",
-				"ID_NAT_IN_PROGRESS",
-				"ID_DATABASE_QUERY_REQUEST",
-				"ID_DATABASE_UPDATE_ROW",
-				"ID_DATABASE_REMOVE_ROW",
-				"ID_DATABASE_QUERY_REPLY",
-				"ID_DATABASE_UNKNOWN_TABLE",
-				"ID_DATABASE_INCORRECT_PASSWORD",
-				"ID_READY_EVENT_SET",
-				"ID_READY_EVENT_UNSET",
-				"ID_READY_EVENT_ALL_SET",
-				"ID_READY_EVENT_QUERY",
-				"ID_LOBBY_GENERAL",
-				"ID_AUTO_RPC_CALL",
-				"ID_AUTO_RPC_REMOTE_INDEX",
-				"ID_AUTO_RPC_UNKNOWN_REMOTE_INDEX",
-				"ID_RPC_REMOTE_ERROR",
-				"ID_STREAM",
-				"ID_ROUTED_STREAM",
-				"ID_VERIFICATION_REQUEST",
-				"ID_VERIFICATION_SUCCEEDED",
-				"ID_PEER_JOINED",
-				"ID_PEER_LEAVING",
-			};
-
-			XLOG("[Network] Packet: %d (%s), %d", cIdentifier, s_pNetworkID[cIdentifier], iDataSize);
-
-			if (m_bHosting)
-				OnProcessHostNotification(cIdentifier, pPacket, pData, iDataSize);
-			else
-				OnProcessClientNotification(cIdentifier, pPacket, pData, iDataSize);
+			OnReceivePacket(pPacket);
+
+			if (m_bStopPending || !m_pInterface)
+				break;
+		}
 
-			m_pInterface->DeallocatePacket(pPacket);
+		// Packets left over when the match stops are freed here as the interface lives on.
+		if (lpPackets.size() && m_pInterface)
+		{
+			CNetworkLock xLock(m_pSharedLock);
+
+			XEN_LIST_FOREACH(t_NetworkPacketList, ppPacket, lpPackets)
+				m_pInterface->DeallocatePacket(*ppPacket);
+		}
+	}
+	else if (m_pInterface)
+	{
+		while (Packet* pPacket = m_pInterface->Receive())
+		{
+			OnReceivePacket(pPacket);
 
 			if (m_bStopPending)
 				return;
@@ -186,6 +152,31 @@ void CNetworkManager::OnUpdate()
 	}
 }
 
+// =============================================================================
+void CNetworkManager::OnReceivePacket(Packet* pPacket)
+{
+	xchar cIdentifier = pPacket->data[0];
+
+	xuchar* pData = &pPacket->data[1];
+	xint iDataSize = pPacket->length - 1;
+
+	// Trace the packet rather than logging it, which is cheap enough to leave on under load.
+	CNetworkPeer* pPeer = FindPeer(pPacket->systemAddress);
+	xint iStreamType = (pPacket->length > 1 && (cIdentifier == ID_STREAM || cIdentifier == ID_ROUTED_STREAM)) ? pPacket->data[1] : 0;
+
+	PacketTrace.Record((xuint8)cIdentifier, iStreamType, pPeer ? pPeer->m_iID : NETWORK_PEER_INVALID_ID, pPacket->length, 0);
+
+	if (m_bHosting)
+		OnProcessHostNotification(cIdentifier, pPacket, pData, iDataSize);
+	else
+		OnProcessClientNotification(cIdentifier, pPacket, pData, iDataSize);
+
+	CNetworkLock xLock(m_pSharedLock);
+
+	if (m_pInterface)
+		m_pInterface->DeallocatePacket(pPacket);
+}
+
 // =============================================================================
 void CNetworkManager::BindReceiveCallback(xuchar cType, t_fpStreamReceived fpCallback)
 {
@@ -203,107 +194,649 @@ void CNetworkManager::UnbindReceiveCallback(xuchar cType)
 
 // =============================================================================
 xbool CNetworkManager::Send(CNetworkPeer* pTo, xint iStreamType, BitStream* pStream, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel)
+{
+	CNetworkStream* pFinalStream = BeginSend(pTo, iStreamType, iPriority, iReliability, iChannel);
+
+	if (pStream)
+		pFinalStream->Write(pStream);
+
+	return SendStream(pFinalStream);
+}
+
+// =============================================================================
+xbool CNetworkManager::Broadcast(CNetworkPeer* pIgnore, xint iStreamType, BitStream* pStream, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel)
+{
+	CNetworkStream* pFinalStream = BeginBroadcast(pIgnore, iStreamType, iPriority, iReliability, iChannel);
+
+	if (pStream)
+		pFinalStream->Write(pStream);
+
+	return SendStream(pFinalStream);
+}
+
+// =============================================================================
+CNetworkStream* CNetworkManager::BeginSend(CNetworkPeer* pTo, xint iStreamType, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel)
 {
 	XMASSERT(iChannel >= 2 && iChannel <= 31, "Channel index out of bounds.");
 	XMASSERT(m_pLocalPeer && m_pLocalPeer->m_bVerified, "The local peer is invalid or not yet initialised.");
 
-	// Initialise tracking vars.
-	BitStream* pFinalStream = NULL;
-	xbool bSuccess = false;
+	CNetworkStream* pStream = AcquireStream(iPriority, iReliability, iChannel);
 
 	// If we are the host.
 	if (m_bHosting)
 	{
 		XMASSERT(pTo, "You must specify a recepient when sending a packet from the host.");
 
-		pFinalStream = CreateStream(iStreamType, m_pLocalPeer->m_iID, pStream);
-		bSuccess = m_pInterface->Send(pFinalStream, iPriority, iReliability, iChannel, pTo->m_xAddress, false);
+		pStream->m_xAddress = pTo->m_xAddress;
+		WriteHeader(pStream, iStreamType, m_pLocalPeer->m_iID);
 	}
 	// If we are the client.
 	else
 	{
 		XMASSERT(m_pHostPeer, "Cannot send from the client until the host peer is validated.");
 
+		pStream->m_xAddress = m_pHostPeer->m_xAddress;
+
 		if (!pTo || pTo == m_pHostPeer)
-			pFinalStream = CreateStream(iStreamType, m_pLocalPeer->m_iID, pStream);
+			WriteHeader(pStream, iStreamType, m_pLocalPeer->m_iID);
 		else
-			pFinalStream = CreateRoutedStream(iStreamType, m_pLocalPeer->m_iID, pTo->m_iID, iPriority, iReliability, iChannel, false, pStream);
-		
-		bSuccess = m_pInterface->Send(pFinalStream, iPriority, iReliability, iChannel, m_pHostPeer->m_xAddress, false);
+			WriteRoutedHeader(pStream, iStreamType, pTo->m_iID, iPriority, iReliability, iChannel, false);
 	}
 
-	// If a stream exists, free it now.
-	if (pFinalStream)
-		delete pFinalStream;
+	pStream->m_iHeaderBits = pStream->GetNumberOfBitsUsed();
 
-	return bSuccess;
+	return pStream;
 }
 
 // =============================================================================
-xbool CNetworkManager::Broadcast(CNetworkPeer* pIgnore, xint iStreamType, BitStream* pStream, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel)
+CNetworkStream* CNetworkManager::BeginBroadcast(CNetworkPeer* pIgnore, xint iStreamType, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel)
 {
 	XMASSERT(iChannel >= 2 && iChannel <= 31, "Channel index out of bounds.");
 	XMASSERT(m_pLocalPeer && m_pLocalPeer->m_bVerified, "The local peer is invalid or not yet initialised.");
 
-	// Initialise tracking vars.
-	BitStream* pFinalStream = NULL;
-	xbool bSuccess = false;
+	CNetworkStream* pStream = AcquireStream(iPriority, iReliability, iChannel);
 
 	// If we are the host.
 	if (m_bHosting)
 	{
-		pFinalStream = CreateStream(iStreamType, m_pLocalPeer->m_iID, pStream);
-		bSuccess = m_pInterface->Send(pFinalStream, iPriority, iReliability, iChannel, pIgnore ? pIgnore->m_xAddress : UNASSIGNED_SYSTEM_ADDRESS, true);
+		pStream->m_xAddress = pIgnore ? pIgnore->m_xAddress : UNASSIGNED_SYSTEM_ADDRESS;
+		pStream->m_bBroadcast = true;
+
+		WriteHeader(pStream, iStreamType, m_pLocalPeer->m_iID);
 	}
 	// If we are the client.
 	else
 	{
 		XMASSERT(m_pHostPeer, "Cannot send from the client until the host peer is validated.");
 
-		pFinalStream = CreateRoutedStream(iStreamType, m_pLocalPeer->m_iID, pIgnore ? pIgnore->m_iID : NETWORK_PEER_INVALID_ID, iPriority, iReliability, iChannel, true, pStream);
-		bSuccess = m_pInterface->Send(pFinalStream, iPriority, iReliability, iChannel, m_pHostPeer->m_xAddress, false);
+		pStream->m_xAddress = m_pHostPeer->m_xAddress;
+		WriteRoutedHeader(pStream, iStreamType, pIgnore ? pIgnore->m_iID : NETWORK_PEER_INVALID_ID, iPriority, iReliability, iChannel, true);
 	}
 
-	// If a stream exists, free it now.
-	if (pFinalStream)
-		delete pFinalStream;
+	pStream->m_iHeaderBits = pStream->GetNumberOfBitsUsed();
+
+	return pStream;
+}
+
+// =============================================================================
+xbool CNetworkManager::SendStream(CNetworkStream* pStream)
+{
+	// Messages queued earlier on the same channel must not be overtaken by one sent straight away.
+	if (pStream->m_iMessageOffset < 0 && m_lpQueuedStreams.size())
+		FlushQueue(pStream);
+
+	if (m_iSendBudget > 0)
+	{
+		if (pStream->m_bBroadcast)
+		{
+			ScheduleBroadcast(pStream);
+			return true;
+		}
+
+		if (CNetworkPeer* pPeer = FindPeer(pStream->m_xAddress))
+		{
+			Schedule(pPeer, pStream);
+			return true;
+		}
+	}
+
+	return TransmitStream(pStream);
+}
+
+// =============================================================================
+xbool CNetworkManager::TransmitStream(CNetworkStream* pStream)
+{
+	const xuchar* pData = &pStream->GetData()[pStream->m_iDataOffset];
+	xint iBytes = (xint)pStream->GetNumberOfBytesUsed() - pStream->m_iDataOffset;
+
+	CNetworkPeer* pPeer = FindPeer(pStream->m_xAddress);
+	PacketTrace.Record(pData[0], pData[1], pPeer ? pPeer->m_iID : NETWORK_PEER_INVALID_ID, iBytes, PacketTraceFlag_Outgoing | pStream->m_iTraceFlags | (pStream->m_bBroadcast ? PacketTraceFlag_Broadcast : 0));
+
+	xbool bSuccess = SendData((const xchar*)pData, iBytes, pStream->m_iPriority, pStream->m_iReliability, pStream->m_iChannel, pStream->m_xAddress, pStream->m_bBroadcast);
+
+	ReleaseStream(pStream);
 
 	return bSuccess;
 }
 
 // =============================================================================
-BitStream* CNetworkManager::CreateStream(xint iStreamType, xint iFrom, BitStream* pStream)
+xbool CNetworkManager::SendData(const xchar* pData, xint iBytes, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel, const SystemAddress& xAddress, xbool bBroadcast)
 {
-	BitStream* pFinalStream = new BitStream();
+	CNetworkLock xLock(m_pSharedLock);
 
-	pFinalStream->Write((xuint8)ID_STREAM);
-	pFinalStream->Write((xuint8)iStreamType);
-	pFinalStream->Write((xuint8)iFrom);
+	if (!m_pSharedLock || !bBroadcast)
+		return m_pInterface->Send(pData, iBytes, iPriority, iReliability, iChannel, xAddress, bBroadcast);
 
-	if (pStream)
-		pFinalStream->Write(pStream);
+	// The other matches on the interface must not see this match's broadcasts, so the address is the one to leave out as it is for RakNet.
+	xbool bSuccess = true;
 
-	return pFinalStream;
+	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, m_lpPeers)
+	{
+		CNetworkPeer* pPeer = *ppPeer;
+
+		if (pPeer->m_xAddress != UNASSIGNED_SYSTEM_ADDRESS && pPeer->m_xAddress != xAddress)
+			bSuccess = m_pInterface->Send(pData, iBytes, iPriority, iReliability, iChannel, pPeer->m_xAddress, false) && bSuccess;
+	}
+
+	return bSuccess;
 }
 
 // =============================================================================
-BitStream* CNetworkManager::CreateRoutedStream(xint iStreamType, xint iFrom, xint iTo, xint iPriority, xint iReliability, xint iChannel, xbool bBroadcast, BitStream* pStream)
+void CNetworkManager::Schedule(CNetworkPeer* pPeer, CNetworkStream* pStream)
 {
-	BitStream* pFinalStream = new BitStream();
+	pStream->m_iScheduledTime = _TIMEMS;
+	pStream->m_iScheduledOrder = m_iScheduleCount++;
+	m_iScheduledMessages++;
 
-	pFinalStream->Write((xuint8)ID_ROUTED_STREAM);
-	pFinalStream->Write((xuint8)iStreamType);
-	pFinalStream->Write((xuint8)iFrom);
-	pFinalStream->Write((xuint8)iTo);
-	pFinalStream->Write((xuint8)iPriority);
-	pFinalStream->Write((xuint8)iReliability);
-	pFinalStream->Write((xuint8)iChannel);
-	pFinalStream->Write((xuint8)bBroadcast);
+	// Ordered and sequenced messages wait with the rest of their channel, whatever their priority, or sending by priority would put them out of order.
+	xbool bOrdered = IsOrdered(pStream->m_iReliability);
+	t_NetworkStreamQueue& lpQueue = bOrdered ? pPeer->m_lpOrderedSchedule[pStream->m_iChannel] : pPeer->m_lpScheduled[pStream->m_iPriority];
 
-	if (pStream)
-		pFinalStream->Write(pStream);
+	// Unreliable data is state that a newer message of the same type makes worthless, so the newer message takes its place in the queue. On an ordered channel only the last message can be replaced, or the newer one would go ahead of messages sent before it.
+	t_NetworkStreamQueue::iterator ppScheduled = lpQueue.begin();
+
+	if (bOrdered && lpQueue.size())
+		ppScheduled = --lpQueue.end();
+
+	for (; ppScheduled != lpQueue.end(); ++ppScheduled)
+	{
+		CNetworkStream* pScheduled = *ppScheduled;
+
+		if (IsSuperseded(pScheduled, pStream))
+		{
+			pStream->m_iScheduledTime = pScheduled->m_iScheduledTime;
+			pStream->m_iScheduledOrder = pScheduled->m_iScheduledOrder;
+			*ppScheduled = pStream;
+
+			if (bOrdered)
+			{
+				pPeer->m_iOrderedPriorities[pStream->m_iChannel][pScheduled->m_iPriority]--;
+				pPeer->m_iOrderedPriorities[pStream->m_iChannel][pStream->m_iPriority]++;
+			}
+
+			ReleaseStream(pScheduled);
+			m_iSupersededMessages++;
+
+			return;
+		}
+	}
+
+	lpQueue.push_back(pStream);
+
+	if (bOrdered)
+	{
+		pPeer->m_iOrderedPriorities[pStream->m_iChannel][pStream->m_iPriority]++;
+		pPeer->m_iOrderedChannels |= (1u << pStream->m_iChannel);
+	}
+}
+
+// =============================================================================
+xbool CNetworkManager::IsSuperseded(CNetworkStream* pScheduled, CNetworkStream* pStream)
+{
+	if (pStream->m_iReliability != UNRELIABLE && pStream->m_iReliability != UNRELIABLE_SEQUENCED)
+		return false;
+
+	if (pScheduled->m_iReliability != pStream->m_iReliability || pScheduled->m_iChannel != pStream->m_iChannel)
+		return false;
+
+	const xuchar* pData = &pStream->GetData()[pStream->m_iDataOffset];
+	const xuchar* pScheduledData = &pScheduled->GetData()[pScheduled->m_iDataOffset];
+
+	return pData[0] == ID_STREAM && pScheduledData[0] == ID_STREAM && pScheduledData[1] == pData[1];
+}
+
+// =============================================================================
+void CNetworkManager::ScheduleBroadcast(CNetworkStream* pStream)
+{
+	const xuchar* pData = &pStream->GetData()[pStream->m_iDataOffset];
+	xint iBytes = (xint)pStream->GetNumberOfBytesUsed() - pStream->m_iDataOffset;
+
+	// Each peer has its own budget so each gets its own copy, going to every directly connected peer except the one ignored.
+	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, m_lpPeers)
+	{
+		CNetworkPeer* pPeer = *ppPeer;
+
+		if (pPeer->m_bLocal || pPeer->m_xAddress == UNASSIGNED_SYSTEM_ADDRESS || pPeer->m_xAddress == pStream->m_xAddress)
+			continue;
+
+		CNetworkStream* pCopy = AcquireStream(pStream->m_iPriority, pStream->m_iReliability, pStream->m_iChannel);
+
+		pCopy->Write((const xchar*)pData, iBytes);
+		pCopy->m_xAddress = pPeer->m_xAddress;
+		pCopy->m_iTraceFlags = PacketTraceFlag_Broadcast;
+
+		Schedule(pPeer, pCopy);
+	}
+
+	ReleaseStream(pStream);
+}
+
+// =============================================================================
+void CNetworkManager::RelayTo(CNetworkPeer* pPeer, const xuchar* pData, xint iSize, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel)
+{
+	m_iRelayedSends++;
+
+	// Relayed messages count against the budget to the peer just as the host's own do.
+	if (m_iSendBudget > 0)
+	{
+		CNetworkStream* pStream = AcquireStream(iPriority, iReliability, iChannel);
+
+		pStream->Write((const xchar*)pData, iSize);
+		pStream->m_xAddress = pPeer->m_xAddress;
+		pStream->m_iTraceFlags = PacketTraceFlag_Relayed;
+
+		Schedule(pPeer, pStream);
+	}
+	else
+	{
+		PacketTrace.Record(pData[0], pData[1], pPeer->m_iID, iSize, PacketTraceFlag_Outgoing | PacketTraceFlag_Relayed);
+		SendData((const xchar*)pData, iSize, iPriority, iReliability, iChannel, pPeer->m_xAddress, false);
+	}
+}
+
+// =============================================================================
+void CNetworkManager::UpdateSchedule()
+{
+	xuint iTime = _TIMEMS;
+	xint iElapsed = m_iScheduleTime ? Math::Clamp<xint>((xint)(iTime - m_iScheduleTime), 0, 1000) : 0;
+
+	m_iScheduleTime = iTime;
+
+	// The budget is counted in thousandths of a byte per millisecond, which is bytes per second.
+	xint64 iBurst = (xint64)m_iSendBudget * NETWORK_SEND_BURST_TIME;
+
+	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, m_lpPeers)
+	{
+		CNetworkPeer* pPeer = *ppPeer;
+
+		if (pPeer->m_bLocal)
+			continue;
+
+		pPeer->m_iSendTokens = Math::Min<xint64>(pPeer->m_iSendTokens + (xint64)m_iSendBudget * iElapsed, iBurst);
+
+		// Send the most urgent message while there is any budget left, letting the last message take it into debt rather than holding a large message back forever.
+		while (pPeer->m_iSendTokens > 0)
+		{
+			t_NetworkStreamQueue* plpQueue = GetNextScheduled(pPeer);
+
+			if (!plpQueue)
+				break;
+
+			CNetworkStream* pStream = plpQueue->front();
+			plpQueue->pop_front();
+
+			if (IsOrdered(pStream->m_iReliability))
+			{
+				pPeer->m_iOrderedPriorities[pStream->m_iChannel][pStream->m_iPriority]--;
+
+				if (plpQueue->empty())
+					pPeer->m_iOrderedChannels &= ~(1u << pStream->m_iChannel);
+			}
+
+			xint iDelay = (xint)(iTime - pStream->m_iScheduledTime);
+
+			m_iScheduleDelay += iDelay;
+			m_iScheduleDelayMax = Math::Max(m_iScheduleDelayMax, iDelay);
+
+			pPeer->m_iSendTokens -= ((xint64)pStream->GetNumberOfBytesUsed() - pStream->m_iDataOffset + NETWORK_MESSAGE_OVERHEAD) * 1000;
+
+			TransmitStream(pStream);
+		}
+	}
+}
+
+// =============================================================================
+t_NetworkStreamQueue* CNetworkManager::GetNextScheduled(CNetworkPeer* pPeer)
+{
+	t_NetworkStreamQueue* plpNext = NULL;
+	xint iNextPriority = NUMBER_OF_PRIORITIES;
+
+	for (xint iA = 0; iA < NUMBER_OF_PRIORITIES; ++iA)
+	{
+		if (pPeer->m_lpScheduled[iA].size())
+		{
+			plpNext = &pPeer->m_lpScheduled[iA];
+			iNextPriority = iA;
+
+			break;
+		}
+	}
+
+	// An ordered channel goes at the priority of its most urgent message so that message isn't held up by the less urgent ones it has to follow. Messages of the same priority go in the order they were sent.
+	// Only the channels with messages waiting are visited and each one's priority comes from its counts, so the cost doesn't grow with the queues.
+	for (xuint32 iChannels = pPeer->m_iOrderedChannels; iChannels; iChannels &= iChannels - 1)
+	{
+		unsigned long iA;
+		_BitScanForward(&iA, iChannels);
+
+		t_NetworkStreamQueue& lpQueue = pPeer->m_lpOrderedSchedule[iA];
+		xint iPriority = 0;
+
+		while (iPriority < NUMBER_OF_PRIORITIES - 1 && !pPeer->m_iOrderedPriorities[iA][iPriority])
+			iPriority++;
+
+		if (iPriority < iNextPriority || (iPriority == iNextPriority && (xint)(lpQueue.front()->m_iScheduledOrder - plpNext->front()->m_iScheduledOrder) < 0))
+		{
+			plpNext = &lpQueue;
+			iNextPriority = iPriority;
+		}
+	}
+
+	return plpNext;
+}
+
+// =============================================================================
+void CNetworkManager::ClearSchedule(CNetworkPeer* pPeer)
+{
+	for (xint iA = 0; iA < NUMBER_OF_PRIORITIES; ++iA)
+	{
+		XEN_LIST_FOREACH(t_NetworkStreamQueue, ppStream, pPeer->m_lpScheduled[iA])
+			ReleaseStream(*ppStream);
+
+		pPeer->m_lpScheduled[iA].clear();
+	}
+
+	for (xint iA = 0; iA < NETWORK_CHANNELS; ++iA)
+	{
+		XEN_LIST_FOREACH(t_NetworkStreamQueue, ppStream, pPeer->m_lpOrderedSchedule[iA])
+			ReleaseStream(*ppStream);
+
+		pPeer->m_lpOrderedSchedule[iA].clear();
+	}
+
+	memset(pPeer->m_iOrderedPriorities, 0, sizeof(pPeer->m_iOrderedPriorities));
+	pPeer->m_iOrderedChannels = 0;
+}
+
+// =============================================================================
+CNetworkStream* CNetworkManager::BeginQueue(CNetworkPeer* pTo, xint iStreamType, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel)
+{
+	// Messages to other clients have to be routed through the host so they go on their own.
+	if (!m_bCoalescing || (!m_bHosting && pTo && pTo != m_pHostPeer))
+		return BeginSend(pTo, iStreamType, iPriority, iReliability, iChannel);
+
+	XMASSERT(iChannel >= 2 && iChannel <= 31, "Channel index out of bounds.");
+	XMASSERT(m_pLocalPeer && m_pLocalPeer->m_bVerified, "The local peer is invalid or not yet initialised.");
+	XMASSERT(!m_bHosting || pTo, "You must specify a recepient when sending a packet from the host.");
+	XMASSERT(m_bHosting || m_pHostPeer, "Cannot send from the client until the host peer is validated.");
+
+	const SystemAddress& xAddress = m_bHosting ? pTo->m_xAddress : m_pHostPeer->m_xAddress;
+
+	// Find the batch already open for this peer and send settings.
+	CNetworkStream* pStream = NULL;
+
+	for (xint iA = 0; iA < (xint)m_lpQueuedStreams.size(); ++iA)
+	{
+		CNetworkStream* pQueuedStream = m_lpQueuedStreams[iA];
+
+		if (pQueuedStream->m_xAddress == xAddress && pQueuedStream->m_iPriority == iPriority && pQueuedStream->m_iReliability == iReliability && pQueuedStream->m_iChannel == iChannel)
+		{
+			pStream = pQueuedStream;
+			break;
+		}
+	}
+
+	if (!pStream)
+	{
+		pStream = AcquireStream(iPriority, iReliability, iChannel);
+		pStream->m_xAddress = xAddress;
+
+		pStream->Write((xuint8)ID_BATCHED_STREAM);
+		pStream->Write((xuint8)m_pLocalPeer->m_iID);
+
+		pStream->m_iHeaderBits = pStream->GetNumberOfBitsUsed();
+
+		m_lpQueuedStreams.push_back(pStream);
+	}
+
+	// Each message is its stream type and length in bytes, filled in once the message is finished.
+	pStream->Write((xuint8)iStreamType);
+	pStream->m_iMessageOffset = (xint)pStream->GetNumberOfBytesUsed();
+	pStream->Write((xuint8)0);
+	pStream->Write((xuint8)0);
+	pStream->m_iMessageCount++;
+
+	return pStream;
+}
+
+// =============================================================================
+void CNetworkManager::EndQueue(CNetworkStream* pStream)
+{
+	if (pStream->m_iMessageOffset < 0)
+	{
+		SendStream(pStream);
+		return;
+	}
+
+	// Messages start on a byte boundary so that they can be read where they lie.
+	pStream->AlignWriteToByteBoundary();
+
+	xint iBytes = (xint)pStream->GetNumberOfBytesUsed() - pStream->m_iMessageOffset - 2;
+	XMASSERT(iBytes <= 0xFFFF, "A queued message cannot exceed 65535 bytes.");
+
+	xuchar* pData = pStream->GetData();
+
+	pData[pStream->m_iMessageOffset] = (xuchar)(iBytes & 0xFF);
+	pData[pStream->m_iMessageOffset + 1] = (xuchar)(iBytes >> 8);
+
+	m_iCoalescedMessages++;
+}
+
+// =============================================================================
+void CNetworkManager::Flush()
+{
+	for (xint iA = 0; iA < (xint)m_lpQueuedStreams.size(); ++iA)
+		SendBatch(m_lpQueuedStreams[iA]);
+
+	m_lpQueuedStreams.clear();
+
+	if (m_iSendBudget > 0)
+		UpdateSchedule();
+}
+
+// =============================================================================
+void CNetworkManager::FlushQueue(CNetworkStream* pStream)
+{
+	xint iKept = 0;
+
+	for (xint iA = 0; iA < (xint)m_lpQueuedStreams.size(); ++iA)
+	{
+		CNetworkStream* pQueuedStream = m_lpQueuedStreams[iA];
+
+		if (pQueuedStream->m_iChannel == pStream->m_iChannel && (pStream->m_bBroadcast || pQueuedStream->m_xAddress == pStream->m_xAddress))
+			SendBatch(pQueuedStream);
+		else
+			m_lpQueuedStreams[iKept++] = pQueuedStream;
+	}
+
+	m_lpQueuedStreams.resize(iKept);
+}
+
+// =============================================================================
+void CNetworkManager::SendBatch(CNetworkStream* pStream)
+{
+	// A lone message goes as a standard data packet, with the standard header written over the end of the batch header.
+	if (pStream->m_iMessageCount == 1)
+	{
+		xuchar* pData = pStream->GetData();
+
+		xuint8 iFrom = pData[1];
+		xuint8 iStreamType = pData[2];
+
+		pData[2] = ID_STREAM;
+		pData[3] = iStreamType;
+		pData[4] = iFrom;
+
+		pStream->m_iDataOffset = 2;
+	}
+
+	SendStream(pStream);
+
+	m_iCoalescedPackets++;
+}
+
+// =============================================================================
+void CNetworkManager::ClearQueue()
+{
+	for (xint iA = 0; iA < (xint)m_lpQueuedStreams.size(); ++iA)
+		ReleaseStream(m_lpQueuedStreams[iA]);
+
+	m_lpQueuedStreams.clear();
+}
+
+// =============================================================================
+CNetworkStream* CNetworkManager::AcquireStream(PacketPriority iPriority, PacketReliability iReliability, xchar iChannel)
+{
+	CNetworkStream* pStream = NULL;
+
+	if (m_lpFreeStreams.size())
+	{
+		pStream = m_lpFreeStreams.back();
+		m_lpFreeStreams.pop_back();
+	}
+	else
+		pStream = new CNetworkStream();
+
+	pStream->Reset();
+
+	pStream->m_xAddress = UNASSIGNED_SYSTEM_ADDRESS;
+	pStream->m_bBroadcast = false;
+	pStream->m_iPriority = iPriority;
+	pStream->m_iReliability = iReliability;
+	pStream->m_iChannel = iChannel;
+	pStream->m_iHeaderBits = 0;
+	pStream->m_iMessageOffset = -1;
+	pStream->m_iMessageCount = 0;
+	pStream->m_iDataOffset = 0;
+	pStream->m_iScheduledTime = 0;
+	pStream->m_iScheduledOrder = 0;
+	pStream->m_iTraceFlags = 0;
+
+	return pStream;
+}
+
+// =============================================================================
+void CNetworkManager::ReleaseStream(CNetworkStream* pStream)
+{
+	m_lpFreeStreams.push_back(pStream);
+}
+
+// =============================================================================
+void CNetworkManager::WriteHeader(BitStream* pStream, xint iStreamType, xint iFrom)
+{
+	pStream->Write((xuint8)ID_STREAM);
+	pStream->Write((xuint8)iStreamType);
+	pStream->Write((xuint8)iFrom);
+}
+
+// =============================================================================
+void CNetworkManager::WriteRoutedHeader(BitStream* pStream, xint iStreamType, xint iTo, xint iPriority, xint iReliability, xint iChannel, xbool bBroadcast)
+{
+	// The sender is known to the host from the packet address, so only the routing is written.
+	// The priority, reliability and broadcast flag are packed into one byte to keep the payload byte-aligned.
+	pStream->Write((xuint8)ID_ROUTED_STREAM);
+	pStream->Write((xuint8)iStreamType);
+	pStream->Write((xuint8)iTo);
+	pStream->Write((xuint8)((iPriority & 0x3) | ((iReliability & 0x7) << 2) | (bBroadcast ? 0x20 : 0)));
+	pStream->Write((xuint8)iChannel);
+}
+
+// =============================================================================
+void CNetworkManager::SetConditions(const NetworkConditions& xConditions, CNetworkPeer* pPeer)
+{
+	if (!pPeer)
+	{
+		m_xConditions = xConditions;
+
+		// The conditions on a shared interface belong to whoever started it.
+		if (m_pInterface && !m_pSharedLock)
+			m_pInterface->GetNetworkConditioner()->SetConditions(m_xConditions, UNASSIGNED_SYSTEM_ADDRESS);
+	}
+	else if (m_pInterface)
+	{
+		CNetworkLock xLock(m_pSharedLock);
+
+		// Only the links RakNet holds directly can be conditioned, so peers reached through the host are conditioned on the link to the host.
+		XMASSERT(pPeer->m_xAddress != UNASSIGNED_SYSTEM_ADDRESS, "Network conditions can only be set on a directly connected peer.");
+
+		if (pPeer->m_xAddress != UNASSIGNED_SYSTEM_ADDRESS)
+			m_pInterface->GetNetworkConditioner()->SetConditions(xConditions, pPeer->m_xAddress);
+	}
+}
+
+// =============================================================================
+void CNetworkManager::SetConditionsSeed(xuint iSeed)
+{
+	m_iConditionsSeed = iSeed;
+
+	if (m_pInterface && !m_pSharedLock)
+		m_pInterface->GetNetworkConditioner()->SetSeed(m_iConditionsSeed);
+}
+
+// =============================================================================
+xbool CNetworkManager::LoadConditions(const xchar* pName)
+{
+	CMetadata* pMetadata = _METADATA("Network");
+	CDataset* pDataset = pMetadata->GetDataset("Conditions", pName);
+
+	if (pDataset)
+	{
+		NetworkConditions xConditions;
+
+		if (XEN_METADATA_PROPERTY_EXISTS(pDataset, "Latency"))
+			xConditions.latency = (unsigned short)Math::Clamp<xint>(XEN_METADATA_PROPERTY->GetInt(), 0, USHRT_MAX);
+
+		if (XEN_METADATA_PROPERTY_EXISTS(pDataset, "Jitter"))
+			xConditions.jitter = (unsigned short)Math::Clamp<xint>(XEN_METADATA_PROPERTY->GetInt(), 0, USHRT_MAX);
+
+		if (XEN_METADATA_PROPERTY_EXISTS(pDataset, "Loss"))
+			xConditions.lossChance = XEN_METADATA_PROPERTY->GetFloat();
 
-	return pFinalStream;
+		if (XEN_METADATA_PROPERTY_EXISTS(pDataset, "Duplicate"))
+			xConditions.duplicateChance = XEN_METADATA_PROPERTY->GetFloat();
+
+		if (XEN_METADATA_PROPERTY_EXISTS(pDataset, "Reorder"))
+		{
+			xConditions.reorderChance = XEN_METADATA_PROPERTY->GetFloat(0);
+			xConditions.reorderDelay = (unsigned short)Math::Clamp<xint>(XEN_METADATA_PROPERTY->GetInt(1), 0, USHRT_MAX);
+		}
+
+		if (XEN_METADATA_PROPERTY_EXISTS(pDataset, "Bandwidth"))
+			xConditions.bytesPerSecond = (unsigned int)Math::Max<xint>(XEN_METADATA_PROPERTY->GetInt(), 0);
+
+		if (XEN_METADATA_PROPERTY_EXISTS(pDataset, "Seed"))
+			SetConditionsSeed((xuint)XEN_METADATA_PROPERTY->GetInt());
+
+		SetConditions(xConditions);
+
+		XLOG("[Network] Simulating '%s' network conditions.", pName);
+	}
+	else
+		XLOG("[Network] There are no network conditions named '%s'.", pName);
+
+	delete pMetadata;
+
+	return pDataset != NULL;
 }
 
 // =============================================================================
@@ -324,33 +857,64 @@ void CNetworkManager::StartHost(xint iMaxPeers, xint iPort, void* pData, xint iD
 		m_xSocket.hostAddress[0] = NULL;
 		m_xSocket.port = iPort;
 
-		m_pInterface->Startup(iMaxPeers, 0, &m_xSocket, 1);
+		m_pInterface->Startup(iMaxPeers, NETWORK_THREAD_WAIT_TIME, &m_xSocket, 1);
+		m_pInterface->GetNetworkConditioner()->SetSeed(m_iConditionsSeed);
+		m_pInterface->GetNetworkConditioner()->SetConditions(m_xConditions, UNASSIGNED_SYSTEM_ADDRESS);
 		m_pInterface->SetMaximumIncomingConnections(iMaxPeers);
 		m_pInterface->SetTimeoutTime(NETWORK_PEER_TIMEOUT, UNASSIGNED_SYSTEM_ADDRESS);
 		m_pInterface->SetOccasionalPing(true);
 
-		m_pHostPeer = CreatePeer();
-		m_pLocalPeer = m_pHostPeer;
+		StartHosting();
+	}
+}
 
-		m_pLocalPeer->m_bHost = true;
-		m_pLocalPeer->m_bLocal = true;
-		m_pLocalPeer->m_iID = 0;
-		m_pLocalPeer->m_bVerified = true;
+// =============================================================================
+void CNetworkManager::StartSharedHost(RakPeerInterface* pInterface, CRITICAL_SECTION* pLock)
+{
+	XASSERT(!m_pInterface);
+	XASSERT(pInterface && pLock);
 
-		if (m_iGamerCardSize)
-		{
-			m_pLocalPeer->m_pGamerCard = new xchar[m_iGamerCardSize];				
-			memcpy_s(m_pLocalPeer->m_pGamerCard, m_iGamerCardSize, m_pGamerCard, m_iGamerCardSize);
-		}
+	if (!m_pInterface)
+	{
+		XLOG("[Network] Starting network as the host of match %d on a shared interface.", m_iMatchID);
 
-		m_lpVerifiedPeers.push_back(m_pLocalPeer);
+		m_bHosting = true;
+		m_bVerified = true;
 
-		if (m_xCallbacks.m_fpNetworkStarted)
-			m_xCallbacks.m_fpNetworkStarted();
+		m_pInterface = pInterface;
+		m_pSharedLock = pLock;
+
+		StartHosting();
+	}
+}
+
+// =============================================================================
+void CNetworkManager::StartHosting()
+{
+	// The host takes the first ID and the rest are handed out to clients as they connect.
+	for (xint iA = 1; iA < NETWORK_PEER_INVALID_ID; ++iA)
+		m_liFreePeerIDs.push_back(iA);
+
+	m_pHostPeer = CreatePeer(0, UNASSIGNED_SYSTEM_ADDRESS);
+	m_pLocalPeer = m_pHostPeer;
 
-		if (m_xCallbacks.m_fpPeerJoined)
-			m_xCallbacks.m_fpPeerJoined(m_pLocalPeer);
+	m_pLocalPeer->m_bHost = true;
+	m_pLocalPeer->m_bLocal = true;
+	m_pLocalPeer->m_bVerified = true;
+
+	if (m_iGamerCardSize)
+	{
+		m_pLocalPeer->m_pGamerCard = new xchar[m_iGamerCardSize];				
+		memcpy_s(m_pLocalPeer->m_pGamerCard, m_iGamerCardSize, m_pGamerCard, m_iGamerCardSize);
 	}
+
+	m_lpVerifiedPeers.push_back(m_pLocalPeer);
+
+	if (m_xCallbacks.m_fpNetworkStarted)
+		m_xCallbacks.m_fpNetworkStarted();
+
+	if (m_xCallbacks.m_fpPeerJoined)
+		m_xCallbacks.m_fpPeerJoined(m_pLocalPeer);
 }
 
 // =============================================================================
@@ -369,7 +933,9 @@ void CNetworkManager::StartClient(const xchar* pHostAddress, xint iHostPort, voi
 		m_xSocket.hostAddress[0] = NULL;
 		m_xSocket.port = 0;
 
-		m_pInterface->Startup(1, 0, &m_xSocket, 1);
+		m_pInterface->Startup(1, NETWORK_THREAD_WAIT_TIME, &m_xSocket, 1);
+		m_pInterface->GetNetworkConditioner()->SetSeed(m_iConditionsSeed);
+		m_pInterface->GetNetworkConditioner()->SetConditions(m_xConditions, UNASSIGNED_SYSTEM_ADDRESS);
 		m_pInterface->Connect(pHostAddress, iHostPort, NULL, 0, 0);
 		m_pInterface->SetTimeoutTime(NETWORK_PEER_TIMEOUT, UNASSIGNED_SYSTEM_ADDRESS);
 
@@ -390,15 +956,30 @@ void CNetworkManager::Stop()
 	{
 		XLOG("[Network] Stopping network.");
 
+		ClearQueue();
 		DestroyPeers();
 
-		m_pInterface->Shutdown(500);
+		// A shared interface carries on for the other matches and only gives back the packets routed here.
+		if (m_pSharedLock)
+		{
+			CNetworkLock xLock(m_pSharedLock);
+
+			XEN_LIST_FOREACH(t_NetworkPacketList, ppPacket, m_lpRoutedPackets)
+				m_pInterface->DeallocatePacket(*ppPacket);
+
+			m_lpRoutedPackets.clear();
+		}
+		else
+			m_pInterface->Shutdown(500);
 
 		if (m_xCallbacks.m_fpNetworkStopped)
 			m_xCallbacks.m_fpNetworkStopped();
 
-		RakNetworkFactory::DestroyRakPeerInterface(m_pInterface);
+		if (!m_pSharedLock)
+			RakNetworkFactory::DestroyRakPeerInterface(m_pInterface);
+
 		m_pInterface = NULL;
+		m_pSharedLock = NULL;
 
 		Reset();
 	}
@@ -407,6 +988,8 @@ void CNetworkManager::Stop()
 // =============================================================================
 void CNetworkManager::Kick(SystemAddress& xAddress)
 {
+	CNetworkLock xLock(m_pSharedLock);
+
 	if (m_pInterface)
 		m_pInterface->CloseConnection(xAddress, true);
 }
@@ -420,32 +1003,63 @@ xint CNetworkManager::GetLastPing()
 		return m_pInterface->GetLastPing(m_pHostPeer->m_xAddress);
 }
 
+// =============================================================================
+xint CNetworkManager::GetLastPing(CNetworkPeer* pPeer)
+{
+	if (!m_pInterface || !pPeer || pPeer->m_xAddress == UNASSIGNED_SYSTEM_ADDRESS)
+		return -1;
+
+	CNetworkLock xLock(m_pSharedLock);
+
+	return m_pInterface->GetLastPing(pPeer->m_xAddress);
+}
+
+// =============================================================================
+xdouble CNetworkManager::GetRelayTime()
+{
+	return CProfileManager::GetMilliseconds(m_iRelayCounter);
+}
+
 // =============================================================================
 xint CNetworkManager::GetUniquePeerID()
 {
-	while (FindPeer(m_iLastPeerID) != NULL) 
-	{
-		m_iLastPeerID++;
-		m_iLastPeerID %= NETWORK_PEER_INVALID_ID - 1;
-	} 
+	// The caller kicks the connection when the IDs run out.
+	if (m_liFreePeerIDs.empty())
+		return NETWORK_PEER_INVALID_ID;
 
-	return m_iLastPeerID;
+	xint iID = m_liFreePeerIDs.front();
+	m_liFreePeerIDs.pop_front();
+
+	return iID;
 }
 
 // =============================================================================
-CNetworkPeer* CNetworkManager::CreatePeer()
+CNetworkPeer* CNetworkManager::CreatePeer(xint iID, const SystemAddress& xAddress)
 {
 	CNetworkPeer* pPeer = new CNetworkPeer();
 
 	pPeer->m_bHost = false;
 	pPeer->m_bLocal = false;
-	pPeer->m_iID = (m_bHosting) ? GetUniquePeerID() : NETWORK_PEER_INVALID_ID;
-	pPeer->m_xAddress = UNASSIGNED_SYSTEM_ADDRESS;
+	pPeer->m_iID = iID;
+	pPeer->m_xAddress = xAddress;
 	pPeer->m_bVerified = false;
 	pPeer->m_pGamerCard = NULL;
+	pPeer->m_iSendTokens = (xint64)m_iSendBudget * NETWORK_SEND_BURST_TIME;
+	pPeer->m_iOrderedChannels = 0;
+
+	memset(pPeer->m_iOrderedPriorities, 0, sizeof(pPeer->m_iOrderedPriorities));
 
 	m_lpPeers.push_back(pPeer);
 
+	if (iID >= 0 && iID < NETWORK_PEER_INVALID_ID)
+	{
+		XMASSERT(!m_pPeersByID[iID], "A peer with this ID already exists.");
+		m_pPeersByID[iID] = pPeer;
+	}
+
+	if (xAddress != UNASSIGNED_SYSTEM_ADDRESS)
+		AddPeerAddress(pPeer);
+
 	XLOG("[Network] Created a new peer.");
 
 	return pPeer;
@@ -459,16 +1073,37 @@ void CNetworkManager::DestroyPeer(CNetworkPeer* pPeer)
 		XLOG("[Network] Destroying peer %d.", pPeer->m_iID);
 
 		if (pPeer->m_xAddress != UNASSIGNED_SYSTEM_ADDRESS)
+		{
 			Kick(pPeer->m_xAddress);
 
+			// Any conditions on the link end with it.
+			CNetworkLock xLock(m_pSharedLock);
+
+			if (m_pInterface)
+				m_pInterface->GetNetworkConditioner()->SetConditions(NetworkConditions(), pPeer->m_xAddress);
+		}
+
 		if (pPeer->m_pGamerCard)
 		{
 			delete pPeer->m_pGamerCard;
 			pPeer->m_pGamerCard = NULL;
 		}
 
+		ClearSchedule(pPeer);
+
 		XEN_LIST_REMOVE(t_NetworkPeerList, m_lpPeers, pPeer);
 		XEN_LIST_REMOVE(t_NetworkPeerList, m_lpVerifiedPeers, pPeer);
+
+		if (pPeer->m_iID >= 0 && pPeer->m_iID < NETWORK_PEER_INVALID_ID && m_pPeersByID[pPeer->m_iID] == pPeer)
+		{
+			m_pPeersByID[pPeer->m_iID] = NULL;
+
+			if (m_bHosting && !pPeer->m_bLocal)
+				m_liFreePeerIDs.push_back(pPeer->m_iID);
+		}
+
+		if (pPeer->m_xAddress != UNASSIGNED_SYSTEM_ADDRESS)
+			RemovePeerAddress(pPeer);
 	
 		delete pPeer;
 	}
@@ -495,27 +1130,55 @@ xbool CNetworkManager::OnComparePeers(const CNetworkPeer* pA, const CNetworkPeer
 }
 
 // =============================================================================
-CNetworkPeer* CNetworkManager::FindPeer(SystemAddress& xAddress)
+CNetworkPeer* CNetworkManager::FindPeer(const SystemAddress& xAddress)
 {
-	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, m_lpPeers)
+	for (xint iSlot = GetAddressSlot(xAddress); m_pPeersByAddress[iSlot]; iSlot = (iSlot + 1) & (NETWORK_ADDRESS_TABLE_SIZE - 1))
 	{
-		if ((*ppPeer)->m_xAddress == xAddress)
-			return *ppPeer;
+		if (m_pPeersByAddress[iSlot]->m_xAddress == xAddress)
+			return m_pPeersByAddress[iSlot];
 	}
 
 	return NULL;
 }
 
 // =============================================================================
-CNetworkPeer* CNetworkManager::FindPeer(xint iPeerID)
+void CNetworkManager::AddPeerAddress(CNetworkPeer* pPeer)
 {
-	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, m_lpPeers)
+	xint iSlot = GetAddressSlot(pPeer->m_xAddress);
+
+	while (m_pPeersByAddress[iSlot])
+		iSlot = (iSlot + 1) & (NETWORK_ADDRESS_TABLE_SIZE - 1);
+
+	m_pPeersByAddress[iSlot] = pPeer;
+}
+
+// =============================================================================
+void CNetworkManager::RemovePeerAddress(CNetworkPeer* pPeer)
+{
+	xint iSlot = GetAddressSlot(pPeer->m_xAddress);
+
+	while (m_pPeersByAddress[iSlot] && m_pPeersByAddress[iSlot] != pPeer)
+		iSlot = (iSlot + 1) & (NETWORK_ADDRESS_TABLE_SIZE - 1);
+
+	if (!m_pPeersByAddress[iSlot])
+		return;
+
+	m_pPeersByAddress[iSlot] = NULL;
+
+	// Any entry further along that could have been placed in the gap is moved back so that searches don't stop short of it.
+	for (xint iNext = (iSlot + 1) & (NETWORK_ADDRESS_TABLE_SIZE - 1); m_pPeersByAddress[iNext]; iNext = (iNext + 1) & (NETWORK_ADDRESS_TABLE_SIZE - 1))
 	{
-		if ((*ppPeer)->m_iID == iPeerID)
-			return *ppPeer;
-	}
+		xint iHome = GetAddressSlot(m_pPeersByAddress[iNext]->m_xAddress);
 
-	return NULL;
+		// The distance from its home slot must reach back past the gap for the entry to move.
+		if (((iNext - iHome) & (NETWORK_ADDRESS_TABLE_SIZE - 1)) >= ((iNext - iSlot) & (NETWORK_ADDRESS_TABLE_SIZE - 1)))
+		{
+			m_pPeersByAddress[iSlot] = m_pPeersByAddress[iNext];
+			m_pPeersByAddress[iNext] = NULL;
+
+			iSlot = iNext;
+		}
+	}
 }
 
 // =============================================================================
@@ -528,8 +1191,12 @@ void CNetworkManager::OnProcessHostNotification(xchar cIdentifier, Packet* pPack
 	// A new client connection was established to this machine.
 	case ID_NEW_INCOMING_CONNECTION:
 		{
-			CNetworkPeer* pPeer = CreatePeer();
-			pPeer->m_xAddress = pPacket->systemAddress;
+			xint iID = GetUniquePeerID();
+
+			if (iID != NETWORK_PEER_INVALID_ID)
+				CreatePeer(iID, pPacket->systemAddress);
+			else
+				Kick(pPacket->systemAddress);
 		}
 		break;
 
@@ -541,10 +1208,12 @@ void CNetworkManager::OnProcessHostNotification(xchar cIdentifier, Packet* pPack
 
 			if (pPeer)
 			{
-				// Read the data sizes before doing anything else.
+				// Read the data sizes before doing anything else. The match was already picked by the match host so it is skipped here.
+				xuint16 iMatchID = 0;
 				xuint16 iGamerCardSize = 0;
 				xuint16 iVerificationInfoSize = 0;
 
+				xInStream.Read(iMatchID);
 				xInStream.Read(iGamerCardSize);
 				xInStream.Read(iVerificationInfoSize);
 
@@ -579,7 +1248,7 @@ void CNetworkManager::OnProcessHostNotification(xchar cIdentifier, Packet* pPack
 						BitStream xOutStream;
 						xOutStream.Write((xuint8)ID_VERIFICATION_SUCCEEDED);
 
-						m_pInterface->Send(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, pPacket->systemAddress, false);
+						SendData(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, pPacket->systemAddress, false);
 					}
 
 					// Notify our new client about all existing verified clients. 
@@ -597,7 +1266,7 @@ void CNetworkManager::OnProcessHostNotification(xchar cIdentifier, Packet* pPack
 							if (iGamerCardSize)
 								xOutStream.Write((xchar*)(*ppPeer)->m_pGamerCard, iGamerCardSize);
 
-							m_pInterface->Send(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, pPacket->systemAddress, false);
+							SendData(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, pPacket->systemAddress, false);
 						}
 					}
 
@@ -616,7 +1285,7 @@ void CNetworkManager::OnProcessHostNotification(xchar cIdentifier, Packet* pPack
 							if (iGamerCardSize)
 								xOutStream.Write((xchar*)pPeer->m_pGamerCard, iGamerCardSize);
 
-							m_pInterface->Send(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, (*ppPeer)->m_xAddress, false);
+							SendData(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, (*ppPeer)->m_xAddress, false);
 						}
 					}
 
@@ -641,6 +1310,9 @@ void CNetworkManager::OnProcessHostNotification(xchar cIdentifier, Packet* pPack
 		{
 			// If we have a record of them, notify all other clients of their disconnection.
 			CNetworkPeer* pPeer = FindPeer(pPacket->systemAddress);
+
+			if (cIdentifier == ID_CONNECTION_LOST)
+				PacketTrace.Dump(XFORMAT("lost the connection to peer %d", pPeer ? pPeer->m_iID : NETWORK_PEER_INVALID_ID));
 			
 			if (pPeer)
 			{
@@ -650,7 +1322,7 @@ void CNetworkManager::OnProcessHostNotification(xchar cIdentifier, Packet* pPack
 				xOutStream.Write((xuint8)ID_PEER_LEAVING);
 				xOutStream.Write((xuint16)pPeer->m_iID);
 
-				m_pInterface->Send(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, UNASSIGNED_SYSTEM_ADDRESS, true);
+				SendData(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, pPeer->m_xAddress, true);
 			}
 
 			// Fire the leaving notification.
@@ -668,81 +1340,17 @@ void CNetworkManager::OnProcessHostNotification(xchar cIdentifier, Packet* pPack
 		}
 		break;
 
+	// Received a batch of data packets from a client.
+	case ID_BATCHED_STREAM:
+		{
+			OnProcessBatch(pPacket, pData, iDataSize);
+		}
+		break;
+
 	// Received a data packet from a client to broadcast to other peers.
 	case ID_ROUTED_STREAM:
 		{
-			xuint8 iStreamType;
-			xuint8 iFrom;
-			xuint8 iTo;
-			xuint8 iPriority;
-			xuint8 iReliability;
-			xuint8 iChannel;
-			xuint8 bBroadcast;
-
-			xInStream.Read(iStreamType);
-			xInStream.Read(iFrom);
-			xInStream.Read(iTo);
-			xInStream.Read(iPriority);
-			xInStream.Read(iReliability);
-			xInStream.Read(iChannel);
-			xInStream.Read(bBroadcast);
-
-			BitStream xAppendStream;
-
-			if (xInStream.GetNumberOfUnreadBits())
-				xInStream.Read(xAppendStream);
-
-			// Check if the host should process this packet.
-			if (bBroadcast && iTo != m_pLocalPeer->m_iID)
-			{
-				BitStream xLocalStream;
-
-				xLocalStream.Write(iStreamType);
-				xLocalStream.Write(iFrom);
-
-				if (xAppendStream.GetNumberOfBitsUsed())
-				{
-					xLocalStream.Write(xAppendStream);
-					xAppendStream.SetReadOffset(0);
-				}
-
-				OnProcessPacket(pPacket, &xLocalStream);
-			}
-
-			// Forward or broadcast the stream.
-			CNetworkPeer* pToPeer = FindPeer(iTo);
-
-			BitStream* pFinalStream = NULL;
-			BitStream* pAppendStream = xAppendStream.GetNumberOfBitsUsed() ? &xAppendStream : NULL; 
-
-			if (bBroadcast)
-			{
-				pFinalStream = CreateStream(iStreamType, iFrom, pAppendStream);
-
-				XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, m_lpVerifiedPeers)
-				{
-					CNetworkPeer* pWorkingPeer = *ppPeer;
-
-					if (pWorkingPeer != pToPeer && pWorkingPeer->m_iID != iFrom && !pWorkingPeer->m_bLocal)
-					{
-						XLOG("[Network] Forwarding broadcasted packet from peer %d to peer %d", iFrom, pWorkingPeer->m_iID);
-						m_pInterface->Send(pFinalStream, (PacketPriority)iPriority, (PacketReliability)iReliability, iChannel, pWorkingPeer->m_xAddress, false);
-					}
-				}
-			}
-			else
-			{
-				if (pToPeer)
-				{
-					pFinalStream = CreateStream(iStreamType, iFrom, pAppendStream);
-
-					XLOG("[Network] Forwarding packet from peer %d to peer %d", iFrom, pToPeer->m_iID);
-					m_pInterface->Send(pFinalStream, (PacketPriority)iPriority, (PacketReliability)iReliability, iChannel, pToPeer->m_xAddress, false);
-				}
-			}
-
-			if (pFinalStream)
-				delete pFinalStream;
+			OnRelayPacket(pPacket);
 		}
 		break;
 	}
@@ -761,6 +1369,8 @@ void CNetworkManager::OnProcessClientNotification(xchar cIdentifier, Packet* pPa
 			m_bConnected = true;
 			m_bVerified = false;
 
+			m_iConnectTime = _TIMEMS;
+
 			// We're connected but not verified yet. Execute early so that verification data can be set in the callback.
 			if (m_xCallbacks.m_fpConnectionCompleted)
 				m_xCallbacks.m_fpConnectionCompleted(true);
@@ -770,6 +1380,7 @@ void CNetworkManager::OnProcessClientNotification(xchar cIdentifier, Packet* pPa
 
 			xOutStream.Write((xuint8)ID_VERIFICATION_REQUEST);
 
+			xOutStream.Write((xuint16)m_iMatchID);
 			xOutStream.Write((xuint16)m_iGamerCardSize);
 			xOutStream.Write((xuint16)m_iVerificationInfoSize);
 
@@ -779,7 +1390,7 @@ void CNetworkManager::OnProcessClientNotification(xchar cIdentifier, Packet* pPa
 			if (m_iVerificationInfoSize)
 				xOutStream.Write((xchar*)m_pVerificationInfo, m_iVerificationInfoSize);
 
-			m_pInterface->Send(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, pPacket->systemAddress, false);
+			SendData(&xOutStream, HIGH_PRIORITY, RELIABLE, 1, pPacket->systemAddress, false);
 		}
 		break;
 
@@ -808,6 +1419,9 @@ void CNetworkManager::OnProcessClientNotification(xchar cIdentifier, Packet* pPa
 	case ID_DISCONNECTION_NOTIFICATION:
 	case ID_CONNECTION_LOST:
 		{
+			if (cIdentifier == ID_CONNECTION_LOST)
+				PacketTrace.Dump("lost the connection to the host");
+
 			// Remove all existing peers and execute the leaving callbacks.
 			DestroyPeers();
 
@@ -832,9 +1446,6 @@ void CNetworkManager::OnProcessClientNotification(xchar cIdentifier, Packet* pPa
 	// A new peer has been added to the game.
 	case ID_PEER_JOINED:
 		{
-			// Create the new peer structure.
-			CNetworkPeer* pPeer = CreatePeer();
-
 			// Read the stream header information.
 			xbool bLocal = false;
 			xuint16 iID = 0;
@@ -844,6 +1455,9 @@ void CNetworkManager::OnProcessClientNotification(xchar cIdentifier, Packet* pPa
 			xInStream.Read(iID);
 			xInStream.Read(iGamerCardSize);
 
+			// Create the new peer structure. Only the host is connected directly.
+			CNetworkPeer* pPeer = CreatePeer((xint)iID, (iID == 0) ? pPacket->systemAddress : UNASSIGNED_SYSTEM_ADDRESS);
+
 			// Read the gamercard data for this peer.
 			if (iGamerCardSize)
 			{
@@ -854,14 +1468,10 @@ void CNetworkManager::OnProcessClientNotification(xchar cIdentifier, Packet* pPa
 			// Initalise the peer.
 			pPeer->m_bHost = (iID == 0);
 			pPeer->m_bLocal = bLocal;
-			pPeer->m_iID = (xint)iID;
 			pPeer->m_bVerified = true;
 
 			if (pPeer->m_bHost)
-			{
 				m_pHostPeer = pPeer;
-				m_pHostPeer->m_xAddress = pPacket->systemAddress;
-			}
 
 			if (bLocal)
 				m_pLocalPeer = pPeer;
@@ -895,6 +1505,13 @@ void CNetworkManager::OnProcessClientNotification(xchar cIdentifier, Packet* pPa
 			OnProcessPacket(pPacket, &xInStream);
 		}
 		break;
+
+	// Received a batch of data packets from the host.
+	case ID_BATCHED_STREAM:
+		{
+			OnProcessBatch(pPacket, pData, iDataSize);
+		}
+		break;
 	}
 }
 
@@ -909,13 +1526,228 @@ void CNetworkManager::OnProcessPacket(Packet* pPacket, BitStream* pStream)
 
 	CNetworkPeer* pPeer = FindPeer((xint)iFrom);
 
-	XLOG("[Network] Received a packet from peer %d.", iFrom);
-
 	if (pPeer)
 	{
-		if (m_fpReceiveCallbacks[iStreamType])
-			m_fpReceiveCallbacks[iStreamType](pPeer, pStream);
+		if (m_fpStreamMonitor)
+			m_fpStreamMonitor(pPeer, iStreamType, pStream);
+
+		DispatchStream(pPeer, iStreamType, pStream);
 	}
 }
 
+// =============================================================================
+void CNetworkManager::OnRelayPacket(Packet* pPacket)
+{
+	xint64 iStartCounter = CProfileManager::GetCounter();
+
+	// Only verified peers may route packets through the host.
+	CNetworkPeer* pFromPeer = FindPeer(pPacket->systemAddress);
+
+	if (!pFromPeer || !pFromPeer->m_bVerified || pPacket->length < NETWORK_ROUTED_HEADER_SIZE)
+		return;
+
+	// Read the routing header where it lies rather than copying the packet into a stream.
+	xuchar* pData = pPacket->data;
+
+	xuint8 iStreamType = pData[1];
+	xuint8 iTo = pData[2];
+	xuint8 iFlags = pData[3];
+	xuint8 iChannel = pData[4];
+
+	PacketPriority iPriority = (PacketPriority)(iFlags & 0x3);
+	PacketReliability iReliability = (PacketReliability)((iFlags >> 2) & 0x7);
+	xbool bBroadcast = (iFlags & 0x20) != 0;
+
+	// A channel or reliability RakNet doesn't have can't be forwarded.
+	if (iChannel >= NETWORK_CHANNELS || iReliability > RELIABLE_SEQUENCED)
+		return;
+
+	// System priority is RakNet's own, so a peer can't ask the host to jump its traffic ahead of everything else.
+	if (iPriority < HIGH_PRIORITY)
+		iPriority = HIGH_PRIORITY;
+
+	xuint8 iFrom = (xuint8)pFromPeer->m_iID;
+
+	// The standard header is two bytes shorter, so it's written over the end of the routing header and the payload is forwarded as it stands.
+	xuchar* pForward = &pData[NETWORK_ROUTED_HEADER_SIZE - 3];
+	xint iForwardSize = (xint)pPacket->length - (NETWORK_ROUTED_HEADER_SIZE - 3);
+
+	pForward[0] = ID_STREAM;
+	pForward[1] = iStreamType;
+	pForward[2] = iFrom;
+
+	// Forward or broadcast the packet.
+	CNetworkPeer* pToPeer = FindPeer(iTo);
+
+	if (bBroadcast)
+	{
+		XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, m_lpVerifiedPeers)
+		{
+			CNetworkPeer* pWorkingPeer = *ppPeer;
+
+			if (pWorkingPeer != pToPeer && pWorkingPeer->m_iID != iFrom && !pWorkingPeer->m_bLocal)
+				RelayTo(pWorkingPeer, pForward, iForwardSize, iPriority, iReliability, iChannel);
+		}
+	}
+	else if (pToPeer && !pToPeer->m_bLocal)
+		RelayTo(pToPeer, pForward, iForwardSize, iPriority, iReliability, iChannel);
+
+	m_iRelayedMessages++;
+	m_iRelayCounter += CProfileManager::GetCounter() - iStartCounter;
+
+	// Process the packet locally if the host is one of the recipients. The stream type and sender lead the payload as usual.
+	if (bBroadcast ? iTo != m_pLocalPeer->m_iID : pToPeer == m_pLocalPeer)
+	{
+		BitStream xLocalStream(&pForward[1], iForwardSize - 1, false);
+		OnProcessPacket(pPacket, &xLocalStream);
+	}
+}
+
+// =============================================================================
+void CNetworkManager::OnProcessBatch(Packet* pPacket, xuchar* pData, xint iDataSize)
+{
+	if (iDataSize < 1)
+		return;
+
+	// The host knows the sender from the packet address.
+	CNetworkPeer* pPeer = m_bHosting ? FindPeer(pPacket->systemAddress) : FindPeer((xint)pData[0]);
+
+	// Only verified peers may send data messages.
+	if (!pPeer || !pPeer->m_bVerified)
+		return;
+
+	// Each message is read where it lies in the packet.
+	xint iOffset = 1;
+
+	while (iOffset + 3 <= iDataSize)
+	{
+		xint iStreamType = pData[iOffset];
+		xint iBytes = pData[iOffset + 1] | (pData[iOffset + 2] << 8);
+
+		iOffset += 3;
+
+		if (iOffset + iBytes > iDataSize)
+			break;
+
+		BitStream xStream(&pData[iOffset], iBytes, false);
+
+		if (m_fpStreamMonitor)
+			m_fpStreamMonitor(pPeer, iStreamType, &xStream);
+
+		DispatchStream(pPeer, iStreamType, &xStream);
+
+		iOffset += iBytes;
+	}
+}
+
+// =============================================================================
+const xchar* CNetworkManager::GetPacketName(xint iIdentifier)
+{
+	static const xchar* s_pNames[] =
+	{
+		"ID_INTERNAL_PING",  
+		"ID_PING",
+		"ID_PING_OPEN_CONNECTIONS",
+		"ID_CONNECTED_PONG",
+		"ID_CONNECTION_REQUEST",
+		"ID_SECURED_CONNECTION_RESPONSE",
+		"ID_SECURED_CONNECTION_CONFIRMATION",
+		"ID_RPC_MAPPING",
+		"ID_DETECT_LOST_CONNECTIONS",
+		"ID_OPEN_CONNECTION_REQUEST",
+		"ID_OPEN_CONNECTION_REPLY",
+		"ID_RPC",
+		"ID_RPC_REPLY",
+		"ID_OUT_OF_BAND_INTERNAL",
+		"ID_CONNECTION_REQUEST_ACCEPTED",
+		"ID_CONNECTION_ATTEMPT_FAILED",
+		"ID_ALREADY_CONNECTED",
+		"ID_NEW_INCOMING_CONNECTION",
+		"ID_NO_FREE_INCOMING_CONNECTIONS",
+		"ID_DISCONNECTION_NOTIFICATION",
+		"ID_CONNECTION_LOST",
+		"ID_RSA_PUBLIC_KEY_MISMATCH",
+		"ID_CONNECTION_BANNED",
+		"ID_INVALID_PASSWORD",
+		"ID_MODIFIED_PACKET",
+		"ID_TIMESTAMP",
+		"ID_PONG",
+		"ID_ADVERTISE_SYSTEM",
+		"ID_REMOTE_DISCONNECTION_NOTIFICATION",
+		"ID_REMOTE_CONNECTION_LOST",
+		"ID_REMOTE_NEW_INCOMING_CONNECTION",
+		"ID_DOWNLOAD_PROGRESS",
+		"ID_FILE_LIST_TRANSFER_HEADER",
+		"ID_FILE_LIST_TRANSFER_FILE",
+		"ID_DDT_DOWNLOAD_REQUEST",
+		"ID_TRANSPORT_STRING",
+		"ID_REPLICA_MANAGER_CONSTRUCTION",
+		"ID_REPLICA_MANAGER_DESTRUCTION",
+		"ID_REPLICA_MANAGER_SCOPE_CHANGE",
+		"ID_REPLICA_MANAGER_SERIALIZE",
+		"ID_REPLICA_MANAGER_DOWNLOAD_STARTED",
+		"ID_REPLICA_MANAGER_DOWNLOAD_COMPLETE",
+		"ID_CONNECTION_GRAPH_REQUEST",
+		"ID_CONNECTION_GRAPH_REPLY",
+		"ID_CONNECTION_GRAPH_UPDATE",
+		"ID_CONNECTION_GRAPH_NEW_CONNECTION",
+		"ID_CONNECTION_GRAPH_CONNECTION_LOST",
+		"ID_CONNECTION_GRAPH_DISCONNECTION_NOTIFICATION",
+		"ID_ROUTE_AND_MULTICAST",
+		"ID_RAKVOICE_OPEN_CHANNEL_REQUEST",
+		"ID_RAKVOICE_OPEN_CHANNEL_REPLY",
+		"ID_RAKVOICE_CLOSE_CHANNEL",
+		"ID_RAKVOICE_DATA",
+		"ID_AUTOPATCHER_GET_CHANGELIST_SINCE_DATE",
+		"ID_AUTOPATCHER_CREATION_LIST",
+		"ID_AUTOPATCHER_DELETION_LIST",
+		"ID_AUTOPATCHER_GET_PATCH",
+		"ID_AUTOPATCHER_PATCH_LIST",
+		"ID_AUTOPATCHER_REPOSITORY_FATAL_ERROR",
+		"ID_AUTOPATCHER_FINISHED_INTERNAL",
+		"ID_AUTOPATCHER_FINISHED",
+		"ID_AUTOPATCHER_RESTART_APPLICATION",
+		"ID_NAT_PUNCHTHROUGH_REQUEST",
+		"ID_NAT_TARGET_NOT_CONNECTED",
+		"ID_NAT_TARGET_CONNECTION_LOST",
+		"ID_NAT_CONNECT_AT_TIME",
+		"ID_NAT_SEND_OFFLINE_MESSAGE_AT_TIME",
+		"ID_NAT_IN_PROGRESS",
+		"ID_DATABASE_QUERY_REQUEST",
+		"ID_DATABASE_UPDATE_ROW",
+		"ID_DATABASE_REMOVE_ROW",
+		"ID_DATABASE_QUERY_REPLY",
+		"ID_DATABASE_UNKNOWN_TABLE",
+		"ID_DATABASE_INCORRECT_PASSWORD",
+		"ID_READY_EVENT_SET",
+		"ID_READY_EVENT_UNSET",
+		"ID_READY_EVENT_ALL_SET",
+		"ID_READY_EVENT_QUERY",
+		"ID_LOBBY_GENERAL",
+		"ID_AUTO_RPC_CALL",
+		"ID_AUTO_RPC_REMOTE_INDEX",
+		"ID_AUTO_RPC_UNKNOWN_REMOTE_INDEX",
+		"ID_RPC_REMOTE_ERROR",
+		"ID_STREAM",
+		"ID_ROUTED_STREAM",
+		"ID_VERIFICATION_REQUEST",
+		"ID_VERIFICATION_SUCCEEDED",
+		"ID_PEER_JOINED",
+		"ID_PEER_LEAVING",
+		"ID_BATCHED_STREAM",
+	};
+
+	if (iIdentifier < 0 || iIdentifier >= (xint)(sizeof(s_pNames) / sizeof(s_pNames[0])))
+		return "Unknown";
+
+	return s_pNames[iIdentifier];
+}
+
+// =============================================================================
+void CNetworkManager::DispatchStream(CNetworkPeer* pFrom, xint iStreamType, BitStream* pStream)
+{
+	if (m_fpReceiveCallbacks[(xuint8)iStreamType])
+		m_fpReceiveCallbacks[(xuint8)iStreamType](pFrom, pStream);
+}
+
 //##############################################################################
\ No newline at end of file
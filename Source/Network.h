@@ -9,6 +9,9 @@
 // Global.
 #include <Global.h>
 
+// Other.
+#include <RakNet/NetworkConditioner.h>
+
 //##############################################################################
 
 // Shortcuts.
@@ -17,9 +20,45 @@
 // The maximum ID for network peers is invalid.
 #define NETWORK_PEER_INVALID_ID 0xFF
 
+// The number of bits in a slot index of the table of peers by address. There must be at least twice as many slots as peers to keep the probes short.
+#define NETWORK_ADDRESS_TABLE_BITS 9
+
+// The number of slots in the table of peers by address.
+#define NETWORK_ADDRESS_TABLE_SIZE (1 << NETWORK_ADDRESS_TABLE_BITS)
+
 // The maximum time to wait before disconnecting if a reliable packet cannot be sent.
 #define NETWORK_PEER_TIMEOUT 6000
 
+// The longest time in milliseconds the RakNet update thread waits with nothing to do. It wakes sooner for incoming datagrams, sends and resends, so this only bounds pings and timeouts.
+#define NETWORK_THREAD_WAIT_TIME 50
+
+// The size, in bytes, of the header on a data packet relayed by the host.
+#define NETWORK_ROUTED_HEADER_SIZE 5
+
+// The time in milliseconds of send budget a peer can save up while idle, which bounds the bursts the scheduler sends.
+#define NETWORK_SEND_BURST_TIME 100
+
+// The approximate size, in bytes, of the RakNet header on each message, counted against the send budget.
+#define NETWORK_MESSAGE_OVERHEAD 10
+
+// The number of channels that RakNet keeps ordered and sequenced messages in order on.
+#define NETWORK_CHANNELS 32
+
+// The priority of player input, which the host can't simulate the player without.
+#define NETWORK_PRIORITY_INPUT HIGH_PRIORITY
+
+// The priority of snapshots and their acknowledgements.
+#define NETWORK_PRIORITY_STATE MEDIUM_PRIORITY
+
+// The priority of the map data sent to a joining client, which is large and reliable so it can trickle in behind the game state.
+#define NETWORK_PRIORITY_MAP LOW_PRIORITY
+
+// The priority of lobby and chat messages, which give way to the game.
+#define NETWORK_PRIORITY_LOBBY LOW_PRIORITY
+
+// The command line option that simulates the named network conditions from the network metadata.
+#define NETWORK_CONDITIONS_OPTION "-conditions "
+
 //##############################################################################
 
 // Namespaces.
@@ -27,6 +66,7 @@ using namespace RakNet;
 
 // Predeclare.
 class CNetworkPeer;
+class CNetworkStream;
 
 // The custom RakNet message identifiers.
 enum
@@ -37,13 +77,19 @@ enum
 	ID_VERIFICATION_SUCCEEDED,
 	ID_PEER_JOINED,
 	ID_PEER_LEAVING,
+	ID_BATCHED_STREAM,
 };
 
 // Callbacks.
 typedef xfunction(2)<CNetworkPeer* /*From*/, BitStream* /*Stream*/> t_fpStreamReceived;
+typedef xfunction(3)<CNetworkPeer* /*From*/, xint /*StreamType*/, BitStream* /*Stream*/> t_fpStreamMonitor;
 
 // Lists.
 typedef xlist<CNetworkPeer*> t_NetworkPeerList;
+typedef xarray<CNetworkStream*> t_NetworkStreamList;
+typedef xlist<xint> t_NetworkPeerIDList;
+typedef xlist<CNetworkStream*> t_NetworkStreamQueue;
+typedef xlist<Packet*> t_NetworkPacketList;
 
 //##############################################################################
 class CNetworkCallbacks
@@ -59,13 +105,42 @@ public:
 	xfunction(1)<CNetworkPeer* /*Peer*/> m_fpPeerLeaving;
 };
 
+//##############################################################################
+
+// Holds the lock on an interface shared with other matches for the life of the scope. Nothing is locked if there is no lock given.
+class CNetworkLock
+{
+public:
+	// Constructor.
+	CNetworkLock(CRITICAL_SECTION* pLock) :
+		m_pLock(pLock)
+	{
+		if (m_pLock)
+			EnterCriticalSection(m_pLock);
+	}
+
+	// Destructor.
+	~CNetworkLock()
+	{
+		if (m_pLock)
+			LeaveCriticalSection(m_pLock);
+	}
+
+protected:
+	// The lock held.
+	CRITICAL_SECTION* m_pLock;
+};
+
 //##############################################################################
 class CNetworkManager : public CModule
 {
 public:
-	// Singleton instance.
+	// Singleton instance, or the instance belonging to the match bound to the calling thread.
 	static inline CNetworkManager& Get() 
 	{
+		if (CMatchContext* pContext = CMatchContext::GetCurrent())
+			return *pContext->m_pNetworkManager;
+
 		static CNetworkManager s_Instance;
 		return s_Instance;
 	}
@@ -79,6 +154,9 @@ public:
 	// Initialise the network system.
 	virtual void OnInitialise();
 
+	// Free the pooled send streams.
+	virtual void OnDeinitialise();
+
 	// Update the network system.
 	virtual void OnUpdate();
 
@@ -88,18 +166,150 @@ public:
 	// Unbind a callback function from a specific packet type.
 	void UnbindReceiveCallback(xuchar cType);
 
+	// Set a callback to observe every stream received before it is dispatched. Specify NULL to remove it.
+	inline void SetStreamMonitor(t_fpStreamMonitor fpMonitor)
+	{
+		m_fpStreamMonitor = fpMonitor;
+	}
+
+	// Dispatch a stream to the callback bound to its type as if it had been received from the specified peer.
+	void DispatchStream(CNetworkPeer* pFrom, xint iStreamType, BitStream* pStream);
+
+	// Get the name of a RakNet message identifier.
+	static const xchar* GetPacketName(xint iIdentifier);
+
 	// Send a data packet to a remote peer. "pTo" is the peer to send to when sending from the host and is ignored otherwise.
 	xbool Send(CNetworkPeer* pTo, xint iStreamType, BitStream* pStream, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel = 2);
 
 	// Send a data packet to all remote peers (via the host if we are a client).
 	xbool Broadcast(CNetworkPeer* pIgnore, xint iStreamType, BitStream* pStream, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel = 2);
 
+	// Get a pooled stream for a data packet to a remote peer with the header already written, so the payload can be written straight into it. The stream must be passed to SendStream.
+	CNetworkStream* BeginSend(CNetworkPeer* pTo, xint iStreamType, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel = 2);
+
+	// Get a pooled stream for a data packet to all remote peers with the header already written. The stream must be passed to SendStream.
+	CNetworkStream* BeginBroadcast(CNetworkPeer* pIgnore, xint iStreamType, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel = 2);
+
+	// Send a stream from BeginSend or BeginBroadcast and return it to the pool. Any messages queued earlier on the same channel to the same recipients are sent first. If there is a send budget the stream waits in the schedule of each peer it goes to.
+	xbool SendStream(CNetworkStream* pStream);
+
+	// Get a stream to write a message to a remote peer into. The message is sent together with any others queued for the same peer and send settings when the network is flushed, or straight away if it must be routed through the host or coalescing is off. The stream must be passed to EndQueue.
+	CNetworkStream* BeginQueue(CNetworkPeer* pTo, xint iStreamType, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel = 2);
+
+	// Finish a message from BeginQueue.
+	void EndQueue(CNetworkStream* pStream);
+
+	// Send every queued message, one packet for each peer and send settings, then feed each peer's schedule to RakNet as its budget allows. This should be called once at the end of each tick.
+	void Flush();
+
+	// Set the number of bytes per second each peer may be sent, or zero to send everything straight away.
+	inline void SetSendBudget(xint iBytesPerSecond)
+	{
+		m_iSendBudget = iBytesPerSecond;
+	}
+
+	// Get the number of bytes per second each peer may be sent, or zero if there is no limit.
+	inline xint GetSendBudget()
+	{
+		return m_iSendBudget;
+	}
+
+	// Get the number of messages that have waited in a schedule since starting.
+	inline xint GetScheduledMessages()
+	{
+		return m_iScheduledMessages;
+	}
+
+	// Get the number of scheduled messages replaced by a newer message of the same type since starting.
+	inline xint GetSupersededMessages()
+	{
+		return m_iSupersededMessages;
+	}
+
+	// Get the total time in milliseconds scheduled messages have waited since starting.
+	inline xint64 GetScheduleDelay()
+	{
+		return m_iScheduleDelay;
+	}
+
+	// Get the longest time in milliseconds a scheduled message has waited since starting.
+	inline xint GetScheduleDelayMax()
+	{
+		return m_iScheduleDelayMax;
+	}
+
+	// Enable or disable coalescing queued messages.
+	inline void SetCoalescing(xbool bCoalescing)
+	{
+		m_bCoalescing = bCoalescing;
+	}
+
+	// Check if queued messages are coalesced.
+	inline xbool IsCoalescing()
+	{
+		return m_bCoalescing;
+	}
+
+	// Get the number of messages coalesced since starting.
+	inline xint GetCoalescedMessages()
+	{
+		return m_iCoalescedMessages;
+	}
+
+	// Get the number of packets the coalesced messages were sent in since starting.
+	inline xint GetCoalescedPackets()
+	{
+		return m_iCoalescedPackets;
+	}
+
+	// Simulate network conditions on the link to a peer, or on every link without its own conditions if no peer is given. The conditions on a peer last until it leaves and the defaults apply each time the network starts.
+	void SetConditions(const NetworkConditions& xConditions, CNetworkPeer* pPeer = NULL);
+
+	// Get the network conditions simulated on every link without its own conditions.
+	inline const NetworkConditions& GetConditions()
+	{
+		return m_xConditions;
+	}
+
+	// Seed the simulated conditions so that each run treats the same packets the same way.
+	void SetConditionsSeed(xuint iSeed);
+
+	// Simulate the named network conditions from the network metadata on every link. Returns false if there are no conditions with that name.
+	xbool LoadConditions(const xchar* pName);
+
 	// Initialise the network system as a host.
 	void StartHost(xint iMaxPeers, xint iPort, void* pCustomInfo = NULL, xint iCustomInfoSize = 0);
 
+	// Initialise the network system as the host of one match on an interface shared with other matches. Every call on the interface is made holding the lock, and the packets for the match are passed in with QueuePacket.
+	void StartSharedHost(RakPeerInterface* pInterface, CRITICAL_SECTION* pLock);
+
 	// Initialise the network system as a client.
 	void StartClient(const xchar* pHostAddress, xint iHostPort, void* pCustomInfo = NULL, xint iCustomInfoSize = 0);
 
+	// Pass on a packet received on a shared interface for processing in the next update. The caller must hold the lock and the packet is freed once processed.
+	inline void QueuePacket(Packet* pPacket)
+	{
+		m_lpRoutedPackets.push_back(pPacket);
+	}
+
+	// Check if the interface is shared with other matches.
+	inline xbool IsShared()
+	{
+		return m_pSharedLock != NULL;
+	}
+
+	// Set the match to join on a host running several matches. This is sent to the host with the verification info.
+	inline void SetMatchID(xint iMatchID)
+	{
+		m_iMatchID = iMatchID;
+	}
+
+	// Get the match to join on a host running several matches.
+	inline xint GetMatchID()
+	{
+		return m_iMatchID;
+	}
+
 	// Deinitialise the network system.
 	void Stop();
 
@@ -121,6 +331,30 @@ public:
 	// Get the last ping time to the host or -1 if we are the host or disconnected.
 	xint GetLastPing();
 
+	// Get the last ping time to a directly connected peer or -1 if it isn't connected.
+	xint GetLastPing(CNetworkPeer* pPeer);
+
+	// Get the time the host accepted the connection, or zero if we are the host or have not connected.
+	inline xuint GetConnectTime()
+	{
+		return m_iConnectTime;
+	}
+
+	// Get the number of data packets relayed on the host since starting.
+	inline xint GetRelayedMessages()
+	{
+		return m_iRelayedMessages;
+	}
+
+	// Get the number of sends made on the host to relay data packets since starting.
+	inline xint GetRelayedSends()
+	{
+		return m_iRelayedSends;
+	}
+
+	// Get the total time in milliseconds the host has spent relaying data packets since starting.
+	xdouble GetRelayTime();
+
 	// Get a pointer to the internal raknet interface.
 	inline RakPeerInterface* GetInterface() 
 	{ 
@@ -155,7 +389,10 @@ public:
 	void SortPeers();
 
 	// Find an exisiting peer by peer ID.
-	CNetworkPeer* FindPeer(xint iPeerID);
+	inline CNetworkPeer* FindPeer(xint iPeerID)
+	{
+		return (iPeerID >= 0 && iPeerID < NETWORK_PEER_INVALID_ID) ? m_pPeersByID[iPeerID] : NULL;
+	}
 
 	// Determine if the local machine is the host.
 	inline xbool IsHosting() 
@@ -211,15 +448,33 @@ public:
 	CNetworkCallbacks m_xCallbacks;
 
 protected:
-	// Make a standard data packet that will be going directly to the destination.
-	BitStream* CreateStream(xint iStreamType, xint iFrom, BitStream* pStream);
+	// Write the header for a standard data packet that will be going directly to the destination.
+	static void WriteHeader(BitStream* pStream, xint iStreamType, xint iFrom);
+
+	// Write the header for a data packet that will be relayed on the host.
+	static void WriteRoutedHeader(BitStream* pStream, xint iStreamType, xint iTo, xint iPriority, xint iReliability, xint iChannel, xbool bBroadcast);
+
+	// Take an empty stream from the pool, allocating one only if the pool has run dry.
+	CNetworkStream* AcquireStream(PacketPriority iPriority, PacketReliability iReliability, xchar iChannel);
+
+	// Return a stream to the pool. The memory it has grown is kept for the next message.
+	void ReleaseStream(CNetworkStream* pStream);
+
+	// Check if messages sent with a reliability are kept in order with the others on their channel.
+	static inline xbool IsOrdered(PacketReliability iReliability)
+	{
+		return iReliability == RELIABLE_ORDERED || iReliability == RELIABLE_SEQUENCED || iReliability == UNRELIABLE_SEQUENCED;
+	}
 
-	// Make a standard data packet that will be relayed on the host.
-	BitStream* CreateRoutedStream(xint iStreamType, xint iFrom, xint iTo, xint iPriority, xint iReliability, xint iChannel, xbool bBroadcast, BitStream* pStream);
+	// Check if a new stream makes a scheduled one worthless, which is the case for unreliable data of the same type on the same channel.
+	static xbool IsSuperseded(CNetworkStream* pScheduled, CNetworkStream* pStream);
 
 	// Comparison routine for sorting peers.
 	static xbool OnComparePeers(const CNetworkPeer* pA, const CNetworkPeer* pB);
 
+	// Trace and process a received packet and then free it.
+	void OnReceivePacket(Packet* pPacket);
+
 	// Process all host notifications.
 	void OnProcessHostNotification(xchar cIdentifier, Packet* pPacket, xuchar* pData, xint iDataSize);
 
@@ -229,17 +484,78 @@ protected:
 	// Process an incoming packet and dispatch to any callbacks.
 	void OnProcessPacket(Packet* pPacket, BitStream* pStream);
 
-	// Geterate a new peer ID. Valid only on the host.
+	// Forward a data packet from a client to the peers it is routed to, and process it locally if it is broadcast.
+	void OnRelayPacket(Packet* pPacket);
+
+	// Unpack a batch of coalesced messages and dispatch each one in turn.
+	void OnProcessBatch(Packet* pPacket, xuchar* pData, xint iDataSize);
+
+	// Return the queued streams to the pool without sending them.
+	void ClearQueue();
+
+	// Send the queued batches an immediate stream would otherwise overtake: those on its channel to the same peer, or to any peer if it is broadcast.
+	void FlushQueue(CNetworkStream* pStream);
+
+	// Send a queued batch, as a standard data packet if it holds only one message.
+	void SendBatch(CNetworkStream* pStream);
+
+	// Pass a stream to RakNet and return it to the pool.
+	xbool TransmitStream(CNetworkStream* pStream);
+
+	// Send data on the interface. A broadcast over a shared interface is sent to each of this manager's peers in turn so that it doesn't reach the other matches.
+	xbool SendData(const xchar* pData, xint iBytes, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel, const SystemAddress& xAddress, xbool bBroadcast);
+
+	// Send a bit stream on the interface.
+	inline xbool SendData(BitStream* pStream, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel, const SystemAddress& xAddress, xbool bBroadcast)
+	{
+		return SendData((const xchar*)pStream->GetData(), (xint)pStream->GetNumberOfBytesUsed(), iPriority, iReliability, iChannel, xAddress, bBroadcast);
+	}
+
+	// Add a stream to a peer's schedule. Unreliable data messages replace any waiting message of the same stream type.
+	void Schedule(CNetworkPeer* pPeer, CNetworkStream* pStream);
+
+	// Add a copy of a broadcast stream to the schedule of each peer it goes to and return it to the pool.
+	void ScheduleBroadcast(CNetworkStream* pStream);
+
+	// Forward a message relayed by the host to a peer, through the peer's schedule if there is a send budget.
+	void RelayTo(CNetworkPeer* pPeer, const xuchar* pData, xint iSize, PacketPriority iPriority, PacketReliability iReliability, xchar iChannel);
+
+	// Top up each peer's send budget for the time passed and transmit its scheduled messages, highest priority first, until it runs out. Ordered and sequenced messages still leave in the order they were sent on each channel.
+	void UpdateSchedule();
+
+	// Get the queue holding a peer's most urgent scheduled message or NULL if nothing is waiting.
+	t_NetworkStreamQueue* GetNextScheduled(CNetworkPeer* pPeer);
+
+	// Return a peer's scheduled streams to the pool without sending them.
+	void ClearSchedule(CNetworkPeer* pPeer);
+
+	// Create the host peer and free peer IDs once the interface is started as a host.
+	void StartHosting();
+
+	// Geterate a new peer ID or NETWORK_PEER_INVALID_ID if none are left. Valid only on the host.
 	xint GetUniquePeerID();
 
-	// Create a new peer object.
-	CNetworkPeer* CreatePeer();
+	// Create a new peer object and add it to the lookup tables. The address should be unassigned if the peer is not directly connected.
+	CNetworkPeer* CreatePeer(xint iID, const SystemAddress& xAddress);
 
 	// Destroy an existing peer.
 	void DestroyPeer(CNetworkPeer* pPeer);
 
 	// Find an existing peer by system address.
-	CNetworkPeer* FindPeer(SystemAddress& xAddress);
+	CNetworkPeer* FindPeer(const SystemAddress& xAddress);
+
+	// Get the slot in the table of peers by address that a search for an address starts from.
+	static inline xint GetAddressSlot(const SystemAddress& xAddress)
+	{
+		xuint iHash = (xAddress.binaryAddress ^ ((xuint)xAddress.port * 0x85EBCA6B)) * 0x9E3779B1;
+		return (xint)(iHash >> (32 - NETWORK_ADDRESS_TABLE_BITS));
+	}
+
+	// Add a peer to the table of peers by address.
+	void AddPeerAddress(CNetworkPeer* pPeer);
+
+	// Remove a peer from the table of peers by address, moving any later entries in its probe sequence back to fill the gap.
+	void RemovePeerAddress(CNetworkPeer* pPeer);
 
 	// Free all existing peers in the system and fire any leaving notifications.
 	void DestroyPeers();
@@ -247,6 +563,15 @@ protected:
 	// The local interface.
 	RakPeerInterface* m_pInterface;
 
+	// The lock held for calls on an interface shared with other matches, or NULL if the interface belongs to this manager.
+	CRITICAL_SECTION* m_pSharedLock;
+
+	// The packets received on a shared interface waiting to be processed.
+	t_NetworkPacketList m_lpRoutedPackets;
+
+	// The match to join on a host running several matches.
+	xint m_iMatchID;
+
 	// The network peer list.
 	t_NetworkPeerList m_lpPeers;
 
@@ -271,11 +596,20 @@ protected:
 	// The array of callback type bindings.
 	t_fpStreamReceived m_fpReceiveCallbacks[256];
 
+	// The callback observing all received streams.
+	t_fpStreamMonitor m_fpStreamMonitor;
+
 	// The local socket descriptor.
 	SocketDescriptor m_xSocket;
 
-	// The last used peer ID.
-	xint m_iLastPeerID;
+	// The peers indexed by peer ID.
+	CNetworkPeer* m_pPeersByID[NETWORK_PEER_INVALID_ID];
+
+	// The directly connected peers hashed by system address with linear probing.
+	CNetworkPeer* m_pPeersByAddress[NETWORK_ADDRESS_TABLE_SIZE];
+
+	// The peer IDs free for use on the host, oldest first so that an ID isn't reused while packets for its last peer may still arrive.
+	t_NetworkPeerIDList m_liFreePeerIDs;
 
 	// Determines if a stop request is pending.
 	xbool m_bStopPending;
@@ -291,6 +625,48 @@ protected:
 
 	// The size, in bytes, of the verification info.
 	xuint m_iVerificationInfoSize;
+
+	// The send streams ready for reuse.
+	t_NetworkStreamList m_lpFreeStreams;
+
+	// The streams holding queued messages, one for each peer and send settings.
+	t_NetworkStreamList m_lpQueuedStreams;
+
+	// Determines if queued messages are coalesced.
+	xbool m_bCoalescing;
+
+	// The coalescing statistics since starting.
+	xint m_iCoalescedMessages;
+	xint m_iCoalescedPackets;
+
+	// The number of bytes per second each peer may be sent, or zero if there is no limit.
+	xint m_iSendBudget;
+
+	// The time the schedules were last updated.
+	xuint m_iScheduleTime;
+
+	// The number of streams ever scheduled, used to number them in the order they were sent.
+	xuint m_iScheduleCount;
+
+	// The scheduling statistics since starting.
+	xint m_iScheduledMessages;
+	xint m_iSupersededMessages;
+	xint64 m_iScheduleDelay;
+	xint m_iScheduleDelayMax;
+
+	// The network conditions simulated on every link without its own conditions.
+	NetworkConditions m_xConditions;
+
+	// The seed for the simulated network conditions.
+	xuint m_iConditionsSeed;
+
+	// The relay statistics since starting.
+	xint m_iRelayedMessages;
+	xint m_iRelayedSends;
+	xint64 m_iRelayCounter;
+
+	// The time the host accepted the connection.
+	xuint m_iConnectTime;
 };
 
 //##############################################################################
@@ -317,6 +693,64 @@ public:
 
 	// The local peer data.
 	void* m_pData;
+
+	// The unordered messages waiting for send budget, a queue for each priority.
+	t_NetworkStreamQueue m_lpScheduled[NUMBER_OF_PRIORITIES];
+
+	// The ordered and sequenced messages waiting for send budget, a queue for each channel so that they leave in the order they were sent.
+	t_NetworkStreamQueue m_lpOrderedSchedule[NETWORK_CHANNELS];
+
+	// The number of messages of each priority in each ordered channel's queue, so a channel's most urgent message is found without walking it.
+	xint m_iOrderedPriorities[NETWORK_CHANNELS][NUMBER_OF_PRIORITIES];
+
+	// A bit for each ordered channel with messages waiting.
+	xuint32 m_iOrderedChannels;
+
+	// The send budget saved up, in thousandths of a byte so that nothing is lost to rounding. This goes negative when a message larger than what is left is sent.
+	xint64 m_iSendTokens;
+};
+
+//##############################################################################
+class CNetworkStream : public BitStream
+{
+public:
+	// Get the number of payload bytes written after the header.
+	inline xint GetPayloadBytes()
+	{
+		return (xint)BITS_TO_BYTES(GetNumberOfBitsUsed() - m_iHeaderBits);
+	}
+
+	// The address to send to, or to ignore when broadcasting.
+	SystemAddress m_xAddress;
+
+	// Specifies if the stream is sent to every connected system.
+	xbool m_bBroadcast;
+
+	// The send settings.
+	PacketPriority m_iPriority;
+	PacketReliability m_iReliability;
+	xchar m_iChannel;
+
+	// The size, in bits, of the header written ahead of the payload.
+	xint m_iHeaderBits;
+
+	// The byte offset of the length of the message being written to a batch, or -1 if the stream isn't a batch.
+	xint m_iMessageOffset;
+
+	// The number of messages in a batch.
+	xint m_iMessageCount;
+
+	// The number of bytes at the start of the stream that are skipped when it is sent.
+	xint m_iDataOffset;
+
+	// The time the stream was added to a schedule.
+	xuint m_iScheduledTime;
+
+	// The number of streams scheduled before this one.
+	xuint m_iScheduledOrder;
+
+	// The packet trace flags recorded when the stream is sent, besides those the send settings imply.
+	xint m_iTraceFlags;
 };
 
 //##############################################################################
\ No newline at end of file
@@ -11,6 +11,10 @@
 #include <Sprite.h>
 #include <Game.h>
 #include <Brain.h>
+#include <Profile.h>
+#include <Replay.h>
+#include <Trigger.h>
+#include <Lobby.h>
 
 //##############################################################################
 
@@ -20,19 +24,22 @@
 //##############################################################################
 
 // =============================================================================
-CPlayer::CPlayer(t_PlayerType iType, const xchar* pSpriteName) : CRenderable(RenderableType_Player), 
-	m_iType(iType),
-	m_pSprite(NULL),
-	m_pNavPath(NULL),
-	m_pBrain(NULL)
+CPlayer::CPlayer(t_PlayerType iType, const xchar* pSpriteName) : CRenderable(RenderableType_Player),
+	m_pSprite(NULL)
 {
-	m_iIndex = (xint)PlayerManager.GetPlayerCount();
+	m_iIndex = PlayerManager.CreateComponents();
+
+	GetStatus().m_iType = iType;
+	GetControl().m_pNavPath = NULL;
+	GetControl().m_pBrain = NULL;
 
 	m_pSprite = new CAnimatedSprite(_SPRITE(pSpriteName));
 	m_pSprite->SetAnimation("Idle");
 	m_pSprite->SetAnchor(m_pSprite->GetAreaCentre());
 	m_pSprite->SetEventCallback(xbind(this, &CPlayer::OnAnimationEvent));
 
+	GetCollider().m_iRadius = m_pSprite->GetAreaWidth() / 3;
+
 	Reset();
 }
 
@@ -47,19 +54,26 @@ CPlayer::~CPlayer()
 // =============================================================================
 void CPlayer::Reset()
 {
-	m_iState = PlayerState_None;
-	m_iLogicType = PlayerLogicType_None;
-	m_pCurrentBlock = NULL;
-	m_pTargetBlock = NULL;
-	m_iTime = 0;
-	m_iMoveTime = 0;
-	m_fTransition = 0.f;
-	m_bLeaving = false;
-    m_iRequestedDir = PlayerDirection_None;
-    m_iLastDir = PlayerDirection_None;
-	m_iTransitionDir = PlayerDirection_Left;
-	m_iMoveDir = PlayerDirection_Left;
-	m_liQueuedMoves.clear();
+	CPlayerMovement& xMovement = GetMovement();
+	CPlayerReplication& xReplication = GetReplication();
+
+	GetStatus().m_iState = PlayerState_None;
+	GetStatus().m_iLogicType = PlayerLogicType_None;
+	EnterBlock(NULL);
+	xMovement.m_pTargetBlock = NULL;
+	xMovement.m_xPosition = xpoint();
+	xMovement.m_iTime = 0;
+	xMovement.m_iMoveTime = 0;
+	xMovement.m_fTransition = 0.f;
+	xMovement.m_bLeaving = false;
+    xMovement.m_iRequestedDir = PlayerDirection_None;
+    xMovement.m_iLastDir = PlayerDirection_None;
+	xMovement.m_iTransitionDir = PlayerDirection_Left;
+	xMovement.m_iMoveDir = PlayerDirection_Left;
+	xReplication.m_lxQueuedInputs.clear();
+	xReplication.m_lxInputHistory.clear();
+	xReplication.m_iInputSequence = 0;
+	xReplication.m_lxSamples.clear();
 
 	m_pSprite->Play("Idle");
 	m_pSprite->SetAlpha(1.f);
@@ -74,149 +88,39 @@ void CPlayer::Revive()
 }
 
 // =============================================================================
-void CPlayer::Update()
+void CPlayer::OnRender()
 {
-	const static xfloat s_fMoveDir[PlayerDirection_Max] = {-1.f, -1.f, 1.f, 1.f};
-	static xfloat s_fBlockSize = 48.f;
-
-	xfloat fAlpha = 1.f;
-
-	switch (m_iState)
-	{
-	case PlayerState_Idle:
-		{
-			Logic();
-
-			// Idle is a logic state so if we have a state now, process it immediately.
-			if (m_iState != PlayerState_Idle)
-				Update();
-		}
-		break;
-
-	case PlayerState_Move:
-		{
-			// Move the player along their path.
-			m_iTime = Math::Clamp<xint>(m_iTime + _TIMEDELTA, 0, m_iMoveTime);
-			m_fTransition = Math::Clamp((xfloat)m_iTime / (xfloat)m_iMoveTime, 0.f, 1.f);
-
-			m_pSprite->SetPosition(m_pCurrentBlock->GetScreenPosition() + (((m_pTargetBlock->GetScreenPosition() - m_pCurrentBlock->GetScreenPosition()) * m_iTime) / m_iMoveTime));
-			
-			// See if we have arrived at the next block.
-			if (m_pSprite->GetPosition() == m_pTargetBlock->GetScreenPosition())
-			{
-				m_pCurrentBlock = m_pTargetBlock;
-				m_pTargetBlock = NULL;
-
-				SetState(PlayerState_Idle);
-			}
-		}
-		break;
-
-	case PlayerState_Warp:
-		{
-			if (m_bLeaving)
-			{
-				m_iTime = Math::Clamp<xint>(m_iTime + _TIMEDELTA, 0, m_iMoveTime);
-				m_fTransition = Math::Clamp((xfloat)m_iTime / (xfloat)m_iMoveTime, 0.f, 1.f);
-
-				if (m_iTime == m_iMoveTime)
-				{
-					m_fTransition = 1.f;
-					m_pCurrentBlock = MapManager.GetCurrentMap()->GetAdjacentBlock((t_AdjacentDirection)m_iTransitionDir, m_pCurrentBlock);
-					m_iTransitionDir = (t_PlayerDirection)((m_iTransitionDir + 2) % PlayerDirection_Max);
-					m_bLeaving = false;
-				}
-			}
-			else
-			{
-				m_iTime = Math::Clamp<xint>(m_iTime - _TIMEDELTA, 0, m_iMoveTime);
-				m_fTransition = Math::Clamp((xfloat)m_iTime / (xfloat)m_iMoveTime, 0.f, 1.f);
-
-				if (m_iTime == 0)
-				{
-					m_fTransition = 0.f;
-					SetState(PlayerState_Idle);
-				}
-			}
-
-			xpoint xOffset;
-			
-			if (m_iTransitionDir % 2)
-				xOffset.m_tY = (xint)(m_fTransition * s_fBlockSize * s_fMoveDir[m_iTransitionDir]);
-			else
-				xOffset.m_tX = (xint)(m_fTransition * s_fBlockSize * s_fMoveDir[m_iTransitionDir]);
-
-			m_pSprite->SetPosition(m_pCurrentBlock->GetScreenPosition() + xOffset);
-
-			if (PlayerManager.GetLocalPlayer() == this)
-				Global.m_fMapAlpha = Math::Clamp(1.f - m_fTransition, 0.f, 1.f);
-		}
-		break;
-
-	case PlayerState_Die:
-		{
-			// Burst into particle dust, the ghost should keep moving.
-			// Restart the round.
-		}
-		break;
-	}
-
-    // Things to do while we are alive.
-    if (m_iState != PlayerState_Die)
-    {
-        // Local players should check input every update.
-        if (m_iLogicType == PlayerLogicType_Local)
-        {
-            // Check player input for all directions.
-	        for (xuint iA = 0; iA < PlayerDirection_Max; ++iA)
-	        {
-		        if (_HGE->Input_GetKeyState(HGEK_LEFT + iA))
-                    m_iRequestedDir = (t_PlayerDirection)iA;
-            }
-        }
-    }
-
-    // Calculate visibility of local player.
-	if (this != PlayerManager.GetLocalPlayer())
-	{
-		xfloat fVisibility = (m_pCurrentBlock->m_fPlayerVisibility * (1.f - m_fTransition));
-
-		if (m_pTargetBlock)
-			fVisibility += m_pTargetBlock->m_fPlayerVisibility * m_fTransition;
-
-		m_pSprite->SetAlpha(fVisibility * fAlpha);
-	}
-	else
-		m_pSprite->SetAlpha(fAlpha);
-
-	m_pSprite->Update();
+	m_pSprite->Render();
 }
 
 // =============================================================================
-void CPlayer::OnRender()
+void CPlayer::SetCurrentBlock(CMapBlock* pBlock)
 {
-	m_pSprite->Render();
+	EnterBlock(pBlock);
+
+	if (pBlock)
+		SetPosition(pBlock->GetScreenPosition());
 }
 
 // =============================================================================
-void CPlayer::SetCurrentBlock(CMapBlock* pBlock)
+void CPlayer::EnterBlock(CMapBlock* pBlock)
 {
-	m_pCurrentBlock = pBlock;
+	GetMovement().m_pCurrentBlock = pBlock;
 
-	if (m_pCurrentBlock)
-		SetPosition(m_pCurrentBlock->GetScreenPosition());
+	if (MapManager.HasCurrentMap())
+		MapManager.GetCurrentMap()->SetOccupiedBlock(this, pBlock);
 }
 
 // =============================================================================
 void CPlayer::SetState(t_PlayerState iState)
 {
-	m_iState = iState;
+	GetStatus().m_iState = iState;
 
-	switch (m_iState)
+	switch (iState)
 	{
 	case PlayerState_Idle:
 		{
-			m_pTargetBlock = m_pCurrentBlock;
+			GetMovement().m_pTargetBlock = GetMovement().m_pCurrentBlock;
 		}
 		break;
 	}
@@ -225,33 +129,52 @@ void CPlayer::SetState(t_PlayerState iState)
 // =============================================================================
 void CPlayer::Move(t_PlayerDirection iDirection)
 {
-	m_pTargetBlock = m_pCurrentBlock->m_pAdjacents[iDirection];
-    m_iLastDir = iDirection;
-	m_iMoveDir = iDirection;
-	m_iTransitionDir = iDirection;
-	m_iTime = 0;
-	m_fTransition = 0.f;
+	CPlayerMovement& xMovement = GetMovement();
 
-	if (m_pCurrentBlock->m_pAdjacents[iDirection])
+	xMovement.m_pTargetBlock = xMovement.m_pCurrentBlock->m_pAdjacents[iDirection];
+    xMovement.m_iLastDir = iDirection;
+	xMovement.m_iMoveDir = iDirection;
+	xMovement.m_iTransitionDir = iDirection;
+	xMovement.m_iTime = 0;
+	xMovement.m_fTransition = 0.f;
+
+	if (xMovement.m_pCurrentBlock->m_pAdjacents[iDirection])
 		SetState(PlayerState_Move);
 	else
 	{
-		m_bLeaving = true;
+		xMovement.m_bLeaving = true;
 		SetState(PlayerState_Warp);
 	}
 
 	// Network.
 	if (NetworkManager.IsRunning())
 	{
-		if (m_iLogicType == PlayerLogicType_Local || m_iLogicType == PlayerLogicType_AI)
+		// The host replicates all movement to clients using snapshots.
+		if (NetworkManager.IsHosting())
+			SnapshotManager.CountMove();
+
+		// Clients predict their own moves and send them to the host to be applied authoritatively.
+		else if (GetLogicType() == PlayerLogicType_Local)
 		{
-			BitStream xStream;
+			CPlayerReplication& xReplication = GetReplication();
+			CPlayerInput xInput;
 
-			xStream.Write((xuint8)PlayerStreamType_Move);
-			xStream.Write((xuint8)m_iIndex);
-			xStream.Write((xuint8)iDirection);
+			xInput.m_iSequence = ++xReplication.m_iInputSequence;
+			xInput.m_iDirection = iDirection;
 
-			NetworkManager.Broadcast(NULL, NetworkStreamType_PlayerUpdate, &xStream, HIGH_PRIORITY, RELIABLE_ORDERED);
+			xReplication.m_lxInputHistory.push_back(xInput);
+
+			if (xReplication.m_lxInputHistory.size() > PLAYER_INPUT_HISTORY)
+				xReplication.m_lxInputHistory.pop_front();
+
+			CNetworkStream* pStream = NetworkManager.BeginQueue(NULL, NetworkStreamType_PlayerUpdate, NETWORK_PRIORITY_INPUT, RELIABLE_ORDERED);
+
+			pStream->Write((xuint8)PlayerStreamType_Move);
+			pStream->Write((xuint8)m_iIndex);
+			pStream->Write((xuint8)iDirection);
+			pStream->Write(xInput.m_iSequence);
+
+			NetworkManager.EndQueue(pStream);
 		}
 	}
 }
@@ -259,20 +182,20 @@ void CPlayer::Move(t_PlayerDirection iDirection)
 // =============================================================================
 void CPlayer::Logic()
 {
-	switch (m_iLogicType)
+	switch (GetLogicType())
 	{
 	case PlayerLogicType_None:
 		LogicPath();
 		break;
-	case PlayerLogicType_Local:	
-		LogicLocal();		
+	case PlayerLogicType_Local:
+		LogicLocal();
 		break;
 	case PlayerLogicType_AI:
 		LogicPath();
-		LogicAI();			
+		LogicAI();
 		break;
-	case PlayerLogicType_Remote:	
-		LogicRemote();		
+	case PlayerLogicType_Remote:
+		LogicRemote();
 		break;
 	}
 }
@@ -280,11 +203,13 @@ void CPlayer::Logic()
 // =============================================================================
 void CPlayer::LogicPath()
 {
-	if (m_pNavPath)
+	CNavigationPath* pNavPath = GetNavPath();
+
+	if (pNavPath)
 	{
 		// If we are on our target node, move to the next node in the sequence.
-		CNavigationNode* pCurrentNode = m_pNavPath->GetCurrentNode();
-		CNavigationNode* pNextNode = m_pNavPath->GetNextNode();
+		CNavigationNode* pCurrentNode = pNavPath->GetCurrentNode();
+		CNavigationNode* pNextNode = pNavPath->GetNextNode();
 
 		if (pCurrentNode && pNextNode)
 		{
@@ -310,73 +235,117 @@ void CPlayer::LogicPath()
 void CPlayer::LogicLocal()
 {
 	// Currently we can only control one player at a time.
-	if (this != PlayerManager.GetLocalPlayer() || !Global.m_bWindowFocused)
+	if (this != PlayerManager.GetLocalPlayer())
 		return;
 
+	// Bot-controlled players play with the player's brain, whose moves are predicted and sent to the host like those from the keys.
+	if (IsThinking())
+	{
+		LogicPath();
+		LogicAI();
+
+		return;
+	}
+
+	if (!Global.m_bWindowFocused)
+		return;
+
+	CPlayerMovement& xMovement = GetMovement();
+
     // If we have a pending request, try to follow it.
-    if (m_iRequestedDir != PlayerDirection_None && IsPassable(m_pCurrentBlock->m_pAdjacents[m_iRequestedDir]))
+    if (xMovement.m_iRequestedDir != PlayerDirection_None && IsPassable(xMovement.m_pCurrentBlock->m_pAdjacents[xMovement.m_iRequestedDir]))
     {
-        Move(m_iRequestedDir);
-        m_iRequestedDir = PlayerDirection_None;
+        Move(xMovement.m_iRequestedDir);
+        xMovement.m_iRequestedDir = PlayerDirection_None;
     }
 
     // If we haven't picked a new direction...
-    if (m_iState == PlayerState_Idle)
+    if (GetState() == PlayerState_Idle)
     {
         // Try to continue the way we were going before.
-        if (m_iLastDir != PlayerDirection_None && IsPassable(m_pCurrentBlock->m_pAdjacents[m_iLastDir]))
-            Move(m_iLastDir);
+        if (xMovement.m_iLastDir != PlayerDirection_None && IsPassable(xMovement.m_pCurrentBlock->m_pAdjacents[xMovement.m_iLastDir]))
+            Move(xMovement.m_iLastDir);
     }
 }
 
 // =============================================================================
 void CPlayer::LogicAI()
 {
-	if (m_pBrain)
-		m_pBrain->Think();
+	// The brain thinks once the scheduler has the budget for it.
+	if (GetControl().m_pBrain)
+		BrainScheduler.Request(GetControl().m_pBrain);
 }
 
 // =============================================================================
 void CPlayer::LogicRemote()
 {
-	if (m_liQueuedMoves.size())
+	CPlayerMovement& xMovement = GetMovement();
+	CPlayerReplication& xReplication = GetReplication();
+
+	// The host applies the inputs sent by the owning client, clients are driven by snapshots.
+	xint iInputs = Math::Min<xint>((xint)xReplication.m_lxQueuedInputs.size(), PLAYER_INPUTS_PER_TICK);
+
+	for (xint iA = 0; iA < iInputs; ++iA)
 	{
-		while (m_liQueuedMoves.size() > 1)
-		{
-			m_pCurrentBlock = m_pCurrentBlock->m_pAdjacents[m_liQueuedMoves.front()];
-			m_liQueuedMoves.pop_front();
-		}
+		CPlayerInput xInput = xReplication.m_lxQueuedInputs.front();
+		xReplication.m_lxQueuedInputs.pop_front();
+
+		// Inputs into a wall are dropped but still acknowledged, so the client reconciles back onto the host's block.
+		xReplication.m_iInputSequence = xInput.m_iSequence;
+
+		if (!IsPassable(xMovement.m_pCurrentBlock->m_pAdjacents[xInput.m_iDirection]))
+			continue;
 
-		Move(m_liQueuedMoves.front());
-		m_liQueuedMoves.pop_front();
+		// Inputs that arrived together are caught up straight away, the last one is animated.
+		if (iA < iInputs - 1)
+			EnterBlock(MapManager.GetCurrentMap()->GetAdjacentBlock((t_AdjacentDirection)xInput.m_iDirection, xMovement.m_pCurrentBlock));
+		else
+			Move(xInput.m_iDirection);
 	}
 }
 
+// =============================================================================
+xbool CPlayer::IsThinking()
+{
+	if (GetLogicType() == PlayerLogicType_AI)
+		return true;
+
+	return GetLogicType() == PlayerLogicType_Local && this == PlayerManager.GetLocalPlayer() && Global.m_bBotControlled;
+}
+
 // =============================================================================
 void CPlayer::SetLogicType(t_PlayerLogicType _Value)
 {
 	ClearNavPath();
 
-	m_iLogicType = _Value;
+	GetStatus().m_iLogicType = _Value;
 }
 
 // =============================================================================
 void CPlayer::NavigateTo(CMapBlock* pBlock)
 {
+	SetNavPath(FindPath(pBlock));
+}
+
+// =============================================================================
+CNavigationPath* CPlayer::FindPath(CMapBlock* pBlock)
+{
+	CPlayerMovement& xMovement = GetMovement();
+
 	CNavigationRequest xRequest;
 	CNavigationPath* pPath = new CNavigationPath();
 	CMapEvaluator* pEvaluator = new CMapEvaluator(this);
 
 	xRequest.m_pMesh = MapManager.GetCurrentMap()->GetNavMesh();
 	xRequest.m_pEvaluator = pEvaluator;
-	xRequest.m_pStart = m_pTargetBlock ? m_pTargetBlock->m_pNavNode : m_pCurrentBlock->m_pNavNode;
+	xRequest.m_pStart = xMovement.m_pTargetBlock ? xMovement.m_pTargetBlock->m_pNavNode : xMovement.m_pCurrentBlock->m_pNavNode;
 	xRequest.m_pGoal = pBlock->m_pNavNode;
 
 	NavigationManager.FindPath(&xRequest, *pPath);
 
 	delete pEvaluator;
 
-	SetNavPath(pPath);
+	return pPath;
 }
 
 // =============================================================================
@@ -385,16 +354,20 @@ void CPlayer::SetNavPath(CNavigationPath* pPath)
 	ClearNavPath();
 
 	if (pPath->GetNodeCount())
-		m_pNavPath = pPath;
+		GetControl().m_pNavPath = pPath;
+	else
+		delete pPath;
 }
 
 // =============================================================================
 void CPlayer::ClearNavPath()
 {
-	if (m_pNavPath)
-		delete m_pNavPath;
+	CPlayerControl& xControl = GetControl();
+
+	if (xControl.m_pNavPath)
+		delete xControl.m_pNavPath;
 
-	m_pNavPath = NULL;
+	xControl.m_pNavPath = NULL;
 }
 
 // =============================================================================
@@ -402,8 +375,10 @@ void CPlayer::OnAnimationEvent(CAnimatedSprite* pSprite, const xchar* pEvent)
 {
 	if (String::IsMatch(pEvent, "Eat"))
 	{
-		if (m_pTargetBlock && m_pTargetBlock->IsEdible())
-			m_pTargetBlock->Eat();
+		CMapBlock* pTargetBlock = GetMovement().m_pTargetBlock;
+
+		if (pTargetBlock && pTargetBlock->IsEdible())
+			pTargetBlock->Eat();
 	}
 
 	if (String::IsMatch(pEvent, "Dead"))
@@ -423,6 +398,12 @@ void CPlayer::OnReceivePlayerUpdate(CNetworkPeer* pFrom, BitStream* pStream)
 
     CPlayer* pPlayer = (iPlayerIndex < PlayerManager.GetPlayerCount()) ? PlayerManager.GetPlayer(iPlayerIndex) : NULL;
 
+	// Peers can only steer the player they were assigned.
+	CNetworkPeerInfo* pInfo = pFrom ? (CNetworkPeerInfo*)pFrom->m_pData : NULL;
+
+	if (!pInfo || pInfo->m_pPlayer != pPlayer)
+		pPlayer = NULL;
+
 	if (pPlayer)
 	{
 		switch (iStreamType)
@@ -431,27 +412,226 @@ void CPlayer::OnReceivePlayerUpdate(CNetworkPeer* pFrom, BitStream* pStream)
 		case PlayerStreamType_Move:
 			{
 				xuint8 iMoveDirection;
+				CPlayerInput xInput;
+
 				pStream->Read(iMoveDirection);
+				pStream->Read(xInput.m_iSequence);
+
+				xInput.m_iDirection = (t_PlayerDirection)iMoveDirection;
+
+				// The queue is bounded so that a client can't build up an unlimited backlog of moves.
+				if (xInput.m_iDirection >= 0 && xInput.m_iDirection < PlayerDirection_Max && pPlayer->GetReplication().m_lxQueuedInputs.size() < PLAYER_INPUT_HISTORY)
+					pPlayer->GetReplication().m_lxQueuedInputs.push_back(xInput);
+			}
+			break;
+		}
+	}
+}
+
+// =============================================================================
+void CPlayer::OnReceiveSnapshot(const CPlayerSnapshot& xSnapshot, xint iTime)
+{
+	if (GetLogicType() == PlayerLogicType_Local)
+		Reconcile(xSnapshot);
+	else if (GetLogicType() == PlayerLogicType_Remote)
+	{
+		t_PlayerSampleList& lxSamples = GetReplication().m_lxSamples;
+		CPlayerSample xSample;
+
+		xSample.m_iTime = iTime;
+		xSample.m_xState = xSnapshot;
+
+		lxSamples.push_back(xSample);
+
+		if (lxSamples.size() > PLAYER_SAMPLE_HISTORY)
+			lxSamples.pop_front();
+	}
+}
+
+// =============================================================================
+void CPlayer::UpdateInterpolation()
+{
+	t_PlayerSampleList& lxSamples = GetReplication().m_lxSamples;
+	xint iTime = SnapshotManager.GetInterpolationTime();
+
+	// Discard the samples we've passed, keeping the one immediately before the render time.
+	while (lxSamples.size() > 1 && (++lxSamples.begin())->m_iTime <= iTime)
+		lxSamples.pop_front();
+
+	if (lxSamples.empty())
+		return;
+
+	CPlayerSample& xFrom = lxSamples.front();
+	xpoint xPosition = GetSnapshotPosition(xFrom.m_xState);
+
+	// Blend towards the next sample unless it's on the other side of the map after a warp.
+	if (lxSamples.size() > 1 && iTime > xFrom.m_iTime)
+	{
+		CPlayerSample& xTo = *(++lxSamples.begin());
+		xpoint xDelta = GetSnapshotPosition(xTo.m_xState) - xPosition;
+
+		if (abs(xDelta.m_tX) + abs(xDelta.m_tY) <= 96)
+		{
+			xDelta = (xDelta * (iTime - xFrom.m_iTime)) / (xTo.m_iTime - xFrom.m_iTime);
+			xPosition = xPosition + xDelta;
+		}
+	}
+
+	SetSnapshotState(xFrom.m_xState);
+	GetMovement().m_xPosition = xPosition;
+}
+
+// =============================================================================
+CMapBlock* CPlayer::GetDestinationBlock()
+{
+	CPlayerMovement& xMovement = GetMovement();
+
+	switch (GetState())
+	{
+	case PlayerState_Move:
+		return xMovement.m_pTargetBlock;
+
+	case PlayerState_Warp:
+		return xMovement.m_bLeaving ? MapManager.GetCurrentMap()->GetAdjacentBlock((t_AdjacentDirection)xMovement.m_iMoveDir, xMovement.m_pCurrentBlock) : xMovement.m_pCurrentBlock;
+	}
+
+	return xMovement.m_pCurrentBlock;
+}
+
+// =============================================================================
+CMapBlock* CPlayer::GetDestinationBlock(const CPlayerSnapshot& xSnapshot)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+	CMapBlock* pBlock = pMap->GetBlock(xSnapshot.m_iBlock);
+
+	if (xSnapshot.m_iDirection < PlayerDirection_Max)
+	{
+		switch (xSnapshot.m_iState)
+		{
+		case PlayerState_Move:
+			return pMap->GetAdjacentBlock((t_AdjacentDirection)xSnapshot.m_iDirection, pBlock);
+
+		case PlayerState_Warp:
+			return xSnapshot.m_bLeaving ? pMap->GetAdjacentBlock((t_AdjacentDirection)xSnapshot.m_iDirection, pBlock) : pBlock;
+		}
+	}
+
+	return pBlock;
+}
+
+// =============================================================================
+xpoint CPlayer::GetSnapshotPosition(const CPlayerSnapshot& xSnapshot)
+{
+	const static xint s_iMoveDir[PlayerDirection_Max] = {-1, -1, 1, 1};
+
+	CMapBlock* pBlock = MapManager.GetCurrentMap()->GetBlock(xSnapshot.m_iBlock);
+	xpoint xPosition = pBlock->GetScreenPosition();
+
+	if (xSnapshot.m_iDirection < PlayerDirection_Max)
+	{
+		switch (xSnapshot.m_iState)
+		{
+		case PlayerState_Move:
+			{
+				CMapBlock* pTargetBlock = pBlock->m_pAdjacents[xSnapshot.m_iDirection];
+
+				if (pTargetBlock)
+				{
+					xpoint xDelta = pTargetBlock->GetScreenPosition() - xPosition;
+					xDelta = (xDelta * (xint)xSnapshot.m_iTransition) / 255;
+					xPosition = xPosition + xDelta;
+				}
+			}
+			break;
+
+		case PlayerState_Warp:
+			{
+				xint iDirection = xSnapshot.m_bLeaving ? xSnapshot.m_iDirection : (xSnapshot.m_iDirection + 2) % PlayerDirection_Max;
+				xint iOffset = (48 * xSnapshot.m_iTransition * s_iMoveDir[iDirection]) / 255;
 
-				pPlayer->m_liQueuedMoves.push_back((t_PlayerDirection)iMoveDirection);
+				if (iDirection % 2)
+					xPosition.m_tY += iOffset;
+				else
+					xPosition.m_tX += iOffset;
 			}
 			break;
 		}
 	}
+
+	return xPosition;
+}
+
+// =============================================================================
+void CPlayer::SetSnapshotState(const CPlayerSnapshot& xSnapshot)
+{
+	CPlayerMovement& xMovement = GetMovement();
+
+	t_PlayerState iState = (t_PlayerState)xSnapshot.m_iState;
+	t_PlayerDirection iDirection = (xSnapshot.m_iDirection < PlayerDirection_Max) ? (t_PlayerDirection)xSnapshot.m_iDirection : xMovement.m_iMoveDir;
+	t_PlayerDirection iTransitionDir = (iState == PlayerState_Warp && !xSnapshot.m_bLeaving) ? (t_PlayerDirection)((iDirection + 2) % PlayerDirection_Max) : iDirection;
+	xbool bChanged = (iState != GetState() || iTransitionDir != xMovement.m_iTransitionDir);
+
+	EnterBlock(MapManager.GetCurrentMap()->GetBlock(xSnapshot.m_iBlock));
+	xMovement.m_pTargetBlock = (iState == PlayerState_Move) ? xMovement.m_pCurrentBlock->m_pAdjacents[iDirection] : NULL;
+	xMovement.m_fTransition = (xfloat)xSnapshot.m_iTransition / 255.f;
+	xMovement.m_bLeaving = xSnapshot.m_bLeaving;
+	xMovement.m_iMoveDir = iDirection;
+	xMovement.m_iLastDir = iDirection;
+	xMovement.m_iTransitionDir = iTransitionDir;
+
+	// Only change state when required so animations aren't restarted.
+	if (bChanged)
+		SetState(iState);
+}
+
+// =============================================================================
+void CPlayer::Reconcile(const CPlayerSnapshot& xSnapshot)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+	t_PlayerInputList& lxInputHistory = GetReplication().m_lxInputHistory;
+
+	// Discard the inputs the host has already applied.
+	while (lxInputHistory.size() && (xint16)(lxInputHistory.front().m_iSequence - xSnapshot.m_iInputSequence) <= 0)
+		lxInputHistory.pop_front();
+
+	// Rewind to the authoritative state and replay the remaining inputs.
+	CMapBlock* pBlock = GetDestinationBlock(xSnapshot);
+
+	XEN_LIST_FOREACH(t_PlayerInputList, pInput, lxInputHistory)
+		pBlock = pMap->GetAdjacentBlock((t_AdjacentDirection)pInput->m_iDirection, pBlock);
+
+	// If our prediction disagrees, move to the corrected block.
+	CMapBlock* pPredictedBlock = GetDestinationBlock();
+
+	if (pBlock != pPredictedBlock)
+	{
+		CPlayerMovement& xMovement = GetMovement();
+
+		SnapshotManager.RecordCorrection(pMap->GetDistance(pBlock, pPredictedBlock));
+
+		xMovement.m_iTime = 0;
+		xMovement.m_fTransition = 0.f;
+		xMovement.m_bLeaving = false;
+
+		SetCurrentBlock(pBlock);
+		SetState(PlayerState_Idle);
+	}
 }
 
 //##############################################################################
 
 // =============================================================================
-CPacman::CPacman() : CPlayer(PlayerType_Pacman, "Player-Pacman"), CCollidable(CollisionGroup_Player, CollisionType_Circle)
+CPacman::CPacman() : CPlayer(PlayerType_Pacman, "Player-Pacman")
 {
+	GetControl().m_pBrain = new CPacmanBrain(this);
+
 	SetState(PlayerState_Idle);
 }
 
 // =============================================================================
-void CPacman::Update()
+CPacman::~CPacman()
 {
-	CPlayer::Update();
+	delete GetControl().m_pBrain;
 }
 
 // =============================================================================
@@ -470,9 +650,9 @@ void CPacman::SetState(t_PlayerState iState)
 	case PlayerState_Warp:
 		{
 			m_pSprite->Play("Move");
-			m_pSprite->SetAngle((xfloat)m_iTransitionDir * 90.f, true);
+			m_pSprite->SetAngle((xfloat)GetMovement().m_iTransitionDir * 90.f, true);
 
-			m_iMoveTime = _MOVETIME;
+			GetMovement().m_iMoveTime = _MOVETIME;
 		}
 		break;
 
@@ -487,29 +667,25 @@ void CPacman::SetState(t_PlayerState iState)
 }
 
 // =============================================================================
-xcircle CPacman::GetCollisionCircle()
+xbool CPacman::IsCollidable(CPlayer* pWith)
 {
-	return xcircle(m_pSprite->GetPosition(), m_pSprite->GetAreaWidth() / 3);
+	return GetState() != PlayerState_Die;
 }
 
 // =============================================================================
-xbool CPacman::IsCollidable(CCollidable* pWith)
-{
-	return (dynamic_cast<CPlayer*>(pWith) != NULL) && m_iState != PlayerState_Die;
-}
-
-// =============================================================================
-void CPacman::OnCollision(CCollidable* pWith)
+void CPacman::OnCollision(CPlayer* pWith)
 {
 	// If we collided with a ghost player.
-	CPlayer* pPlayer = dynamic_cast<CPlayer*>(pWith);
-
-	if (pPlayer && pPlayer->GetType() == PlayerType_Ghost)
+	if (pWith->GetType() == PlayerType_Ghost)
 	{
-		CGameScreen* pGameScreen = (CGameScreen*)ScreenManager.FindScreen(ScreenIndex_GameScreen);
+		// A hosted match has no screen and watches for the death itself.
+		if (!CMatchContext::GetCurrent())
+		{
+			CGameScreen* pGameScreen = (CGameScreen*)ScreenManager.FindScreen(ScreenIndex_GameScreen);
 
-		if (pGameScreen)
-			pGameScreen->OnPacmanDie((CGhost*)pPlayer);
+			if (pGameScreen && pGameScreen->IsActive())
+				pGameScreen->OnPacmanDie((CGhost*)pWith);
+		}
 
 		SetState(PlayerState_Die);
 	}
@@ -518,11 +694,11 @@ void CPacman::OnCollision(CCollidable* pWith)
 //##############################################################################
 
 // =============================================================================
-CGhost::CGhost(xuint iColour) : CPlayer(PlayerType_Ghost, "Player-Ghost"), CCollidable(CollisionGroup_Player, CollisionType_Circle),
+CGhost::CGhost(xuint iColour) : CPlayer(PlayerType_Ghost, "Player-Ghost"),
 	m_pEyes(NULL),
 	m_iColour(iColour)
 {
-	m_pBrain = new CGhostBrain(this);
+	GetControl().m_pBrain = new CGhostBrain(this);
 
 	m_pEyes = new CSprite(_SPRITE("Player-Ghost-Eyes"));
 	m_pEyes->SetArea("F1");
@@ -534,16 +710,10 @@ CGhost::CGhost(xuint iColour) : CPlayer(PlayerType_Ghost, "Player-Ghost"), CColl
 // =============================================================================
 CGhost::~CGhost()
 {
-	delete m_pBrain;
+	delete GetControl().m_pBrain;
 	delete m_pEyes;
 }
 
-// =============================================================================
-void CGhost::Update()
-{
-	CPlayer::Update();
-}
-
 // =============================================================================
 void CGhost::OnRender()
 {
@@ -557,7 +727,7 @@ void CGhost::OnRender()
 		m_pEyes->SetAlpha(m_pSprite->GetAlpha());
 	else
 		m_pEyes->SetAlpha(1.f);
-	
+
 	m_pEyes->Render();
 }
 
@@ -576,11 +746,13 @@ void CGhost::SetState(t_PlayerState iState)
 	case PlayerState_Move:
 	case PlayerState_Warp:
 		{
-			m_pEyes->SetArea(XFORMAT("F%d", m_iTransitionDir + 1));
-			m_iMoveTime = m_pSprite->GetAnimation()->m_iAnimationTime;
+			CPlayerMovement& xMovement = GetMovement();
+
+			m_pEyes->SetArea(XFORMAT("F%d", xMovement.m_iTransitionDir + 1));
+			xMovement.m_iMoveTime = m_pSprite->GetAnimation()->m_iAnimationTime;
 
-			if (m_pCurrentBlock->m_iTileType == TileType_Entrance || (m_pTargetBlock && m_pTargetBlock->m_iTileType == TileType_Entrance))
-				m_iMoveTime *= 3;
+			if (xMovement.m_pCurrentBlock->m_iTileType == TileType_Entrance || (xMovement.m_pTargetBlock && xMovement.m_pTargetBlock->m_iTileType == TileType_Entrance))
+				xMovement.m_iMoveTime *= 3;
 		}
 		break;
 	}
@@ -589,19 +761,13 @@ void CGhost::SetState(t_PlayerState iState)
 }
 
 // =============================================================================
-xcircle CGhost::GetCollisionCircle()
-{
-	return xcircle(m_pSprite->GetPosition(), m_pSprite->GetAreaWidth() / 3);
-}
-
-// =============================================================================
-xbool CGhost::IsCollidable(CCollidable* pWith)
+xbool CGhost::IsCollidable(CPlayer* pWith)
 {
 	return true;
 }
 
 // =============================================================================
-void CGhost::OnCollision(CCollidable* pWith)
+void CGhost::OnCollision(CPlayer* pWith)
 {
 }
 
@@ -612,14 +778,58 @@ void CPlayerManager::Initialise()
 {
 	m_bPlayersEnabled = true;
 
-    // Create all the available players.
-	m_lpPlayers.push_back(new CPacman());
-    m_lpPlayers.push_back(new CPacman());
-	m_lpPlayers.push_back(new CGhost(0xFF40F0F0));
-	m_lpPlayers.push_back(new CGhost(0xFFF04040));
-	m_lpPlayers.push_back(new CGhost(0xFF4040F0));
-	m_lpPlayers.push_back(new CGhost(0xFFF0F040));
-	m_lpPlayers.push_back(new CGhost(0xFFF040F0));
+    // Create the players used by the standard maps, larger maps will create more as they are loaded.
+	CreatePlayers(2, 5);
+}
+
+// =============================================================================
+void CPlayerManager::CreatePlayers(xint iPacmanCount, xint iGhostCount)
+{
+	xint iGhostIndex = 0;
+
+	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, m_lpPlayers)
+	{
+		if ((*ppPlayer)->GetType() == PlayerType_Pacman)
+			iPacmanCount--;
+		else
+			iGhostIndex++;
+	}
+
+	for (; iPacmanCount > 0; --iPacmanCount)
+		m_lpPlayers.push_back(new CPacman());
+
+	for (; iGhostIndex < iGhostCount; ++iGhostIndex)
+		m_lpPlayers.push_back(new CGhost(GetGhostColour(iGhostIndex)));
+}
+
+// =============================================================================
+xuint CPlayerManager::GetGhostColour(xint iGhostIndex)
+{
+	static const xuint s_iColours[] = { 0xFF40F0F0, 0xFFF04040, 0xFF4040F0, 0xFFF0F040, 0xFFF040F0 };
+	static const xint s_iColourCount = sizeof(s_iColours) / sizeof(xuint);
+
+	if (iGhostIndex < s_iColourCount)
+		return s_iColours[iGhostIndex];
+
+	// Spread any further ghosts around the hue wheel using the golden angle so neighbours stay distinct.
+	xint iHue = ((iGhostIndex - s_iColourCount) * 137) % 360;
+	xint iSector = iHue / 60;
+	xint iRise = 0x40 + ((iHue % 60) * 0xB0) / 60;
+	xint iFall = 0xF0 - (iRise - 0x40);
+
+	xint iRed = 0x40, iGreen = 0x40, iBlue = 0x40;
+
+	switch (iSector)
+	{
+	case 0: iRed = 0xF0; iGreen = iRise; break;
+	case 1: iRed = iFall; iGreen = 0xF0; break;
+	case 2: iGreen = 0xF0; iBlue = iRise; break;
+	case 3: iGreen = iFall; iBlue = 0xF0; break;
+	case 4: iRed = iRise; iBlue = 0xF0; break;
+	default: iRed = 0xF0; iBlue = iFall; break;
+	}
+
+	return 0xFF000000 | (iRed << 16) | (iGreen << 8) | iBlue;
 }
 
 // =============================================================================
@@ -627,6 +837,31 @@ void CPlayerManager::OnDeinitialise()
 {
     // Create all the available players.
 	XEN_LIST_ERASE_ALL(m_lpPlayers);
+
+	m_lxMovement.clear();
+	m_lxStatus.clear();
+	m_lxControl.clear();
+	m_lxColliders.clear();
+	m_lxReplication.clear();
+}
+
+// =============================================================================
+xint CPlayerManager::CreateComponents()
+{
+	CPlayerStatus xStatus;
+
+	xStatus.m_iType = PlayerType_Pacman;
+	xStatus.m_iLogicType = PlayerLogicType_None;
+	xStatus.m_iState = PlayerState_None;
+	xStatus.m_bActive = false;
+
+	m_lxMovement.push_back(CPlayerMovement());
+	m_lxStatus.push_back(xStatus);
+	m_lxControl.push_back(CPlayerControl());
+	m_lxColliders.push_back(CPlayerCollider());
+	m_lxReplication.push_back(CPlayerReplication());
+
+	return (xint)m_lxStatus.size() - 1;
 }
 
 // =============================================================================
@@ -634,9 +869,212 @@ void CPlayerManager::Update()
 {
 	if (m_bPlayersEnabled)
 	{
-		XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+		UpdateInput();
+		UpdateLogic();
+		BrainScheduler.Update();
+		UpdateMovement();
+		TriggerManager.Update();
+		UpdateSprites();
+		UpdateCollisions();
+	}
+}
+
+// =============================================================================
+xbool CPlayerManager::IsInterpolated(CPlayerStatus& xStatus)
+{
+	return xStatus.m_iLogicType == PlayerLogicType_Remote && NetworkManager.IsRunning() && !NetworkManager.IsHosting();
+}
+
+// =============================================================================
+void CPlayerManager::UpdateInput()
+{
+	for (xint iA = 0; iA < (xint)m_lxStatus.size(); ++iA)
+	{
+		CPlayerStatus& xStatus = m_lxStatus[iA];
+
+		// Local players should check input every update while they are alive.
+		if (!xStatus.m_bActive || xStatus.m_iLogicType != PlayerLogicType_Local || xStatus.m_iState == PlayerState_Die)
+			continue;
+
+		// Check player input for all directions. The input is sampled once per tick so that it can be recorded.
+		for (xuint iB = 0; iB < PlayerDirection_Max; ++iB)
 		{
-			(*ppPlayer)->Update();
+			if (ReplayManager.GetInput() & XBIT(iB))
+				m_lxMovement[iA].m_iRequestedDir = (t_PlayerDirection)iB;
+		}
+	}
+}
+
+// =============================================================================
+void CPlayerManager::UpdateLogic()
+{
+	for (xint iA = 0; iA < (xint)m_lxStatus.size(); ++iA)
+	{
+		CPlayerStatus& xStatus = m_lxStatus[iA];
+
+		// Idle is a logic state so any move decided on here is processed immediately by the movement system.
+		if (xStatus.m_bActive && xStatus.m_iState == PlayerState_Idle && !IsInterpolated(xStatus))
+			m_lpPlayers[iA]->Logic();
+	}
+}
+
+// =============================================================================
+void CPlayerManager::UpdateMovement()
+{
+	const static xfloat s_fMoveDir[PlayerDirection_Max] = {-1.f, -1.f, 1.f, 1.f};
+	static xfloat s_fBlockSize = 48.f;
+
+	xint iTimeDelta = (xint)_TIMEDELTA;
+
+	for (xint iA = 0; iA < (xint)m_lxMovement.size(); ++iA)
+	{
+		CPlayerStatus& xStatus = m_lxStatus[iA];
+		CPlayerMovement& xMovement = m_lxMovement[iA];
+
+		if (!xStatus.m_bActive)
+			continue;
+
+		// Remote players on a client are driven by the host's snapshots rather than their own movement.
+		if (IsInterpolated(xStatus))
+		{
+			m_lpPlayers[iA]->UpdateInterpolation();
+			continue;
+		}
+
+		switch (xStatus.m_iState)
+		{
+		case PlayerState_Move:
+			{
+				// Move the player along their path.
+				xMovement.m_iTime = Math::Clamp<xint>(xMovement.m_iTime + iTimeDelta, 0, xMovement.m_iMoveTime);
+				xMovement.m_fTransition = Math::Clamp((xfloat)xMovement.m_iTime / (xfloat)xMovement.m_iMoveTime, 0.f, 1.f);
+
+				xpoint xCurrentPosition = xMovement.m_pCurrentBlock->GetScreenPosition();
+				xpoint xTargetPosition = xMovement.m_pTargetBlock->GetScreenPosition();
+
+				xMovement.m_xPosition = xCurrentPosition + (((xTargetPosition - xCurrentPosition) * xMovement.m_iTime) / xMovement.m_iMoveTime);
+
+				// See if we have arrived at the next block.
+				if (xMovement.m_xPosition == xTargetPosition)
+				{
+					m_lpPlayers[iA]->EnterBlock(xMovement.m_pTargetBlock);
+					xMovement.m_pTargetBlock = NULL;
+
+					m_lpPlayers[iA]->SetState(PlayerState_Idle);
+				}
+			}
+			break;
+
+		case PlayerState_Warp:
+			{
+				if (xMovement.m_bLeaving)
+				{
+					xMovement.m_iTime = Math::Clamp<xint>(xMovement.m_iTime + iTimeDelta, 0, xMovement.m_iMoveTime);
+					xMovement.m_fTransition = Math::Clamp((xfloat)xMovement.m_iTime / (xfloat)xMovement.m_iMoveTime, 0.f, 1.f);
+
+					if (xMovement.m_iTime == xMovement.m_iMoveTime)
+					{
+						xMovement.m_fTransition = 1.f;
+						m_lpPlayers[iA]->EnterBlock(MapManager.GetCurrentMap()->GetAdjacentBlock((t_AdjacentDirection)xMovement.m_iTransitionDir, xMovement.m_pCurrentBlock));
+						xMovement.m_iTransitionDir = (t_PlayerDirection)((xMovement.m_iTransitionDir + 2) % PlayerDirection_Max);
+						xMovement.m_bLeaving = false;
+					}
+				}
+				else
+				{
+					xMovement.m_iTime = Math::Clamp<xint>(xMovement.m_iTime - iTimeDelta, 0, xMovement.m_iMoveTime);
+					xMovement.m_fTransition = Math::Clamp((xfloat)xMovement.m_iTime / (xfloat)xMovement.m_iMoveTime, 0.f, 1.f);
+
+					if (xMovement.m_iTime == 0)
+					{
+						xMovement.m_fTransition = 0.f;
+						m_lpPlayers[iA]->SetState(PlayerState_Idle);
+					}
+				}
+
+				xpoint xOffset;
+
+				if (xMovement.m_iTransitionDir % 2)
+					xOffset.m_tY = (xint)(xMovement.m_fTransition * s_fBlockSize * s_fMoveDir[xMovement.m_iTransitionDir]);
+				else
+					xOffset.m_tX = (xint)(xMovement.m_fTransition * s_fBlockSize * s_fMoveDir[xMovement.m_iTransitionDir]);
+
+				xMovement.m_xPosition = xMovement.m_pCurrentBlock->GetScreenPosition() + xOffset;
+
+				if (m_pLocalPlayer == m_lpPlayers[iA])
+					Global.m_fMapAlpha = Math::Clamp(1.f - xMovement.m_fTransition, 0.f, 1.f);
+			}
+			break;
+
+		case PlayerState_Die:
+			{
+				// Burst into particle dust, the ghost should keep moving.
+				// Restart the round.
+			}
+			break;
+		}
+	}
+}
+
+// =============================================================================
+void CPlayerManager::UpdateSprites()
+{
+	for (xint iA = 0; iA < (xint)m_lxMovement.size(); ++iA)
+	{
+		if (!m_lxStatus[iA].m_bActive)
+			continue;
+
+		CPlayerMovement& xMovement = m_lxMovement[iA];
+		CAnimatedSprite* pSprite = m_lpPlayers[iA]->m_pSprite;
+
+		pSprite->SetPosition(xMovement.m_xPosition);
+
+		// Calculate visibility of local player.
+		if (m_lpPlayers[iA] != m_pLocalPlayer)
+		{
+			xfloat fVisibility = (xMovement.m_pCurrentBlock->m_fPlayerVisibility * (1.f - xMovement.m_fTransition));
+
+			if (xMovement.m_pTargetBlock)
+				fVisibility += xMovement.m_pTargetBlock->m_fPlayerVisibility * xMovement.m_fTransition;
+
+			pSprite->SetAlpha(fVisibility);
+		}
+		else
+			pSprite->SetAlpha(1.f);
+
+		pSprite->Update();
+	}
+}
+
+// =============================================================================
+void CPlayerManager::UpdateCollisions()
+{
+	PROFILE_SECTION(ProfileSection_Collision);
+
+	for (xint iA = 0; iA < (xint)m_lxColliders.size(); ++iA)
+	{
+		if (!m_lxStatus[iA].m_bActive)
+			continue;
+
+		for (xint iB = iA + 1; iB < (xint)m_lxColliders.size(); ++iB)
+		{
+			if (!m_lxStatus[iB].m_bActive)
+				continue;
+
+			CPlayer* pA = m_lpPlayers[iA];
+			CPlayer* pB = m_lpPlayers[iB];
+
+			if (pA->IsCollidable(pB) && pB->IsCollidable(pA))
+			{
+				xcircle xA(m_lxMovement[iA].m_xPosition, m_lxColliders[iA].m_iRadius);
+				xcircle xB(m_lxMovement[iB].m_xPosition, m_lxColliders[iB].m_iRadius);
+
+				if (Math::IsIntersecting(xA, xB))
+				{
+					pA->OnCollision(pB);
+					pB->OnCollision(pA);
+				}
+			}
 		}
 	}
 }
@@ -656,6 +1094,8 @@ void CPlayerManager::InitialisePlayers(t_PlayerLogicType iLogicType)
 	ResetPlayers();
 	EstablishActivePlayers();
 
+	BrainScheduler.Reset();
+
 	// Make sure there is no local player by default.
 	m_pLocalPlayer = NULL;
 
@@ -664,15 +1104,6 @@ void CPlayerManager::InitialisePlayers(t_PlayerLogicType iLogicType)
 	{
 		(*ppPlayer)->SetLogicType(iLogicType);
 	}
-
-	// Make all players collidable with each other.
-	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, GetActivePlayers())
-	{
-		if ((*ppPlayer)->GetType() == PlayerType_Pacman)
-			CollisionManager.Add((CPacman*)(*ppPlayer), CollisionGroup_Player);
-		else if ((*ppPlayer)->GetType() == PlayerType_Ghost)
-			CollisionManager.Add((CGhost*)(*ppPlayer), CollisionGroup_Player);
-	}
 }
 
 // =============================================================================
@@ -681,6 +1112,11 @@ void CPlayerManager::EstablishActivePlayers()
 	xint iPacmanCount = MapManager.GetCurrentMap()->GetPacmanCount();
 	xint iGhostCount = MapManager.GetCurrentMap()->GetGhostCount();
 
+	XMASSERT(iPacmanCount + iGhostCount <= _MAXPLAYERS, "The map has more players than a match supports.");
+
+	// Players are only ever added so that every machine creates them in the same order.
+	CreatePlayers(iPacmanCount, iGhostCount);
+
 	m_lpActivePlayers.clear();
 
 	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, m_lpPlayers)
@@ -699,6 +1135,8 @@ void CPlayerManager::EstablishActivePlayers()
 			break;
 		}
 
+		pPlayer->GetStatus().m_bActive = bPlaying;
+
 		if (bPlaying)
 		{
 			m_lpActivePlayers.push_back(pPlayer);
@@ -10,6 +10,7 @@
 #include <Map.h>
 #include <Network.h>
 #include <Collision.h>
+#include <Snapshot.h>
 
 //##############################################################################
 
@@ -60,9 +61,141 @@ enum t_PlayerStreamType
 	PlayerStreamType_Move,
 };
 
+// The maximum number of unacknowledged inputs kept for reconciliation.
+#define PLAYER_INPUT_HISTORY 64
+
+// The maximum number of inputs from a client the host applies each tick, so that a burst can't move a player any distance at once.
+#define PLAYER_INPUTS_PER_TICK 4
+
+// The maximum number of snapshots kept for interpolation.
+#define PLAYER_SAMPLE_HISTORY 32
+
+// A sequenced movement input made by a player.
+class CPlayerInput
+{
+public:
+	// The input sequence number.
+	xuint16 m_iSequence;
+
+	// The direction to move in.
+	t_PlayerDirection m_iDirection;
+};
+
+// An authoritative player state received from the host.
+class CPlayerSample
+{
+public:
+	// The time of the sample on the host's snapshot timeline.
+	xint m_iTime;
+
+	// The player state.
+	CPlayerSnapshot m_xState;
+};
+
 // Lists.
 typedef xarray<CPlayer*> t_PlayerList;
-typedef xlist<t_PlayerDirection> t_PlayerDirectionList;
+typedef xlist<CPlayerInput> t_PlayerInputList;
+typedef xlist<CPlayerSample> t_PlayerSampleList;
+
+//##############################################################################
+
+// The transform and movement of a player through the map.
+class CPlayerMovement
+{
+public:
+	// The current map block.
+	CMapBlock* m_pCurrentBlock;
+
+	// The target map block.
+	CMapBlock* m_pTargetBlock;
+
+	// The screen position.
+	xpoint m_xPosition;
+
+	// The current time set for the operation.
+	xint m_iTime;
+
+	// The total time set for the move.
+	xint m_iMoveTime;
+
+	// The transition distance between two blocks clamped to the range 0.0 to 1.0.
+	xfloat m_fTransition;
+
+	// Determines if the player is leaving or entering the map.
+	xbool m_bLeaving;
+
+    // The last requested direction.
+	t_PlayerDirection m_iRequestedDir;
+
+    // The last direction we travelled.
+	t_PlayerDirection m_iLastDir;
+
+	// The movement direction.
+	t_PlayerDirection m_iMoveDir;
+
+	// The transition direction.
+	t_PlayerDirection m_iTransitionDir;
+};
+
+// The state of a player and how it is controlled.
+class CPlayerStatus
+{
+public:
+	// The type of the player.
+	t_PlayerType m_iType;
+
+	// The player logic type.
+	t_PlayerLogicType m_iLogicType;
+
+	// The state of the player.
+	t_PlayerState m_iState;
+
+	// Determines if the player is in the current game.
+	xbool m_bActive;
+};
+
+// The decision making of a player.
+class CPlayerControl
+{
+public:
+	// The current navigation path for this player (overrides other behaviours).
+	CNavigationPath* m_pNavPath;
+
+	// The player's brain!
+	CBrain* m_pBrain;
+};
+
+// The collision proxy of a player.
+class CPlayerCollider
+{
+public:
+	// The radius of the collision circle around the player's position.
+	xint m_iRadius;
+};
+
+// The network replication state of a player.
+class CPlayerReplication
+{
+public:
+	// The queued inputs from the network.
+	t_PlayerInputList m_lxQueuedInputs;
+
+	// The local inputs not yet acknowledged by the host.
+	t_PlayerInputList m_lxInputHistory;
+
+	// The last input sequence number made locally or applied by the host.
+	xuint16 m_iInputSequence;
+
+	// The authoritative states used to interpolate remote players.
+	t_PlayerSampleList m_lxSamples;
+};
+
+// Component lists.
+typedef xarray<CPlayerMovement> t_PlayerMovementList;
+typedef xarray<CPlayerStatus> t_PlayerStatusList;
+typedef xarray<CPlayerControl> t_PlayerControlList;
+typedef xarray<CPlayerCollider> t_PlayerColliderList;
+typedef xarray<CPlayerReplication> t_PlayerReplicationList;
 
 //##############################################################################
 class CPlayer : public CRenderable
@@ -73,6 +206,7 @@ public:
 	friend CMap;
 	friend CBrain;
 	friend CGhostBrain;
+	friend CSnapshotManager;
 
 	// Destructor.
 	virtual ~CPlayer();
@@ -83,9 +217,6 @@ public:
 	// Revive the player from a dead state.
 	virtual void Revive();
 
-	// Update the object ready for rendering.
-	virtual void Update();
-
 	// Render the object.
 	virtual void OnRender();
 
@@ -95,16 +226,31 @@ public:
 		return m_iIndex;
 	}
 
+	// Get the player's movement component.
+	inline CPlayerMovement& GetMovement();
+
+	// Get the player's status component.
+	inline CPlayerStatus& GetStatus();
+
+	// Get the player's control component.
+	inline CPlayerControl& GetControl();
+
+	// Get the player's collision component.
+	inline CPlayerCollider& GetCollider();
+
+	// Get the player's replication component.
+	inline CPlayerReplication& GetReplication();
+
 	// Get the type of the player.
 	t_PlayerType GetType()
 	{
-		return m_iType;
+		return GetStatus().m_iType;
 	}
 
 	// Get the current state of the player.
 	t_PlayerState GetState()
 	{
-		return m_iState;
+		return GetStatus().m_iState;
 	}
 
 	// Get the internal sprite.
@@ -119,40 +265,47 @@ public:
 	// Get the player logic type.
 	inline t_PlayerLogicType GetLogicType() 
 	{ 
-		return m_iLogicType; 
+		return GetStatus().m_iLogicType; 
 	}
 
+	// Check if the player's moves are decided by its brain. This includes a bot-controlled local player.
+	xbool IsThinking();
+
 	// Set the player's position using a map block.
 	void SetCurrentBlock(CMapBlock* pBlock);
 
 	// Get the current map block this player is on.
 	inline CMapBlock* GetCurrentBlock()
 	{
-		return m_pCurrentBlock;
+		return GetMovement().m_pCurrentBlock;
 	}
 
 	// Set the player's position using a point.
 	inline void SetPosition(xpoint xPosition)
 	{
+		GetMovement().m_xPosition = xPosition;
 		m_pSprite->SetPosition(xPosition);
 	}
 
 	// Get the player's screen position.
 	inline xpoint GetPosition()
 	{
-		return m_pSprite->GetPosition();
+		return GetMovement().m_xPosition;
 	}
 
 	// Navigate the player to a specific block on the map.
 	void NavigateTo(CMapBlock* pBlock);
 
+	// Find a path from the player's position to a specific block without changing any state. The caller owns the path.
+	CNavigationPath* FindPath(CMapBlock* pBlock);
+
 	// Set a navigation path for this player (this will override default behaviours).
 	void SetNavPath(CNavigationPath* pPath);
 
 	// Get the current navigation path for this player.
 	inline CNavigationPath* GetNavPath()
 	{
-		return m_pNavPath;
+		return GetControl().m_pNavPath;
 	}
 
 	// Clear any navigation path this player might have.
@@ -161,6 +314,9 @@ public:
 	// Process incoming streams.
 	static void OnReceivePlayerUpdate(CNetworkPeer* pFrom, BitStream* pStream);
 
+	// Process the authoritative state received from the host at the specified snapshot time.
+	void OnReceiveSnapshot(const CPlayerSnapshot& xSnapshot, xint iTime);
+
 	// The player's starting block.
 	CMapBlock* m_pStartingBlock;
 
@@ -171,9 +327,30 @@ protected:
 	// Called to change the state of the player object.
 	virtual void SetState(t_PlayerState iState);
 
+	// Move the player onto a block without changing their screen position, keeping the map's occupancy index in step.
+	void EnterBlock(CMapBlock* pBlock);
+
+	// Update a remote player's position from the interpolation buffer.
+	void UpdateInterpolation();
+
 	// Execute a move action for the player.
 	void Move(t_PlayerDirection iDirection);
 
+	// Get the block the player will be on once the current move completes.
+	CMapBlock* GetDestinationBlock();
+
+	// Get the block a player will be on once the move in a snapshot completes.
+	CMapBlock* GetDestinationBlock(const CPlayerSnapshot& xSnapshot);
+
+	// Get the screen position of a player from a snapshot.
+	xpoint GetSnapshotPosition(const CPlayerSnapshot& xSnapshot);
+
+	// Set the player's state from a snapshot for rendering and collisions.
+	void SetSnapshotState(const CPlayerSnapshot& xSnapshot);
+
+	// Rewind to the authoritative state and replay any unacknowledged inputs, correcting the player if the prediction was wrong.
+	void Reconcile(const CPlayerSnapshot& xSnapshot);
+
 	// The player logic update where decisions are made regarding state changes.
 	virtual void Logic();
 
@@ -195,74 +372,32 @@ protected:
 		return !pBlock || !pBlock->IsWall();
 	}
 
-	// Called when an animation event occurs.
-	void OnAnimationEvent(CAnimatedSprite* pSprite, const xchar* pEvent);
-
-	// The type of the derived class.
-	t_PlayerType m_iType;
+	// Check if the player is actually collidable with another player at the present time.
+	virtual xbool IsCollidable(CPlayer* pWith) = 0;
 
-	// The player logic type.
-	t_PlayerLogicType m_iLogicType;
+	// Callback that is executed when a valid collision occurs.
+	virtual void OnCollision(CPlayer* pWith) = 0;
 
-	// The state of the player.
-	t_PlayerState m_iState;
+	// Called when an animation event occurs.
+	void OnAnimationEvent(CAnimatedSprite* pSprite, const xchar* pEvent);
 
 	// The player sprite.
 	CAnimatedSprite* m_pSprite;
 
-	// The current map block.
-	CMapBlock* m_pCurrentBlock;
-
-	// The target map block.
-	CMapBlock* m_pTargetBlock;
-
-	// The current time set for the operation.
-	xint m_iTime;
-
-	// The total time set for the move.
-	xint m_iMoveTime;
-
-	// The transition distance between two blocks clamped to the range 0.0 to 1.0.
-	xfloat m_fTransition;
-
-	// Determines if the player is leaving or entering the map.
-	xbool m_bLeaving;
-
-    // The last requested direction.
-	t_PlayerDirection m_iRequestedDir;
-
-    // The last direction we travelled.
-	t_PlayerDirection m_iLastDir;
-
-	// The movement direction.
-	t_PlayerDirection m_iMoveDir;
-
-	// The transition direction.
-	t_PlayerDirection m_iTransitionDir;
-
-	// The queued moves from the network.
-	t_PlayerDirectionList m_liQueuedMoves;
-
-	// The current navigation path for this player (overrides other behaviours).
-	CNavigationPath* m_pNavPath;
-
-	// The player's brain!
-	CBrain* m_pBrain;
-
 private:
-	// The player's index.
+	// The player's index into the player list and the component lists.
 	xint m_iIndex;
 };
 
 //##############################################################################
-class CPacman : public CPlayer, public CCollidable
+class CPacman : public CPlayer
 {
 public:
 	// Costructor.
 	CPacman();
 
-	// Update the object ready for rendering.
-	virtual void Update();
+	// Destructor.
+	virtual ~CPacman();
 
 protected:
 	// Check if the specified block is passable.
@@ -274,19 +409,15 @@ protected:
 	// Called to change the state of the player object.
 	virtual void SetState(t_PlayerState iState);
 
-	// Get the collision circle.
-	virtual xcircle GetCollisionCircle();
-
-	// Check if the object is actually collidable at the present time. 
-	// ~note It is important that both objects must remain valid for the duration of the call.
-	virtual xbool IsCollidable(CCollidable* pWith);
+	// Check if the player is actually collidable with another player at the present time.
+	virtual xbool IsCollidable(CPlayer* pWith);
 
 	// Callback that is executed when a valid collision occurs.
-	virtual void OnCollision(CCollidable* pWith);
+	virtual void OnCollision(CPlayer* pWith);
 };
 
 //##############################################################################
-class CGhost : public CPlayer, public CCollidable
+class CGhost : public CPlayer
 {
 public:
 	// Constructor.
@@ -295,9 +426,6 @@ public:
 	// Destructor.
 	~CGhost();
 
-	// Update the object ready for rendering.
-	virtual void Update();
-
 	// Render the object.
 	virtual void OnRender();
 
@@ -311,15 +439,11 @@ public:
 	}
 
 protected:
-	// Get the collision circle.
-	virtual xcircle GetCollisionCircle();
-
-	// Check if the object is actually collidable at the present time. 
-	// ~note It is important that both objects must remain valid for the duration of the call.
-	virtual xbool IsCollidable(CCollidable* pWith);
+	// Check if the player is actually collidable with another player at the present time.
+	virtual xbool IsCollidable(CPlayer* pWith);
 
 	// Callback that is executed when a valid collision occurs.
-	virtual void OnCollision(CCollidable* pWith);
+	virtual void OnCollision(CPlayer* pWith);
 
 	// The ghost's eyes.
 	CSprite* m_pEyes;
@@ -332,9 +456,15 @@ protected:
 class CPlayerManager : public CModule
 {
 public:
-    // Singleton instance.
+	// Friends.
+	friend CPlayer;
+
+    // Singleton instance, or the instance belonging to the match bound to the calling thread.
 	static inline CPlayerManager& Get() 
 	{
+		if (CMatchContext* pContext = CMatchContext::GetCurrent())
+			return *pContext->m_pPlayerManager;
+
 		static CPlayerManager s_Instance;
 		return s_Instance;
 	}
@@ -345,12 +475,15 @@ public:
     // Free all player resources.
 	virtual void OnDeinitialise();
 
-	// Update the active players.
+	// Update the active players by running each system over the player components.
 	void Update();
 
     // Initialise the players for play.
     void InitialisePlayers(t_PlayerLogicType iLogicType);
 
+	// Create players until there are at least as many of each type as requested.
+	void CreatePlayers(xint iPacmanCount, xint iGhostCount);
+
 	// Enable or disable all players logic and movement.
 	void SetPlayersEnabled(xbool bEnabled)
 	{
@@ -398,7 +531,8 @@ public:
 	// Sets the player being controlled locally.
 	void SetLocalPlayer(CPlayer* pPlayer)
 	{
-		SetLocalPlayer(pPlayer->m_iIndex);
+		m_pLocalPlayer = pPlayer;
+		m_pLocalPlayer->SetLogicType(PlayerLogicType_Local);
 	}
 
 	// Sets the player being controlled locally.
@@ -417,15 +551,88 @@ protected:
     // Determine the list of players for the active map and position them.
 	void EstablishActivePlayers();
 
+	// Add a set of components for a new player and return the index.
+	xint CreateComponents();
+
+	// Get the colour for a ghost by the order it was created in.
+	static xuint GetGhostColour(xint iGhostIndex);
+
+	// Check if a player is driven by the host's snapshots rather than its own movement.
+	xbool IsInterpolated(CPlayerStatus& xStatus);
+
+	// Apply the input sampled for this tick to the local players.
+	void UpdateInput();
+
+	// Run the logic for idle players so they can decide on their next move.
+	void UpdateLogic();
+
+	// Move players along their paths.
+	void UpdateMovement();
+
+	// Apply the simulation state to the player sprites and animate them.
+	void UpdateSprites();
+
+	// Check for collisions between players.
+	void UpdateCollisions();
+
     // The list of all players available to the game.
 	t_PlayerList m_lpPlayers;
 
 	// The list of all active players in the current game.
 	t_PlayerList m_lpActivePlayers;
 
+	// The movement components indexed by player.
+	t_PlayerMovementList m_lxMovement;
+
+	// The status components indexed by player.
+	t_PlayerStatusList m_lxStatus;
+
+	// The control components indexed by player.
+	t_PlayerControlList m_lxControl;
+
+	// The collision components indexed by player.
+	t_PlayerColliderList m_lxColliders;
+
+	// The replication components indexed by player.
+	t_PlayerReplicationList m_lxReplication;
+
 	// The currently active player on the local machine.
 	CPlayer* m_pLocalPlayer;
 
 	// Whether or not to update players.
 	xbool m_bPlayersEnabled;
-};
\ No newline at end of file
+};
+
+//##############################################################################
+
+// =============================================================================
+inline CPlayerMovement& CPlayer::GetMovement()
+{
+	return PlayerManager.m_lxMovement[m_iIndex];
+}
+
+// =============================================================================
+inline CPlayerStatus& CPlayer::GetStatus()
+{
+	return PlayerManager.m_lxStatus[m_iIndex];
+}
+
+// =============================================================================
+inline CPlayerControl& CPlayer::GetControl()
+{
+	return PlayerManager.m_lxControl[m_iIndex];
+}
+
+// =============================================================================
+inline CPlayerCollider& CPlayer::GetCollider()
+{
+	return PlayerManager.m_lxColliders[m_iIndex];
+}
+
+// =============================================================================
+inline CPlayerReplication& CPlayer::GetReplication()
+{
+	return PlayerManager.m_lxReplication[m_iIndex];
+}
+
+//##############################################################################
@@ -15,4 +15,63 @@
 // Local.
 #include <Power.h>
 
+// Other.
+#include <Map.h>
+#include <Player.h>
+
+//##############################################################################
+
+// =============================================================================
+CPower::CPower(CMapBlock* pBlock) :
+	m_pBlock(pBlock),
+	m_bAvailable(true),
+	m_pHolder(NULL)
+{
+	m_pBlock->m_pPower = this;
+	TriggerManager.Register(this, m_pBlock->m_iIndex);
+}
+
+// =============================================================================
+CPower::~CPower()
+{
+	m_pBlock->m_pPower = NULL;
+}
+
+// =============================================================================
+void CPower::OnEnter(CPlayer* pPlayer)
+{
+	if (!m_bAvailable || pPlayer->GetType() != PlayerType_Pacman)
+		return;
+
+	m_bAvailable = false;
+	m_pHolder = pPlayer;
+
+	TriggerManager.Schedule(this, POWER_DURATION, PowerTimer_Expire);
+}
+
+// =============================================================================
+void CPower::OnTimer(xint iData)
+{
+	switch (iData)
+	{
+	case PowerTimer_Expire:
+		{
+			m_pHolder = NULL;
+			TriggerManager.Schedule(this, POWER_RESPAWN_TIME, PowerTimer_Respawn);
+		}
+		break;
+
+	case PowerTimer_Respawn:
+		m_bAvailable = true;
+		break;
+	}
+}
+
+// =============================================================================
+void CPower::OnRestart()
+{
+	m_bAvailable = true;
+	m_pHolder = NULL;
+}
+
 //##############################################################################
\ No newline at end of file
@@ -14,11 +14,69 @@
 // Global.
 #include <Global.h>
 
+// Other.
+#include <Trigger.h>
+
+//##############################################################################
+
+// The time in milliseconds a power-up lasts once collected.
+#define POWER_DURATION 8000
+
+// The time in milliseconds before a power-up can be collected again once it wears off.
+#define POWER_RESPAWN_TIME 20000
+
+//##############################################################################
+
+// Predeclare.
+class CMapBlock;
+
+// The timed effects of a power-up.
+enum t_PowerTimer
+{
+	PowerTimer_Expire,
+	PowerTimer_Respawn,
+};
+
 //##############################################################################
-class CPower
+class CPower : public CTrigger
 {
 public:
+	// Constructor. The power-up is bound to the block and registered on it.
+	CPower(CMapBlock* pBlock);
+
+	// Destructor.
+	virtual ~CPower();
+
+	// Give the power-up to the first Pacman to reach it.
+	virtual void OnEnter(CPlayer* pPlayer);
+
+	// Wear off or respawn the power-up.
+	virtual void OnTimer(xint iData);
+
+	// Make the power-up available again.
+	virtual void OnRestart();
+
+	// Check if the power-up is waiting to be collected.
+	inline xbool IsAvailable()
+	{
+		return m_bAvailable;
+	}
+
+	// Get the player the power-up is currently affecting or NULL if none.
+	inline CPlayer* GetHolder()
+	{
+		return m_pHolder;
+	}
+
 protected:
+	// The block the power-up is bound to.
+	CMapBlock* m_pBlock;
+
+	// Determines if the power-up is waiting to be collected.
+	xbool m_bAvailable;
+
+	// The player the power-up is affecting.
+	CPlayer* m_pHolder;
 };
 
 //##############################################################################
\ No newline at end of file
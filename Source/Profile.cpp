@@ -0,0 +1,92 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Profile.h>
+
+// Other.
+#include <Windows.h>
+
+//##############################################################################
+
+// =============================================================================
+CProfileManager::CProfileManager() :
+	m_bEnabled(false),
+	m_iThreadID(0)
+{
+	Reset();
+}
+
+// =============================================================================
+void CProfileManager::Reset()
+{
+	for (xint iA = 0; iA < ProfileSection_Max; ++iA)
+	{
+		m_iDepth[iA] = 0;
+		m_iStart[iA] = 0;
+		m_iTotal[iA] = 0;
+		m_iCalls[iA] = 0;
+	}
+}
+
+// =============================================================================
+void CProfileManager::SetEnabled(xbool bEnabled)
+{
+	m_bEnabled = bEnabled;
+	m_iThreadID = GetCurrentThreadId();
+}
+
+// =============================================================================
+xbool CProfileManager::IsProfiling()
+{
+	return m_bEnabled && GetCurrentThreadId() == m_iThreadID;
+}
+
+// =============================================================================
+xdouble CProfileManager::GetTime(t_ProfileSection iSection)
+{
+	return GetMilliseconds(m_iTotal[iSection]);
+}
+
+// =============================================================================
+const xchar* CProfileManager::GetName(t_ProfileSection iSection)
+{
+	static const xchar* s_pNames[ProfileSection_Max] =
+	{
+		"Navigation",
+		"Map",
+		"Collision",
+		"Brain",
+	};
+
+	return s_pNames[iSection];
+}
+
+// =============================================================================
+xint64 CProfileManager::GetCounter()
+{
+	LARGE_INTEGER xCounter;
+	QueryPerformanceCounter(&xCounter);
+
+	return xCounter.QuadPart;
+}
+
+// =============================================================================
+xdouble CProfileManager::GetMilliseconds(xint64 iInterval)
+{
+	static xint64 s_iFrequency = 0;
+
+	if (!s_iFrequency)
+	{
+		LARGE_INTEGER xFrequency;
+		QueryPerformanceFrequency(&xFrequency);
+
+		s_iFrequency = xFrequency.QuadPart;
+	}
+
+	return ((xdouble)iInterval * 1000.0) / (xdouble)s_iFrequency;
+}
+
+//##############################################################################
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define ProfileManager CProfileManager::Get()
+
+// Time the rest of the current scope against a profile section.
+#define PROFILE_SECTION(SECTION) CProfileScope xProfileScope(SECTION)
+
+//##############################################################################
+
+// The profiled sections of the simulation. Sections are inclusive so a brain's time includes any navigation it requests, and navigation run on worker threads is only counted as brain time.
+enum t_ProfileSection
+{
+	ProfileSection_Navigation,
+	ProfileSection_Map,
+	ProfileSection_Collision,
+	ProfileSection_Brain,
+
+	ProfileSection_Max,
+};
+
+//##############################################################################
+class CProfileManager
+{
+public:
+	// Singleton instance.
+	static inline CProfileManager& Get()
+	{
+		static CProfileManager s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CProfileManager();
+
+	// Clear all recorded timings.
+	void Reset();
+
+	// Enable or disable profiling. Sections are only timed on the thread that enabled profiling.
+	void SetEnabled(xbool bEnabled);
+
+	// Check if profiling is enabled.
+	inline xbool IsEnabled()
+	{
+		return m_bEnabled;
+	}
+
+	// Check if sections entered on the calling thread should be timed.
+	xbool IsProfiling();
+
+	// Begin timing a section.
+	inline void Begin(t_ProfileSection iSection)
+	{
+		if (m_iDepth[iSection]++ == 0)
+			m_iStart[iSection] = GetCounter();
+	}
+
+	// End timing a section.
+	inline void End(t_ProfileSection iSection)
+	{
+		if (--m_iDepth[iSection] == 0)
+		{
+			m_iTotal[iSection] += GetCounter() - m_iStart[iSection];
+			m_iCalls[iSection]++;
+		}
+	}
+
+	// Get the total time spent in a section in milliseconds.
+	xdouble GetTime(t_ProfileSection iSection);
+
+	// Get the number of times a section was entered.
+	inline xint GetCalls(t_ProfileSection iSection)
+	{
+		return m_iCalls[iSection];
+	}
+
+	// Get the display name of a section.
+	static const xchar* GetName(t_ProfileSection iSection);
+
+	// Get the current value of the high resolution counter.
+	static xint64 GetCounter();
+
+	// Convert a high resolution counter interval to milliseconds.
+	static xdouble GetMilliseconds(xint64 iInterval);
+
+protected:
+	// Determines if profiling is enabled.
+	xbool m_bEnabled;
+
+	// The thread that enabled profiling.
+	xuint m_iThreadID;
+
+	// The nesting depth of each section so that recursion is only timed once.
+	xint m_iDepth[ProfileSection_Max];
+
+	// The counter value when each section began.
+	xint64 m_iStart[ProfileSection_Max];
+
+	// The total counter interval spent in each section.
+	xint64 m_iTotal[ProfileSection_Max];
+
+	// The number of times each section was entered.
+	xint m_iCalls[ProfileSection_Max];
+};
+
+//##############################################################################
+class CProfileScope
+{
+public:
+	// Constructor.
+	CProfileScope(t_ProfileSection iSection) :
+		m_iSection(iSection),
+		m_bActive(ProfileManager.IsProfiling())
+	{
+		if (m_bActive)
+			ProfileManager.Begin(m_iSection);
+	}
+
+	// Destructor.
+	~CProfileScope()
+	{
+		if (m_bActive)
+			ProfileManager.End(m_iSection);
+	}
+
+protected:
+	// The section being timed.
+	t_ProfileSection m_iSection;
+
+	// Determines if profiling was enabled when the scope began.
+	xbool m_bActive;
+};
+
+//##############################################################################
\ No newline at end of file
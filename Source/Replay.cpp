@@ -0,0 +1,452 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Replay.h>
+
+// Other.
+#include <Brain.h>
+#include <Map.h>
+#include <Player.h>
+#include <Profile.h>
+#include <RakNet/SuperFastHash.h>
+
+//##############################################################################
+
+// =============================================================================
+CReplayManager::CReplayManager() :
+	m_iState(ReplayState_None),
+	m_iInput(0),
+	m_iEventCount(0),
+	m_iTickCount(0)
+{
+	m_xReplayPeer.m_bHost = false;
+	m_xReplayPeer.m_bLocal = false;
+	m_xReplayPeer.m_iID = 0;
+	m_xReplayPeer.m_bVerified = true;
+	m_xReplayPeer.m_pGamerCard = NULL;
+	m_xReplayPeer.m_pData = NULL;
+}
+
+// =============================================================================
+void CReplayManager::OnDeinitialise()
+{
+	StopRecording();
+}
+
+// =============================================================================
+xbool CReplayManager::StartRecording(const xchar* pFile)
+{
+	if (m_iState != ReplayState_None || !MapManager.GetCurrentMap())
+		return false;
+
+	m_sFile = pFile;
+
+	m_xData.Reset();
+	m_xEvents.Reset();
+
+	m_iEventCount = 0;
+	m_iTickCount = 0;
+
+	// Re-seed the match from a known value so that the replay makes the same decisions.
+	xuint32 iSeed = _TIMEMS;
+	Global.SeedMatch(iSeed);
+
+	m_xData.Write((xuint32)REPLAY_MAGIC);
+	m_xData.Write((xuint16)REPLAY_VERSION);
+	m_xData.Write(iSeed);
+
+	WriteHeader();
+
+	// Only the player updates sent to the host affect the simulation.
+	NetworkManager.SetStreamMonitor(xbind(this, &CReplayManager::OnStreamMonitor));
+
+	m_iState = ReplayState_Recording;
+
+	XLOG("[ReplayManager] Recording to '%s' with seed %u.", pFile, iSeed);
+
+	return true;
+}
+
+// =============================================================================
+void CReplayManager::StopRecording()
+{
+	if (m_iState != ReplayState_Recording)
+		return;
+
+	NetworkManager.SetStreamMonitor(NULL);
+
+	m_iState = ReplayState_None;
+
+	CWinFile* pFile = FileManager.Create(m_sFile.c_str(), FileFlag_WriteOnly | FileFlag_OverwriteExisting);
+
+	if (pFile)
+	{
+		pFile->Write(m_xData.GetData(), m_xData.GetNumberOfBytesUsed());
+		FileManager.Close(pFile);
+
+		XLOG("[ReplayManager] Recorded %d ticks in %d bytes to '%s'.", m_iTickCount, m_xData.GetNumberOfBytesUsed(), m_sFile.c_str());
+	}
+	else
+		XLOG("[ReplayManager] Failed to write the recording to '%s'.", m_sFile.c_str());
+
+	m_xData.Reset();
+}
+
+// =============================================================================
+xbool CReplayManager::Run(const xchar* pFile)
+{
+	CWinFile* pReplayFile = FileManager.Open(pFile, FileFlag_ReadOnly);
+
+	if (!pReplayFile)
+	{
+		XLOG("[ReplayManager] Failed to open the recording '%s'.", pFile);
+		return false;
+	}
+
+	xint iSize = pReplayFile->GetSize();
+	xuint8* pBuffer = new xuint8[iSize];
+
+	pReplayFile->Read(pBuffer, iSize);
+	FileManager.Close(pReplayFile);
+
+	m_xData.Reset();
+	m_xData.Write((const xchar*)pBuffer, iSize);
+
+	delete [] pBuffer;
+
+	// Verify the file.
+	xuint32 iMagic = 0;
+	xuint16 iVersion = 0;
+	xuint32 iSeed = 0;
+
+	m_xData.Read(iMagic);
+	m_xData.Read(iVersion);
+	m_xData.Read(iSeed);
+
+	if (iMagic != REPLAY_MAGIC || iVersion != REPLAY_VERSION)
+	{
+		XLOG("[ReplayManager] The file '%s' is not a compatible recording.", pFile);
+		return false;
+	}
+
+	if (!ReadHeader())
+	{
+		XLOG("[ReplayManager] The recording '%s' does not match the available maps.", pFile);
+		return false;
+	}
+
+	// Setting up the players draws from the match streams so the seed must be applied afterwards.
+	Global.SeedMatch(iSeed);
+
+	m_iState = ReplayState_Replaying;
+	m_iTickCount = 0;
+
+	ProfileManager.Reset();
+	ProfileManager.SetEnabled(true);
+
+	xint64 iStart = CProfileManager::GetCounter();
+
+	// Each tick is at least a byte of flags and a byte of time delta.
+	while (m_xData.GetNumberOfUnreadBits() >= 16)
+	{
+		BeginTick();
+
+		MapManager.Update();
+		PlayerManager.Update();
+	}
+
+	xdouble fTime = CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - iStart);
+
+	ProfileManager.SetEnabled(false);
+
+	m_iState = ReplayState_None;
+	m_xData.Reset();
+
+	XLOG("[ReplayManager] Replayed %d ticks in %.2fms (%.0f ticks/sec).", m_iTickCount, fTime, (fTime > 0.0) ? (xdouble)m_iTickCount * 1000.0 / fTime : 0.0);
+
+	for (xint iA = 0; iA < ProfileSection_Max; ++iA)
+	{
+		t_ProfileSection iSection = (t_ProfileSection)iA;
+
+		XLOG("[ReplayManager] %s: %.2fms in %d calls (%.1f%%).",
+			CProfileManager::GetName(iSection),
+			ProfileManager.GetTime(iSection),
+			ProfileManager.GetCalls(iSection),
+			(fTime > 0.0) ? ProfileManager.GetTime(iSection) * 100.0 / fTime : 0.0);
+	}
+
+	BrainScheduler.LogStats();
+
+	XLOG("[ReplayManager] Final state hash: %08X.", HashState());
+
+	return true;
+}
+
+// =============================================================================
+void CReplayManager::BeginTick()
+{
+	if (m_iState == ReplayState_Replaying)
+	{
+		xuint8 iFlags = 0;
+		m_xData.Read(iFlags);
+
+		if (iFlags & ReplayTickFlag_LongDelta)
+		{
+			xuint16 iDelta = 0;
+			m_xData.Read(iDelta);
+
+			Application::SetTimeDelta(iDelta);
+		}
+		else
+		{
+			xuint8 iDelta = 0;
+			m_xData.Read(iDelta);
+
+			Application::SetTimeDelta(iDelta);
+		}
+
+		m_iInput = iFlags & ReplayTickFlag_Input;
+		Global.m_bWindowFocused = (iFlags & ReplayTickFlag_Focused) != 0;
+
+		// Dispatch the network events in the order they were received.
+		if (iFlags & ReplayTickFlag_Events)
+		{
+			xuint16 iEventCount = 0;
+			m_xData.Read(iEventCount);
+
+			for (xint iA = 0; iA < iEventCount; ++iA)
+			{
+				xuint8 iStreamType = 0;
+				xuint8 iFrom = 0;
+				xuint32 iBits = 0;
+
+				m_xData.Read(iStreamType);
+				m_xData.Read(iFrom);
+				m_xData.Read(iBits);
+
+				BitStream xStream;
+				m_xData.Read(&xStream, iBits);
+
+				m_xReplayPeer.m_iID = iFrom;
+				NetworkManager.DispatchStream(&m_xReplayPeer, iStreamType, &xStream);
+			}
+		}
+
+		m_iTickCount++;
+		return;
+	}
+
+	// Sample the input once so that every player sees the same state this tick.
+	m_iInput = 0;
+
+	// Bot-controlled players are steered by their brains, so the keys are left alone.
+	if (!Global.m_bBotControlled)
+	{
+		for (xuint iA = 0; iA < PlayerDirection_Max; ++iA)
+		{
+			if (_HGE->Input_GetKeyState(HGEK_LEFT + iA))
+				m_iInput |= XBIT(iA);
+		}
+	}
+
+	if (m_iState == ReplayState_Recording)
+	{
+		xuint iDelta = Math::Min<xuint>(_TIMEDELTA, 0xFFFF);
+		xuint8 iFlags = (xuint8)m_iInput;
+
+		if (Global.m_bWindowFocused)
+			iFlags |= ReplayTickFlag_Focused;
+
+		if (m_iEventCount)
+			iFlags |= ReplayTickFlag_Events;
+
+		if (iDelta > 0xFF)
+			iFlags |= ReplayTickFlag_LongDelta;
+
+		m_xData.Write(iFlags);
+
+		if (iFlags & ReplayTickFlag_LongDelta)
+			m_xData.Write((xuint16)iDelta);
+		else
+			m_xData.Write((xuint8)iDelta);
+
+		if (m_iEventCount)
+		{
+			m_xData.Write((xuint16)m_iEventCount);
+			m_xData.Write(&m_xEvents, m_xEvents.GetNumberOfBitsUsed());
+
+			m_xEvents.Reset();
+			m_iEventCount = 0;
+		}
+
+		m_iTickCount++;
+	}
+}
+
+// =============================================================================
+xuint32 CReplayManager::HashState()
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+
+	if (!pMap)
+		return 0;
+
+	xuint32 iHash = 0;
+
+	XEN_LIST_FOREACH(t_PlayerList, ppPlayer, PlayerManager.GetActivePlayers())
+	{
+		CPlayer* pPlayer = *ppPlayer;
+
+		xint32 iState[4] =
+		{
+			pPlayer->GetCurrentBlock() ? pPlayer->GetCurrentBlock()->m_iIndex : -1,
+			pPlayer->GetState(),
+			pPlayer->GetPosition().m_tX,
+			pPlayer->GetPosition().m_tY,
+		};
+
+		iHash = SuperFastHashIncremental((const char*)iState, sizeof(iState), iHash);
+	}
+
+	const t_BlockBitmap& lpEatenBitmap = pMap->GetEatenBitmap();
+
+	if (lpEatenBitmap.size())
+		iHash = SuperFastHashIncremental((const char*)&lpEatenBitmap[0], (int)(lpEatenBitmap.size() * sizeof(xuint32)), iHash);
+
+	return iHash;
+}
+
+// =============================================================================
+void CReplayManager::OnStreamMonitor(CNetworkPeer* pFrom, xint iStreamType, BitStream* pStream)
+{
+	if (iStreamType != NetworkStreamType_PlayerUpdate)
+		return;
+
+	xuint32 iBits = pStream->GetNumberOfUnreadBits();
+	xuint32 iReadOffset = pStream->GetReadOffset();
+
+	m_xEvents.Write((xuint8)iStreamType);
+	m_xEvents.Write((xuint8)pFrom->m_iID);
+	m_xEvents.Write(iBits);
+	m_xEvents.Write(pStream, iBits);
+
+	// Leave the stream as it was for the receiving callback.
+	pStream->SetReadOffset(iReadOffset);
+
+	m_iEventCount++;
+}
+
+// =============================================================================
+void CReplayManager::WriteHeader()
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+
+	m_xData.Write((xuint8)strlen(pMap->GetID()));
+	m_xData.Write(pMap->GetID(), (xuint)strlen(pMap->GetID()));
+
+	// The starting state of each player.
+	t_PlayerList& lpPlayers = PlayerManager.GetActivePlayers();
+	xuint8 iLocalPlayer = 0xFF;
+
+	m_xData.Write((xuint8)lpPlayers.size());
+
+	for (xint iA = 0; iA < (xint)lpPlayers.size(); ++iA)
+	{
+		CPlayer* pPlayer = lpPlayers[iA];
+
+		m_xData.Write((xuint32)pPlayer->GetCurrentBlock()->m_iIndex);
+		m_xData.Write((xuint8)pPlayer->GetLogicType());
+
+		if (pPlayer == PlayerManager.GetLocalPlayer())
+			iLocalPlayer = (xuint8)iA;
+	}
+
+	m_xData.Write(iLocalPlayer);
+
+	// The pellets already eaten.
+	const t_BlockBitmap& lpEatenBitmap = pMap->GetEatenBitmap();
+
+	m_xData.Write((xuint16)lpEatenBitmap.size());
+
+	for (xint iA = 0; iA < (xint)lpEatenBitmap.size(); ++iA)
+		m_xData.Write(lpEatenBitmap[iA]);
+}
+
+// =============================================================================
+xbool CReplayManager::ReadHeader()
+{
+	xuint8 iLength = 0;
+	xchar cMapID[256];
+
+	m_xData.Read(iLength);
+	m_xData.Read(cMapID, iLength);
+	cMapID[iLength] = 0;
+
+	CMap* pMap = MapManager.SetCurrentMap(cMapID);
+
+	if (!pMap)
+		return false;
+
+	PlayerManager.InitialisePlayers(PlayerLogicType_None);
+
+	// Restore the starting state of each player.
+	t_PlayerList& lpPlayers = PlayerManager.GetActivePlayers();
+	xuint8 iPlayerCount = 0;
+
+	m_xData.Read(iPlayerCount);
+
+	if (iPlayerCount != lpPlayers.size())
+		return false;
+
+	for (xint iA = 0; iA < (xint)lpPlayers.size(); ++iA)
+	{
+		CPlayer* pPlayer = lpPlayers[iA];
+
+		xuint32 iBlock = 0;
+		xuint8 iLogicType = 0;
+
+		m_xData.Read(iBlock);
+		m_xData.Read(iLogicType);
+
+		if (iBlock >= (xuint32)pMap->GetBlockCount())
+			return false;
+
+		pPlayer->Revive();
+		pPlayer->SetCurrentBlock(pMap->GetBlock(iBlock));
+		pPlayer->m_pStartingBlock = pPlayer->GetCurrentBlock();
+		pPlayer->SetLogicType((t_PlayerLogicType)iLogicType);
+	}
+
+	xuint8 iLocalPlayer = 0xFF;
+	m_xData.Read(iLocalPlayer);
+
+	if (iLocalPlayer < lpPlayers.size())
+		PlayerManager.SetLocalPlayer(lpPlayers[iLocalPlayer]);
+
+	// Restore the pellets already eaten.
+	xuint16 iBitmapSize = 0;
+	m_xData.Read(iBitmapSize);
+
+	for (xint iA = 0; iA < iBitmapSize; ++iA)
+	{
+		xuint32 iBits = 0;
+		m_xData.Read(iBits);
+
+		for (xint iB = 0; iB < 32; ++iB)
+		{
+			xint iBlock = (iA << 5) + iB;
+
+			if (iBlock < pMap->GetBlockCount())
+				pMap->SetEaten(iBlock, (iBits & (1u << iB)) != 0);
+		}
+	}
+
+	PlayerManager.SetPlayersEnabled(true);
+
+	return true;
+}
+
+//##############################################################################
@@ -0,0 +1,129 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Other.
+#include <Network.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define ReplayManager CReplayManager::Get()
+
+// The replay file identifier.
+#define REPLAY_MAGIC 0x50525050
+
+// The replay file format version.
+#define REPLAY_VERSION 2
+
+// The file the game records to when recording is toggled in debug builds.
+#define REPLAY_DEFAULT_FILE "Replay.ppr"
+
+//##############################################################################
+
+// The replay states.
+enum t_ReplayState
+{
+	ReplayState_None,
+	ReplayState_Recording,
+	ReplayState_Replaying,
+};
+
+// The per-tick replay flags.
+enum t_ReplayTickFlag
+{
+	ReplayTickFlag_Input		= 0x0F,		// The directional input keys held down.
+	ReplayTickFlag_Focused		= XBIT(4),	// The window had focus.
+	ReplayTickFlag_Events		= XBIT(5),	// Network events were received.
+	ReplayTickFlag_LongDelta	= XBIT(6),	// The time delta is stored with 16 bits.
+};
+
+//##############################################################################
+class CReplayManager : public CModule
+{
+public:
+	// Singleton instance.
+	static inline CReplayManager& Get()
+	{
+		static CReplayManager s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CReplayManager();
+
+	// Stop any recording in progress.
+	virtual void OnDeinitialise();
+
+	// Begin recording the current game to a file. The random number generator is re-seeded so that the match can be reproduced.
+	xbool StartRecording(const xchar* pFile);
+
+	// Stop recording and write the recording to disk.
+	void StopRecording();
+
+	// Replay a recording headlessly as fast as possible and report the timings and the final state hash.
+	xbool Run(const xchar* pFile);
+
+	// Sample or play back the input and network events for the current tick. This must be called once before each simulation tick.
+	void BeginTick();
+
+	// Get the directional input for the current tick as a bit per direction.
+	inline xuint GetInput()
+	{
+		return m_iInput;
+	}
+
+	// Check if a recording is in progress.
+	inline xbool IsRecording()
+	{
+		return m_iState == ReplayState_Recording;
+	}
+
+	// Check if a recording is being replayed.
+	inline xbool IsReplaying()
+	{
+		return m_iState == ReplayState_Replaying;
+	}
+
+	// Hash the current simulation state.
+	static xuint32 HashState();
+
+protected:
+	// Capture a network stream received during the current tick.
+	void OnStreamMonitor(CNetworkPeer* pFrom, xint iStreamType, BitStream* pStream);
+
+	// Write the initial game state.
+	void WriteHeader();
+
+	// Read the initial game state and set up the simulation to match.
+	xbool ReadHeader();
+
+	// The current replay state.
+	t_ReplayState m_iState;
+
+	// The file being recorded to.
+	xstring m_sFile;
+
+	// The directional input for the current tick.
+	xuint m_iInput;
+
+	// The recorded data.
+	BitStream m_xData;
+
+	// The network events received during the current tick.
+	BitStream m_xEvents;
+
+	// The number of network events received during the current tick.
+	xint m_iEventCount;
+
+	// The number of ticks recorded or replayed.
+	xint m_iTickCount;
+
+	// The peer network events are dispatched from during a replay.
+	CNetworkPeer m_xReplayPeer;
+};
+
+//##############################################################################
\ No newline at end of file
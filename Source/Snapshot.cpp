@@ -0,0 +1,850 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Snapshot.h>
+
+// Other.
+#include <Player.h>
+#include <Lobby.h>
+
+//##############################################################################
+
+// =============================================================================
+static inline xbool IsEaten(const t_BlockBitmap& lpEatenBitmap, xint iBlockIndex)
+{
+	return ((lpEatenBitmap[iBlockIndex >> 5] >> (iBlockIndex & 31)) & 1) != 0;
+}
+
+//##############################################################################
+
+// =============================================================================
+CSnapshotManager::CSnapshotManager() :
+	m_iInterpolationDelay(SNAPSHOT_INTERPOLATION_DELAY),
+	m_iWorldStatesSent(0),
+	m_iWorldStateBytes(0),
+	m_iJoinCount(0),
+	m_iJoinTime(0),
+	m_iJoinTimeMax(0),
+	m_iJoinConnectTime(0)
+{
+	Reset();
+}
+
+// =============================================================================
+void CSnapshotManager::Reset()
+{
+	for (xint iA = 0; iA < SNAPSHOT_HISTORY; ++iA)
+		m_xHistory[iA] = CWorldSnapshot();
+
+	for (xint iA = 0; iA < NETWORK_PEER_INVALID_ID; ++iA)
+		m_xClients[iA].m_pPeer = NULL;
+
+	m_iNextID = 0;
+	m_iReceivedID = 0;
+	m_bReceived = false;
+	m_iReceivedSequence = 0;
+	m_iClock = 0;
+	m_iMoveCount = 0;
+	m_iPlayerBits = 0;
+	m_iPlayerCount = 0;
+	m_iCorrectionCount = 0;
+	m_iCorrectionTotal = 0;
+	m_iCorrectionMax = 0;
+
+	m_xSnapshotTimer.Reset();
+	m_xStatsTimer.ExpireAfter(SNAPSHOT_STATS_INTERVAL);
+	m_xCorrectionTimer.ExpireAfter(SNAPSHOT_CORRECTION_INTERVAL);
+
+	// The sectors cover the whole map so they are only allocated when a match starts on it.
+	if (MapManager.HasCurrentMap())
+	{
+		CMap* pMap = MapManager.GetCurrentMap();
+		m_xSectorizer.Init((xfloat)SNAPSHOT_INTEREST_RADIUS, (xfloat)SNAPSHOT_INTEREST_RADIUS, 0.f, 0.f, (xfloat)pMap->GetWidth(), (xfloat)pMap->GetHeight());
+	}
+}
+
+// =============================================================================
+void CSnapshotManager::Update()
+{
+	if (!NetworkManager.IsRunning())
+		return;
+
+	if (NetworkManager.IsHosting())
+	{
+		UpdateHost();
+		UpdateStats();
+	}
+	else
+	{
+		m_iClock += _TIMEDELTA;
+		UpdateCorrectionStats();
+	}
+}
+
+// =============================================================================
+void CSnapshotManager::UpdateHost()
+{
+	if (m_xSnapshotTimer.IsExpired())
+	{
+		m_xSnapshotTimer.ExpireAfter(SNAPSHOT_INTERVAL);
+
+		// Capture the world into the next history slot.
+		CWorldSnapshot& xSnapshot = m_xHistory[m_iNextID % SNAPSHOT_HISTORY];
+
+		xSnapshot.m_iID = m_iNextID++;
+		Capture(xSnapshot);
+		BuildSectors(xSnapshot);
+
+		// Send each client a delta against the last snapshot it acknowledged.
+		XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, NetworkManager.GetVerifiedPeers())
+		{
+			CNetworkPeer* pPeer = *ppPeer;
+
+			if (pPeer->m_bLocal)
+				continue;
+
+			CSnapshotClient* pClient = &m_xClients[pPeer->m_iID];
+
+			if (pClient->m_pPeer != pPeer)
+			{
+				pClient->m_pPeer = pPeer;
+				pClient->m_bAcknowledged = false;
+				pClient->m_iAcknowledgedID = 0;
+				pClient->m_iBytesSent = 0;
+				pClient->m_iSnapshotsSent = 0;
+				pClient->m_iFullSnapshotsSent = 0;
+				pClient->m_iDeferredPlayers = 0;
+				pClient->m_bWorldStatePending = false;
+			}
+
+			CWorldSnapshot* pBaseline = NULL;
+
+			if (pClient->m_bAcknowledged && (xuint16)(xSnapshot.m_iID - pClient->m_iAcknowledgedID) < SNAPSHOT_HISTORY)
+				pBaseline = FindSnapshot(pClient->m_iAcknowledgedID);
+
+			// Until the client acknowledges its world state, deltas are written against it so that they can be decoded as soon as it arrives.
+			if (pClient->m_bWorldStatePending && (xuint16)(xSnapshot.m_iID - pClient->m_iWorldStateID) < SNAPSHOT_HISTORY)
+				pBaseline = FindSnapshot(pClient->m_iWorldStateID);
+
+			// A client with nothing to delta against, having just joined or fallen too far behind, is sent the whole world once instead.
+			if (!pBaseline)
+			{
+				SendWorldState(xSnapshot, pClient);
+				continue;
+			}
+
+			t_PlayerSnapshotList* plxBaselinePlayers = &pClient->m_lxViews[pBaseline->m_iID % SNAPSHOT_HISTORY];
+
+			// Stagger the summaries by peer so that they don't all land on the same snapshot.
+			CNetworkPeerInfo* pInfo = (CNetworkPeerInfo*)pPeer->m_pData;
+			xbool bSummary = ((xSnapshot.m_iID + pPeer->m_iID) % SNAPSHOT_SUMMARY_INTERVAL) == 0;
+
+			FindInterest(xSnapshot, pInfo ? pInfo->m_pPlayer : NULL);
+			BuildView(xSnapshot, pClient, plxBaselinePlayers, bSummary);
+
+			CNetworkStream* pStream = NetworkManager.BeginSend(pPeer, NetworkStreamType_Snapshot, NETWORK_PRIORITY_STATE, UNRELIABLE_SEQUENCED, SNAPSHOT_CHANNEL);
+			Write(xSnapshot, pBaseline, pClient->m_lxViews[xSnapshot.m_iID % SNAPSHOT_HISTORY], plxBaselinePlayers, pStream);
+
+			pClient->m_iBytesSent += pStream->GetPayloadBytes();
+
+			NetworkManager.SendStream(pStream);
+			pClient->m_iSnapshotsSent++;
+		}
+	}
+}
+
+// =============================================================================
+void CSnapshotManager::SendWorldState(CWorldSnapshot& xSnapshot, CSnapshotClient* pClient)
+{
+	CNetworkStream* pStream = NetworkManager.BeginSend(pClient->m_pPeer, NetworkStreamType_WorldState, NETWORK_PRIORITY_MAP, RELIABLE, SNAPSHOT_CHANNEL);
+	WriteWorldState(xSnapshot, pStream);
+
+	// The client will hold every player as they are now, so that is the baseline for its deltas.
+	pClient->m_lxViews[xSnapshot.m_iID % SNAPSHOT_HISTORY] = xSnapshot.m_lxPlayers;
+
+	pClient->m_bWorldStatePending = true;
+	pClient->m_iWorldStateID = xSnapshot.m_iID;
+	pClient->m_iWorldStateBytes = pStream->GetPayloadBytes();
+
+	pClient->m_iBytesSent += pClient->m_iWorldStateBytes;
+	pClient->m_iSnapshotsSent++;
+	pClient->m_iFullSnapshotsSent++;
+
+	m_iWorldStatesSent++;
+	m_iWorldStateBytes += pClient->m_iWorldStateBytes;
+
+	NetworkManager.SendStream(pStream);
+}
+
+// =============================================================================
+void CSnapshotManager::BuildSectors(CWorldSnapshot& xSnapshot)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+
+	m_xSectorizer.Clear();
+
+	XEN_LIST_FOREACH(t_PlayerSnapshotList, pxPlayer, xSnapshot.m_lxPlayers)
+	{
+		xpoint xPosition = pMap->GetBlock(pxPlayer->m_iBlock)->m_xPosition;
+		m_xSectorizer.AddEntry(&*pxPlayer, (xfloat)xPosition.m_tX, (xfloat)xPosition.m_tY, (xfloat)xPosition.m_tX + 1.f, (xfloat)xPosition.m_tY + 1.f);
+	}
+}
+
+// =============================================================================
+void CSnapshotManager::FindInterest(CWorldSnapshot& xSnapshot, CPlayer* pViewer)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+	CMapBlock* pViewerBlock = pViewer ? pViewer->GetCurrentBlock() : NULL;
+
+	m_lbInterested.assign(xSnapshot.m_lxPlayers.size(), pViewerBlock == NULL);
+
+	if (!pViewerBlock)
+		return;
+
+	xpoint xCentre = pViewerBlock->m_xPosition;
+	xfloat fRadius = (xfloat)SNAPSHOT_INTEREST_RADIUS;
+
+	xint iWidth = pMap->GetWidth();
+	xint iHeight = pMap->GetHeight();
+
+	// The map wraps around through its tunnels, so the area is also looked up on the far side of any edge it crosses.
+	for (xint iOffsetX = -iWidth; iOffsetX <= iWidth; iOffsetX += iWidth)
+	{
+		for (xint iOffsetY = -iHeight; iOffsetY <= iHeight; iOffsetY += iHeight)
+		{
+			xfloat fMinX = (xfloat)(xCentre.m_tX + iOffsetX) - fRadius;
+			xfloat fMinY = (xfloat)(xCentre.m_tY + iOffsetY) - fRadius;
+			xfloat fMaxX = (xfloat)(xCentre.m_tX + iOffsetX) + fRadius + 1.f;
+			xfloat fMaxY = (xfloat)(xCentre.m_tY + iOffsetY) + fRadius + 1.f;
+
+			if (fMaxX <= 0.f || fMaxY <= 0.f || fMinX >= (xfloat)iWidth || fMinY >= (xfloat)iHeight)
+				continue;
+
+			m_xSectorizer.GetEntries(m_lpNearbyPlayers, fMinX, fMinY, fMaxX, fMaxY);
+
+			// The sectors are coarse so check the exact wrapped distance of each player they return.
+			for (xuint iA = 0; iA < m_lpNearbyPlayers.Size(); ++iA)
+			{
+				CPlayerSnapshot* pPlayer = (CPlayerSnapshot*)m_lpNearbyPlayers[iA];
+				xpoint xPosition = pMap->GetBlock(pPlayer->m_iBlock)->m_xPosition;
+
+				xint iX = abs(xPosition.m_tX - xCentre.m_tX);
+				xint iY = abs(xPosition.m_tY - xCentre.m_tY);
+
+				if (Math::Min(iX, iWidth - iX) <= SNAPSHOT_INTEREST_RADIUS && Math::Min(iY, iHeight - iY) <= SNAPSHOT_INTEREST_RADIUS)
+					m_lbInterested[pPlayer - &xSnapshot.m_lxPlayers[0]] = true;
+			}
+		}
+	}
+}
+
+// =============================================================================
+void CSnapshotManager::BuildView(CWorldSnapshot& xSnapshot, CSnapshotClient* pClient, t_PlayerSnapshotList* plxBaselinePlayers, xbool bSummary)
+{
+	t_PlayerSnapshotList& lxView = pClient->m_lxViews[xSnapshot.m_iID % SNAPSHOT_HISTORY];
+
+	lxView.resize(xSnapshot.m_lxPlayers.size());
+
+	for (xint iA = 0; iA < (xint)xSnapshot.m_lxPlayers.size(); ++iA)
+	{
+		CPlayerSnapshot& xPlayer = xSnapshot.m_lxPlayers[iA];
+
+		// The client keeps its baseline state for a distant player, so that is what it will hold after this snapshot too.
+		if (!bSummary && !m_lbInterested[iA] && plxBaselinePlayers && iA < (xint)plxBaselinePlayers->size())
+		{
+			lxView[iA] = (*plxBaselinePlayers)[iA];
+
+			if (lxView[iA] != xPlayer)
+				pClient->m_iDeferredPlayers++;
+		}
+		else
+			lxView[iA] = xPlayer;
+	}
+}
+
+// =============================================================================
+CWorldSnapshot* CSnapshotManager::FindSnapshot(xuint16 iID)
+{
+	CWorldSnapshot* pSnapshot = &m_xHistory[iID % SNAPSHOT_HISTORY];
+
+	if (pSnapshot->m_bValid && pSnapshot->m_iID == iID)
+		return pSnapshot;
+
+	return NULL;
+}
+
+// =============================================================================
+void CSnapshotManager::Capture(CWorldSnapshot& xSnapshot)
+{
+	t_PlayerList& lpPlayers = PlayerManager.GetActivePlayers();
+
+	xSnapshot.m_bValid = true;
+	xSnapshot.m_lxPlayers.resize(lpPlayers.size());
+
+	for (xint iA = 0; iA < (xint)lpPlayers.size(); ++iA)
+	{
+		CPlayer* pPlayer = lpPlayers[iA];
+		CPlayerMovement& xMovement = pPlayer->GetMovement();
+		CPlayerSnapshot& xPlayer = xSnapshot.m_lxPlayers[iA];
+
+		xPlayer.m_iBlock = pPlayer->GetCurrentBlock() ? pPlayer->GetCurrentBlock()->m_iIndex : 0;
+		xPlayer.m_iState = (xuint8)pPlayer->GetState();
+		xPlayer.m_iDirection = (xuint8)xMovement.m_iMoveDir;
+		xPlayer.m_iTransition = (xuint8)(xMovement.m_fTransition * 255.f);
+		xPlayer.m_bLeaving = xMovement.m_bLeaving;
+		xPlayer.m_iInputSequence = pPlayer->GetReplication().m_iInputSequence;
+	}
+
+	xSnapshot.m_lpEatenBitmap = MapManager.GetCurrentMap()->GetEatenBitmap();
+}
+
+// =============================================================================
+void CSnapshotManager::Write(CWorldSnapshot& xSnapshot, CWorldSnapshot* pBaseline, t_PlayerSnapshotList& lxPlayers, t_PlayerSnapshotList* plxBaselinePlayers, BitStream* pStream)
+{
+	pStream->Write(xSnapshot.m_iID);
+	pStream->Write(pBaseline != NULL);
+
+	if (pBaseline)
+		pStream->Write(pBaseline->m_iID);
+
+	m_xCodec.SetBlockCount(MapManager.GetCurrentMap()->GetBlockCount());
+
+	// Write only the players that have changed since the baseline.
+	pStream->Write((xuint8)lxPlayers.size());
+
+	for (xint iA = 0; iA < (xint)lxPlayers.size(); ++iA)
+	{
+		CPlayerSnapshot& xPlayer = lxPlayers[iA];
+		CPlayerSnapshot* pPlayerBaseline = (plxBaselinePlayers && iA < (xint)plxBaselinePlayers->size()) ? &(*plxBaselinePlayers)[iA] : NULL;
+		xbool bChanged = !pPlayerBaseline || xPlayer != *pPlayerBaseline;
+
+		BitSize_t iStart = pStream->GetNumberOfBitsUsed();
+
+		pStream->Write(bChanged);
+
+		if (bChanged)
+			m_xCodec.Write(xPlayer, pPlayerBaseline, pStream);
+
+		m_iPlayerBits += pStream->GetNumberOfBitsUsed() - iStart;
+		m_iPlayerCount++;
+	}
+
+	// Write the index of each block where the eaten status has changed since the baseline.
+	xarray<xuint32> liChanges;
+
+	for (xint iA = 0; iA < (xint)xSnapshot.m_lpEatenBitmap.size(); ++iA)
+	{
+		xuint32 iBaseline = (pBaseline && iA < (xint)pBaseline->m_lpEatenBitmap.size()) ? pBaseline->m_lpEatenBitmap[iA] : 0;
+		xuint32 iDifference = xSnapshot.m_lpEatenBitmap[iA] ^ iBaseline;
+
+		for (xint iB = 0; iDifference; ++iB, iDifference >>= 1)
+		{
+			if (iDifference & 1)
+				liChanges.push_back((iA << 5) + iB);
+		}
+	}
+
+	CPlayerSnapshotCodec::WriteValue(pStream, (xuint32)liChanges.size(), m_xCodec.GetBlockBits() + 1);
+
+	XEN_LIST_FOREACH(xarray<xuint32>, piChange, liChanges)
+		CPlayerSnapshotCodec::WriteValue(pStream, *piChange, m_xCodec.GetBlockBits());
+}
+
+// =============================================================================
+void CSnapshotManager::Read(CWorldSnapshot& xSnapshot, CWorldSnapshot* pBaseline, BitStream* pStream)
+{
+	xuint8 iPlayerCount = 0;
+	pStream->Read(iPlayerCount);
+
+	if (pBaseline)
+		xSnapshot.m_lpEatenBitmap = pBaseline->m_lpEatenBitmap;
+	else
+		xSnapshot.m_lpEatenBitmap.assign(MapManager.GetCurrentMap()->GetEatenBitmap().size(), 0);
+
+	m_xCodec.SetBlockCount(MapManager.GetCurrentMap()->GetBlockCount());
+
+	// Read the players that have changed.
+	xSnapshot.m_lxPlayers.resize(iPlayerCount);
+
+	for (xint iA = 0; iA < iPlayerCount; ++iA)
+	{
+		CPlayerSnapshot* pPlayerBaseline = (pBaseline && iA < (xint)pBaseline->m_lxPlayers.size()) ? &pBaseline->m_lxPlayers[iA] : NULL;
+
+		if (pStream->ReadBit())
+			m_xCodec.Read(xSnapshot.m_lxPlayers[iA], pPlayerBaseline, pStream);
+		else if (pPlayerBaseline)
+			xSnapshot.m_lxPlayers[iA] = *pPlayerBaseline;
+	}
+
+	// Toggle each block where the eaten status has changed.
+	xuint32 iChangeCount = CPlayerSnapshotCodec::ReadValue(pStream, m_xCodec.GetBlockBits() + 1);
+
+	for (xuint32 iA = 0; iA < iChangeCount; ++iA)
+	{
+		xuint32 iBlockIndex = CPlayerSnapshotCodec::ReadValue(pStream, m_xCodec.GetBlockBits());
+
+		if ((iBlockIndex >> 5) < xSnapshot.m_lpEatenBitmap.size())
+			xSnapshot.m_lpEatenBitmap[iBlockIndex >> 5] ^= (1u << (iBlockIndex & 31));
+	}
+
+	xSnapshot.m_bValid = true;
+}
+
+// =============================================================================
+void CSnapshotManager::WriteWorldState(CWorldSnapshot& xSnapshot, BitStream* pStream)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+
+	pStream->Write(xSnapshot.m_iID);
+
+	m_xCodec.SetBlockCount(pMap->GetBlockCount());
+
+	// Write every player in full.
+	pStream->Write((xuint8)xSnapshot.m_lxPlayers.size());
+
+	XEN_LIST_FOREACH(t_PlayerSnapshotList, pxPlayer, xSnapshot.m_lxPlayers)
+		m_xCodec.Write(*pxPlayer, NULL, pStream);
+
+	// Only pellet blocks can be eaten, so those are all that need sending. Most maps are eaten in long stretches which pack well as runs.
+	xarray<xint> liPellets;
+	GetPelletBlocks(liPellets);
+
+	xarray<xint> liRuns;
+
+	for (xint iA = 0; iA < (xint)liPellets.size(); ++iA)
+	{
+		if (!iA || IsEaten(xSnapshot.m_lpEatenBitmap, liPellets[iA]) != IsEaten(xSnapshot.m_lpEatenBitmap, liPellets[iA - 1]))
+			liRuns.push_back(0);
+
+		liRuns.back()++;
+	}
+
+	// The runs take the state of the first pellet, the number of runs and the length of each but the last, which fills whatever is left.
+	xint iRunBits = 1 + CPlayerSnapshotCodec::GetGammaBits((xuint32)liRuns.size() + 1);
+
+	for (xint iA = 0; iA < (xint)liRuns.size() - 1; ++iA)
+		iRunBits += CPlayerSnapshotCodec::GetGammaBits(liRuns[iA]);
+
+	t_PelletEncoding iEncoding = (iRunBits < (xint)liPellets.size()) ? PelletEncoding_Runs : PelletEncoding_Bitmap;
+
+	CPlayerSnapshotCodec::WriteValue(pStream, iEncoding, 1);
+
+	if (iEncoding == PelletEncoding_Bitmap)
+	{
+		XEN_LIST_FOREACH(xarray<xint>, piPellet, liPellets)
+			pStream->Write(IsEaten(xSnapshot.m_lpEatenBitmap, *piPellet));
+	}
+	else
+	{
+		pStream->Write(IsEaten(xSnapshot.m_lpEatenBitmap, liPellets[0]));
+		CPlayerSnapshotCodec::WriteGamma(pStream, (xuint32)liRuns.size() + 1);
+
+		for (xint iA = 0; iA < (xint)liRuns.size() - 1; ++iA)
+			CPlayerSnapshotCodec::WriteGamma(pStream, liRuns[iA]);
+	}
+
+	// Write the time left on each pellet waiting to respawn, placed by how many pellet blocks it is past the one before.
+	xarray<xint> liRespawns;
+
+	for (xint iA = 0; iA < (xint)liPellets.size(); ++iA)
+	{
+		CMapBlock* pBlock = pMap->GetBlock(liPellets[iA]);
+
+		if (pBlock->m_bEaten && !pBlock->m_xRespawnTimer.IsExpired())
+			liRespawns.push_back(iA);
+	}
+
+	CPlayerSnapshotCodec::WriteGamma(pStream, (xuint32)liRespawns.size() + 1);
+
+	for (xint iA = 0; iA < (xint)liRespawns.size(); ++iA)
+	{
+		CMapBlock* pBlock = pMap->GetBlock(liPellets[liRespawns[iA]]);
+
+		CPlayerSnapshotCodec::WriteGamma(pStream, liRespawns[iA] - (iA ? liRespawns[iA - 1] : -1));
+		CPlayerSnapshotCodec::WriteGamma(pStream, pBlock->m_xRespawnTimer.TimeToExpiration() + 1);
+	}
+}
+
+// =============================================================================
+xbool CSnapshotManager::ReadWorldState(CWorldSnapshot& xSnapshot, t_PelletRespawnList& lxRespawns, BitStream* pStream)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+
+	xuint8 iPlayerCount = 0;
+
+	if (!pStream->Read(xSnapshot.m_iID) || !pStream->Read(iPlayerCount))
+		return false;
+
+	m_xCodec.SetBlockCount(pMap->GetBlockCount());
+
+	// Read every player.
+	xSnapshot.m_lxPlayers.resize(iPlayerCount);
+
+	XEN_LIST_FOREACH(t_PlayerSnapshotList, pxPlayer, xSnapshot.m_lxPlayers)
+		m_xCodec.Read(*pxPlayer, NULL, pStream);
+
+	// Read the eaten state of each pellet block.
+	xarray<xint> liPellets;
+	GetPelletBlocks(liPellets);
+
+	xSnapshot.m_lpEatenBitmap.assign(pMap->GetEatenBitmap().size(), 0);
+
+	t_PelletEncoding iEncoding = (t_PelletEncoding)CPlayerSnapshotCodec::ReadValue(pStream, 1);
+
+	if (iEncoding == PelletEncoding_Bitmap)
+	{
+		XEN_LIST_FOREACH(xarray<xint>, piPellet, liPellets)
+		{
+			if (pStream->ReadBit())
+				xSnapshot.m_lpEatenBitmap[*piPellet >> 5] |= (1u << (*piPellet & 31));
+		}
+	}
+	else
+	{
+		xbool bEaten = pStream->ReadBit();
+		xint iRunCount = (xint)CPlayerSnapshotCodec::ReadGamma(pStream) - 1;
+
+		if (iRunCount < 1)
+			return false;
+
+		for (xint iA = 0, iRun = 0; iRun < iRunCount; ++iRun)
+		{
+			// The last run takes the rest of the pellets.
+			xint iRunLength = (iRun < iRunCount - 1) ? (xint)CPlayerSnapshotCodec::ReadGamma(pStream) : (xint)liPellets.size() - iA;
+
+			if (iRunLength < 1 || iA + iRunLength > (xint)liPellets.size())
+				return false;
+
+			for (xint iEnd = iA + iRunLength; iA < iEnd; ++iA)
+			{
+				if (bEaten)
+					xSnapshot.m_lpEatenBitmap[liPellets[iA] >> 5] |= (1u << (liPellets[iA] & 31));
+			}
+
+			bEaten = !bEaten;
+		}
+	}
+
+	// Read the pellets waiting to respawn.
+	xint iRespawnCount = (xint)CPlayerSnapshotCodec::ReadGamma(pStream) - 1;
+
+	if (iRespawnCount < 0)
+		return false;
+
+	lxRespawns.resize(iRespawnCount);
+
+	for (xint iA = 0, iPellet = -1; iA < iRespawnCount; ++iA)
+	{
+		iPellet += (xint)CPlayerSnapshotCodec::ReadGamma(pStream);
+		xuint32 iTimeLeft = CPlayerSnapshotCodec::ReadGamma(pStream);
+
+		if (iPellet < 0 || iPellet >= (xint)liPellets.size() || !iTimeLeft)
+			return false;
+
+		lxRespawns[iA].m_iBlock = liPellets[iPellet];
+		lxRespawns[iA].m_iTimeLeft = iTimeLeft - 1;
+	}
+
+	xSnapshot.m_bValid = true;
+
+	return true;
+}
+
+// =============================================================================
+void CSnapshotManager::GetPelletBlocks(xarray<xint>& liBlocks)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+
+	liBlocks.clear();
+
+	for (xint iA = 0; iA < pMap->GetBlockCount(); ++iA)
+	{
+		if (pMap->GetBlock(iA)->m_iBlockType == BlockType_Pellet)
+			liBlocks.push_back(iA);
+	}
+}
+
+// =============================================================================
+void CSnapshotManager::Apply(CWorldSnapshot& xSnapshot)
+{
+	CMap* pMap = MapManager.GetCurrentMap();
+	t_PlayerList& lpPlayers = PlayerManager.GetActivePlayers();
+
+	// Hand the authoritative state to each player to be interpolated or reconciled.
+	for (xint iA = 0; iA < (xint)lpPlayers.size() && iA < (xint)xSnapshot.m_lxPlayers.size(); ++iA)
+	{
+		if (xSnapshot.m_lxPlayers[iA].m_iBlock < (xuint32)pMap->GetBlockCount())
+			lpPlayers[iA]->OnReceiveSnapshot(xSnapshot.m_lxPlayers[iA], m_iReceivedSequence * SNAPSHOT_INTERVAL);
+	}
+
+	// Bring the map in line with the host.
+	const t_BlockBitmap& lpEatenBitmap = pMap->GetEatenBitmap();
+
+	for (xint iA = 0; iA < (xint)lpEatenBitmap.size() && iA < (xint)xSnapshot.m_lpEatenBitmap.size(); ++iA)
+	{
+		xuint32 iDifference = lpEatenBitmap[iA] ^ xSnapshot.m_lpEatenBitmap[iA];
+
+		for (xint iB = 0; iDifference; ++iB, iDifference >>= 1)
+		{
+			if (iDifference & 1)
+				pMap->SetEaten((iA << 5) + iB, (xSnapshot.m_lpEatenBitmap[iA] & (1u << iB)) != 0);
+		}
+	}
+}
+
+// =============================================================================
+void CSnapshotManager::UpdateStats()
+{
+	if (!m_xStatsTimer.IsExpired())
+		return;
+
+	m_xStatsTimer.ExpireAfter(SNAPSHOT_STATS_INTERVAL);
+
+	// Under the old scheme every move was broadcast to every client with a 3 byte header and 3 byte payload.
+	xint iMoveBytes = m_iMoveCount * 6;
+
+	XEN_LIST_FOREACH(t_NetworkPeerList, ppPeer, NetworkManager.GetVerifiedPeers())
+	{
+		CSnapshotClient* pClient = &m_xClients[(*ppPeer)->m_iID];
+
+		if ((*ppPeer)->m_bLocal || pClient->m_pPeer != *ppPeer)
+			continue;
+
+		XLOG("[SnapshotManager] Peer %d: %d bytes/sec in %d snapshots (%d world states, %d player changes deferred), per-move scheme would use %d bytes/sec for %d moves with %d players.",
+			pClient->m_pPeer->m_iID,
+			pClient->m_iBytesSent,
+			pClient->m_iSnapshotsSent,
+			pClient->m_iFullSnapshotsSent,
+			pClient->m_iDeferredPlayers,
+			iMoveBytes,
+			m_iMoveCount,
+			PlayerManager.GetActivePlayerCount());
+
+		pClient->m_iBytesSent = 0;
+		pClient->m_iSnapshotsSent = 0;
+		pClient->m_iFullSnapshotsSent = 0;
+		pClient->m_iDeferredPlayers = 0;
+	}
+
+	if (m_iPlayerCount)
+		XLOG("[SnapshotManager] Average of %.1f bits per player per snapshot.", (xfloat)m_iPlayerBits / (xfloat)m_iPlayerCount);
+
+	m_iMoveCount = 0;
+	m_iPlayerBits = 0;
+	m_iPlayerCount = 0;
+}
+
+// =============================================================================
+void CSnapshotManager::Benchmark()
+{
+	CWorldSnapshot xSnapshot;
+	Capture(xSnapshot);
+
+	m_xCodec.SetBlockCount(MapManager.GetCurrentMap()->GetBlockCount());
+	m_xCodec.Benchmark(xSnapshot.m_lxPlayers, 100000);
+
+	// Compare the world state a joining client is sent with the full snapshot it would otherwise be sent, leaving the player statistics as they were.
+	xint iPlayerBits = m_iPlayerBits;
+	xint iPlayerCount = m_iPlayerCount;
+
+	BitStream xStream;
+	Write(xSnapshot, NULL, xSnapshot.m_lxPlayers, NULL, &xStream);
+
+	xint iFullBytes = (xint)xStream.GetNumberOfBytesUsed();
+
+	m_iPlayerBits = iPlayerBits;
+	m_iPlayerCount = iPlayerCount;
+
+	xStream.Reset();
+	WriteWorldState(xSnapshot, &xStream);
+
+	xarray<xint> liPellets;
+	GetPelletBlocks(liPellets);
+
+	xint iEaten = 0;
+
+	XEN_LIST_FOREACH(xarray<xint>, piPellet, liPellets)
+		iEaten += IsEaten(xSnapshot.m_lpEatenBitmap, *piPellet) ? 1 : 0;
+
+	XLOG("[SnapshotManager] World state for %d players and %d of %d pellets eaten is %d bytes, against %d bytes for a full snapshot.",
+		(xint)xSnapshot.m_lxPlayers.size(),
+		iEaten,
+		(xint)liPellets.size(),
+		(xint)xStream.GetNumberOfBytesUsed(),
+		iFullBytes);
+}
+
+// =============================================================================
+void CSnapshotManager::RecordCorrection(xint iBlocks)
+{
+	XLOG("[SnapshotManager] Corrected the local player by %d blocks.", iBlocks);
+
+	m_iCorrectionCount++;
+	m_iCorrectionTotal += iBlocks;
+	m_iCorrectionMax = Math::Max(m_iCorrectionMax, iBlocks);
+}
+
+// =============================================================================
+void CSnapshotManager::UpdateCorrectionStats()
+{
+	if (!m_xCorrectionTimer.IsExpired())
+		return;
+
+	m_xCorrectionTimer.ExpireAfter(SNAPSHOT_CORRECTION_INTERVAL);
+
+	XLOG("[SnapshotManager] %d corrections per minute, average size %.2f blocks, largest %d blocks (interpolation delay %dms).",
+		m_iCorrectionCount,
+		m_iCorrectionCount ? (xfloat)m_iCorrectionTotal / (xfloat)m_iCorrectionCount : 0.f,
+		m_iCorrectionMax,
+		m_iInterpolationDelay);
+
+	m_iCorrectionCount = 0;
+	m_iCorrectionTotal = 0;
+	m_iCorrectionMax = 0;
+}
+
+// =============================================================================
+void CSnapshotManager::OnReceiveSnapshot(CNetworkPeer* pFrom, BitStream* pStream)
+{
+	xuint16 iID = 0;
+	xbool bDelta = false;
+	xuint16 iBaselineID = 0;
+
+	pStream->Read(iID);
+	pStream->Read(bDelta);
+
+	if (bDelta)
+		pStream->Read(iBaselineID);
+
+	// Sequencing should already drop old snapshots, but never apply one older than we have.
+	if (m_bReceived && (xint16)(iID - m_iReceivedID) <= 0)
+		return;
+
+	// If we no longer have the baseline we can't decode this, the host will fall back to a full snapshot when our acks stop.
+	CWorldSnapshot* pBaseline = NULL;
+
+	if (bDelta)
+	{
+		pBaseline = FindSnapshot(iBaselineID);
+
+		if (!pBaseline)
+			return;
+	}
+
+	CWorldSnapshot xSnapshot;
+	Read(xSnapshot, pBaseline, pStream);
+
+	xSnapshot.m_iID = iID;
+	Accept(xSnapshot);
+}
+
+// =============================================================================
+void CSnapshotManager::OnReceiveWorldState(CNetworkPeer* pFrom, BitStream* pStream)
+{
+	CWorldSnapshot xSnapshot;
+	t_PelletRespawnList lxRespawns;
+
+	if (!ReadWorldState(xSnapshot, lxRespawns, pStream))
+	{
+		XLOG("[SnapshotManager] Discarded a world state that could not be read.");
+		return;
+	}
+
+	// A world state sent again after the first was slow to be acknowledged may be older than the deltas since.
+	if (m_bReceived && (xint16)(xSnapshot.m_iID - m_iReceivedID) <= 0)
+		return;
+
+	XLOG("[SnapshotManager] Received a %d byte world state with %d players and %d pellets waiting to respawn.", (xint)BITS_TO_BYTES(pStream->GetNumberOfBitsUsed()), (xint)xSnapshot.m_lxPlayers.size(), (xint)lxRespawns.size());
+
+	Accept(xSnapshot);
+
+	CMap* pMap = MapManager.GetCurrentMap();
+
+	XEN_LIST_FOREACH(t_PelletRespawnList, pxRespawn, lxRespawns)
+		pMap->GetBlock(pxRespawn->m_iBlock)->m_xRespawnTimer.ExpireAfter(pxRespawn->m_iTimeLeft);
+}
+
+// =============================================================================
+void CSnapshotManager::Accept(CWorldSnapshot& xSnapshot)
+{
+	xuint16 iID = xSnapshot.m_iID;
+
+	m_xHistory[iID % SNAPSHOT_HISTORY] = xSnapshot;
+
+	// Keep the interpolation clock in step with the host's snapshot timeline.
+	m_iReceivedSequence = m_bReceived ? m_iReceivedSequence + (xint16)(iID - m_iReceivedID) : iID;
+
+	xint iHostTime = m_iReceivedSequence * SNAPSHOT_INTERVAL;
+
+	if (m_bReceived && abs(iHostTime - m_iClock) < SNAPSHOT_INTERVAL * 4)
+		m_iClock += (iHostTime - m_iClock) / 8;
+	else
+		m_iClock = iHostTime;
+
+	m_iReceivedID = iID;
+	m_bReceived = true;
+
+	Apply(xSnapshot);
+
+	// The client is playable once the first snapshot since connecting is applied, so that acknowledgement carries the time it took and must arrive.
+	xuint iConnectTime = NetworkManager.GetConnectTime();
+	xbool bJoined = iConnectTime && iConnectTime != m_iJoinConnectTime;
+
+	// Acknowledge the snapshot so the host can delta against it.
+	CNetworkStream* pStream = NetworkManager.BeginSend(NULL, NetworkStreamType_SnapshotAck, NETWORK_PRIORITY_STATE, bJoined ? RELIABLE : UNRELIABLE_SEQUENCED, SNAPSHOT_CHANNEL);
+	pStream->Write(iID);
+	pStream->Write(bJoined);
+
+	if (bJoined)
+	{
+		xuint32 iJoinTime = _TIMEMS - iConnectTime;
+		pStream->Write(iJoinTime);
+
+		m_iJoinConnectTime = iConnectTime;
+
+		XLOG("[SnapshotManager] Playable %ums after connecting.", iJoinTime);
+	}
+
+	NetworkManager.SendStream(pStream);
+}
+
+// =============================================================================
+void CSnapshotManager::OnReceiveSnapshotAck(CNetworkPeer* pFrom, BitStream* pStream)
+{
+	xuint16 iID = 0;
+	xbool bJoined = false;
+	xuint32 iJoinTime = 0;
+
+	pStream->Read(iID);
+	pStream->Read(bJoined);
+
+	if (bJoined)
+		pStream->Read(iJoinTime);
+
+	CSnapshotClient* pClient = &m_xClients[pFrom->m_iID];
+
+	if (pClient->m_pPeer == pFrom && (!pClient->m_bAcknowledged || (xint16)(iID - pClient->m_iAcknowledgedID) > 0))
+	{
+		pClient->m_bAcknowledged = true;
+		pClient->m_iAcknowledgedID = iID;
+	}
+
+	// The client has caught up once it acknowledges its world state or anything since.
+	if (pClient->m_pPeer == pFrom && pClient->m_bWorldStatePending && (xint16)(iID - pClient->m_iWorldStateID) >= 0)
+		pClient->m_bWorldStatePending = false;
+
+	// The time the client took to become playable is measured on its own clock, from the host accepting its connection to applying its first snapshot.
+	if (bJoined)
+	{
+		m_iJoinCount++;
+		m_iJoinTime += iJoinTime;
+		m_iJoinTimeMax = Math::Max(m_iJoinTimeMax, (xint)iJoinTime);
+
+		XLOG("[SnapshotManager] Peer %d was playable %ums after connecting.", pFrom->m_iID, iJoinTime);
+	}
+}
+
+//##############################################################################
\ No newline at end of file
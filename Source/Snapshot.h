@@ -0,0 +1,343 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Other.
+#include <Map.h>
+#include <Network.h>
+#include <Codec.h>
+#include <RakNet/GridSectorizer.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define SnapshotManager CSnapshotManager::Get()
+
+// The time in milliseconds between each snapshot sent by the host.
+#define SNAPSHOT_INTERVAL 50
+
+// The number of snapshots kept for delta compression. A client must acknowledge a snapshot within this window or it will be sent a full snapshot.
+#define SNAPSHOT_HISTORY 32
+
+// The channel used for snapshot traffic so that sequencing is kept apart from other gameplay streams.
+#define SNAPSHOT_CHANNEL 3
+
+// The time in milliseconds between each bandwidth report.
+#define SNAPSHOT_STATS_INTERVAL 1000
+
+// The default time in milliseconds that remote players are rendered behind the latest snapshot.
+#define SNAPSHOT_INTERPOLATION_DELAY 100
+
+// The time in milliseconds between each prediction correction report.
+#define SNAPSHOT_CORRECTION_INTERVAL 60000
+
+// The distance in blocks within which a client is sent every change to another player.
+#define SNAPSHOT_INTEREST_RADIUS 8
+
+// The number of snapshots between each update of the players outside a client's interest radius.
+#define SNAPSHOT_SUMMARY_INTERVAL 5
+
+//##############################################################################
+
+// The ways the pellets can be packed into a world state. Whichever is smaller for the current map is used.
+enum t_PelletEncoding
+{
+	PelletEncoding_Bitmap,		// A bit for each pellet block.
+	PelletEncoding_Runs,		// The lengths of the runs of eaten and uneaten pellet blocks as gamma codes.
+};
+
+// A pellet waiting to respawn, as sent in a world state.
+class CPelletRespawn
+{
+public:
+	// The index of the pellet block.
+	xint m_iBlock;
+
+	// The time in milliseconds before the pellet respawns.
+	xuint m_iTimeLeft;
+};
+
+// Lists.
+typedef xarray<CPelletRespawn> t_PelletRespawnList;
+
+//##############################################################################
+
+// The replicated state of the world at a specific point in time.
+class CWorldSnapshot
+{
+public:
+	// Constructor.
+	CWorldSnapshot() : m_iID(0), m_bValid(false) {}
+
+	// The snapshot sequence number.
+	xuint16 m_iID;
+
+	// Determines if the snapshot holds valid data.
+	xbool m_bValid;
+
+	// The state of each active player.
+	t_PlayerSnapshotList m_lxPlayers;
+
+	// The eaten status of all map blocks.
+	t_BlockBitmap m_lpEatenBitmap;
+};
+
+//##############################################################################
+
+// The host's replication state for a single client.
+class CSnapshotClient
+{
+public:
+	// The peer this state belongs to.
+	CNetworkPeer* m_pPeer;
+
+	// Determines if the client has acknowledged any snapshot yet.
+	xbool m_bAcknowledged;
+
+	// The most recent snapshot acknowledged by the client.
+	xuint16 m_iAcknowledgedID;
+
+	// The number of bytes sent during the current stats interval.
+	xint m_iBytesSent;
+
+	// The number of snapshots sent during the current stats interval.
+	xint m_iSnapshotsSent;
+
+	// The number of world states sent in place of snapshots during the current stats interval.
+	xint m_iFullSnapshotsSent;
+
+	// Determines if the client has been sent a world state it has not yet acknowledged.
+	xbool m_bWorldStatePending;
+
+	// The snapshot the pending world state was captured as.
+	xuint16 m_iWorldStateID;
+
+	// The size, in bytes, of the pending world state.
+	xint m_iWorldStateBytes;
+
+	// The number of player changes held back during the current stats interval because they were outside the client's interest.
+	xint m_iDeferredPlayers;
+
+	// The players as sent to the client for each snapshot in the history, used as the client's delta baselines.
+	t_PlayerSnapshotList m_lxViews[SNAPSHOT_HISTORY];
+};
+
+//##############################################################################
+class CSnapshotManager : public CModule
+{
+public:
+	// Singleton instance, or the instance belonging to the match bound to the calling thread.
+	static inline CSnapshotManager& Get()
+	{
+		if (CMatchContext* pContext = CMatchContext::GetCurrent())
+			return *pContext->m_pSnapshotManager;
+
+		static CSnapshotManager s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CSnapshotManager();
+
+	// Clear all snapshot history and client state ready for a new game.
+	void Reset();
+
+	// Capture and send snapshots to all clients when hosting or advance the interpolation clock as a client.
+	void Update();
+
+	// Get the time in milliseconds, on the host's snapshot timeline, at which remote players should be rendered.
+	inline xint GetInterpolationTime()
+	{
+		return m_iClock - m_iInterpolationDelay;
+	}
+
+	// Set the time in milliseconds that remote players are rendered behind the latest snapshot.
+	inline void SetInterpolationDelay(xint iDelay)
+	{
+		m_iInterpolationDelay = iDelay;
+	}
+
+	// Get the time in milliseconds that remote players are rendered behind the latest snapshot.
+	inline xint GetInterpolationDelay()
+	{
+		return m_iInterpolationDelay;
+	}
+
+	// Record a correction to the local player's predicted position measured in blocks.
+	void RecordCorrection(xint iBlocks);
+
+	// Measure the snapshot codec against the current game state.
+	void Benchmark();
+
+	// Record that a move occurred which the old per-move scheme would have broadcast.
+	inline void CountMove()
+	{
+		m_iMoveCount++;
+	}
+
+	// Process incoming snapshots from the host.
+	void OnReceiveSnapshot(CNetworkPeer* pFrom, BitStream* pStream);
+
+	// Process incoming snapshot acknowledgements from a client.
+	void OnReceiveSnapshotAck(CNetworkPeer* pFrom, BitStream* pStream);
+
+	// Process an incoming world state from the host.
+	void OnReceiveWorldState(CNetworkPeer* pFrom, BitStream* pStream);
+
+	// Get the number of world states sent since starting.
+	inline xint GetWorldStatesSent()
+	{
+		return m_iWorldStatesSent;
+	}
+
+	// Get the total size, in bytes, of the world states sent since starting.
+	inline xint64 GetWorldStateBytes()
+	{
+		return m_iWorldStateBytes;
+	}
+
+	// Get the number of clients that have reported how long they took to become playable since starting.
+	inline xint GetJoinCount()
+	{
+		return m_iJoinCount;
+	}
+
+	// Get the total time in milliseconds the clients took from connecting to applying their first snapshot since starting.
+	inline xint64 GetJoinTime()
+	{
+		return m_iJoinTime;
+	}
+
+	// Get the longest time in milliseconds a client took from connecting to applying its first snapshot since starting.
+	inline xint GetJoinTimeMax()
+	{
+		return m_iJoinTimeMax;
+	}
+
+protected:
+	// Find a snapshot in the history by sequence number.
+	CWorldSnapshot* FindSnapshot(xuint16 iID);
+
+	// Capture the current world state into a snapshot.
+	void Capture(CWorldSnapshot& xSnapshot);
+
+	// Write a snapshot to a stream as a delta against a baseline using the players as seen by the client. A NULL baseline will write the full snapshot.
+	void Write(CWorldSnapshot& xSnapshot, CWorldSnapshot* pBaseline, t_PlayerSnapshotList& lxPlayers, t_PlayerSnapshotList* plxBaselinePlayers, BitStream* pStream);
+
+	// Read a snapshot from a stream as a delta against a baseline. A NULL baseline will read the full snapshot.
+	void Read(CWorldSnapshot& xSnapshot, CWorldSnapshot* pBaseline, BitStream* pStream);
+
+	// Apply an authoritative snapshot to the local world.
+	void Apply(CWorldSnapshot& xSnapshot);
+
+	// Keep a snapshot received from the host, move the clock in step with it, apply it and acknowledge it.
+	void Accept(CWorldSnapshot& xSnapshot);
+
+	// Send a client everything it needs to catch up with a snapshot in one reliable message. The client is sent deltas against it from then on.
+	void SendWorldState(CWorldSnapshot& xSnapshot, CSnapshotClient* pClient);
+
+	// Write a snapshot to a stream in full with the pellets and their respawn times packed as tightly as the current map allows.
+	void WriteWorldState(CWorldSnapshot& xSnapshot, BitStream* pStream);
+
+	// Read a world state from a stream, along with any pellets waiting to respawn.
+	xbool ReadWorldState(CWorldSnapshot& xSnapshot, t_PelletRespawnList& lxRespawns, BitStream* pStream);
+
+	// Get the index of each pellet block on the current map in order. Only these can be eaten so only these are sent.
+	void GetPelletBlocks(xarray<xint>& liBlocks);
+
+	// Capture and send snapshots to all clients.
+	void UpdateHost();
+
+	// Sort the players in a snapshot into sectors by block position.
+	void BuildSectors(CWorldSnapshot& xSnapshot);
+
+	// Mark the players in a snapshot that are within the interest radius of a client's player. A NULL player is interested in everyone.
+	void FindInterest(CWorldSnapshot& xSnapshot, CPlayer* pViewer);
+
+	// Build the players a client will be sent, holding back changes outside its interest until its next summary.
+	void BuildView(CWorldSnapshot& xSnapshot, CSnapshotClient* pClient, t_PlayerSnapshotList* plxBaselinePlayers, xbool bSummary);
+
+	// Log the bandwidth used by each client.
+	void UpdateStats();
+
+	// Log the prediction corrections made on this client.
+	void UpdateCorrectionStats();
+
+	// The ring of recent snapshots.
+	CWorldSnapshot m_xHistory[SNAPSHOT_HISTORY];
+
+	// The sequence number for the next snapshot.
+	xuint16 m_iNextID;
+
+	// The most recent snapshot received from the host.
+	xuint16 m_iReceivedID;
+
+	// Determines if any snapshot has been received from the host.
+	xbool m_bReceived;
+
+	// The unwrapped sequence number of the most recent snapshot received from the host.
+	xint m_iReceivedSequence;
+
+	// The client's estimate of the current time on the host's snapshot timeline.
+	xint m_iClock;
+
+	// The time in milliseconds that remote players are rendered behind the latest snapshot.
+	xint m_iInterpolationDelay;
+
+	// The per-client replication state indexed by peer ID.
+	CSnapshotClient m_xClients[NETWORK_PEER_INVALID_ID];
+
+	// The timer used to trigger each snapshot.
+	CTimer m_xSnapshotTimer;
+
+	// The timer used to trigger each bandwidth report.
+	CTimer m_xStatsTimer;
+
+	// The number of moves made during the current stats interval.
+	xint m_iMoveCount;
+
+	// The number of bits written for players during the current stats interval.
+	xint m_iPlayerBits;
+
+	// The number of players written during the current stats interval.
+	xint m_iPlayerCount;
+
+	// The codec used to pack player state.
+	CPlayerSnapshotCodec m_xCodec;
+
+	// The world state statistics since starting.
+	xint m_iWorldStatesSent;
+	xint64 m_iWorldStateBytes;
+	xint m_iJoinCount;
+	xint64 m_iJoinTime;
+	xint m_iJoinTimeMax;
+
+	// The connection time the client last reported becoming playable after.
+	xuint m_iJoinConnectTime;
+
+	// The players in the current snapshot sorted by block position.
+	GridSectorizer m_xSectorizer;
+
+	// The players found near a client by the sectorizer.
+	DataStructures::List<void*> m_lpNearbyPlayers;
+
+	// Determines if each player in the current snapshot is within the interest radius of the client being sent to.
+	xarray<xbool> m_lbInterested;
+
+	// The timer used to trigger each correction report.
+	CTimer m_xCorrectionTimer;
+
+	// The number of corrections made during the current correction interval.
+	xint m_iCorrectionCount;
+
+	// The total size in blocks of all corrections made during the current correction interval.
+	xint m_iCorrectionTotal;
+
+	// The largest correction in blocks made during the current correction interval.
+	xint m_iCorrectionMax;
+};
+
+//##############################################################################
\ No newline at end of file
@@ -0,0 +1,205 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Trace.h>
+
+// Other.
+#include <Network.h>
+#include <Profile.h>
+
+// System.
+#include <algorithm>
+
+//##############################################################################
+
+// =============================================================================
+CPacketTrace::CPacketTrace() :
+	m_iWriteIndex(0)
+{
+	m_iStartCounter = CProfileManager::GetCounter();
+
+	memset(m_xEvents, 0, sizeof(m_xEvents));
+}
+
+// =============================================================================
+void CPacketTrace::Record(xint iIdentifier, xint iStreamType, xint iPeer, xint iSize, xint iFlags)
+{
+	// Claiming a slot is the only shared write, so writers on different threads never wait on each other.
+	LONG iIndex = InterlockedIncrement(&m_iWriteIndex) - 1;
+	CPacketTraceEvent* pEvent = &m_xEvents[iIndex & (PACKET_TRACE_SIZE - 1)];
+
+	// Clearing the sequence first marks the slot as being written for any dump copying it at the same time.
+	InterlockedExchange(&pEvent->m_iSequence, 0);
+
+	pEvent->m_iTime = (xuint32)(CProfileManager::GetMilliseconds(CProfileManager::GetCounter() - m_iStartCounter) * 1000.0);
+	pEvent->m_iSize = (xuint32)iSize;
+	pEvent->m_iIdentifier = (xuint8)iIdentifier;
+	pEvent->m_iStreamType = (xuint8)iStreamType;
+	pEvent->m_iPeer = (xuint8)iPeer;
+	pEvent->m_iFlags = (xuint8)iFlags;
+
+	// Publish the sequence only once every field is written. The exchange is a full barrier so the fields can't be seen after it.
+	InterlockedExchange(&pEvent->m_iSequence, iIndex + 1);
+}
+
+// =============================================================================
+xbool CPacketTrace::Dump(const xchar* pReason)
+{
+	CPacketTraceHeader xHeader;
+
+	xHeader.m_iMagic = PACKET_TRACE_MAGIC;
+	xHeader.m_iVersion = PACKET_TRACE_VERSION;
+	xHeader.m_iSize = PACKET_TRACE_SIZE;
+	xHeader.m_iWriteIndex = (xuint32)m_iWriteIndex;
+
+	xstring sFile = XFORMAT("PacketTrace_%u.ppt", _TIMEMS);
+	CWinFile* pFile = FileManager.Create(sFile.c_str(), FileFlag_WriteOnly | FileFlag_OverwriteExisting);
+
+	if (!pFile)
+	{
+		XLOG("[PacketTrace] Failed to write the trace to '%s'.", sFile.c_str());
+		return false;
+	}
+
+	// Events may still be recorded while the ring is copied, so an event is only kept if its sequence is the same either side of the copy.
+	xarray<CPacketTraceEvent> lxEvents(PACKET_TRACE_SIZE);
+
+	for (xint iA = 0; iA < PACKET_TRACE_SIZE; ++iA)
+	{
+		CPacketTraceEvent* pEvent = &m_xEvents[iA];
+		LONG iSequence = pEvent->m_iSequence;
+
+		MemoryBarrier();
+		lxEvents[iA] = *pEvent;
+		MemoryBarrier();
+
+		if (!iSequence || pEvent->m_iSequence != iSequence)
+			iSequence = 0;
+
+		lxEvents[iA].m_iSequence = iSequence;
+	}
+
+	pFile->Write(&xHeader, sizeof(xHeader));
+	pFile->Write(&lxEvents[0], PACKET_TRACE_SIZE * sizeof(CPacketTraceEvent));
+
+	FileManager.Close(pFile);
+
+	XLOG("[PacketTrace] Dumped %u events to '%s' (%s).", Math::Min<xuint32>(xHeader.m_iWriteIndex, PACKET_TRACE_SIZE), sFile.c_str(), pReason);
+
+	return true;
+}
+
+// =============================================================================
+xbool CPacketTrace::Decode(const xchar* pFile)
+{
+	// The path is either quoted or the rest of the line, so paths with spaces in them can be given.
+	while (*pFile == ' ')
+		pFile++;
+
+	xstring sFile;
+
+	if (*pFile == '"')
+	{
+		const xchar* pEnd = strchr(pFile + 1, '"');
+		sFile = pEnd ? xstring(pFile + 1, pEnd) : xstring(pFile + 1);
+	}
+	else
+	{
+		sFile = pFile;
+		sFile = sFile.substr(0, sFile.find_last_not_of(" \t\r\n") + 1);
+	}
+
+	CWinFile* pTraceFile = FileManager.Open(sFile.c_str(), FileFlag_ReadOnly);
+
+	if (!pTraceFile)
+	{
+		XLOG("[PacketTrace] Failed to open the trace '%s'.", sFile.c_str());
+		return false;
+	}
+
+	CPacketTraceHeader xHeader;
+	memset(&xHeader, 0, sizeof(xHeader));
+
+	pTraceFile->Read(&xHeader, sizeof(xHeader));
+
+	if (xHeader.m_iMagic != PACKET_TRACE_MAGIC || xHeader.m_iVersion != PACKET_TRACE_VERSION || xHeader.m_iSize == 0 || (xHeader.m_iSize & (xHeader.m_iSize - 1)))
+	{
+		FileManager.Close(pTraceFile);
+
+		XLOG("[PacketTrace] The file '%s' is not a compatible trace.", sFile.c_str());
+		return false;
+	}
+
+	xarray<CPacketTraceEvent> lxEvents(xHeader.m_iSize);
+
+	pTraceFile->Read(&lxEvents[0], xHeader.m_iSize * sizeof(CPacketTraceEvent));
+	FileManager.Close(pTraceFile);
+
+	// Keep the events that were complete, belong to their slot and weren't overwritten while dumping.
+	xuint32 iOldest = (xHeader.m_iWriteIndex > xHeader.m_iSize) ? xHeader.m_iWriteIndex - xHeader.m_iSize : 0;
+	xint iCount = 0;
+
+	for (xint iA = 0; iA < (xint)lxEvents.size(); ++iA)
+	{
+		xuint32 iSequence = (xuint32)lxEvents[iA].m_iSequence;
+
+		if (iSequence > iOldest && iSequence <= xHeader.m_iWriteIndex && ((iSequence - 1) & (xHeader.m_iSize - 1)) == (xuint32)iA)
+			lxEvents[iCount++] = lxEvents[iA];
+	}
+
+	lxEvents.resize(iCount);
+	std::sort(lxEvents.begin(), lxEvents.end(), &CompareEvents);
+
+	// Write the text version.
+	xstring sOutput = sFile + ".txt";
+	CWinFile* pTextFile = FileManager.Create(sOutput.c_str(), FileFlag_WriteOnly | FileFlag_OverwriteExisting);
+
+	if (!pTextFile)
+	{
+		XLOG("[PacketTrace] Failed to write the decoded trace to '%s'.", sOutput.c_str());
+		return false;
+	}
+
+	// The times are 32-bit microseconds so they wrap about every 71 minutes, which is undone by watching for them going backwards.
+	xuint64 iTimeBase = 0;
+	xuint32 iLastTime = lxEvents.size() ? lxEvents[0].m_iTime : 0;
+
+	for (xint iA = 0; iA < iCount; ++iA)
+	{
+		CPacketTraceEvent& xEvent = lxEvents[iA];
+
+		if (xEvent.m_iTime < iLastTime)
+			iTimeBase += 0x100000000ULL;
+
+		iLastTime = xEvent.m_iTime;
+
+		const xchar* pLine = XFORMAT("%12.3fms %-3s %-34s stream %3d peer %3d %6u bytes%s%s\r\n",
+			(xdouble)(iTimeBase + xEvent.m_iTime) / 1000.0,
+			(xEvent.m_iFlags & PacketTraceFlag_Outgoing) ? "out" : "in",
+			CNetworkManager::GetPacketName(xEvent.m_iIdentifier),
+			xEvent.m_iStreamType,
+			xEvent.m_iPeer,
+			xEvent.m_iSize,
+			(xEvent.m_iFlags & PacketTraceFlag_Broadcast) ? " broadcast" : "",
+			(xEvent.m_iFlags & PacketTraceFlag_Relayed) ? " relayed" : "");
+
+		pTextFile->Write(pLine, (xint)strlen(pLine));
+	}
+
+	FileManager.Close(pTextFile);
+
+	XLOG("[PacketTrace] Decoded %d events from '%s' to '%s'.", iCount, sFile.c_str(), sOutput.c_str());
+
+	return true;
+}
+
+// =============================================================================
+xbool CPacketTrace::CompareEvents(const CPacketTraceEvent& xA, const CPacketTraceEvent& xB)
+{
+	return (xuint32)xA.m_iSequence < (xuint32)xB.m_iSequence;
+}
+
+//##############################################################################
@@ -0,0 +1,110 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define PacketTrace CPacketTrace::Get()
+
+// The packet trace file identifier.
+#define PACKET_TRACE_MAGIC 0x52544B50
+
+// The packet trace file format version.
+#define PACKET_TRACE_VERSION 1
+
+// The number of events the trace holds before the oldest are overwritten. This must be a power of two.
+#define PACKET_TRACE_SIZE 65536
+
+// The command line option that decodes a packet trace dump to text.
+#define PACKET_TRACE_DECODE_OPTION "-decodetrace "
+
+//##############################################################################
+
+// The packet trace event flags.
+enum t_PacketTraceFlag
+{
+	PacketTraceFlag_Outgoing	= XBIT(0),	// The packet was sent rather than received.
+	PacketTraceFlag_Broadcast	= XBIT(1),	// The packet was sent to every connected system.
+	PacketTraceFlag_Relayed		= XBIT(2),	// The packet was forwarded by the host for another peer.
+};
+
+//##############################################################################
+
+// A fixed-size record of a packet passing through the network manager.
+class CPacketTraceEvent
+{
+public:
+	// The position of the event in the trace plus one. This is written last so that an event still being written can be spotted.
+	volatile LONG m_iSequence;
+
+	// The time in microseconds since the trace started.
+	xuint32 m_iTime;
+
+	// The size of the packet in bytes.
+	xuint32 m_iSize;
+
+	// The RakNet message identifier.
+	xuint8 m_iIdentifier;
+
+	// The stream type for data packets.
+	xuint8 m_iStreamType;
+
+	// The ID of the peer the packet came from or went to.
+	xuint8 m_iPeer;
+
+	// The event flags.
+	xuint8 m_iFlags;
+};
+
+// The header written ahead of the events in a dump.
+class CPacketTraceHeader
+{
+public:
+	xuint32 m_iMagic;
+	xuint32 m_iVersion;
+	xuint32 m_iSize;
+	xuint32 m_iWriteIndex;
+};
+
+//##############################################################################
+class CPacketTrace
+{
+public:
+	// Singleton instance.
+	static inline CPacketTrace& Get()
+	{
+		static CPacketTrace s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CPacketTrace();
+
+	// Record a packet event, overwriting the oldest once the trace is full. This never blocks and may be called from any thread.
+	void Record(xint iIdentifier, xint iStreamType, xint iPeer, xint iSize, xint iFlags);
+
+	// Write the trace to a new file in binary form. The reason is only logged.
+	xbool Dump(const xchar* pReason);
+
+	// Decode a dump to a text file alongside it, with one line per event from oldest to newest. The path may be quoted, otherwise it's the rest of the line.
+	static xbool Decode(const xchar* pFile);
+
+protected:
+	// Sort events by sequence.
+	static xbool CompareEvents(const CPacketTraceEvent& xA, const CPacketTraceEvent& xB);
+
+	// The number of events recorded since starting.
+	volatile LONG m_iWriteIndex;
+
+	// The counter value when the trace started.
+	xint64 m_iStartCounter;
+
+	// The event ring.
+	CPacketTraceEvent m_xEvents[PACKET_TRACE_SIZE];
+};
+
+//##############################################################################
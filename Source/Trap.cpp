@@ -15,4 +15,46 @@
 // Local.
 #include <Trap.h>
 
+// Other.
+#include <Map.h>
+
+//##############################################################################
+
+// =============================================================================
+CTrap::CTrap(CMapBlock* pBlock) :
+	m_pBlock(pBlock),
+	m_pVictim(NULL)
+{
+	m_pBlock->m_pTrap = this;
+	TriggerManager.Register(this, m_pBlock->m_iIndex);
+}
+
+// =============================================================================
+CTrap::~CTrap()
+{
+	m_pBlock->m_pTrap = NULL;
+}
+
+// =============================================================================
+void CTrap::OnEnter(CPlayer* pPlayer)
+{
+	if (m_pVictim)
+		return;
+
+	m_pVictim = pPlayer;
+	TriggerManager.Schedule(this, TRAP_RESET_TIME);
+}
+
+// =============================================================================
+void CTrap::OnTimer(xint iData)
+{
+	m_pVictim = NULL;
+}
+
+// =============================================================================
+void CTrap::OnRestart()
+{
+	m_pVictim = NULL;
+}
+
 //##############################################################################
\ No newline at end of file
@@ -14,11 +14,50 @@
 // Global.
 #include <Global.h>
 
+// Other.
+#include <Trigger.h>
+
+//##############################################################################
+
+// The time in milliseconds a sprung trap takes to reset.
+#define TRAP_RESET_TIME 5000
+
+//##############################################################################
+
+// Predeclare.
+class CMapBlock;
+
 //##############################################################################
-class CTrap
+class CTrap : public CTrigger
 {
 public:
+	// Constructor. The trap is bound to the block and registered on it.
+	CTrap(CMapBlock* pBlock);
+
+	// Destructor.
+	virtual ~CTrap();
+
+	// Spring the trap on the first player to step on it.
+	virtual void OnEnter(CPlayer* pPlayer);
+
+	// Reset the trap once it has been sprung for long enough.
+	virtual void OnTimer(xint iData);
+
+	// Set the trap again.
+	virtual void OnRestart();
+
+	// Get the player that sprang the trap or NULL if it's set.
+	inline CPlayer* GetVictim()
+	{
+		return m_pVictim;
+	}
+
 protected:
+	// The block the trap is bound to.
+	CMapBlock* m_pBlock;
+
+	// The player that sprang the trap.
+	CPlayer* m_pVictim;
 };
 
 //##############################################################################
\ No newline at end of file
@@ -0,0 +1,207 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Trigger.h>
+
+// System.
+#include <algorithm>
+
+//##############################################################################
+
+// =============================================================================
+CTrigger::CTrigger() :
+	m_iBlock(-1),
+	m_pNext(NULL),
+	m_pPrev(NULL)
+{
+}
+
+// =============================================================================
+CTrigger::~CTrigger()
+{
+	TriggerManager.Unregister(this);
+	TriggerManager.Cancel(this);
+}
+
+//##############################################################################
+
+// =============================================================================
+CTriggerManager::CTriggerManager() :
+	m_iClock(0),
+	m_iTimerCount(0)
+{
+}
+
+// =============================================================================
+void CTriggerManager::Reset(xint iBlockCount)
+{
+	// Any triggers still registered are detached so that they don't point into the old index.
+	XEN_LIST_FOREACH(t_TriggerList, ppTrigger, m_lpFirstTrigger)
+	{
+		for (CTrigger* pTrigger = *ppTrigger; pTrigger;)
+		{
+			CTrigger* pNext = pTrigger->m_pNext;
+
+			pTrigger->m_iBlock = -1;
+			pTrigger->m_pNext = NULL;
+			pTrigger->m_pPrev = NULL;
+
+			pTrigger = pNext;
+		}
+	}
+
+	m_lpFirstTrigger.assign(iBlockCount, NULL);
+	m_lxTimers.clear();
+
+	m_iClock = 0;
+	m_iTimerCount = 0;
+}
+
+// =============================================================================
+void CTriggerManager::Restart()
+{
+	m_lxTimers.clear();
+
+	m_iClock = 0;
+	m_iTimerCount = 0;
+
+	XEN_LIST_FOREACH(t_TriggerList, ppTrigger, m_lpFirstTrigger)
+	{
+		for (CTrigger* pTrigger = *ppTrigger; pTrigger; pTrigger = pTrigger->m_pNext)
+			pTrigger->OnRestart();
+	}
+}
+
+// =============================================================================
+void CTriggerManager::Register(CTrigger* pTrigger, xint iBlock)
+{
+	XMASSERT(iBlock >= 0 && iBlock < (xint)m_lpFirstTrigger.size(), "A trigger was registered on a block outside of the map.");
+
+	Unregister(pTrigger);
+
+	CTrigger* pFirst = m_lpFirstTrigger[iBlock];
+
+	if (pFirst)
+		pFirst->m_pPrev = pTrigger;
+
+	pTrigger->m_iBlock = iBlock;
+	pTrigger->m_pNext = pFirst;
+	pTrigger->m_pPrev = NULL;
+
+	m_lpFirstTrigger[iBlock] = pTrigger;
+}
+
+// =============================================================================
+void CTriggerManager::Unregister(CTrigger* pTrigger)
+{
+	if (pTrigger->m_iBlock == -1)
+		return;
+
+	if (pTrigger->m_pPrev)
+		pTrigger->m_pPrev->m_pNext = pTrigger->m_pNext;
+	else
+		m_lpFirstTrigger[pTrigger->m_iBlock] = pTrigger->m_pNext;
+
+	if (pTrigger->m_pNext)
+		pTrigger->m_pNext->m_pPrev = pTrigger->m_pPrev;
+
+	pTrigger->m_iBlock = -1;
+	pTrigger->m_pNext = NULL;
+	pTrigger->m_pPrev = NULL;
+}
+
+// =============================================================================
+void CTriggerManager::Schedule(CTrigger* pTrigger, xint iDelay, xint iData)
+{
+	CTriggerTimer xTimer;
+
+	xTimer.m_iTime = m_iClock + iDelay;
+	xTimer.m_iOrder = m_iTimerCount++;
+	xTimer.m_pTrigger = pTrigger;
+	xTimer.m_iData = iData;
+
+	m_lxTimers.push_back(xTimer);
+	std::push_heap(m_lxTimers.begin(), m_lxTimers.end(), &CTriggerManager::CompareTimers);
+}
+
+// =============================================================================
+void CTriggerManager::Cancel(CTrigger* pTrigger)
+{
+	xint iCount = (xint)m_lxTimers.size();
+
+	for (xint iA = 0; iA < (xint)m_lxTimers.size();)
+	{
+		if (m_lxTimers[iA].m_pTrigger == pTrigger)
+		{
+			m_lxTimers[iA] = m_lxTimers.back();
+			m_lxTimers.pop_back();
+		}
+		else
+			++iA;
+	}
+
+	if ((xint)m_lxTimers.size() != iCount)
+		std::make_heap(m_lxTimers.begin(), m_lxTimers.end(), &CTriggerManager::CompareTimers);
+}
+
+// =============================================================================
+void CTriggerManager::Update()
+{
+	m_iClock += _TIMEDELTA;
+
+	// Only the timers that are due are looked at, however many are waiting.
+	while (m_lxTimers.size() && m_lxTimers.front().m_iTime <= m_iClock)
+	{
+		CTriggerTimer xTimer = m_lxTimers.front();
+
+		std::pop_heap(m_lxTimers.begin(), m_lxTimers.end(), &CTriggerManager::CompareTimers);
+		m_lxTimers.pop_back();
+
+		xTimer.m_pTrigger->OnTimer(xTimer.m_iData);
+	}
+}
+
+// =============================================================================
+void CTriggerManager::OnEnter(CPlayer* pPlayer, xint iBlock)
+{
+	if (iBlock < 0 || iBlock >= (xint)m_lpFirstTrigger.size())
+		return;
+
+	for (CTrigger* pTrigger = m_lpFirstTrigger[iBlock]; pTrigger;)
+	{
+		CTrigger* pNext = pTrigger->m_pNext;
+
+		pTrigger->OnEnter(pPlayer);
+		pTrigger = pNext;
+	}
+}
+
+// =============================================================================
+void CTriggerManager::OnLeave(CPlayer* pPlayer, xint iBlock)
+{
+	if (iBlock < 0 || iBlock >= (xint)m_lpFirstTrigger.size())
+		return;
+
+	for (CTrigger* pTrigger = m_lpFirstTrigger[iBlock]; pTrigger;)
+	{
+		CTrigger* pNext = pTrigger->m_pNext;
+
+		pTrigger->OnLeave(pPlayer);
+		pTrigger = pNext;
+	}
+}
+
+// =============================================================================
+xbool CTriggerManager::CompareTimers(const CTriggerTimer& xA, const CTriggerTimer& xB)
+{
+	// The heap keeps the largest at the top so the later timer counts as the smaller.
+	if (xA.m_iTime != xB.m_iTime)
+		return xA.m_iTime > xB.m_iTime;
+
+	return xA.m_iOrder > xB.m_iOrder;
+}
+
+//##############################################################################
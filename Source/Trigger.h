@@ -0,0 +1,151 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define TriggerManager CTriggerManager::Get()
+
+//##############################################################################
+
+// Predeclare.
+class CPlayer;
+class CTrigger;
+
+// A timed effect waiting to fire on a trigger.
+class CTriggerTimer
+{
+public:
+	// The trigger clock time to fire at.
+	xint m_iTime;
+
+	// The order the timer was scheduled in, so that timers due at the same time fire in the order they were set.
+	xuint m_iOrder;
+
+	// The trigger to fire on.
+	CTrigger* m_pTrigger;
+
+	// A value passed back to the trigger when it fires.
+	xint m_iData;
+};
+
+// Lists.
+typedef xarray<CTrigger*> t_TriggerList;
+typedef xarray<CTriggerTimer> t_TriggerTimerList;
+
+//##############################################################################
+
+// Something bound to a map block that reacts to players entering and leaving it. Triggers are only told about the blocks they're registered on so their cost follows the number of players changing blocks rather than the number of players and triggers.
+class CTrigger
+{
+public:
+	// Friends.
+	friend class CTriggerManager;
+
+	// Constructor.
+	CTrigger();
+
+	// Destructor. This unregisters the trigger and cancels its timers.
+	virtual ~CTrigger();
+
+	// Called when a player arrives on the trigger's block.
+	virtual void OnEnter(CPlayer* pPlayer)
+	{
+	}
+
+	// Called when a player moves off the trigger's block.
+	virtual void OnLeave(CPlayer* pPlayer)
+	{
+	}
+
+	// Called when a timer scheduled by the trigger is due.
+	virtual void OnTimer(xint iData)
+	{
+	}
+
+	// Called when a match starts to put the trigger back in its starting state.
+	virtual void OnRestart()
+	{
+	}
+
+	// Get the index of the block the trigger is registered on or -1 if it isn't.
+	inline xint GetBlock()
+	{
+		return m_iBlock;
+	}
+
+protected:
+	// The index of the block the trigger is registered on.
+	xint m_iBlock;
+
+	// The next and previous triggers on the same block.
+	CTrigger* m_pNext;
+	CTrigger* m_pPrev;
+};
+
+//##############################################################################
+class CTriggerManager
+{
+public:
+	// Singleton instance, or the instance belonging to the match bound to the calling thread.
+	static inline CTriggerManager& Get()
+	{
+		if (CMatchContext* pContext = CMatchContext::GetCurrent())
+			return *pContext->m_pTriggerManager;
+
+		static CTriggerManager s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CTriggerManager();
+
+	// Size the block index for a map, dropping every registered trigger and pending timer.
+	void Reset(xint iBlockCount);
+
+	// Start the trigger clock again for a new match, dropping every pending timer and restarting the registered triggers.
+	void Restart();
+
+	// Register a trigger on a block, moving it from any block it was already on.
+	void Register(CTrigger* pTrigger, xint iBlock);
+
+	// Remove a trigger from its block.
+	void Unregister(CTrigger* pTrigger);
+
+	// Fire a trigger's timer after a number of milliseconds of simulation time.
+	void Schedule(CTrigger* pTrigger, xint iDelay, xint iData = 0);
+
+	// Cancel every timer waiting on a trigger.
+	void Cancel(CTrigger* pTrigger);
+
+	// Advance the trigger clock and fire the timers that are due.
+	void Update();
+
+	// Tell the triggers on a block that a player has arrived. A trigger may unregister itself while handling this but not others on the same block.
+	void OnEnter(CPlayer* pPlayer, xint iBlock);
+
+	// Tell the triggers on a block that a player has left.
+	void OnLeave(CPlayer* pPlayer, xint iBlock);
+
+protected:
+	// Order timers so that the earliest is at the top of the heap.
+	static xbool CompareTimers(const CTriggerTimer& xA, const CTriggerTimer& xB);
+
+	// The first trigger on each block or NULL if it has none.
+	t_TriggerList m_lpFirstTrigger;
+
+	// The pending timers, kept as a heap.
+	t_TriggerTimerList m_lxTimers;
+
+	// The simulation time in milliseconds used for timers.
+	xint m_iClock;
+
+	// The number of timers scheduled.
+	xuint m_iTimerCount;
+};
+
+//##############################################################################
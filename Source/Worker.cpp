@@ -0,0 +1,149 @@
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+// Local.
+#include <Worker.h>
+
+// System.
+#include <Windows.h>
+#include <process.h>
+
+//##############################################################################
+
+// =============================================================================
+CWorkerPool::CWorkerPool() :
+	m_hStart(NULL),
+	m_hFinished(NULL),
+	m_pJob(NULL),
+	m_iCount(0),
+	m_iNext(0),
+	m_iRemaining(0),
+	m_bStopping(false)
+{
+}
+
+// =============================================================================
+void CWorkerPool::OnInitialise()
+{
+	SYSTEM_INFO xInfo;
+	GetSystemInfo(&xInfo);
+
+	// The calling thread always takes part so only the spare processors need a thread.
+	xint iThreadCount = Math::Clamp<xint>((xint)xInfo.dwNumberOfProcessors - 1, 0, WORKER_THREAD_LIMIT);
+
+	m_hStart = CreateSemaphore(NULL, 0, WORKER_THREAD_LIMIT * 2, NULL);
+	m_hFinished = CreateEvent(NULL, FALSE, FALSE, NULL);
+	m_bStopping = false;
+
+	for (xint iA = 0; iA < iThreadCount; ++iA)
+	{
+		HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, &CWorkerPool::ThreadMain, this, 0, NULL);
+
+		if (hThread)
+			m_lhThreads.push_back(hThread);
+	}
+
+	XLOG("[WorkerPool] Started %d worker threads.", GetThreadCount());
+}
+
+// =============================================================================
+void CWorkerPool::OnDeinitialise()
+{
+	m_bStopping = true;
+
+	if (GetThreadCount())
+	{
+		ReleaseSemaphore(m_hStart, GetThreadCount(), NULL);
+		WaitForMultipleObjects((DWORD)m_lhThreads.size(), &m_lhThreads[0], TRUE, INFINITE);
+	}
+
+	XEN_LIST_FOREACH(t_ThreadHandleList, phThread, m_lhThreads)
+		CloseHandle(*phThread);
+
+	m_lhThreads.clear();
+
+	CloseHandle(m_hStart);
+	CloseHandle(m_hFinished);
+
+	m_hStart = NULL;
+	m_hFinished = NULL;
+}
+
+// =============================================================================
+void CWorkerPool::Execute(CWorkerJob* pJob, xint iCount)
+{
+	if (iCount <= 0)
+		return;
+
+	// Small jobs aren't worth waking the workers for. The workers also can't see a match bound to the calling thread, and matches on other threads would share the job slot, so hosted matches run their jobs in place.
+	if (iCount == 1 || !GetThreadCount() || CMatchContext::GetCurrent())
+	{
+		for (xint iA = 0; iA < iCount; ++iA)
+			pJob->Execute(iA);
+
+		return;
+	}
+
+	xint iWakeCount = Math::Min<xint>(GetThreadCount(), iCount - 1);
+
+	// Each woken worker also checks out so that none can still be looking at this job when the next one starts.
+	m_pJob = pJob;
+	m_iCount = iCount;
+	m_iRemaining = iCount + iWakeCount;
+
+	InterlockedExchange(&m_iNext, 0);
+
+	ReleaseSemaphore(m_hStart, iWakeCount, NULL);
+
+	RunItems();
+
+	WaitForSingleObject(m_hFinished, INFINITE);
+
+	m_pJob = NULL;
+}
+
+// =============================================================================
+void CWorkerPool::RunItems()
+{
+	while (true)
+	{
+		xint iIndex = (xint)InterlockedIncrement(&m_iNext) - 1;
+
+		if (iIndex >= m_iCount)
+			break;
+
+		m_pJob->Execute(iIndex);
+
+		Finish();
+	}
+}
+
+// =============================================================================
+void CWorkerPool::Finish()
+{
+	if (InterlockedDecrement(&m_iRemaining) == 0)
+		SetEvent(m_hFinished);
+}
+
+// =============================================================================
+xuint __stdcall CWorkerPool::ThreadMain(void* pParam)
+{
+	CWorkerPool* pPool = (CWorkerPool*)pParam;
+
+	while (true)
+	{
+		WaitForSingleObject(pPool->m_hStart, INFINITE);
+
+		if (pPool->m_bStopping)
+			break;
+
+		pPool->RunItems();
+		pPool->Finish();
+	}
+
+	return 0;
+}
+
+//##############################################################################
@@ -0,0 +1,96 @@
+#pragma once
+
+//##############################################################################
+
+// Global.
+#include <Global.h>
+
+//##############################################################################
+
+// Shortcuts.
+#define WorkerPool CWorkerPool::Get()
+
+// The most worker threads the pool will start.
+#define WORKER_THREAD_LIMIT 8
+
+//##############################################################################
+
+// Lists.
+typedef xarray<HANDLE> t_ThreadHandleList;
+
+//##############################################################################
+class CWorkerJob
+{
+public:
+	// Destructor.
+	virtual ~CWorkerJob() {}
+
+	// Execute a single item of the job. Items may run on any thread and in any order.
+	virtual void Execute(xint iIndex) = 0;
+};
+
+//##############################################################################
+class CWorkerPool : public CModule
+{
+public:
+	// Singleton instance.
+	static inline CWorkerPool& Get()
+	{
+		static CWorkerPool s_Instance;
+		return s_Instance;
+	}
+
+	// Constructor.
+	CWorkerPool();
+
+	// Start a worker thread for each spare processor.
+	virtual void OnInitialise();
+
+	// Stop all worker threads.
+	virtual void OnDeinitialise();
+
+	// Run every item of a job across the worker threads and the calling thread, returning once all items have finished.
+	void Execute(CWorkerJob* pJob, xint iCount);
+
+	// Get the number of worker threads excluding the calling thread.
+	inline xint GetThreadCount()
+	{
+		return (xint)m_lhThreads.size();
+	}
+
+protected:
+	// The worker thread entry point.
+	static xuint __stdcall ThreadMain(void* pParam);
+
+	// Execute items of the current job until none remain.
+	void RunItems();
+
+	// Count down an item or a worker checking out and signal when the job is complete.
+	void Finish();
+
+	// The worker thread handles.
+	t_ThreadHandleList m_lhThreads;
+
+	// Released once for each worker woken for a job.
+	HANDLE m_hStart;
+
+	// Signalled when the last item of a job finishes.
+	HANDLE m_hFinished;
+
+	// The job being executed.
+	CWorkerJob* volatile m_pJob;
+
+	// The number of items in the job being executed.
+	volatile long m_iCount;
+
+	// The next item to execute.
+	volatile long m_iNext;
+
+	// The number of items and woken workers still to finish.
+	volatile long m_iRemaining;
+
+	// Determines if the worker threads should exit.
+	volatile xbool m_bStopping;
+};
+
+//##############################################################################
@@ -0,0 +1,397 @@
+//##############################################################################
+//
+//                                   INCLUDE
+//
+//##############################################################################
+
+// Local.
+#include <Main.h>
+
+// Standard Lib.
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+// RakNet.
+#include <RakNetworkFactory.h>
+#include <RakPeerInterface.h>
+#include <MessageIdentifiers.h>
+#include <RakNetStatistics.h>
+#include <BitStream.h>
+#include <SocketLayer.h>
+#include <GetTime.h>
+#include <RakSleep.h>
+
+//##############################################################################
+
+//##############################################################################
+//
+//                                   MACROS
+//
+//##############################################################################
+
+// The instruction sheet.
+#define TEXT_HEADER \
+		"\n" \
+		"  Network Benchmark" "\n" \
+		"  Revision 2" "\n" \
+		"  ---------------------------------------------------------------------------  " "\n" \
+		"  Usage: NetworkBenchmark [message bytes] [seconds per run] [send path messages]" "\n" \
+		"\n" \
+
+// The address both peers bind to.
+#define BENCHMARK_ADDRESS "127.0.0.1"
+
+// The time in milliseconds each update thread may wait between cycles, as the game passes for NETWORK_THREAD_WAIT_TIME.
+#define BENCHMARK_THREAD_WAIT_TIME 50
+
+// The time in milliseconds to wait for the sender to connect.
+#define BENCHMARK_CONNECT_TIMEOUT 2000
+
+// The default size of each message, large enough that every message is sent in its own datagram.
+#define BENCHMARK_DEFAULT_BYTES 1000
+
+// The default time in seconds each run is measured for.
+#define BENCHMARK_DEFAULT_TIME 5
+
+// The most messages left waiting in the sender's queues before it stops sending more.
+#define BENCHMARK_SEND_WINDOW 512
+
+// The default number of messages sent for each payload size when measuring the send path.
+#define BENCHMARK_DEFAULT_SEND_MESSAGES 200000
+
+// The time in milliseconds to wait for sent messages to arrive before discarding them.
+#define BENCHMARK_DRAIN_TIME 100
+
+// The size of the game's standard data packet header, as written by CNetworkManager::WriteHeader.
+#define BENCHMARK_HEADER_BYTES 3
+
+//##############################################################################
+
+//##############################################################################
+//
+//                                    TYPES
+//
+//##############################################################################
+
+// The results of a run.
+struct t_BenchmarkResult
+{
+	// Determines if the peers connected.
+	bool m_bConnected;
+
+	// The messages and datagrams the receiver took in.
+	unsigned m_iMessages;
+	unsigned m_iDatagrams;
+
+	// The time in milliseconds the run was measured for.
+	RakNetTime m_iTime;
+};
+
+//##############################################################################
+
+//##############################################################################
+//
+//                                  FUNCTIONS
+//
+//##############################################################################
+
+// =============================================================================
+// Start a sender and a receiver on the loopback and wait for the sender to
+// connect. Returns false if they didn't connect in time.
+// =============================================================================
+static bool StartPeers(RakPeerInterface* pSender, RakPeerInterface* pReceiver, SystemAddress& xReceiverAddress, SystemAddress& xSenderAddress)
+{
+	SocketDescriptor xSenderSocket(0, BENCHMARK_ADDRESS);
+	SocketDescriptor xReceiverSocket(0, BENCHMARK_ADDRESS);
+
+	pReceiver->Startup(1, BENCHMARK_THREAD_WAIT_TIME, &xReceiverSocket, 1);
+	pReceiver->SetMaximumIncomingConnections(1);
+
+	pSender->Startup(1, BENCHMARK_THREAD_WAIT_TIME, &xSenderSocket, 1);
+	pSender->Connect(BENCHMARK_ADDRESS, pReceiver->GetInternalID(UNASSIGNED_SYSTEM_ADDRESS).port, NULL, 0, 0);
+
+	xReceiverAddress = UNASSIGNED_SYSTEM_ADDRESS;
+	xSenderAddress = UNASSIGNED_SYSTEM_ADDRESS;
+	RakNetTime iConnectStart = RakNet::GetTime();
+
+	while ((xReceiverAddress == UNASSIGNED_SYSTEM_ADDRESS || xSenderAddress == UNASSIGNED_SYSTEM_ADDRESS) && RakNet::GetTime() - iConnectStart < BENCHMARK_CONNECT_TIMEOUT)
+	{
+		while (Packet* pPacket = pSender->Receive())
+		{
+			if (pPacket->data[0] == ID_CONNECTION_REQUEST_ACCEPTED)
+				xReceiverAddress = pPacket->systemAddress;
+
+			pSender->DeallocatePacket(pPacket);
+		}
+
+		while (Packet* pPacket = pReceiver->Receive())
+		{
+			if (pPacket->data[0] == ID_NEW_INCOMING_CONNECTION)
+				xSenderAddress = pPacket->systemAddress;
+
+			pReceiver->DeallocatePacket(pPacket);
+		}
+
+		RakSleep(1);
+	}
+
+	return xReceiverAddress != UNASSIGNED_SYSTEM_ADDRESS && xSenderAddress != UNASSIGNED_SYSTEM_ADDRESS;
+}
+
+// =============================================================================
+// Shut down and destroy a pair of peers.
+// =============================================================================
+static void StopPeers(RakPeerInterface* pSender, RakPeerInterface* pReceiver)
+{
+	pSender->Shutdown(0);
+	pReceiver->Shutdown(0);
+
+	RakNetworkFactory::DestroyRakPeerInterface(pSender);
+	RakNetworkFactory::DestroyRakPeerInterface(pReceiver);
+}
+
+// =============================================================================
+// Connect a sender to a receiver over the loopback and stream messages from one
+// to the other for a number of seconds. Both peers send and receive every
+// datagram on their own update thread, through RunUpdateCycle.
+// =============================================================================
+static t_BenchmarkResult RunBenchmark(int iMessageBytes, int iSeconds)
+{
+	t_BenchmarkResult xResult;
+	memset(&xResult, 0, sizeof(xResult));
+
+	RakPeerInterface* pSender = RakNetworkFactory::GetRakPeerInterface();
+	RakPeerInterface* pReceiver = RakNetworkFactory::GetRakPeerInterface();
+
+	SystemAddress xReceiverAddress;
+	SystemAddress xSenderAddress;
+
+	xResult.m_bConnected = StartPeers(pSender, pReceiver, xReceiverAddress, xSenderAddress);
+
+	if (xResult.m_bConnected)
+	{
+		char* pMessage = new char[iMessageBytes];
+		memset(pMessage, 0, iMessageBytes);
+		pMessage[0] = ID_USER_PACKET_ENUM;
+
+		unsigned iStartDatagrams = pReceiver->GetStatistics(xSenderAddress)->packetsReceived;
+		RakNetTime iStart = RakNet::GetTime();
+		RakNetTime iEnd = iStart + (RakNetTime)iSeconds * 1000;
+
+		while (RakNet::GetTime() < iEnd)
+		{
+			// Keep the sender's queue topped up without letting it grow without bound.
+			RakNetStatistics* pStatistics = pSender->GetStatistics(xReceiverAddress);
+			unsigned iQueued = pStatistics ? pStatistics->messageSendBuffer[HIGH_PRIORITY] : 0;
+
+			for (unsigned iA = iQueued; iA < BENCHMARK_SEND_WINDOW; ++iA)
+				pSender->Send(pMessage, iMessageBytes, HIGH_PRIORITY, UNRELIABLE, 0, xReceiverAddress, false);
+
+			bool bReceived = false;
+
+			while (Packet* pPacket = pReceiver->Receive())
+			{
+				if (pPacket->data[0] == ID_USER_PACKET_ENUM)
+					++xResult.m_iMessages;
+
+				pReceiver->DeallocatePacket(pPacket);
+				bReceived = true;
+			}
+
+			if (!bReceived)
+				RakSleep(0);
+		}
+
+		xResult.m_iTime = RakNet::GetTime() - iStart;
+		xResult.m_iDatagrams = pReceiver->GetStatistics(xSenderAddress)->packetsReceived - iStartDatagrams;
+
+		delete [] pMessage;
+	}
+
+	StopPeers(pSender, pReceiver);
+
+	return xResult;
+}
+
+// =============================================================================
+// Give the update threads a moment to deliver what was sent and discard it, so
+// that the next run starts from empty queues.
+// =============================================================================
+static void DrainPeer(RakPeerInterface* pReceiver)
+{
+	RakSleep(BENCHMARK_DRAIN_TIME);
+
+	while (Packet* pPacket = pReceiver->Receive())
+		pReceiver->DeallocatePacket(pPacket);
+}
+
+// =============================================================================
+// Measure the cost of building and handing messages to RakNet in the two ways
+// the game's network manager has used: building the payload in its own stream
+// and copying it into a new message stream behind the header, against writing
+// the payload straight into a pooled stream behind the header.
+// =============================================================================
+static void RunSendPathBenchmark(int iPayloadBytes, int iMessages)
+{
+	RakPeerInterface* pSender = RakNetworkFactory::GetRakPeerInterface();
+	RakPeerInterface* pReceiver = RakNetworkFactory::GetRakPeerInterface();
+
+	SystemAddress xReceiverAddress;
+	SystemAddress xSenderAddress;
+
+	if (!StartPeers(pSender, pReceiver, xReceiverAddress, xSenderAddress))
+	{
+		std::cout << "  Send path: Could not connect over the loopback." << "\n";
+		StopPeers(pSender, pReceiver);
+		return;
+	}
+
+	// Copy the payload into a new message stream for each message.
+	RakNetTimeNS iCopyStart = RakNet::GetTimeNS();
+
+	for (int iA = 0; iA < iMessages; ++iA)
+	{
+		RakNet::BitStream xPayload;
+
+		for (int iB = 0; iB < iPayloadBytes; ++iB)
+			xPayload.Write((unsigned char)iB);
+
+		RakNet::BitStream* pStream = new RakNet::BitStream;
+
+		pStream->Write((unsigned char)ID_USER_PACKET_ENUM);
+		pStream->Write((unsigned char)0);
+		pStream->Write((unsigned char)0);
+		pStream->Write(&xPayload);
+
+		pSender->Send(pStream, HIGH_PRIORITY, UNRELIABLE, 0, xReceiverAddress, false);
+		delete pStream;
+	}
+
+	RakNetTimeNS iCopyTime = RakNet::GetTimeNS() - iCopyStart;
+	DrainPeer(pReceiver);
+
+	// Write the payload straight into a stream taken from a pool, allocating only when the pool runs dry.
+	std::vector<RakNet::BitStream*> lpPool;
+	int iAllocations = 0;
+
+	RakNetTimeNS iPoolStart = RakNet::GetTimeNS();
+
+	for (int iA = 0; iA < iMessages; ++iA)
+	{
+		RakNet::BitStream* pStream;
+
+		if (lpPool.empty())
+		{
+			pStream = new RakNet::BitStream(BENCHMARK_HEADER_BYTES + iPayloadBytes);
+			++iAllocations;
+		}
+		else
+		{
+			pStream = lpPool.back();
+			lpPool.pop_back();
+		}
+
+		pStream->Write((unsigned char)ID_USER_PACKET_ENUM);
+		pStream->Write((unsigned char)0);
+		pStream->Write((unsigned char)0);
+
+		for (int iB = 0; iB < iPayloadBytes; ++iB)
+			pStream->Write((unsigned char)iB);
+
+		pSender->Send(pStream, HIGH_PRIORITY, UNRELIABLE, 0, xReceiverAddress, false);
+
+		pStream->Reset();
+		lpPool.push_back(pStream);
+	}
+
+	RakNetTimeNS iPoolTime = RakNet::GetTimeNS() - iPoolStart;
+	DrainPeer(pReceiver);
+
+	for (size_t iA = 0; iA < lpPool.size(); ++iA)
+		delete lpPool[iA];
+
+	StopPeers(pSender, pReceiver);
+
+	double fCopySeconds = iCopyTime > 0 ? iCopyTime / 1000000.0 : 0.000001;
+	double fPoolSeconds = iPoolTime > 0 ? iPoolTime / 1000000.0 : 0.000001;
+
+	std::cout << "  " << iPayloadBytes << " byte payloads copied: " << (unsigned)(iMessages / fCopySeconds) << " messages/sec, 1 stream allocation each" << "\n";
+	std::cout << "  " << iPayloadBytes << " byte payloads pooled: " << (unsigned)(iMessages / fPoolSeconds) << " messages/sec, " << iAllocations << " stream allocations in total" << "\n";
+}
+
+// =============================================================================
+// Write the results of a run.
+// =============================================================================
+static void ReportBenchmark(const char* pName, const t_BenchmarkResult& xResult)
+{
+	if (!xResult.m_bConnected)
+	{
+		std::cout << "  " << pName << ": Could not connect over the loopback." << "\n";
+		return;
+	}
+
+	double fSeconds = xResult.m_iTime > 0 ? xResult.m_iTime / 1000.0 : 1.0;
+
+	std::cout << "  " << pName << ": " << (unsigned)(xResult.m_iMessages / fSeconds) << " messages/sec, " << (unsigned)(xResult.m_iDatagrams / fSeconds) << " datagrams/sec" << "\n";
+}
+
+//##############################################################################
+
+//##############################################################################
+//
+//                                    MAIN
+//
+//##############################################################################
+
+// =============================================================================
+// Run the benchmark once with a system call per datagram and, where the
+// platform has recvmmsg and sendmmsg, once more with batched calls. Then
+// measure the send path for a small and a larger payload.
+// =============================================================================
+int main(int iNumArgs, const char* pArgs[])
+{
+	static const int s_iPayloadSizes[] = { 8, 128 };
+
+	int iMessageBytes = iNumArgs > 1 ? atoi(pArgs[1]) : BENCHMARK_DEFAULT_BYTES;
+	int iSeconds = iNumArgs > 2 ? atoi(pArgs[2]) : BENCHMARK_DEFAULT_TIME;
+	int iSendMessages = iNumArgs > 3 ? atoi(pArgs[3]) : BENCHMARK_DEFAULT_SEND_MESSAGES;
+
+	if (iMessageBytes < 1)
+		iMessageBytes = BENCHMARK_DEFAULT_BYTES;
+
+	if (iSeconds < 1)
+		iSeconds = BENCHMARK_DEFAULT_TIME;
+
+	if (iSendMessages < 1)
+		iSendMessages = BENCHMARK_DEFAULT_SEND_MESSAGES;
+
+	// Output the header.
+	std::cout << TEXT_HEADER;
+	std::cout << "  " << iMessageBytes << " byte messages, " << iSeconds << " seconds per run" << "\n";
+
+#ifdef SOCKET_LAYER_BATCHED_IO
+	SocketLayer::Instance()->SetBatchedIO(false);
+	ReportBenchmark("recvfrom/sendto", RunBenchmark(iMessageBytes, iSeconds));
+
+	SocketLayer::Instance()->SetBatchedIO(true);
+	ReportBenchmark("recvmmsg/sendmmsg", RunBenchmark(iMessageBytes, iSeconds));
+#else
+	ReportBenchmark("recvfrom/sendto", RunBenchmark(iMessageBytes, iSeconds));
+	std::cout << "  Batched socket calls are not available on this platform." << "\n";
+#endif
+
+	std::cout << "\n";
+	std::cout << "  " << iSendMessages << " messages per send path run" << "\n";
+
+	for (int iA = 0; iA < 2; ++iA)
+		RunSendPathBenchmark(s_iPayloadSizes[iA], iSendMessages);
+
+	std::cout << "\n";
+
+	// Exit.
+	return 0;
+}
+
+//##############################################################################
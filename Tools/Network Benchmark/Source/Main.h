@@ -0,0 +1,13 @@
+#pragma once
+
+//##############################################################################
+//
+//	Network Benchmark
+//	========================================================================
+//	Measures how many datagrams a pair of RakNet peers pass over the loopback
+//	through their update threads, with and without batched socket calls, and
+//	the cost of building messages by copying against writing into a pool.
+//	Build it with the Makefile on Linux, where the datagrams are batched, or
+//	with the project in Tools.sln on Windows, where each is its own call.
+//
+//##############################################################################
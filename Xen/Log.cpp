@@ -50,8 +50,8 @@
 // 
 ///////////////////////////////////////////////////////////////////////////
 static HANDLE s_hFile = INVALID_HANDLE_VALUE;
-static Xen::xchar s_cFormatBuffer[XEN_FORMAT_BUFFER_LENGTH];
-static Xen::xwchar s_wcFormatBuffer[XEN_FORMAT_BUFFER_LENGTH];
+static __declspec(thread) Xen::xchar s_cFormatBuffer[XEN_FORMAT_BUFFER_LENGTH];
+static __declspec(thread) Xen::xwchar s_wcFormatBuffer[XEN_FORMAT_BUFFER_LENGTH];
 
 ///////////////////////////////////////////////////////////////////////////
 // 
@@ -0,0 +1,32 @@
+//##############################################################################
+
+// Common.
+#include <Xen/Common.h>
+
+// Local.
+#include <Xen/Random.h>
+
+//##############################################################################
+namespace Xen
+{
+	// =============================================================================
+	void CRandom::Seed(xuint64 iSeed, xuint64 iStream)
+	{
+		// Spread the seed over the state with SplitMix64 so that similar seeds and streams still start far apart.
+		xuint64 iMix = iSeed ^ (iStream * 0xD1342543DE82EF95ULL);
+
+		for (xint iA = 0; iA < 4; ++iA)
+		{
+			iMix += 0x9E3779B97F4A7C15ULL;
+
+			xuint64 iValue = iMix;
+
+			iValue = (iValue ^ (iValue >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			iValue = (iValue ^ (iValue >> 27)) * 0x94D049BB133111EBULL;
+
+			m_iState[iA] = iValue ^ (iValue >> 31);
+		}
+	}
+}
+
+//##############################################################################
@@ -0,0 +1,98 @@
+#pragma once
+
+//##############################################################################
+
+// Common.
+#include <Xen/Common.h>
+
+//##############################################################################
+namespace Xen
+{
+	// A fast pseudo-random number generator using xoshiro256**. Each generator has its own state so separate systems can draw from their own sequence without disturbing each other.
+	class CRandom
+	{
+	public:
+		// Constructor.
+		CRandom()
+		{
+			Seed(1);
+		}
+
+		// Constructor.
+		CRandom(xuint64 iSeed, xuint64 iStream = 0)
+		{
+			Seed(iSeed, iStream);
+		}
+
+		// Seed the generator. The same seed and stream always give the same sequence and different streams of a seed are independent of each other.
+		void Seed(xuint64 iSeed, xuint64 iStream = 0);
+
+		// Get the next 64 random bits.
+		inline xuint64 Next()
+		{
+			xuint64 iResult = Rotate(m_iState[1] * 5, 7) * 9;
+			xuint64 iShifted = m_iState[1] << 17;
+
+			m_iState[2] ^= m_iState[0];
+			m_iState[3] ^= m_iState[1];
+			m_iState[1] ^= m_iState[2];
+			m_iState[0] ^= m_iState[3];
+
+			m_iState[2] ^= iShifted;
+			m_iState[3] = Rotate(m_iState[3], 45);
+
+			return iResult;
+		}
+
+		// Get a random number from zero up to but excluding a limit, or zero if the limit isn't positive.
+		inline xint GetInt(xint iLimit)
+		{
+			if (iLimit <= 0)
+				return 0;
+
+			// Scale the top bits into the range rather than taking a remainder, only drawing again in the rare case the scaling would favour some values.
+			xuint32 iRange = (xuint32)iLimit;
+			xuint64 iScaled = (Next() >> 32) * iRange;
+
+			if ((xuint32)iScaled < iRange)
+			{
+				xuint32 iThreshold = (xuint32)((0x100000000ULL - iRange) % iRange);
+
+				while ((xuint32)iScaled < iThreshold)
+					iScaled = (Next() >> 32) * iRange;
+			}
+
+			return (xint)(iScaled >> 32);
+		}
+
+		// Get a random number between two values inclusive.
+		inline xint GetRange(xint iMin, xint iMax)
+		{
+			return iMin + GetInt(iMax - iMin + 1);
+		}
+
+		// Get a random number from zero up to but excluding one.
+		inline xfloat GetFloat()
+		{
+			return (xfloat)(Next() >> 40) * (1.f / 16777216.f);
+		}
+
+		// Get a random true or false.
+		inline xbool GetBool()
+		{
+			return (Next() >> 63) != 0;
+		}
+
+	protected:
+		// Rotate the bits of a value left.
+		static inline xuint64 Rotate(xuint64 iValue, xint iBits)
+		{
+			return (iValue << iBits) | (iValue >> (64 - iBits));
+		}
+
+		// The generator state.
+		xuint64 m_iState[4];
+	};
+}
+
+//##############################################################################
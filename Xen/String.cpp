@@ -33,9 +33,9 @@
 
 //##############################################################################
 
-// Format.
-static Xen::xint s_iBufferIndex = XEN_FORMAT_BUFFER_COUNT;
-static Xen::xchar s_cFormatBuffer[XEN_FORMAT_BUFFER_COUNT][XEN_FORMAT_BUFFER_LENGTH];
+// Format. Each thread rotates through its own buffers so that formatting is safe from any thread.
+static __declspec(thread) Xen::xint s_iBufferIndex = XEN_FORMAT_BUFFER_COUNT;
+static __declspec(thread) Xen::xchar s_cFormatBuffer[XEN_FORMAT_BUFFER_COUNT][XEN_FORMAT_BUFFER_LENGTH];
 
 //##############################################################################
 
@@ -13,6 +13,7 @@
 #include <Xen/Memory.h>
 #include <Xen/String.h>
 #include <Xen/Math.h>
+#include <Xen/Random.h>
 #include <Xen/Module.h>
 #include <Xen/Screen.h>
 #include <Xen/Timer.h>